@@ -0,0 +1,238 @@
+/**
+ *  Compares the exact minimum ball of a point cloud with the streamed sphere and the old hemisphere heuristic,
+ *  in time and in radius, then times the point batch kernels, k-means clustering, k-d tree queries, keeping a
+ *  ball up to date while a few points move every frame and convex hulls.
+ *  Build with -DOGLBUBBLES_BUILD_BENCHMARKS=ON and run OGLBubblesCentroidBench.
+ */
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <functional>
+#include <random>
+#include <vector>
+
+#include "Centroid.hpp"
+#include "ConvexHull.hpp"
+#include "JobSystem.hpp"
+#include "KdTree.hpp"
+#include "KMeans.hpp"
+#include "PointBatch.hpp"
+
+/** Runs a task a few times and returns the best time in milliseconds. */
+static double Time(const std::function<void()>& task)
+{
+    const int RUNS = 5;
+    double best = 1e30;
+
+    for (int i = 0; i < RUNS; i++)
+    {
+        auto start = std::chrono::steady_clock::now();
+        task();
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        if ( ms < best )
+            best = ms;
+    }
+
+    return best;
+}
+
+int main()
+{
+    // The heuristic scans every point for every point, so it's only timed on the small clouds
+    const int HEURISTIC_LIMIT = 10000;
+
+    std::printf("%10s %14s %14s %14s %14s %14s %16s %14s\n", "points", "ball (ms)", "ball radius", "stream (ms)",
+                "stream r", "stream bound", "heuristic (ms)", "heuristic r");
+    std::mt19937 rng(42);
+    std::normal_distribution<float> spread(0.0f, 1.0f);
+
+    for (int n = 100; n <= 10000000; n *= 10)
+    {
+        std::vector<Point> points(n);
+        for (Point& p : points)
+            p = { spread(rng), spread(rng) * 0.5f, spread(rng) * 2.0f };
+
+        float radius = 0.0f;
+        double ballMs = Time([&]() { radius = MinimumBall(points.data(), n).GetRadius(); });
+
+        // Both passes of the streamed sphere, handed the cloud a chunk at a time
+        float streamed = 0.0f, bound = 0.0f;
+        double streamMs = Time([&]()
+        {
+            StreamingBall stream;
+            for (int pass = 0; pass < 2; pass++)
+            {
+                if ( pass == 1 )
+                    stream.Rewind();
+                for (int i = 0; i < n; i += StreamingBall::CHUNK)
+                    stream.Add(points.data() + i, std::min(StreamingBall::CHUNK, n - i));
+            }
+            streamed = stream.GetRadius();
+            bound    = stream.GetErrorBound();
+        });
+
+        if ( n <= HEURISTIC_LIMIT )
+        {
+            float heuristic = 0.0f;
+            double heuristicMs = Time([&]() { heuristic = HemisphereCenter(points).second; });
+            std::printf("%10d %14.3f %14.5f %14.3f %14.5f %14.2e %16.3f %14.5f\n", n, ballMs, radius, streamMs, streamed, bound,
+                        heuristicMs, heuristic);
+        }
+        else
+            std::printf("%10d %14.3f %14.5f %14.3f %14.5f %14.2e %16s %14s\n", n, ballMs, radius, streamMs, streamed, bound,
+                        "-", "-");
+    }
+
+    // The batch kernels, from plain code up to the widest the CPU has, over ten million points
+    const int BATCH = 10000000;
+    const char* names[] = { "scalar", "sse2", "avx2" };
+    std::vector<float> coordinates(3 * static_cast<size_t>(BATCH));
+    for (float& c : coordinates)
+        c = spread(rng);
+    PointBatch batch;
+    batch.Assign(coordinates.data(), BATCH);
+    std::vector<float> distances(BATCH);
+
+    // Sixteen centers for the nearest center kernel, spread over the cloud
+    const int CENTERS = 16;
+    std::vector<float> centers(3 * CENTERS);
+    for (float& c : centers)
+        c = spread(rng);
+    std::vector<int> labels(BATCH);
+
+    std::printf("\n%10s %14s %14s %14s %14s\n", "kernels", "centroid (ms)", "farthest (ms)", "dist sq (ms)", "nearest (ms)");
+    for (int k = PointBatch::SCALAR; k <= PointBatch::Detect(); k++)
+    {
+        batch.SetKernels(static_cast<PointBatch::Kernels>(k));
+        float mean[3];
+        double centroidMs = Time([&]() { batch.Centroid(mean); });
+        double farthestMs = Time([&]() { batch.Farthest(mean); });
+        double distanceMs = Time([&]() { batch.DistancesSq(mean, distances.data()); });
+        double nearestMs  = Time([&]()
+        {
+            batch.Nearest(centers.data(), centers.data() + CENTERS, centers.data() + 2 * CENTERS, CENTERS, 0, BATCH,
+                          labels.data(), distances.data());
+        });
+        std::printf("%10s %14.3f %14.3f %14.3f %14.3f\n", names[k], centroidMs, farthestMs, distanceMs, nearestMs);
+    }
+
+    // K-means over a million points in sixteen clumps, on one thread, on the job system and in mini-batches
+    const int CLUSTERED = 1000000;
+    std::normal_distribution<float> clump(0.0f, 1.0f);
+    std::vector<float> clustered(3 * static_cast<size_t>(CLUSTERED));
+    for (int i = 0; i < CLUSTERED; i++)
+        for (int a = 0; a < 3; a++)
+            clustered[3 * static_cast<size_t>(i) + a] = 100.0f * centers[a * CENTERS + i % CENTERS] + clump(rng);
+    PointBatch cloud;
+    cloud.Assign(clustered.data(), CLUSTERED);
+
+    JobSystem jobs;
+    std::printf("\n%10s %14s %14s %14s %14s\n", "k-means", "time (ms)", "iterations", "inertia / n", "largest r");
+    const char* modes[] = { "serial", "jobs", "mini-batch" };
+    for (int mode = 0; mode < 3; mode++)
+    {
+        KMeans kmeans;
+        kmeans.SetJobSystem(mode > 0 ? &jobs : NULL);
+        kmeans.SetMiniBatch(mode == 2 ? 4096 : 0);
+        int iterations = 0;
+        double fitMs = Time([&]() { iterations = kmeans.Fit(cloud, CENTERS); });
+        float largest = 0.0f;
+        for (const KMeans::Ball& ball : kmeans.GetBalls())
+            largest = std::max(largest, ball.radius);
+        std::printf("%10s %14.3f %14d %14.4f %14.4f\n", modes[mode], fitMs, iterations, kmeans.GetInertia() / CLUSTERED, largest);
+    }
+
+    // K-d tree queries over the clumped cloud, against scanning every point for every query
+    const int QUERIES    = 100000;
+    const int SCANS      = 100;
+    const int NEIGHBOURS = 8;
+    KdTree tree;
+    tree.SetJobSystem(&jobs);
+    double buildMs = Time([&]() { tree.Build(cloud); });
+    std::vector<int>   neighbours(static_cast<size_t>(QUERIES) * NEIGHBOURS);
+    std::vector<float> neighbourSq(neighbours.size());
+    double nearestMs = Time([&]()
+    {
+        tree.NearestBatch(cloud.GetX(), cloud.GetY(), cloud.GetZ(), QUERIES, NEIGHBOURS, neighbours.data(), neighbourSq.data());
+    });
+    std::vector<int> offsets, found;
+    double radiusMs = Time([&]() { tree.RadiusBatch(cloud.GetX(), cloud.GetY(), cloud.GetZ(), QUERIES, 0.25f, offsets, found); });
+    std::vector<float> scanned(CLUSTERED);
+    double scanMs = Time([&]()
+    {
+        for (int q = 0; q < SCANS; q++)
+        {
+            float query[3] = { cloud.GetX()[q], cloud.GetY()[q], cloud.GetZ()[q] };
+            cloud.DistancesSq(query, scanned.data());
+            std::nth_element(scanned.begin(), scanned.begin() + NEIGHBOURS, scanned.end());
+        }
+    });
+
+    std::printf("\n%10s %14s %14s %14s %14s\n", "k-d tree", "build (ms)", "knn (us/q)", "radius (us/q)", "scan (us/q)");
+    std::printf("%10d %14.3f %14.3f %14.3f %14.3f\n", CLUSTERED, buildMs, 1000.0 * nearestMs / QUERIES, 1000.0 * radiusMs / QUERIES,
+                1000.0 * scanMs / SCANS);
+
+    // A live cloud: a few points move every frame, and the dynamic ball is updated against a refit from scratch
+    const int LIVE   = 300000;
+    const int FRAMES = 1000;
+    const int MOVES  = 16;
+    DynamicBall live;
+    std::vector<int> handles(LIVE);
+    for (int i = 0; i < LIVE; i++)
+        handles[i] = live.Insert({ spread(rng), spread(rng), spread(rng) });
+    live.Update();
+
+    std::uniform_int_distribution<int> pick(0, LIVE - 1);
+    auto start = std::chrono::steady_clock::now();
+    for (int frame = 0; frame < FRAMES; frame++)
+    {
+        for (int m = 0; m < MOVES; m++)
+        {
+            int   handle = handles[pick(rng)];
+            Point point  = live.GetPoint(handle);
+            live.Move(handle, { point.x + 0.1f * spread(rng), point.y + 0.1f * spread(rng), point.z + 0.1f * spread(rng) });
+        }
+        live.Update();
+    }
+    double liveMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / FRAMES;
+
+    std::vector<Point> snapshot(LIVE);
+    for (int i = 0; i < LIVE; i++)
+        snapshot[i] = live.GetPoint(handles[i]);
+    double refitMs = Time([&]() { MinimumBall(snapshot.data(), LIVE); });
+
+    std::printf("\n%10s %14s %14s %14s %14s\n", "live", "frame (ms)", "refits", "refit (ms)", "radius");
+    std::printf("%10d %14.4f %14d %14.3f %14.5f\n", LIVE, liveMs, live.GetRefitCount() - 1, refitMs, live.GetRadius());
+
+    // Hulls of a million filled points, the clumped cloud, and points all on a sphere, where every one is a corner
+    const int HULLED  = 1000000;
+    const int SPHERED = 100000;
+    std::vector<float> filled(3 * static_cast<size_t>(HULLED)), sphered(3 * static_cast<size_t>(SPHERED));
+    for (float& coordinate : filled)
+        coordinate = spread(rng);
+    for (int i = 0; i < SPHERED; i++)
+    {
+        float p[3] = { spread(rng), spread(rng), spread(rng) };
+        float length = std::sqrt(p[0] * p[0] + p[1] * p[1] + p[2] * p[2]);
+        for (int a = 0; a < 3; a++)
+            sphered[3 * static_cast<size_t>(i) + a] = p[a] / length;
+    }
+    PointBatch hullClouds[3];
+    hullClouds[0].Assign(filled.data(), HULLED);
+    hullClouds[1].Assign(clustered.data(), CLUSTERED);
+    hullClouds[2].Assign(sphered.data(), SPHERED);
+
+    std::printf("\n%10s %14s %14s %14s %14s\n", "hull", "serial (ms)", "jobs (ms)", "candidates", "triangles");
+    const char* shapes[] = { "filled", "clumped", "sphere" };
+    for (int shape = 0; shape < 3; shape++)
+    {
+        ConvexHull hull;
+        double serialMs = Time([&]() { hull.Build(hullClouds[shape]); });
+        hull.SetJobSystem(&jobs);
+        double jobsMs = Time([&]() { hull.Build(hullClouds[shape]); });
+        std::printf("%10s %14.3f %14.3f %14d %14d\n", shapes[shape], serialMs, jobsMs, hull.GetCandidateCount(), hull.GetTriangleCount());
+    }
+
+    return 0;
+}
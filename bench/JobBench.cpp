@@ -0,0 +1,146 @@
+/**
+ *  Measures how the job system scales from one thread up to every hardware thread.
+ *  Build with -DOGLBUBBLES_BUILD_BENCHMARKS=ON and run OGLBubblesJobBench.
+ */
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <functional>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "JobSystem.hpp"
+#include "Simulation.hpp"
+#include "Sphere.hpp"
+#include "ThinFilm.hpp"
+#include "AirFlow.hpp"
+#include "WindField.hpp"
+#include "Droplets.hpp"
+
+/** Runs a task a few times and returns the best time in milliseconds. */
+static double Time(const std::function<void()>& task)
+{
+    const int RUNS = 5;
+    double best = 1e30;
+
+    for (int i = 0; i < RUNS; i++)
+    {
+        auto start = std::chrono::steady_clock::now();
+        task();
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        if ( ms < best )
+            best = ms;
+    }
+
+    return best;
+}
+
+/** Fills a simulation with randomly placed, moving bubbles, packed tightly enough that many touch. */
+static void Populate(Simulation& sim, int count)
+{
+    std::mt19937 rng(42);
+    float extent = std::cbrt(static_cast<float>(count)) * 2.5f;
+    std::uniform_real_distribution<float> place(0.0f, extent);
+    std::uniform_real_distribution<float> speed(-1.0f, 1.0f);
+
+    for (int i = 0; i < count; i++)
+    {
+        int id = sim.AddBubble(glm::vec3(place(rng), place(rng), place(rng)), 1.0f);
+        sim.ApplyImpulse(id, glm::vec3(speed(rng), speed(rng), speed(rng)));
+    }
+}
+
+int main()
+{
+    int maxThreads = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+
+    std::printf("%8s %14s %14s %14s %14s %14s %14s %14s %14s\n", "threads", "for (ms)", "step (ms)", "sphere (ms)", "film (ms)",
+                "air (ms)", "wind (ms)", "drops (ms)", "speedup");
+
+    double baseline = 0.0;
+    for (int threads = 1; threads <= maxThreads; threads++)
+    {
+        JobSystem jobs(threads);
+
+        // Pure compute, no shared state
+        std::vector<float> values(1 << 22);
+        double forMs = Time([&]()
+        {
+            jobs.ParallelFor(0, static_cast<int>(values.size()), 16384, [&](int begin, int end)
+            {
+                for (int i = begin; i < end; i++)
+                    values[i] = std::sqrt(static_cast<float>(i)) * std::sin(static_cast<float>(i));
+            });
+        });
+
+        // Bubble integration and contacts
+        Simulation sim;
+        sim.SetJobSystem(&jobs);
+        Populate(sim, 20000);
+        for (int i = 0; i < 30; i++)
+            sim.Step(1.0f / 120.0f); // Let the initial overlaps settle first
+        double stepMs = Time([&]() { sim.Step(1.0f / 120.0f); });
+
+        // Icosphere subdivision and normals
+        double sphereMs = Time([&]()
+        {
+            Sphere sphere(1.0f);
+            sphere.SetJobSystem(&jobs);
+            sphere.Divide(6);
+            sphere.GenerateNormals();
+        });
+
+        // One fixed step of soap film drainage over a 40k vertex bubble
+        Sphere filmSphere(1.0f);
+        filmSphere.Divide(6);
+        ThinFilm film;
+        film.SetJobSystem(&jobs);
+        film.Build(filmSphere.GetVertices(), filmSphere.GetIndices());
+        double filmMs = Time([&]() { film.Step(glm::vec3(0.0f, -1.0f, 0.0f)); });
+
+        // One step of a 128^3 air grid with a swirl in it
+        AirFlow air(128, 0.125f, glm::vec3(-8.0f));
+        air.SetJobSystem(&jobs);
+        air.AddVelocity(glm::vec3(0.0f), glm::vec3(2.0f, 0.0f, 0.0f), 2.0f);
+        double airMs = Time([&]() { air.Step(AirFlow::STEP); });
+
+        // Curl noise wind at 100k scattered bubbles, in the same chunks the simulation uses
+        const int WIND_POINTS = 100000;
+        WindField wind(2.0f, 1.0f, glm::vec3(0.5f, 0.0f, 0.0f));
+        std::vector<float> coords(WIND_POINTS * 3), winds(WIND_POINTS * 3);
+        std::mt19937 rng(7);
+        std::uniform_real_distribution<float> scatter(-20.0f, 20.0f);
+        for (float& c : coords)
+            c = scatter(rng);
+        double windMs = Time([&]()
+        {
+            jobs.ParallelFor(0, WIND_POINTS, 4096, [&](int begin, int end)
+            {
+                wind.Sample(&coords[begin], &coords[WIND_POINTS + begin], &coords[2 * WIND_POINTS + begin],
+                            &winds[begin], &winds[WIND_POINTS + begin], &winds[2 * WIND_POINTS + begin], end - begin);
+            });
+        });
+
+        // A million pop droplets on the CPU path, from bubbles big enough to fill whole bursts
+        const int DROPLET_COUNT = 1 << 20;
+        CpuDroplets drops(DROPLET_COUNT);
+        drops.SetJobSystem(&jobs);
+        for (int i = 0; i < DROPLET_COUNT / Droplets::MAX_BURST; i++)
+            drops.Burst(glm::vec3(static_cast<float>(i), 0.0f, 0.0f), glm::vec3(0.0f), 1.0f);
+        drops.Step(0.0f);
+        double dropsMs = Time([&]() { drops.Step(1.0f / 120.0f); });
+
+        double total = forMs + stepMs + sphereMs + filmMs + airMs + windMs + dropsMs;
+        if ( threads == 1 )
+            baseline = total;
+
+        std::printf("%8d %14.3f %14.3f %14.3f %14.3f %14.3f %14.3f %14.3f %13.2fx\n", threads, forMs, stepMs, sphereMs, filmMs,
+                    airMs, windMs, dropsMs, baseline / total);
+    }
+
+    return 0;
+}
@@ -0,0 +1,509 @@
+#include "AirFlow.hpp"
+
+#include <cmath>
+
+// SSE is part of every x86-64 target, so the Jacobi rows use it without a runtime check
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <xmmintrin.h>
+#define AIRFLOW_SSE
+#endif
+
+/** Gets the offset of the first cell of a grid row. */
+static inline int RowOffset(int n, int y, int z)
+{
+    return (y + n * z) * n;
+}
+
+/**
+ *  Runs a weighted Jacobi sweep over one row of a Poisson problem. Cells past the walls mirror the cell next to
+ *  them, which keeps the pressure gradient through the walls at zero.
+ *  @param p     - The current pressure of the whole level.
+ *  @param rhs   - The right hand side of the whole level.
+ *  @param out   - Receives the new pressure of the row.
+ *  @param n     - Cells along each side of the level.
+ *  @param h2    - The squared cell width of the level.
+ *  @param omega - The Jacobi weight.
+ */
+static void JacobiRow(const float* p, const float* rhs, float* out, int n, int y, int z, float h2, float omega)
+{
+    int row = RowOffset(n, y, z);
+    const float* c  = p + row;
+    const float* ym = p + RowOffset(n, std::max(y - 1, 0), z);
+    const float* yp = p + RowOffset(n, std::min(y + 1, n - 1), z);
+    const float* zm = p + RowOffset(n, y, std::max(z - 1, 0));
+    const float* zp = p + RowOffset(n, y, std::min(z + 1, n - 1));
+    const float* r  = rhs + row;
+    float*       o  = out + row;
+
+    auto cell = [&](int x)
+    {
+        float sum = c[std::max(x - 1, 0)] + c[std::min(x + 1, n - 1)] + ym[x] + yp[x] + zm[x] + zp[x];
+        o[x] = c[x] + omega * ((sum - h2 * r[x]) / 6.0f - c[x]);
+    };
+
+    cell(0);
+    int x = 1;
+#ifdef AIRFLOW_SSE
+    const __m128 sixth  = _mm_set1_ps(1.0f / 6.0f);
+    const __m128 weight = _mm_set1_ps(omega);
+    const __m128 area   = _mm_set1_ps(h2);
+    for (; x + 4 < n; x += 4)
+    {
+        __m128 centre = _mm_loadu_ps(c + x);
+        __m128 sum    = _mm_add_ps(_mm_loadu_ps(c + x - 1), _mm_loadu_ps(c + x + 1));
+        sum = _mm_add_ps(sum, _mm_add_ps(_mm_loadu_ps(ym + x), _mm_loadu_ps(yp + x)));
+        sum = _mm_add_ps(sum, _mm_add_ps(_mm_loadu_ps(zm + x), _mm_loadu_ps(zp + x)));
+        sum = _mm_sub_ps(sum, _mm_mul_ps(area, _mm_loadu_ps(r + x)));
+
+        __m128 target = _mm_mul_ps(sum, sixth);
+        _mm_storeu_ps(o + x, _mm_add_ps(centre, _mm_mul_ps(weight, _mm_sub_ps(target, centre))));
+    }
+#endif
+    for (; x < n - 1; x++)
+        cell(x);
+    if ( n > 1 )
+        cell(n - 1);
+}
+
+/** Writes the residual rhs - laplacian(p) of one row, with the same walls as JacobiRow. */
+static void ResidualRow(const float* p, const float* rhs, float* out, int n, int y, int z, float h2)
+{
+    int row = RowOffset(n, y, z);
+    const float* c  = p + row;
+    const float* ym = p + RowOffset(n, std::max(y - 1, 0), z);
+    const float* yp = p + RowOffset(n, std::min(y + 1, n - 1), z);
+    const float* zm = p + RowOffset(n, y, std::max(z - 1, 0));
+    const float* zp = p + RowOffset(n, y, std::min(z + 1, n - 1));
+    const float* r  = rhs + row;
+    float*       o  = out + row;
+    float inverse   = 1.0f / h2;
+
+    auto cell = [&](int x)
+    {
+        float sum = c[std::max(x - 1, 0)] + c[std::min(x + 1, n - 1)] + ym[x] + yp[x] + zm[x] + zp[x];
+        o[x] = r[x] - (sum - 6.0f * c[x]) * inverse;
+    };
+
+    cell(0);
+    int x = 1;
+#ifdef AIRFLOW_SSE
+    const __m128 six   = _mm_set1_ps(6.0f);
+    const __m128 scale = _mm_set1_ps(inverse);
+    for (; x + 4 < n; x += 4)
+    {
+        __m128 sum = _mm_add_ps(_mm_loadu_ps(c + x - 1), _mm_loadu_ps(c + x + 1));
+        sum = _mm_add_ps(sum, _mm_add_ps(_mm_loadu_ps(ym + x), _mm_loadu_ps(yp + x)));
+        sum = _mm_add_ps(sum, _mm_add_ps(_mm_loadu_ps(zm + x), _mm_loadu_ps(zp + x)));
+        sum = _mm_sub_ps(sum, _mm_mul_ps(six, _mm_loadu_ps(c + x)));
+        _mm_storeu_ps(o + x, _mm_sub_ps(_mm_loadu_ps(r + x), _mm_mul_ps(sum, scale)));
+    }
+#endif
+    for (; x < n - 1; x++)
+        cell(x);
+    if ( n > 1 )
+        cell(n - 1);
+}
+
+/** The eight cells around a point and how much each one counts, shared by every field sampled there. */
+struct Stencil
+{
+    int   offsets[4]; // Row offsets of the four corner rows: (y0, z0), (y1, z0), (y0, z1), (y1, z1).
+    int   x0, x1;     // Columns either side of the point.
+    float fx, fy, fz; // Position of the point between the cells.
+
+    /** Finds the cells around a point in cell coordinates, clamped to the cell centers of a grid. */
+    Stencil(int n, glm::vec3 cell)
+    {
+        glm::vec3 clamped = glm::clamp(cell, glm::vec3(0.0f), glm::vec3(static_cast<float>(n - 1)));
+        x0     = std::min(static_cast<int>(clamped.x), n - 1);
+        int y0 = std::min(static_cast<int>(clamped.y), n - 1);
+        int z0 = std::min(static_cast<int>(clamped.z), n - 1);
+        x1     = std::min(x0 + 1, n - 1);
+        int y1 = std::min(y0 + 1, n - 1);
+        int z1 = std::min(z0 + 1, n - 1);
+        fx = clamped.x - x0;
+        fy = clamped.y - y0;
+        fz = clamped.z - z0;
+
+        offsets[0] = RowOffset(n, y0, z0);
+        offsets[1] = RowOffset(n, y1, z0);
+        offsets[2] = RowOffset(n, y0, z1);
+        offsets[3] = RowOffset(n, y1, z1);
+    };
+
+    /** Blends one field over the eight cells. */
+    float Sample(const float* field) const
+    {
+        const float* a = field + offsets[0];
+        const float* b = field + offsets[1];
+        const float* c = field + offsets[2];
+        const float* d = field + offsets[3];
+
+        float front = (a[x0] + (a[x1] - a[x0]) * fx) * (1.0f - fy) + (b[x0] + (b[x1] - b[x0]) * fx) * fy;
+        float back  = (c[x0] + (c[x1] - c[x0]) * fx) * (1.0f - fy) + (d[x0] + (d[x1] - d[x0]) * fx) * fy;
+        return front + (back - front) * fz;
+    };
+};
+
+/** Finds the coarse cells either side of a fine cell center along one axis, and the weight of the second one. */
+static inline void Bracket(int fine, int coarseSize, int* first, int* second, float* weight)
+{
+    // Fine cell centers sit a quarter of a coarse cell either side of the coarse centers
+    float coarse = std::max(fine * 0.5f - 0.25f, 0.0f);
+    *first  = std::min(static_cast<int>(coarse), coarseSize - 1);
+    *second = std::min(*first + 1, coarseSize - 1);
+    *weight = coarse - *first;
+}
+
+AirFlow::AirFlow(int size, float cellSize, glm::vec3 origin)
+{
+    this->size     = size;
+    this->cellSize = cellSize;
+    this->origin   = origin;
+    cycles         = 2;
+    accumulator    = 0.0f;
+    jobs           = NULL;
+
+    int cells = size * size * size;
+    u.assign(cells, 0.0f);
+    v.assign(cells, 0.0f);
+    w.assign(cells, 0.0f);
+    u0.assign(cells, 0.0f);
+    v0.assign(cells, 0.0f);
+    w0.assign(cells, 0.0f);
+
+    // Halve the grid for as long as it divides evenly
+    int   n       = size;
+    float spacing = cellSize;
+    while ( true )
+    {
+        Level level;
+        level.size    = n;
+        level.spacing = spacing;
+        level.pressure.assign(n * n * n, 0.0f);
+        level.rhs.assign(n * n * n, 0.0f);
+        level.scratch.assign(n * n * n, 0.0f);
+        levels.push_back(std::move(level));
+
+        if ( n % 2 != 0 || n / 2 < MIN_LEVEL )
+            break;
+        n       /= 2;
+        spacing *= 2.0f;
+    }
+}
+
+void AirFlow::Advance(float dt)
+{
+    accumulator += dt;
+    int steps = 0;
+    while ( accumulator >= STEP && steps < MAX_STEPS )
+    {
+        Step(STEP);
+        accumulator -= STEP;
+        steps++;
+    }
+
+    // Drop whatever couldn't be caught up on rather than falling further behind
+    if ( steps == MAX_STEPS )
+        accumulator = std::min(accumulator, STEP);
+}
+
+void AirFlow::Step(float dt)
+{
+    Advect(dt);
+    ClampWalls();
+    Project();
+    ClampWalls();
+}
+
+void AirFlow::Advect(float dt)
+{
+    u.swap(u0);
+    v.swap(v0);
+    w.swap(w0);
+
+    int   n     = size;
+    float scale = dt / cellSize;
+    ForRows(n, [this, n, scale](int begin, int end)
+    {
+        for (int row = begin; row < end; row++)
+        {
+            int y = row % n;
+            int z = row / n;
+            int offset = row * n;
+            for (int x = 0; x < n; x++)
+            {
+                // Trace back to where the air in this cell came from and carry its velocity over
+                int i = offset + x;
+                glm::vec3 cell = glm::vec3(x, y, z) - glm::vec3(u0[i], v0[i], w0[i]) * scale;
+                glm::vec3 velocity = Interpolate(u0.data(), v0.data(), w0.data(), cell);
+                u[i] = velocity.x;
+                v[i] = velocity.y;
+                w[i] = velocity.z;
+            }
+        }
+    });
+}
+
+void AirFlow::Project()
+{
+    Level& fine = levels[0];
+    int    n    = size;
+    float  half = 0.5f / cellSize;
+
+    // Central differences of the velocity, with the walls mirroring the cells next to them
+    ForRows(n, [this, &fine, n, half](int begin, int end)
+    {
+        for (int row = begin; row < end; row++)
+        {
+            int y = row % n;
+            int z = row / n;
+            int offset = row * n;
+            int ym = RowOffset(n, std::max(y - 1, 0), z);
+            int yp = RowOffset(n, std::min(y + 1, n - 1), z);
+            int zm = RowOffset(n, y, std::max(z - 1, 0));
+            int zp = RowOffset(n, y, std::min(z + 1, n - 1));
+            for (int x = 0; x < n; x++)
+            {
+                float dx = u[offset + std::min(x + 1, n - 1)] - u[offset + std::max(x - 1, 0)];
+                float dy = v[yp + x] - v[ym + x];
+                float dz = w[zp + x] - w[zm + x];
+                fine.rhs[offset + x] = (dx + dy + dz) * half;
+            }
+        }
+    });
+
+    // A closed box can only be solved if as much air leaves as arrives, so take out any leftover imbalance
+    double total = 0.0;
+    for (float divergence : fine.rhs)
+        total += divergence;
+    float mean = static_cast<float>(total / fine.rhs.size());
+    ForRows(n, [&fine, n, mean](int begin, int end)
+    {
+        for (int i = begin * n; i < end * n; i++)
+            fine.rhs[i] -= mean;
+    });
+
+    // The last step's pressure is a good first guess, so the solve starts warm
+    for (int c = 0; c < cycles; c++)
+        VCycle(0);
+
+    // Subtract the pressure gradient
+    ForRows(n, [this, &fine, n, half](int begin, int end)
+    {
+        const float* p = fine.pressure.data();
+        for (int row = begin; row < end; row++)
+        {
+            int y = row % n;
+            int z = row / n;
+            int offset = row * n;
+            int ym = RowOffset(n, std::max(y - 1, 0), z);
+            int yp = RowOffset(n, std::min(y + 1, n - 1), z);
+            int zm = RowOffset(n, y, std::max(z - 1, 0));
+            int zp = RowOffset(n, y, std::min(z + 1, n - 1));
+            for (int x = 0; x < n; x++)
+            {
+                u[offset + x] -= (p[offset + std::min(x + 1, n - 1)] - p[offset + std::max(x - 1, 0)]) * half;
+                v[offset + x] -= (p[yp + x] - p[ym + x]) * half;
+                w[offset + x] -= (p[zp + x] - p[zm + x]) * half;
+            }
+        }
+    });
+}
+
+void AirFlow::VCycle(int level)
+{
+    Level& current = levels[level];
+    if ( level + 1 == static_cast<int>(levels.size()) )
+    {
+        Smooth(current, COARSE_ITERATIONS);
+        return;
+    }
+
+    Smooth(current, PRE_SMOOTH);
+    Residual(current);
+    Restrict(level);
+
+    // The coarse level solves for the error, starting from nothing
+    Level& coarse = levels[level + 1];
+    std::fill(coarse.pressure.begin(), coarse.pressure.end(), 0.0f);
+    VCycle(level + 1);
+
+    Prolong(level);
+    Smooth(current, POST_SMOOTH);
+}
+
+void AirFlow::Smooth(Level& level, int iterations)
+{
+    int   n  = level.size;
+    float h2 = level.spacing * level.spacing;
+    for (int i = 0; i < iterations; i++)
+    {
+        ForRows(n, [&level, n, h2](int begin, int end)
+        {
+            for (int row = begin; row < end; row++)
+                JacobiRow(level.pressure.data(), level.rhs.data(), level.scratch.data(), n, row % n, row / n, h2, OMEGA);
+        });
+        level.pressure.swap(level.scratch);
+    }
+}
+
+void AirFlow::Residual(Level& level)
+{
+    int   n  = level.size;
+    float h2 = level.spacing * level.spacing;
+    ForRows(n, [&level, n, h2](int begin, int end)
+    {
+        for (int row = begin; row < end; row++)
+            ResidualRow(level.pressure.data(), level.rhs.data(), level.scratch.data(), n, row % n, row / n, h2);
+    });
+}
+
+void AirFlow::Restrict(int level)
+{
+    const Level& fine   = levels[level];
+    Level&       coarse = levels[level + 1];
+    int n  = coarse.size;
+    int fn = fine.size;
+
+    ForRows(n, [&fine, &coarse, n, fn](int begin, int end)
+    {
+        for (int row = begin; row < end; row++)
+        {
+            int y = row % n;
+            int z = row / n;
+            const float* a = fine.scratch.data() + RowOffset(fn, 2 * y,     2 * z);
+            const float* b = fine.scratch.data() + RowOffset(fn, 2 * y + 1, 2 * z);
+            const float* c = fine.scratch.data() + RowOffset(fn, 2 * y,     2 * z + 1);
+            const float* d = fine.scratch.data() + RowOffset(fn, 2 * y + 1, 2 * z + 1);
+            float* out = coarse.rhs.data() + row * n;
+            for (int x = 0; x < n; x++)
+            {
+                int f = 2 * x;
+                out[x] = (a[f] + a[f + 1] + b[f] + b[f + 1] + c[f] + c[f + 1] + d[f] + d[f + 1]) * 0.125f;
+            }
+        }
+    });
+}
+
+void AirFlow::Prolong(int level)
+{
+    Level&       fine   = levels[level];
+    const Level& coarse = levels[level + 1];
+    int n  = fine.size;
+    int cn = coarse.size;
+
+    // The brackets along x are the same for every row
+    std::vector<int>   first(n);
+    std::vector<int>   second(n);
+    std::vector<float> weight(n);
+    for (int x = 0; x < n; x++)
+        Bracket(x, cn, &first[x], &second[x], &weight[x]);
+
+    ForRows(n, [&](int begin, int end)
+    {
+        for (int row = begin; row < end; row++)
+        {
+            int   y0, y1, z0, z1;
+            float fy, fz;
+            Bracket(row % n, cn, &y0, &y1, &fy);
+            Bracket(row / n, cn, &z0, &z1, &fz);
+
+            const float* a = coarse.pressure.data() + RowOffset(cn, y0, z0);
+            const float* b = coarse.pressure.data() + RowOffset(cn, y1, z0);
+            const float* c = coarse.pressure.data() + RowOffset(cn, y0, z1);
+            const float* d = coarse.pressure.data() + RowOffset(cn, y1, z1);
+            float* out = fine.pressure.data() + row * n;
+            for (int x = 0; x < n; x++)
+            {
+                int   x0 = first[x];
+                int   x1 = second[x];
+                float fx = weight[x];
+                float front = (a[x0] + (a[x1] - a[x0]) * fx) * (1.0f - fy) + (b[x0] + (b[x1] - b[x0]) * fx) * fy;
+                float back  = (c[x0] + (c[x1] - c[x0]) * fx) * (1.0f - fy) + (d[x0] + (d[x1] - d[x0]) * fx) * fy;
+                out[x] += front + (back - front) * fz;
+            }
+        }
+    });
+}
+
+void AirFlow::ClampWalls()
+{
+    int n = size;
+    ForRows(n, [this, n](int begin, int end)
+    {
+        for (int row = begin; row < end; row++)
+        {
+            int y = row % n;
+            int z = row / n;
+            int offset = row * n;
+
+            u[offset] = 0.0f;
+            u[offset + n - 1] = 0.0f;
+            if ( y == 0 || y == n - 1 )
+                std::fill(v.begin() + offset, v.begin() + offset + n, 0.0f);
+            if ( z == 0 || z == n - 1 )
+                std::fill(w.begin() + offset, w.begin() + offset + n, 0.0f);
+        }
+    });
+}
+
+glm::vec3 AirFlow::Interpolate(const float* x, const float* y, const float* z, glm::vec3 cell) const
+{
+    Stencil stencil(size, cell);
+    return glm::vec3(stencil.Sample(x), stencil.Sample(y), stencil.Sample(z));
+}
+
+void AirFlow::AddVelocity(glm::vec3 center, glm::vec3 velocity, float radius)
+{
+    if ( radius <= 0.0f )
+        return;
+
+    // Only the cells whose centers can fall inside the sphere are visited
+    glm::vec3 low  = (center - origin - radius) / cellSize - 0.5f;
+    glm::vec3 high = (center - origin + radius) / cellSize - 0.5f;
+    glm::ivec3 first = glm::max(glm::ivec3(glm::ceil(low)), glm::ivec3(0));
+    glm::ivec3 last  = glm::min(glm::ivec3(glm::floor(high)), glm::ivec3(size - 1));
+
+    for (int z = first.z; z <= last.z; z++)
+    {
+        for (int y = first.y; y <= last.y; y++)
+        {
+            for (int x = first.x; x <= last.x; x++)
+            {
+                glm::vec3 point = origin + (glm::vec3(x, y, z) + 0.5f) * cellSize;
+                float falloff = 1.0f - glm::dot(point - center, point - center) / (radius * radius);
+                if ( falloff <= 0.0f )
+                    continue;
+
+                int i = RowOffset(size, y, z) + x;
+                u[i] += velocity.x * falloff * falloff;
+                v[i] += velocity.y * falloff * falloff;
+                w[i] += velocity.z * falloff * falloff;
+            }
+        }
+    }
+}
+
+void AirFlow::Sample(const glm::vec3* positions, glm::vec3* velocities, int count) const
+{
+    float inverse = 1.0f / cellSize;
+    float limit   = static_cast<float>(size) - 0.5f;
+
+    for (int i = 0; i < count; i++)
+    {
+        // The air outside the box is still
+        glm::vec3 cell = (positions[i] - origin) * inverse - 0.5f;
+        if ( glm::any(glm::lessThan(cell, glm::vec3(-0.5f))) || glm::any(glm::greaterThan(cell, glm::vec3(limit))) )
+            velocities[i] = glm::vec3(0.0f);
+        else
+            velocities[i] = Interpolate(u.data(), v.data(), w.data(), cell);
+    }
+}
+
+glm::vec3 AirFlow::Sample(glm::vec3 position) const
+{
+    glm::vec3 velocity;
+    Sample(&position, &velocity, 1);
+    return velocity;
+}
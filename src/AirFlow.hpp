@@ -0,0 +1,159 @@
+#ifndef AIRFLOW
+#define AIRFLOW
+
+#include <algorithm>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "JobSystem.hpp"
+
+/**
+ *  The air the bubbles float in, as a stable fluids velocity grid.
+ *  Each step carries the velocity along itself with semi-Lagrangian advection, then removes its divergence with a
+ *  pressure projection solved by a multigrid V-cycle using weighted Jacobi smoothing. Every pass works on whole grid
+ *  rows, which are split into tiles across the job system, and the Jacobi rows are vectorized with SSE.
+ *  The grid is a closed box: air slides along its walls but can't pass through them, and is still outside it.
+ */
+class AirFlow
+{
+    public:
+        /**
+         *  Creates a box of still air.
+         *  @param size     - The number of cells along each side; a power of two gives the multigrid the most levels.
+         *  @param cellSize - The width of a cell in world units.
+         *  @param origin   - The world space corner of the box with the smallest coordinates.
+         */
+        AirFlow(int size, float cellSize, glm::vec3 origin);
+
+        /** Copying the grid would duplicate a lot of memory, so it's deleted. */
+        AirFlow(const AirFlow&) = delete;
+        AirFlow& operator=(const AirFlow&) = delete;
+
+        ~AirFlow() { };
+
+        /**
+         *  Advances the air in fixed steps, carrying any leftover time over to the next call.
+         *  @param dt - The time that has passed in seconds.
+         */
+        void Advance(float dt);
+
+        /**
+         *  Runs a single step: advection followed by the pressure projection.
+         *  @param dt - The time step in seconds.
+         */
+        void Step(float dt);
+
+        /**
+         *  Pushes the air inside a sphere, fading out toward its edge.
+         *  @param center   - The world space center of the push.
+         *  @param velocity - The velocity added at the center.
+         *  @param radius   - The radius of the push.
+         */
+        void AddVelocity(glm::vec3 center, glm::vec3 velocity, float radius);
+
+        /**
+         *  Interpolates the air velocity at many points at once.
+         *  @param positions  - The world space points to sample.
+         *  @param velocities - Receives the air velocity at each point.
+         *  @param count      - The number of points.
+         */
+        void Sample(const glm::vec3* positions, glm::vec3* velocities, int count) const;
+
+        /** Interpolates the air velocity at a single world space point. */
+        glm::vec3 Sample(glm::vec3 position) const;
+
+        /** Gets the number of cells along each side of the grid. */
+        int GetSize() const { return size; };
+
+        /** Gets the width of a cell in world units. */
+        float GetCellSize() const { return cellSize; };
+
+        /** Gets the world space corner of the grid with the smallest coordinates. */
+        glm::vec3 GetOrigin() const { return origin; };
+
+        /**
+         *  Sets the number of multigrid V-cycles run per projection.
+         *  @param cycles - More cycles leave less divergence behind; two is plenty to look right.
+         */
+        void SetCycles(int cycles) { this->cycles = cycles; };
+
+        /**
+         *  Sets the job system used to step the grid in parallel.
+         *  @param jobs - The job system to use, or NULL to run on the calling thread.
+         */
+        void SetJobSystem(JobSystem* jobs) { this->jobs = jobs; };
+
+        static constexpr float STEP = 1.0f / 30.0f; // Length of a fixed step in seconds.
+
+    private:
+        /** One level of the multigrid hierarchy; level 0 is the full grid. */
+        struct Level
+        {
+            int   size;                  // Cells along each side.
+            float spacing;               // Width of a cell in world units.
+            std::vector<float> pressure; // Current guess of the solution.
+            std::vector<float> rhs;      // Right hand side: the divergence, or the residual of the finer level.
+            std::vector<float> scratch;  // Jacobi output and residuals.
+        };
+
+        /** Moves the velocity along itself, reading from the previous velocity. */
+        void Advect(float dt);
+
+        /** Removes the divergence from the velocity. */
+        void Project();
+
+        /** Runs one multigrid V-cycle on a level and everything coarser. */
+        void VCycle(int level);
+
+        /** Runs weighted Jacobi sweeps on a level. */
+        void Smooth(Level& level, int iterations);
+
+        /** Writes the residual of a level into its scratch buffer. */
+        void Residual(Level& level);
+
+        /** Averages the residual of a level into the right hand side of the next coarser one. */
+        void Restrict(int level);
+
+        /** Interpolates the correction from the next coarser level and adds it to a level. */
+        void Prolong(int level);
+
+        /** Stops the air from flowing through the walls of the box. */
+        void ClampWalls();
+
+        /** Trilinearly samples three fields at a point given in cell coordinates. */
+        glm::vec3 Interpolate(const float* x, const float* y, const float* z, glm::vec3 cell) const;
+
+        /** Runs body(begin, end) over the rows of a grid of the given size, in parallel if a job system is set. */
+        template <typename Body>
+        void ForRows(int n, const Body& body)
+        {
+            int rows  = n * n;
+            int grain = std::max(1, ROW_TILE / n);
+            if ( jobs != NULL )
+                jobs->ParallelFor(0, rows, grain, body);
+            else
+                body(0, rows);
+        };
+
+        static constexpr float OMEGA = 0.8f; // Jacobi weight; under one so the sweeps smooth instead of overshooting.
+        static const int PRE_SMOOTH  = 2;    // Jacobi sweeps before restricting.
+        static const int POST_SMOOTH = 2;    // Jacobi sweeps after prolonging.
+        static const int COARSE_ITERATIONS = 16; // Jacobi sweeps on the coarsest level.
+        static const int MIN_LEVEL   = 4;    // Cells along each side of the coarsest level, at least.
+        static const int MAX_STEPS   = 2;    // Fixed steps run per call at most, so slow frames can't snowball.
+        static const int ROW_TILE    = 16384; // Cells stepped per job.
+
+        int   size;       // Cells along each side.
+        float cellSize;   // Width of a cell in world units.
+        glm::vec3 origin; // World space corner with the smallest coordinates.
+        int   cycles;     // V-cycles per projection.
+        float accumulator; // Time not yet stepped, in seconds.
+
+        std::vector<float> u, v, w;          // Velocity of every cell along x, y and z.
+        std::vector<float> u0, v0, w0;       // Velocity before the current advection.
+        std::vector<Level> levels;           // Multigrid hierarchy, finest first.
+        JobSystem* jobs;                     // Job system for the parallel passes, may be NULL.
+};
+
+#endif
@@ -0,0 +1,272 @@
+#include "BVH.hpp"
+
+#include <algorithm>
+#include <cassert>
+
+BVH::BVH(float m)
+{
+    root      = -1;
+    freeList  = -1;
+    leafCount = 0;
+    margin    = m;
+}
+
+int BVH::AllocateNode()
+{
+    // Grow the pool and thread the new nodes onto the free list
+    if ( freeList == -1 )
+    {
+        int oldSize = static_cast<int>(nodes.size());
+        int newSize = ( oldSize == 0 ) ? 16 : oldSize * 2;
+        nodes.resize(newSize);
+
+        for (int i = oldSize; i < newSize; i++)
+        {
+            nodes[i].parent = ( i + 1 < newSize ) ? i + 1 : -1;
+            nodes[i].height = -1;
+        }
+        freeList = oldSize;
+    }
+
+    int index       = freeList;
+    BVHNode& node   = nodes[index];
+    freeList        = node.parent;
+    node.parent     = -1;
+    node.child1     = -1;
+    node.child2     = -1;
+    node.height     = 0;
+    node.data       = -1;
+
+    return index;
+}
+
+void BVH::FreeNode(int index)
+{
+    nodes[index].parent = freeList;
+    nodes[index].height = -1;
+    freeList = index;
+}
+
+int BVH::CreateProxy(const AABB& box, int data)
+{
+    int proxy = AllocateNode();
+
+    nodes[proxy].box  = { box.min - glm::vec3(margin), box.max + glm::vec3(margin) };
+    nodes[proxy].data = data;
+
+    InsertLeaf(proxy);
+    leafCount++;
+
+    return proxy;
+}
+
+void BVH::DestroyProxy(int proxy)
+{
+    assert(nodes[proxy].IsLeaf());
+
+    RemoveLeaf(proxy);
+    FreeNode(proxy);
+    leafCount--;
+}
+
+bool BVH::MoveProxy(int proxy, const AABB& box, glm::vec3 displacement)
+{
+    assert(nodes[proxy].IsLeaf());
+
+    AABB& fat = nodes[proxy].box;
+    if ( Contains(fat, box) )
+        return false;
+
+    // Fatten the new box and stretch it in the direction of travel
+    AABB moved = { box.min - glm::vec3(margin), box.max + glm::vec3(margin) };
+    glm::vec3 d = 2.0f * displacement;
+    moved.min += glm::min(d, glm::vec3(0.0f));
+    moved.max += glm::max(d, glm::vec3(0.0f));
+
+    // Teleports are cheaper to reinsert than to refit through the whole tree
+    if ( !Overlaps(fat, moved) )
+    {
+        RemoveLeaf(proxy);
+        fat = moved;
+        InsertLeaf(proxy);
+        return true;
+    }
+
+    // Small escapes: grow the leaf in place and refit/rotate its ancestors
+    fat = moved;
+    Refit(nodes[proxy].parent);
+    return true;
+}
+
+void BVH::InsertLeaf(int leaf)
+{
+    if ( root == -1 )
+    {
+        root = leaf;
+        nodes[root].parent = -1;
+        return;
+    }
+
+    // Descend the tree, picking the child with the cheapest increase in surface area
+    AABB leafBox = nodes[leaf].box;
+    int  index   = root;
+    while ( !nodes[index].IsLeaf() )
+    {
+        const BVHNode& node = nodes[index];
+        int child1 = node.child1;
+        int child2 = node.child2;
+
+        float area         = SurfaceArea(node.box);
+        float combinedArea = SurfaceArea(Union(node.box, leafBox));
+
+        // Cost of creating a new parent for this node and the new leaf
+        float cost = 2.0f * combinedArea;
+
+        // Minimum cost of pushing the leaf further down the tree
+        float inheritance = 2.0f * (combinedArea - area);
+
+        float cost1 = SurfaceArea(Union(leafBox, nodes[child1].box)) + inheritance;
+        if ( !nodes[child1].IsLeaf() )
+            cost1 -= SurfaceArea(nodes[child1].box);
+
+        float cost2 = SurfaceArea(Union(leafBox, nodes[child2].box)) + inheritance;
+        if ( !nodes[child2].IsLeaf() )
+            cost2 -= SurfaceArea(nodes[child2].box);
+
+        if ( cost < cost1 && cost < cost2 )
+            break;
+
+        index = ( cost1 < cost2 ) ? child1 : child2;
+    }
+
+    // Create a new parent for the sibling and the leaf
+    int sibling   = index;
+    int oldParent = nodes[sibling].parent;
+    int newParent = AllocateNode();
+
+    nodes[newParent].parent = oldParent;
+    nodes[newParent].box    = Union(leafBox, nodes[sibling].box);
+    nodes[newParent].height = nodes[sibling].height + 1;
+    nodes[newParent].child1 = sibling;
+    nodes[newParent].child2 = leaf;
+    nodes[sibling].parent   = newParent;
+    nodes[leaf].parent      = newParent;
+
+    if ( oldParent == -1 )
+        root = newParent;
+    else if ( nodes[oldParent].child1 == sibling )
+        nodes[oldParent].child1 = newParent;
+    else
+        nodes[oldParent].child2 = newParent;
+
+    Refit(oldParent);
+}
+
+void BVH::RemoveLeaf(int leaf)
+{
+    if ( leaf == root )
+    {
+        root = -1;
+        return;
+    }
+
+    int parent      = nodes[leaf].parent;
+    int grandParent = nodes[parent].parent;
+    int sibling     = ( nodes[parent].child1 == leaf ) ? nodes[parent].child2 : nodes[parent].child1;
+
+    // Replace the parent with the sibling
+    if ( grandParent == -1 )
+    {
+        root = sibling;
+        nodes[sibling].parent = -1;
+    }
+    else
+    {
+        if ( nodes[grandParent].child1 == parent )
+            nodes[grandParent].child1 = sibling;
+        else
+            nodes[grandParent].child2 = sibling;
+        nodes[sibling].parent = grandParent;
+    }
+
+    FreeNode(parent);
+    nodes[leaf].parent = -1;
+
+    Refit(grandParent);
+}
+
+void BVH::Refit(int index)
+{
+    while ( index != -1 )
+    {
+        BVHNode& node = nodes[index];
+        node.box      = Union(nodes[node.child1].box, nodes[node.child2].box);
+        node.height   = 1 + std::max(nodes[node.child1].height, nodes[node.child2].height);
+
+        Rotate(index);
+
+        index = nodes[index].parent;
+    }
+}
+
+void BVH::Rotate(int index)
+{
+    BVHNode& node = nodes[index];
+    if ( node.height < 2 )
+        return;
+
+    int b = node.child1;
+    int c = node.child2;
+
+    // Candidate swaps of a child with one of its sibling's children:
+    // 1: b <-> c.child1, 2: b <-> c.child2, 3: c <-> b.child1, 4: c <-> b.child2
+    // Each one only changes the box of the sibling, so compare its area before and after.
+    float bestGain = 0.0f;
+    int   best     = 0;
+
+    if ( !nodes[c].IsLeaf() )
+    {
+        float area = SurfaceArea(nodes[c].box);
+        float gain1 = area - SurfaceArea(Union(nodes[b].box, nodes[nodes[c].child2].box));
+        float gain2 = area - SurfaceArea(Union(nodes[b].box, nodes[nodes[c].child1].box));
+
+        if ( gain1 > bestGain ) { bestGain = gain1; best = 1; }
+        if ( gain2 > bestGain ) { bestGain = gain2; best = 2; }
+    }
+
+    if ( !nodes[b].IsLeaf() )
+    {
+        float area = SurfaceArea(nodes[b].box);
+        float gain3 = area - SurfaceArea(Union(nodes[c].box, nodes[nodes[b].child2].box));
+        float gain4 = area - SurfaceArea(Union(nodes[c].box, nodes[nodes[b].child1].box));
+
+        if ( gain3 > bestGain ) { bestGain = gain3; best = 3; }
+        if ( gain4 > bestGain ) { bestGain = gain4; best = 4; }
+    }
+
+    if ( best == 0 )
+        return;
+
+    // Resolve the rotation into: child of node <-> grandchild under the other child
+    int child   = ( best <= 2 ) ? b : c;
+    int uncle   = ( best <= 2 ) ? c : b;
+    int nephew  = ( best == 1 || best == 3 ) ? nodes[uncle].child1 : nodes[uncle].child2;
+
+    if ( node.child1 == child )
+        node.child1 = nephew;
+    else
+        node.child2 = nephew;
+
+    if ( nodes[uncle].child1 == nephew )
+        nodes[uncle].child1 = child;
+    else
+        nodes[uncle].child2 = child;
+
+    nodes[nephew].parent = index;
+    nodes[child].parent  = uncle;
+
+    BVHNode& u = nodes[uncle];
+    u.box      = Union(nodes[u.child1].box, nodes[u.child2].box);
+    u.height   = 1 + std::max(nodes[u.child1].height, nodes[u.child2].height);
+    node.height = 1 + std::max(nodes[node.child1].height, nodes[node.child2].height);
+}
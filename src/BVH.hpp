@@ -0,0 +1,296 @@
+#ifndef BVH_H
+#define BVH_H
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "Geometry.hpp"
+
+/**
+ *  A node in the bounding volume hierarchy. Leaves hold a user id, inner nodes always have two children.
+ *  Free nodes reuse the parent field as the next link of the free list.
+ */
+struct BVHNode
+{
+    AABB box;     // Fattened box for leaves, union of the children for inner nodes.
+    int  parent;  // Index of the parent node (or the next free node), -1 for none.
+    int  child1;  // Index of the first child, -1 for leaves.
+    int  child2;  // Index of the second child, -1 for leaves.
+    int  height;  // Height of the subtree, 0 for leaves and -1 for free nodes.
+    int  data;    // User id stored in a leaf.
+
+    bool IsLeaf() const { return child1 == -1; };
+};
+
+/**
+ *  A small stack used during tree traversal; stays on the program stack unless the tree gets very deep.
+ */
+class TraversalStack
+{
+    public:
+        TraversalStack() { count = 0; };
+
+        void Push(int value)
+        {
+            if ( count < LOCAL_SIZE )
+                local[count] = value;
+            else
+                overflow.push_back(value);
+            count++;
+        };
+
+        int Pop()
+        {
+            count--;
+            if ( count < LOCAL_SIZE )
+                return local[count];
+
+            int value = overflow.back();
+            overflow.pop_back();
+            return value;
+        };
+
+        bool Empty() const { return count == 0; };
+
+    private:
+        static const int LOCAL_SIZE = 128; // Number of entries kept on the program stack.
+        int local[LOCAL_SIZE];             // Inline storage.
+        std::vector<int> overflow;         // Heap storage once the inline storage is used up.
+        int count;                         // Total number of entries.
+};
+
+/**
+ *  A dynamic bounding volume hierarchy over spheres (bubbles) or any other boxed object.
+ *  Leaves are fattened by a margin so that small movements don't touch the tree at all; larger movements
+ *  refit the ancestors of the moved leaf and apply local tree rotations to keep the surface area low.
+ */
+class BVH
+{
+    public:
+        /**
+         *  Creates an empty tree.
+         *  @param margin - How much each leaf box is enlarged in every direction.
+         */
+        BVH(float margin = 0.1f);
+
+        /**
+         *  Inserts a new leaf into the tree.
+         *  @param box  - The tight bounds of the object.
+         *  @param data - The user id stored with the leaf.
+         *  @return The proxy id of the new leaf.
+         */
+        int CreateProxy(const AABB& box, int data);
+
+        /**
+         *  Removes a leaf from the tree.
+         *  @param proxy - The proxy id returned by CreateProxy.
+         */
+        void DestroyProxy(int proxy);
+
+        /**
+         *  Updates the bounds of a leaf after its object moved.
+         *  @param proxy        - The proxy id of the leaf.
+         *  @param box          - The new tight bounds of the object.
+         *  @param displacement - The movement since the last update, used to predict the next one.
+         *  @return True if the tree was changed, false if the leaf still fits in its fattened box.
+         */
+        bool MoveProxy(int proxy, const AABB& box, glm::vec3 displacement);
+
+        /** Gets the user id stored in a leaf. */
+        int GetData(int proxy) const { return nodes[proxy].data; };
+
+        /** Changes the user id stored in a leaf, e.g. when the owning object is relocated in memory. */
+        void SetData(int proxy, int data) { nodes[proxy].data = data; };
+
+        /** Gets the fattened box of a leaf. */
+        const AABB& GetFatBox(int proxy) const { return nodes[proxy].box; };
+
+        /** Gets the height of the tree, 0 for an empty or single-leaf tree. */
+        int GetHeight() const { return ( root == -1 ) ? 0 : nodes[root].height; };
+
+        /** Gets the number of leaves in the tree. */
+        int GetLeafCount() const { return leafCount; };
+
+        /**
+         *  Visits every leaf whose fattened box overlaps the query box.
+         *  @param box      - The query box.
+         *  @param callback - Called as bool(int proxy); return false to stop the query.
+         */
+        template <typename Callback>
+        void QueryAABB(const AABB& box, Callback callback) const
+        {
+            if ( root == -1 )
+                return;
+
+            TraversalStack stack;
+            stack.Push(root);
+            while ( !stack.Empty() )
+            {
+                const BVHNode& node = nodes[stack.Pop()];
+                if ( !Overlaps(node.box, box) )
+                    continue;
+
+                if ( node.IsLeaf() )
+                {
+                    if ( !callback(static_cast<int>(&node - nodes.data())) )
+                        return;
+                }
+                else
+                {
+                    stack.Push(node.child1);
+                    stack.Push(node.child2);
+                }
+            }
+        };
+
+        /**
+         *  Visits every leaf whose fattened box touches the query sphere.
+         *  @param center   - The center of the query sphere.
+         *  @param radius   - The radius of the query sphere.
+         *  @param callback - Called as bool(int proxy); return false to stop the query.
+         */
+        template <typename Callback>
+        void QuerySphere(glm::vec3 center, float radius, Callback callback) const
+        {
+            if ( root == -1 )
+                return;
+
+            TraversalStack stack;
+            stack.Push(root);
+            while ( !stack.Empty() )
+            {
+                const BVHNode& node = nodes[stack.Pop()];
+                if ( !Overlaps(node.box, center, radius) )
+                    continue;
+
+                if ( node.IsLeaf() )
+                {
+                    if ( !callback(static_cast<int>(&node - nodes.data())) )
+                        return;
+                }
+                else
+                {
+                    stack.Push(node.child1);
+                    stack.Push(node.child2);
+                }
+            }
+        };
+
+        /**
+         *  Visits every leaf whose fattened box touches a triangle, e.g. the surface swept by a moving ray.
+         *  @param a, b, c  - The corners of the triangle.
+         *  @param callback - Called as bool(int proxy); return false to stop the query.
+         */
+        template <typename Callback>
+        void QueryTriangle(glm::vec3 a, glm::vec3 b, glm::vec3 c, Callback callback) const
+        {
+            if ( root == -1 )
+                return;
+
+            TraversalStack stack;
+            stack.Push(root);
+            while ( !stack.Empty() )
+            {
+                const BVHNode& node = nodes[stack.Pop()];
+                if ( !Overlaps(node.box, a, b, c) )
+                    continue;
+
+                if ( node.IsLeaf() )
+                {
+                    if ( !callback(static_cast<int>(&node - nodes.data())) )
+                        return;
+                }
+                else
+                {
+                    stack.Push(node.child1);
+                    stack.Push(node.child2);
+                }
+            }
+        };
+
+        /**
+         *  Casts a ray through the tree, visiting leaves roughly front to back.
+         *  @param ray      - The ray to cast, with a normalized direction.
+         *  @param maxT     - The furthest distance along the ray to consider.
+         *  @param callback - Called as float(int proxy, float maxT). Return a hit distance to clip the ray,
+         *                    a negative value to ignore the leaf, or 0 to stop the cast.
+         */
+        template <typename Callback>
+        void RayCast(const Ray& ray, float maxT, Callback callback) const
+        {
+            if ( root == -1 )
+                return;
+
+            glm::vec3 invDir = 1.0f / ray.direction;
+
+            TraversalStack stack;
+            stack.Push(root);
+            while ( !stack.Empty() )
+            {
+                const BVHNode& node = nodes[stack.Pop()];
+                if ( RayBox(node.box, ray.origin, invDir, maxT) < 0.0f )
+                    continue;
+
+                if ( node.IsLeaf() )
+                {
+                    float t = callback(static_cast<int>(&node - nodes.data()), maxT);
+                    if ( t == 0.0f )
+                        return;
+                    if ( t > 0.0f && t < maxT )
+                        maxT = t;
+                    continue;
+                }
+
+                // Push the further child first so the closer one is visited first
+                float t1 = RayBox(nodes[node.child1].box, ray.origin, invDir, maxT);
+                float t2 = RayBox(nodes[node.child2].box, ray.origin, invDir, maxT);
+                if ( t1 < 0.0f && t2 < 0.0f )
+                    continue;
+                if ( t1 < 0.0f )
+                    stack.Push(node.child2);
+                else if ( t2 < 0.0f )
+                    stack.Push(node.child1);
+                else if ( t1 <= t2 )
+                {
+                    stack.Push(node.child2);
+                    stack.Push(node.child1);
+                }
+                else
+                {
+                    stack.Push(node.child1);
+                    stack.Push(node.child2);
+                }
+            }
+        };
+
+    private:
+        /** Takes a node from the free list, growing the pool if needed. */
+        int AllocateNode();
+
+        /** Returns a node to the free list. */
+        void FreeNode(int index);
+
+        /** Links a leaf into the tree next to the sibling with the lowest surface area cost. */
+        void InsertLeaf(int leaf);
+
+        /** Unlinks a leaf from the tree, freeing its old parent. */
+        void RemoveLeaf(int leaf);
+
+        /** Recomputes boxes and heights from the given node up to the root, rotating along the way. */
+        void Refit(int index);
+
+        /**
+         *  Swaps a child of the given node with a grandchild if that lowers the surface area of the tree.
+         *  @param index - The inner node to rotate around.
+         */
+        void Rotate(int index);
+
+        std::vector<BVHNode> nodes; // Node pool, both used and free.
+        int   root;                 // Index of the root node, -1 for an empty tree.
+        int   freeList;             // Index of the first free node, -1 if the pool is full.
+        int   leafCount;            // Number of leaves in the tree.
+        float margin;               // Amount each leaf box is fattened by.
+};
+
+#endif
@@ -8,6 +8,7 @@
 #include <GLFW/glfw3.h>
 
 #include "OGLBLOG.hpp"
+#include "Geometry.hpp"
 
 /**
  *  A header class for handling the viewport and input.
@@ -122,6 +123,41 @@ class Camera
             return view;
         };
 
+        /**
+         *  Gets the perspective projection used for the scene.
+         *  @param width  - The width of the viewport.
+         *  @param height - The height of the viewport.
+         *  @returns The projection matrix for the given viewport size.
+         */
+        glm::mat4 GetProjection(float width, float height)
+        {
+            return glm::perspective(glm::radians(FOV), width / height, NEAR_PLANE, FAR_PLANE);
+        };
+
+        /**
+         *  Unprojects a cursor position into a world space ray leaving the camera.
+         *  @param x      - The x position of the cursor in window coordinates.
+         *  @param y      - The y position of the cursor in window coordinates (top-left origin).
+         *  @param width  - The width of the viewport.
+         *  @param height - The height of the viewport.
+         *  @returns A ray from the camera position through the cursor.
+         */
+        Ray GetRay(float x, float y, float width, float height)
+        {
+            // Window coordinates -> normalized device coordinates
+            float ndcX = 2.0f * x / width - 1.0f;
+            float ndcY = 1.0f - 2.0f * y / height;
+
+            glm::mat4 inverse = glm::inverse(GetProjection(width, height) * view);
+            glm::vec4 nearPt  = inverse * glm::vec4(ndcX, ndcY, -1.0f, 1.0f);
+            glm::vec4 farPt   = inverse * glm::vec4(ndcX, ndcY,  1.0f, 1.0f);
+
+            glm::vec3 from = glm::vec3(nearPt) / nearPt.w;
+            glm::vec3 to   = glm::vec3(farPt)  / farPt.w;
+
+            return { cameraPos, glm::normalize(to - from) };
+        };
+
         /**
          *  Gets this Camera's current position in world space.
          *  @returns The current position of the camera.
@@ -146,10 +182,17 @@ class Camera
         /** Gets this Camera's last mouse position in the y direction. */
         float GetY() { return lastPosY; };
 
+        /** Gets the distance to the far clipping plane, the furthest anything can be picked. */
+        float GetFarPlane() { return FAR_PLANE; };
+
         /** Gets this Camera's current mouse velocity. */
         float GetMouseVelocity() { return (velocity < 30.0f) ? velocity : 30.0f; };
 
     private:
+        static constexpr float FOV        = 45.0f;  // Vertical field of view in degrees.
+        static constexpr float NEAR_PLANE = 0.1f;   // Distance to the near clipping plane.
+        static constexpr float FAR_PLANE  = 100.0f; // Distance to the far clipping plane.
+
         glm::vec3 cameraPos;    // Camera position data.
         glm::vec3 cameraFront;  // Camera front position.
         glm::vec3 cameraUp;     // Camera up position.
@@ -2,12 +2,20 @@
 #define CENTROID
 
 #include <vector>
-#include <iostream>
-#include <sstream>
-#include <fstream>
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <random>
 #include <string>
 #include <array>
 
+#include "JobSystem.hpp"
+#include "PointBatch.hpp"
+#include "KdTree.hpp"
+#include "KMeans.hpp"
+#include "PointCloud.hpp"
+#include "PointReader.hpp"
+
 /** A structure of x y z coordinates for a singular point. */
 struct Point
 {
@@ -16,6 +24,18 @@ struct Point
     float z;
 };
 
+/**
+ *  Returns the squared euclidean distance between the two points, for comparing distances without square roots.
+ *  @param one - The first point in xyz space to be compared.
+ *  @param two - The second point whose distance to the first should be calculated.
+ *  @return The squared Euclidean distance from point one to two.
+ */
+inline float distanceSq(Point one, Point two)
+{
+    float dx = one.x - two.x, dy = one.y - two.y, dz = one.z - two.z;
+    return dx * dx + dy * dy + dz * dz;
+};
+
 /**
  *  Returns the euclidean distance between the two points.
  *  @param one - The first point in xyz space to be compared.
@@ -24,7 +44,7 @@ struct Point
  */
 inline float distance(Point one, Point two)
 {
-    return std::sqrt(std::pow(one.x - two.x, 2) + std::pow(one.y - two.y, 2) + std::pow(one.z - two.z, 2));
+    return std::sqrt(distanceSq(one, two));
 };
 
 /** 
@@ -54,13 +74,13 @@ inline Point vSub(Point v1, Point v2)
 inline Point findGreatest(Point center, Point points[], int n)
 {
     // Create max point from center
-    int maxDistance = -1;
+    float maxDistance = -1.0f;
     Point maxPt = center;
 
-    // Loop through each point and find the greatest distance
+    // Loop through each point and find the greatest distance, compared squared
     for (int i = 0; i < n; i++)
     {
-        float d = distance(points[i], center);
+        float d = distanceSq(points[i], center);
 
         if ( d > maxDistance )
         {
@@ -72,41 +92,130 @@ inline Point findGreatest(Point center, Point points[], int n)
     return maxPt;
 };
 
-/** 
- *  Returns the next greatest point from the center .
- *  @param center - The center point of the points cluster.
- *  @param points - The points cluster to find the kth-furthest point in.
- *  @param k      - A number representing the amount of furthest elements you wish to skip.
- *  @return The kth furthest point from the given center, in the given points cluster.
+/**
+ *  Finds the k points furthest from the center, in O(n log k): a bounded heap keeps the k furthest seen so far,
+ *  with the nearest of them on top, so most points cost one comparison against the top. When k is a large part of
+ *  n, the distances are partitioned with nth_element instead. With a job system, every block of points finds its own
+ *  k furthest in parallel and the blocks' picks are merged, or the distances are measured in parallel before the
+ *  partition; either way it gives the same indices as running alone.
+ *  Ties go to the lower index.
+ *  @param center - The point distances are measured from.
+ *  @param points - The points, one after another.
+ *  @param n      - The number of points.
+ *  @param k      - How many points to find; fewer come back if there aren't that many.
+ *  @param jobs   - The job system to search in parallel with, or NULL to search on the calling thread.
+ *  @return The indices of the k furthest points, furthest first.
  */
-inline Point findKGreatest(Point center, Point points[], int k)
+inline std::vector<int> FarthestK(Point center, const Point* points, int n, int k, JobSystem* jobs = NULL)
 {
-    // Temporary array
-    std::vector<Point> pts;
-    Point greatest;
-    for (int x = 0; x < sizeof(points) - (sizeof(points[0]) / sizeof(float)); x++)
-    {
-        pts.push_back(points[x]);
-    }
+    typedef std::pair<float, int> Entry; // Squared distance and index.
 
-    // Find k-th furthest point
-    for (int i = 0; i < k; i++)
+    const int BLOCK     = 65536; // Fewest points each parallel job searches.
+    const int PARTITION = 8;     // Partition instead once k is more than one in this many of the points.
+    const int SPREAD    = 64;    // Fewest points per parallel job for each of the k.
+
+    // The heap's order: a comes first if it's further, or as far with a lower index
+    auto further = [](const Entry& a, const Entry& b) { return a.first > b.first || (a.first == b.first && a.second < b.second); };
+    auto measure = [&](int i)
     {
-        // i-th greatest
-        greatest = findGreatest(center, pts.data(), pts.size());
+        float dx = points[i].x - center.x, dy = points[i].y - center.y, dz = points[i].z - center.z;
+        return Entry(dx * dx + dy * dy + dz * dz, i);
+    };
+
+    k = std::max(0, std::min(k, n));
+    if ( k == 0 )
+        return {};
+    std::vector<Entry> best;
 
-        // Add all elements but the greatest to the array
-        for (int j = 0; j < pts.size(); j++)
+    if ( k * PARTITION > n )
+    {
+        best.resize(n);
+        auto fill = [&](int start, int end)
         {
-            if ( pts[j].x == greatest.x && pts[j].y == greatest.y && pts[j].z == greatest.z )
+            for (int i = start; i < end; i++)
+                best[i] = measure(i);
+        };
+        if ( jobs != NULL )
+            jobs->ParallelFor(0, n, BLOCK, fill);
+        else
+            fill(0, n);
+        std::nth_element(best.begin(), best.begin() + k - 1, best.end(), further);
+        best.resize(k);
+    }
+    else
+    {
+        // Keeps the k furthest of [start, end) at heap, with the nearest of them on top
+        auto search = [&](int start, int end, Entry* heap)
+        {
+            int size = 0;
+            for (int i = start; i < end; i++)
             {
-                pts.erase(pts.begin() + j);
-                j--;
+                Entry entry = measure(i);
+                if ( size < k )
+                {
+                    heap[size++] = entry;
+                    std::push_heap(heap, heap + size, further);
+                }
+                else if ( further(entry, heap[0]) )
+                {
+                    std::pop_heap(heap, heap + k, further);
+                    heap[k - 1] = entry;
+                    std::push_heap(heap, heap + k, further);
+                }
             }
+            return size;
+        };
+
+        // A few blocks per thread, each many times k points: every block's heap refills on its own, so small
+        // blocks would cost more in heap updates than the threads save
+        int threads = jobs != NULL ? jobs->GetThreadCount() : 1;
+        int block   = std::max(std::max(BLOCK, k * SPREAD), (n + threads * 4 - 1) / (threads * 4));
+        int blocks  = threads > 1 ? (n + block - 1) / block : 1;
+        if ( blocks <= 1 )
+        {
+            best.resize(k);
+            best.resize(search(0, n, best.data()));
+        }
+        else
+        {
+            // Every block keeps its own k furthest, then they're merged
+            std::vector<Entry> picks(static_cast<size_t>(blocks) * k);
+            jobs->ParallelFor(0, blocks, 1, [&](int first, int last)
+            {
+                for (int b = first; b < last; b++)
+                    search(b * block, std::min(n, (b + 1) * block), &picks[static_cast<size_t>(b) * k]);
+            });
+
+            std::vector<int> slots(blocks);
+            for (int b = 0; b < blocks; b++)
+                slots[b] = std::min(k, std::min(n, (b + 1) * block) - b * block);
+            for (int b = 0; b < blocks; b++)
+                best.insert(best.end(), picks.begin() + static_cast<size_t>(b) * k, picks.begin() + static_cast<size_t>(b) * k + slots[b]);
+            std::nth_element(best.begin(), best.begin() + (k - 1), best.end(), further);
+            best.resize(k);
         }
     }
 
-    return findGreatest(center, pts.data(), pts.size());
+    std::sort(best.begin(), best.end(), further);
+    std::vector<int> indices(best.size());
+    for (size_t i = 0; i < best.size(); i++)
+        indices[i] = best[i].second;
+    return indices;
+};
+
+/** 
+ *  Returns the next greatest point from the center .
+ *  @param center - The center point of the points cluster.
+ *  @param points - The points cluster to find the kth-furthest point in.
+ *  @param n      - The number of points in this cluster.
+ *  @param k      - A number representing the amount of furthest elements you wish to skip.
+ *  @return The kth furthest point from the given center, in the given points cluster, or the center if there are
+ *          no more than k points.
+ */
+inline Point findKGreatest(Point center, Point points[], int n, int k)
+{
+    std::vector<int> furthest = FarthestK(center, points, n, k + 1);
+    return static_cast<int>(furthest.size()) > k ? points[furthest[k]] : center;
 };
 
 /**
@@ -127,58 +236,825 @@ inline Point findCenter(Point points[], int n)
         center.z += points[i].z;
     }
 
-    center.x /= (sizeof(points) - (sizeof(points[0]) / sizeof(float)));
-    center.y /= (sizeof(points) - (sizeof(points[0]) / sizeof(float)));
-    center.z /= (sizeof(points) - (sizeof(points[0]) / sizeof(float)));
+    if ( n > 0 )
+    {
+        center.x /= n;
+        center.y /= n;
+        center.z /= n;
+    }
 
     return center;
 };
 
 /**
- *  This method calculates the minimum sphere that can hold the points entered in stdin.
- *  @return An pair consisting of {x, y, z} and r, where xyz are the coordinates of the center point and r is the radius.
+ *  The smallest sphere around a set of points, found exactly with Welzl's algorithm in the move-to-front form
+ *  of Gärtner's Miniball. Points that end up outside the ball on the way are moved to the front of a list, so
+ *  the few points that decide the ball are checked first from then on. The list starts out as a random sample;
+ *  every point outside the sample's ball joins it, with the furthest one in front, until none is left outside.
+ *  So only a tiny list is ever walked node by node. The whole array is only scanned straight through, a few
+ *  times, and nothing the size of the input is allocated.
+ *  The ball is worked out in doubles. The radius is then measured back over every point, so every point is
+ *  inside it even after rounding to floats.
  */
-inline std::pair<std::array<float,3>, float> Center()
+class MinimumBall
 {
-    // Pointer to a vector containing the points to be used
-    std::vector<Point> points; // = new std::vector<Point>();
+    public:
+        /**
+         *  Finds the smallest ball around the points.
+         *  @param points - The points, one after another.
+         *  @param n      - The number of points.
+         *  @param seed   - Seeds the choice of the starting sample.
+         */
+        MinimumBall(const Point* points, int n, unsigned int seed = 1u)
+        {
+            Fit(&points->x, &points->y, &points->z, 3, n, seed);
+        };
 
-    // The number of points in this cluster
-    int n;
+        /**
+         *  Finds the smallest ball around points kept as separate coordinate arrays, such as the columns of a
+         *  mapped PointCloud, without copying them.
+         *  @param x, y, z - The coordinates of the points.
+         *  @param n       - The number of points.
+         *  @param seed    - Seeds the choice of the starting sample.
+         */
+        MinimumBall(const float* x, const float* y, const float* z, int n, unsigned int seed = 1u)
+        {
+            Fit(x, y, z, 1, n, seed);
+        };
 
-    // Read in points
-    std::ifstream source("../OGLBubbles/bin/input.txt");
-    bool first = true;
-    for ( std::string line; std::getline(source, line); )
-    {
-        Point point;
-        std::istringstream inp(line);
+        /** Copying would copy the list along with the ball, so it's deleted. */
+        MinimumBall(const MinimumBall&) = delete;
+        MinimumBall& operator=(const MinimumBall&) = delete;
 
-        if ( first )
+        /** Gets the center of the ball. */
+        Point GetCenter() const { return center; };
+
+        /** Gets the radius of the ball. */
+        float GetRadius() const { return radius; };
+
+    private:
+        /** Finds the ball around n points whose coordinates are stride floats apart. */
+        void Fit(const float* x, const float* y, const float* z, int stride, int n, unsigned int seed)
         {
-            inp >> n;
-            first = false;
-            continue;
-        }
+            xs           = x;
+            ys           = y;
+            zs           = z;
+            this->stride = stride;
+            count        = n;
+            head         = -1;
+            tail         = -1;
+            supportCount = 0;
+            current[0]   = current[1] = current[2] = 0.0;
+            sqRadius     = -1.0;
+            center       = { 0.0f, 0.0f, 0.0f };
+            radius       = 0.0f;
+            if ( n <= 0 )
+                return;
 
-        inp >> point.x;
-        inp >> point.y;
-        inp >> point.z;
+            // Start the list with a random sample, whose ball already holds nearly every point
+            std::mt19937 random(seed);
+            for (int i = 0; i < std::min(n, SAMPLE); i++)
+                Link(n <= SAMPLE ? i : static_cast<int>(random() % n));
 
-        points.push_back(point);
-    }
-    source.close();
+            Grow();
+
+            center = { static_cast<float>(current[0]), static_cast<float>(current[1]), static_cast<float>(current[2]) };
+            float furthest = 0.0f;
+            for (int i = 0; i < n; i++)
+                furthest = std::max(furthest, distanceSq(At(i), center));
+            radius = std::sqrt(furthest);
+        };
+
+        /** Gets a point. */
+        Point At(int index) const
+        {
+            size_t k = static_cast<size_t>(index) * stride;
+            return { xs[k], ys[k], zs[k] };
+        };
+
+        /**
+         *  Grows the ball of the current support points until it holds every point on the list before end,
+         *  with the support points on its surface.
+         *  @param end - The node the walk stops at, or -1 for the whole list.
+         */
+        void MoveToFront(int end)
+        {
+            if ( supportCount == MAX_SUPPORT )
+                return;
+
+            for (int node = head; node != end; )
+            {
+                int following = next[node];
+                if ( Excess(members[node]) > 0.0 && Push(members[node]) )
+                {
+                    MoveToFront(node);
+                    Pop();
+                    ToFront(node);
+                }
+                node = following;
+            }
+        };
+
+        /**
+         *  Finds the ball of the list, then adds every point still outside it to the list with the furthest in
+         *  front, and goes again until no point is left outside. The ball of the list holds every point in the
+         *  end, so it's the smallest ball of all of them.
+         */
+        void Grow()
+        {
+            MoveToFront(-1);
+
+            for (;;)
+            {
+                int    worstNode = -1;
+                double worst     = 0.0;
+                int    added     = 0;
+                for (int i = 0; i < count; i++)
+                {
+                    double excess = Excess(i);
+                    if ( excess <= 0.0 || (added == MAX_BATCH && excess <= worst) )
+                        continue;
+
+                    int node = Link(i);
+                    added++;
+                    if ( excess > worst )
+                    {
+                        worst     = excess;
+                        worstNode = node;
+                    }
+                }
+                if ( worstNode == -1 )
+                    break;
+
+                // Rounding could keep a point just outside a ball that can't grow any more
+                double oldSqRadius = sqRadius;
+                ToFront(worstNode);
+                MoveToFront(-1);
+                if ( sqRadius <= oldSqRadius )
+                    break;
+            }
+        };
+
+        /** Gets how far outside the current ball a point is, in squared distance, or nothing if it's inside. */
+        double Excess(int index) const
+        {
+            Point  p  = At(index);
+            double dx = p.x - current[0], dy = p.y - current[1], dz = p.z - current[2];
+            double excess = dx * dx + dy * dy + dz * dz - sqRadius;
+            return excess > EPSILON * std::max(sqRadius, EPSILON) ? excess : 0.0;
+        };
+
+        /**
+         *  Puts a point on the surface of the ball along with the current support points, and makes the smallest
+         *  ball through all of them the current ball. Like in Miniball, taking the point off again with Pop
+         *  leaves the current ball alone.
+         *  @return False if the point lies in the flat the support points span, which has no such ball.
+         */
+        bool Push(int index)
+        {
+            Point  first = At(supportCount > 0 ? support[0] : index);
+            double q0[3] = { first.x, first.y, first.z };
+
+            // The center is q0 + sum_j l_j v_j with v_j = q_j - q0, equally far from every q_j
+            int k = supportCount;
+            double v[MAX_SUPPORT][3];
+            for (int j = 0; j < k; j++)
+            {
+                Point q = At(j + 1 < k ? support[j + 1] : index);
+                v[j][0] = q.x - q0[0];
+                v[j][1] = q.y - q0[1];
+                v[j][2] = q.z - q0[2];
+            }
+
+            double a[3][4], scale = 0.0;
+            for (int i = 0; i < k; i++)
+            {
+                for (int j = 0; j < k; j++)
+                    a[i][j] = 2.0 * (v[i][0] * v[j][0] + v[i][1] * v[j][1] + v[i][2] * v[j][2]);
+                a[i][k] = v[i][0] * v[i][0] + v[i][1] * v[i][1] + v[i][2] * v[i][2];
+                scale   = std::max(scale, a[i][i]);
+            }
+
+            // Gaussian elimination with partial pivoting; a pivot that vanishes next to the largest diagonal
+            // means the points are affinely dependent
+            for (int c = 0; c < k; c++)
+            {
+                int best = c;
+                for (int r = c + 1; r < k; r++)
+                    if ( std::abs(a[r][c]) > std::abs(a[best][c]) )
+                        best = r;
+                for (int j = 0; j <= k; j++)
+                    std::swap(a[c][j], a[best][j]);
+                if ( std::abs(a[c][c]) <= EPSILON * scale || a[c][c] == 0.0 )
+                    return false;
+
+                for (int r = 0; r < k; r++)
+                {
+                    if ( r == c )
+                        continue;
+                    double factor = a[r][c] / a[c][c];
+                    for (int j = c; j <= k; j++)
+                        a[r][j] -= factor * a[c][j];
+                }
+            }
+
+            double c[3] = { q0[0], q0[1], q0[2] };
+            for (int j = 0; j < k; j++)
+            {
+                double l = a[j][k] / a[j][j];
+                c[0] += l * v[j][0];
+                c[1] += l * v[j][1];
+                c[2] += l * v[j][2];
+            }
+
+            current[0] = c[0];
+            current[1] = c[1];
+            current[2] = c[2];
+            sqRadius   = (c[0] - q0[0]) * (c[0] - q0[0]) + (c[1] - q0[1]) * (c[1] - q0[1]) + (c[2] - q0[2]) * (c[2] - q0[2]);
+
+            support[supportCount++] = index;
+            return true;
+        };
+
+        /** Takes the last point off the surface of the ball. */
+        void Pop() { supportCount--; };
+
+        /** Adds a point to the end of the list and returns its node. */
+        int Link(int index)
+        {
+            int node = static_cast<int>(members.size());
+            members.push_back(index);
+            next.push_back(-1);
+            previous.push_back(tail);
+            if ( tail != -1 )
+                next[tail] = node;
+            else
+                head = node;
+            tail = node;
+            return node;
+        };
+
+        /** Moves a node to the front of the list. */
+        void ToFront(int node)
+        {
+            if ( head == node )
+                return;
+
+            if ( tail == node )
+                tail = previous[node];
+            next[previous[node]] = next[node];
+            if ( next[node] != -1 )
+                previous[next[node]] = previous[node];
+            previous[head] = node;
+            next[node]     = head;
+            previous[node] = -1;
+            head = node;
+        };
+
+        static constexpr int    MAX_SUPPORT = 4;     // Points that can sit on the surface of a ball in 3D.
+        static constexpr int    SAMPLE      = 1024;  // Random points the list starts out with.
+        static constexpr int    MAX_BATCH   = 65536; // Points outside the ball added to the list per scan, at most.
+        static constexpr double EPSILON     = 1e-12; // Relative slack of the inside test and the degeneracy test.
+
+        const float* xs;           // X coordinate of the first point the ball goes around.
+        const float* ys;           // Y coordinate of the first point.
+        const float* zs;           // Z coordinate of the first point.
+        int stride;                // Floats from one point's coordinate to the next one's.
+        int count;                 // How many points there are.
+
+        std::vector<int> members;  // Point on every node of the list.
+        std::vector<int> next;     // Next node on the list, or -1.
+        std::vector<int> previous; // Previous node on the list, or -1.
+        int head;                  // First node on the list.
+        int tail;                  // Last node on the list.
+
+        int    support[MAX_SUPPORT]; // Points on the surface of the ball being grown.
+        int    supportCount;         // How many there are.
+        double current[3];           // Center of the ball from the last Push.
+        double sqRadius;             // Squared radius of the ball from the last Push, negative before the first.
+
+        Point center; // Center of the finished ball.
+        float radius; // Radius of the finished ball, measured over every point.
+};
+
+/**
+ *  A bounding sphere built up from a stream of points, a chunk at a time, for clouds too big to hold in memory.
+ *  The first chunk gets its exact MinimumBall. From then on a point outside the sphere grows it just enough to hold
+ *  the old sphere and the point, as in Ritter's second pass, which never ends up more than half again too big.
+ *  Alongside, it keeps the furthest point each way along seven directions. Any sphere around the whole cloud is
+ *  around those too, so their MinimumBall is a lower bound on the best radius, and GetErrorBound certifies how much
+ *  bigger than the best the streamed sphere can be.
+ *  If the stream can be replayed, Rewind starts a correction pass from the ball of those extremes, which is usually
+ *  much closer; once it has seen as many points as the first pass, the smaller of the two spheres is reported.
+ *  Spheres are grown in doubles, and the radius is rounded up to cover the center's rounding to floats.
+ */
+class StreamingBall
+{
+    public:
+        StreamingBall()
+        {
+            first    = { 0.0, 0.0, 0.0, -1.0 };
+            second   = { 0.0, 0.0, 0.0, -1.0 };
+            count    = 0;
+            replayed = 0;
+            lower    = 0.0f;
+        };
+
+        /** Copying is cheap, but a copy would leave one stream counting points it never saw, so it's deleted. */
+        StreamingBall(const StreamingBall&) = delete;
+        StreamingBall& operator=(const StreamingBall&) = delete;
+
+        /**
+         *  Takes in the next chunk of the stream.
+         *  @param points - The points, one after another.
+         *  @param n      - The number of points.
+         */
+        void Add(const Point* points, int n)
+        {
+            if ( n <= 0 )
+                return;
+
+            if ( second.r >= 0.0 )
+            {
+                Enclose(second, points, n);
+                replayed += n;
+                return;
+            }
+
+            if ( first.r < 0.0 )
+            {
+                MinimumBall ball(points, n);
+                Point center = ball.GetCenter();
+                first = { center.x, center.y, center.z, ball.GetRadius() };
+                for (int d = 0; d < 2 * DIRECTIONS; d++)
+                {
+                    extremes[d] = points[0];
+                    reach[d]    = Project(points[0], d);
+                }
+            }
+            else
+                Enclose(first, points, n);
+
+            Track(points, n);
+            count += n;
+
+            Point core[2 * DIRECTIONS];
+            std::copy(extremes, extremes + 2 * DIRECTIONS, core);
+            lower = MinimumBall(core, 2 * DIRECTIONS).GetRadius() * (1.0f - SLACK);
+        };
+
+        /**
+         *  Starts the correction pass; the same points are to be added again, in any chunks and any order.
+         *  Until all of them have been, the first pass's sphere is still the one reported.
+         */
+        void Rewind()
+        {
+            if ( count == 0 )
+                return;
+
+            Point core[2 * DIRECTIONS];
+            std::copy(extremes, extremes + 2 * DIRECTIONS, core);
+            MinimumBall ball(core, 2 * DIRECTIONS);
+            Point center = ball.GetCenter();
+            second   = { center.x, center.y, center.z, ball.GetRadius() };
+            replayed = 0;
+        };
+
+        /** Gets the center of the sphere. */
+        Point GetCenter() const
+        {
+            const Ball& ball = Best();
+            return { static_cast<float>(ball.x), static_cast<float>(ball.y), static_cast<float>(ball.z) };
+        };
+
+        /** Gets the radius of the sphere, which holds every point of the stream. */
+        float GetRadius() const
+        {
+            const Ball& ball = Best();
+            if ( ball.r < 0.0 )
+                return 0.0f;
+
+            Point  center = GetCenter();
+            double dx = center.x - ball.x, dy = center.y - ball.y, dz = center.z - ball.z;
+            double r  = (ball.r + std::sqrt(dx * dx + dy * dy + dz * dz)) * (1.0 + SLACK);
+            return std::nextafter(static_cast<float>(r), HUGE_VALF);
+        };
+
+        /** Gets a radius that no sphere around the whole stream can be smaller than. */
+        float GetLowerBound() const { return lower; };
+
+        /**
+         *  Gets how much bigger than the smallest sphere the reported one can be, as a fraction of the smallest:
+         *  the radius is at most (1 + bound) times the best.
+         */
+        float GetErrorBound() const
+        {
+            float radius = GetRadius();
+            if ( radius <= 0.0f )
+                return 0.0f;
+            return lower > 0.0f ? radius / lower - 1.0f : HUGE_VALF;
+        };
+
+        /** Gets the number of points in the stream. */
+        long long GetCount() const { return count; };
+
+        static constexpr int   CHUNK      = 65536; // Points a reader should hand over at a time.
+        static constexpr int   DIRECTIONS = 7;     // Directions the extremes are kept along, both ways.
+        static constexpr float SLACK      = 1e-6f; // Relative give on the bounds for float rounding.
+
+    private:
+        /** A sphere in doubles; a negative radius means it's empty. */
+        struct Ball
+        {
+            double x, y, z, r;
+        };
+
+        /** Gets the sphere to report: the corrected one if it has seen the whole stream and came out smaller. */
+        const Ball& Best() const
+        {
+            return (second.r >= 0.0 && replayed >= count && second.r < first.r) ? second : first;
+        };
+
+        /**
+         *  Grows a sphere around each point outside it in turn, moving the center toward the point by as much
+         *  as the radius grows, so the new sphere still holds the old one.
+         */
+        static void Enclose(Ball& ball, const Point* points, int n)
+        {
+            double sqRadius = ball.r * ball.r;
+            for (int i = 0; i < n; i++)
+            {
+                double dx = points[i].x - ball.x, dy = points[i].y - ball.y, dz = points[i].z - ball.z;
+                double sq = dx * dx + dy * dy + dz * dz;
+                if ( sq <= sqRadius )
+                    continue;
+
+                double d      = std::sqrt(sq);
+                double radius = (ball.r + d) * 0.5;
+                double shift  = (radius - ball.r) / d;
+                ball.x  += dx * shift;
+                ball.y  += dy * shift;
+                ball.z  += dz * shift;
+                ball.r   = radius;
+                sqRadius = radius * radius;
+            }
+        };
+
+        /** Projects a point onto a direction: the three axes, then the four diagonals of a cube. */
+        static float Project(const Point& p, int direction)
+        {
+            switch ( direction % DIRECTIONS )
+            {
+                case 0:  return p.x;
+                case 1:  return p.y;
+                case 2:  return p.z;
+                case 3:  return p.x + p.y + p.z;
+                case 4:  return p.x + p.y - p.z;
+                case 5:  return p.x - p.y + p.z;
+                default: return -p.x + p.y + p.z;
+            }
+        };
+
+        /** Keeps the furthest point each way along every direction: the highest in the first seven, the lowest after. */
+        void Track(const Point* points, int n)
+        {
+            for (int i = 0; i < n; i++)
+            {
+                const Point& p = points[i];
+                float along[DIRECTIONS] = { p.x, p.y, p.z, p.x + p.y + p.z, p.x + p.y - p.z, p.x - p.y + p.z, -p.x + p.y + p.z };
+                for (int d = 0; d < DIRECTIONS; d++)
+                {
+                    if ( along[d] > reach[d] )
+                    {
+                        reach[d]    = along[d];
+                        extremes[d] = p;
+                    }
+                    if ( along[d] < reach[d + DIRECTIONS] )
+                    {
+                        reach[d + DIRECTIONS]    = along[d];
+                        extremes[d + DIRECTIONS] = p;
+                    }
+                }
+            }
+        };
+
+        Ball      first;    // Sphere grown over the first pass.
+        Ball      second;   // Sphere grown over the correction pass, empty until Rewind.
+        long long count;    // Points in the first pass.
+        long long replayed; // Points seen again in the correction pass.
+        float     lower;    // Lower bound on the best radius, from the extremes.
+
+        Point extremes[2 * DIRECTIONS]; // Furthest point each way along every direction.
+        float reach[2 * DIRECTIONS];    // How far along its direction each of those is.
+};
+
+/**
+ *  The smallest sphere around a set of points that changes a few points at a time, for live sources that insert,
+ *  remove and move points every frame without refitting the whole cloud.
+ *  Points strictly inside the ball don't decide it, so removing or moving one around inside costs nothing. The
+ *  points on its surface are flagged as support; only taking one of those away forces a full MinimumBall refit.
+ *  A point that lands outside grows the ball to the smallest one around the support points and itself. That is
+ *  the new ball when it holds the whole old ball; otherwise one SIMD scan checks that it holds every point, and only
+ *  if one is left outside is the ball refit.
+ *  Changes are only recorded as they're made. Update applies them all at once, so a frame that takes away several
+ *  support points pays for one refit.
+ */
+class DynamicBall
+{
+    public:
+        DynamicBall()
+        {
+            center = { 0.0f, 0.0f, 0.0f };
+            radius = 0.0f;
+            stale  = false;
+            refits = 0;
+        };
+
+        /** Copying would copy every point, so it's deleted. */
+        DynamicBall(const DynamicBall&) = delete;
+        DynamicBall& operator=(const DynamicBall&) = delete;
+
+        /**
+         *  Adds a point.
+         *  @param point - Where the point is.
+         *  @return The handle of the point, which stays the same until the point is removed.
+         */
+        int Insert(Point point)
+        {
+            int handle;
+            if ( !freeHandles.empty() )
+            {
+                handle = freeHandles.back();
+                freeHandles.pop_back();
+            }
+            else
+            {
+                handle = static_cast<int>(slots.size());
+                slots.push_back(-1);
+                support.push_back(0);
+            }
+
+            slots[handle]   = static_cast<int>(owners.size());
+            support[handle] = 0;
+            owners.push_back(handle);
+            x.push_back(point.x);
+            y.push_back(point.y);
+            z.push_back(point.z);
+            Check(handle);
+            return handle;
+        };
+
+        /**
+         *  Takes a point away.
+         *  @param handle - The handle Insert gave the point.
+         */
+        void Remove(int handle)
+        {
+            if ( support[handle] )
+                stale = true;
+
+            // The last point fills the hole, so the coordinates stay packed for the scans
+            int hole = slots[handle], last = static_cast<int>(owners.size()) - 1;
+            x[hole]      = x[last];
+            y[hole]      = y[last];
+            z[hole]      = z[last];
+            owners[hole] = owners[last];
+            slots[owners[hole]] = hole;
+            x.pop_back();
+            y.pop_back();
+            z.pop_back();
+            owners.pop_back();
+
+            slots[handle]   = -1;
+            support[handle] = 0;
+            freeHandles.push_back(handle);
+        };
+
+        /**
+         *  Moves a point.
+         *  @param handle - The handle Insert gave the point.
+         *  @param point  - Where the point is now.
+         */
+        void Move(int handle, Point point)
+        {
+            if ( support[handle] )
+            {
+                stale           = true;
+                support[handle] = 0;
+            }
+
+            int at = slots[handle];
+            x[at] = point.x;
+            y[at] = point.y;
+            z[at] = point.z;
+            Check(handle);
+        };
+
+        /**
+         *  Applies the changes since the last call, so the ball holds every point again.
+         *  @return Whether the ball had to be refit from scratch.
+         */
+        bool Update()
+        {
+            if ( !stale )
+            {
+                for (int handle : outside)
+                {
+                    if ( slots[handle] < 0 || Inside(handle) )
+                        continue;
+                    if ( !Grow(handle) )
+                    {
+                        stale = true;
+                        break;
+                    }
+                }
+            }
+            outside.clear();
+
+            if ( !stale )
+                return false;
+
+            Refit();
+            return true;
+        };
+
+        /** Gets the center of the ball as of the last Update. */
+        Point GetCenter() const { return center; };
+
+        /** Gets the radius of the ball as of the last Update. */
+        float GetRadius() const { return radius; };
+
+        /** Gets the number of points. */
+        int GetCount() const { return static_cast<int>(owners.size()); };
+
+        /** Gets where a point is. */
+        Point GetPoint(int handle) const
+        {
+            int at = slots[handle];
+            return { x[at], y[at], z[at] };
+        };
+
+        /** Gets whether a point is on the surface of the ball, so that taking it away means a refit. */
+        bool IsSupport(int handle) const { return support[handle] != 0; };
+
+        /** Gets how many times Update has refit the ball from scratch. */
+        int GetRefitCount() const { return refits; };
+
+        static constexpr float SURFACE = 1e-5f; // Relative band of squared distance points count as on the surface in.
+
+    private:
+        /** Notes a point for Update if it's outside the ball. */
+        void Check(int handle)
+        {
+            if ( owners.size() == 1 && !stale )
+            {
+                // The first point is its own ball
+                center = GetPoint(handle);
+                radius = 0.0f;
+                supportList.assign(1, handle);
+                support[handle] = 1;
+                return;
+            }
+            if ( !stale && !Inside(handle) )
+                outside.push_back(handle);
+        };
+
+        /** Gets whether a point is inside the current ball. */
+        bool Inside(int handle) const
+        {
+            return distanceSq(GetPoint(handle), center) <= radius * radius;
+        };
+
+        /**
+         *  Grows the ball to hold a point outside it, as the smallest ball around the support points and the point.
+         *  @return False if that ball might leave another point out, and the ball has to be refit.
+         */
+        bool Grow(int handle)
+        {
+            std::vector<Point> core;
+            for (int member : supportList)
+                if ( support[member] )
+                    core.push_back(GetPoint(member));
+            core.push_back(GetPoint(handle));
+
+            MinimumBall ball(core.data(), static_cast<int>(core.size()));
+            Point grown   = ball.GetCenter();
+            float reach   = ball.GetRadius();
+            float shifted = distance(grown, center);
+
+            // A ball holding the old ball holds every point; otherwise every point has to be checked
+            if ( shifted + radius > reach )
+            {
+                batch.View(x.data(), y.data(), z.data(), GetCount());
+                float furthest;
+                float at[3] = { grown.x, grown.y, grown.z };
+                batch.Farthest(at, &furthest);
+                if ( furthest > reach * reach )
+                    return false;
+            }
+
+            center = grown;
+            radius = reach;
+            MarkSupport(supportList);
+            if ( OnSurface(handle) )
+            {
+                support[handle] = 1;
+                supportList.push_back(handle);
+            }
+            return true;
+        };
+
+        /** Fits the ball to every point from scratch and flags the points on its surface. */
+        void Refit()
+        {
+            MinimumBall ball(x.data(), y.data(), z.data(), GetCount());
+            center = ball.GetCenter();
+            radius = ball.GetRadius();
+            stale  = false;
+            refits++;
+
+            std::fill(support.begin(), support.end(), 0);
+            supportList.clear();
+            for (int at = 0; at < GetCount(); at++)
+            {
+                if ( OnSurface(owners[at]) )
+                {
+                    support[owners[at]] = 1;
+                    supportList.push_back(owners[at]);
+                }
+            }
+        };
+
+        /** Keeps only the support points that are still on the surface of the ball. */
+        void MarkSupport(const std::vector<int>& candidates)
+        {
+            std::vector<int> kept;
+            for (int member : candidates)
+            {
+                bool on = support[member] && OnSurface(member);
+                support[member] = on ? 1 : 0;
+                if ( on )
+                    kept.push_back(member);
+            }
+            supportList.swap(kept);
+        };
+
+        /** Gets whether a point is on the surface of the current ball. */
+        bool OnSurface(int handle) const
+        {
+            return distanceSq(GetPoint(handle), center) >= radius * radius * (1.0f - SURFACE);
+        };
+
+        std::vector<float> x;           // X coordinate of every point, packed.
+        std::vector<float> y;           // Y coordinate of every point, packed.
+        std::vector<float> z;           // Z coordinate of every point, packed.
+        std::vector<int>   owners;      // Handle of every packed point.
+        std::vector<int>   slots;       // Packed index of every handle, or -1 if it's free.
+        std::vector<char>  support;     // Whether every handle is on the surface of the ball.
+        std::vector<int>   supportList; // Handles flagged as support.
+        std::vector<int>   freeHandles; // Handles of removed points, to hand out again.
+        std::vector<int>   outside;     // Handles that went outside the ball since the last Update.
+        PointBatch batch;               // View of the packed points for the scans.
+
+        Point center; // Center of the ball.
+        float radius; // Radius of the ball, which holds every point after Update.
+        bool  stale;  // Whether a support point went away, so the ball has to be refit.
+        int   refits; // Full refits so far.
+};
+
+/**
+ *  The original approximation of the enclosing sphere: starting from the average point, it shifts the circle
+ *  toward the furthest points one hemisphere at a time and keeps every shrink that still holds all the points.
+ *  It's neither minimal nor fast, and is kept for comparing against MinimumBall.
+ *  @param points - The points to enclose.
+ *  @return An pair consisting of {x, y, z} and r, where xyz are the coordinates of the center point and r is the radius.
+ */
+inline std::pair<std::array<float,3>, float> HemisphereCenter(const std::vector<Point>& source)
+{
+    std::vector<Point> points(source);
 
     // Keeps track of circle state
     float oldRadius, originalR;
     Point oldCenter, oldGreatest;
 
+    // The furthest point is looked for three times a step, so it's done on a batch with the SIMD kernels
+    PointBatch batch;
+    batch.Assign(&points.data()->x, static_cast<int>(points.size()));
+    auto greatest = [&](Point from)
+    {
+        float c[3] = { from.x, from.y, from.z };
+        int   i    = batch.Farthest(c);
+        return i >= 0 ? points[i] : from;
+    };
+
     // Set up original circle (blue)
-    Point center    = findCenter(points.data(), points.size());
-    float radius    = distance(findGreatest(center, points.data(), points.size()), center);
+    float mean[3];
+    batch.Centroid(mean);
+    Point center    = { mean[0], mean[1], mean[2] };
+    float radius    = distance(greatest(center), center);
 
     originalR       = radius;
-    oldGreatest     = findGreatest(center, points.data(), points.size());
+    oldGreatest     = greatest(center);
 
     // Loop variables
     bool sameX, sameY;
@@ -187,14 +1063,14 @@ inline std::pair<std::array<float,3>, float> Center()
     int k = 0; // The current furthest point that's moving the center & radius
 
     // Move circle for each point
-    for (int k = 0; k < n; k++)
+    for (int k = 0; k < static_cast<int>(points.size()); k++)
     {
         // Save circle state
         oldRadius = radius;
         oldCenter = center;
 
         // Find the next greatest point
-        next = findKGreatest(center, points.data(), k);
+        next = findKGreatest(center, points.data(), static_cast<int>(points.size()), k);
     
         // Difference between next greatest point and center of circle (used in line formula)
         v    = vSub(next, center);
@@ -226,7 +1102,7 @@ inline std::pair<std::array<float,3>, float> Center()
         radius -= (radius - distance(next, oldCenter)) / 2;
 
         // Check if any points are excluded, if so expand the radius to fit them (could instead move center...?)
-        check = distance(findGreatest(center, points.data(), points.size()), center);
+        check = distance(greatest(center), center);
         if (check > radius) radius = check;
         
         // Revert state to previous if radius increased
@@ -235,11 +1111,195 @@ inline std::pair<std::array<float,3>, float> Center()
             radius = oldRadius;
             center = oldCenter;
         }
-        oldGreatest = findGreatest(center, points.data(), points.size());
+        oldGreatest = greatest(center);
     }
 
     std::array<float, 3> cent = {center.x, center.y, center.z};
     return std::make_pair(cent, radius);
 };
 
+/**
+ *  Loads the points in input.opc, or input.txt without it, into a batch. The float columns of a cloud file are
+ *  viewed where they're mapped, with no copies; anything else is decoded or parsed into storage.
+ *  @param cloud   - Maps the cloud file, and has to stay open while the batch is used.
+ *  @param batch   - Receives the points.
+ *  @param storage - Holds the coordinates the batch views when they had to be decoded or parsed.
+ *  @param jobs    - The job system to parse the text in parallel with, or NULL to parse it on the calling thread.
+ */
+inline void LoadInput(PointCloud& cloud, PointBatch& batch, std::vector<float>& storage, JobSystem* jobs = NULL)
+{
+    if ( cloud.Open("../OGLBubbles/bin/input.opc") )
+    {
+        cloud.Fill(batch, storage);
+        return;
+    }
+
+    // Read in points, as many as the count line says
+    PointReader source;
+    int n = 0;
+    if ( source.Open("../OGLBubbles/bin/input.txt") )
+    {
+        n = source.GetCount();
+        storage.resize(static_cast<size_t>(n) * 3);
+        n = source.Read(storage.data(), storage.data() + n, storage.data() + static_cast<size_t>(n) * 2, n, 1, jobs);
+    }
+    int capacity = static_cast<int>(storage.size() / 3);
+    batch.View(storage.data(), storage.data() + capacity, storage.data() + static_cast<size_t>(capacity) * 2, n);
+};
+
+/**
+ *  This method calculates the minimum sphere that can hold the points in input.opc, or input.txt without it.
+ *  The float columns of a cloud file are used where they're mapped, with no copies.
+ *  @param jobs - The job system to parse the text in parallel with, or NULL to parse it on the calling thread.
+ *  @return An pair consisting of {x, y, z} and r, where xyz are the coordinates of the center point and r is the radius.
+ */
+inline std::pair<std::array<float,3>, float> Center(JobSystem* jobs = NULL)
+{
+    PointCloud cloud;
+    PointBatch batch;
+    std::vector<float> storage;
+    LoadInput(cloud, batch, storage, jobs);
+
+    MinimumBall ball(batch.GetX(), batch.GetY(), batch.GetZ(), batch.GetCount());
+    Point center = ball.GetCenter();
+    std::array<float, 3> cent = {center.x, center.y, center.z};
+    return std::make_pair(cent, ball.GetRadius());
+};
+
+/**
+ *  This method finds the points that aren't outliers. Each point's mean distance to its k nearest neighbours is
+ *  found through a k-d tree, and points whose mean is more than a few standard deviations above the average of
+ *  those means are left out, since a stray point would stretch an enclosing sphere all the way out to it.
+ *  @param points     - The points.
+ *  @param k          - The number of neighbours each point is measured against.
+ *  @param deviations - How many standard deviations above the average a point's mean can be and still be kept.
+ *  @param jobs       - The job system to build the tree and query it in parallel with, or NULL for the calling thread.
+ *  @return The indices of the points that are kept, in increasing order.
+ */
+inline std::vector<int> Inliers(const PointBatch& points, int k, float deviations, JobSystem* jobs = NULL)
+{
+    const int QUERIES = 65536; // Points queried at a time, so the neighbour lists stay small.
+
+    int n = points.GetCount();
+    KdTree tree;
+    tree.SetJobSystem(jobs);
+    tree.Build(points);
+
+    // Every point is its own nearest neighbour, so one more is asked for and the first is skipped
+    std::vector<float> means(n);
+    std::vector<int>   neighbours(static_cast<size_t>(QUERIES) * (k + 1));
+    std::vector<float> sqDist(neighbours.size());
+    for (int begin = 0; begin < n; begin += QUERIES)
+    {
+        int m = std::min(QUERIES, n - begin);
+        tree.NearestBatch(points.GetX() + begin, points.GetY() + begin, points.GetZ() + begin, m, k + 1, neighbours.data(), sqDist.data());
+        for (int q = 0; q < m; q++)
+        {
+            double sum   = 0.0;
+            int    found = 0;
+            for (int j = 1; j <= k && neighbours[static_cast<size_t>(q) * (k + 1) + j] >= 0; j++, found++)
+                sum += std::sqrt(sqDist[static_cast<size_t>(q) * (k + 1) + j]);
+            means[begin + q] = found > 0 ? static_cast<float>(sum / found) : 0.0f;
+        }
+    }
+
+    double average = 0.0, spread = 0.0;
+    for (float mean : means)
+        average += mean;
+    average /= std::max(n, 1);
+    for (float mean : means)
+        spread += (mean - average) * (mean - average);
+    float limit = static_cast<float>(average + deviations * std::sqrt(spread / std::max(n, 1)));
+
+    std::vector<int> kept;
+    for (int i = 0; i < n; i++)
+        if ( means[i] <= limit )
+            kept.push_back(i);
+    return kept;
+};
+
+/**
+ *  This method splits the points in input.opc, or input.txt without it, into clusters with k-means and calculates
+ *  the minimum sphere around each one, so every clump of points can become a bubble of its own.
+ *  @param k          - The number of clusters wanted; there are fewer if there aren't k distinct points.
+ *  @param miniBatch  - Points per mini-batch, or 0 to iterate over every point; a cloud no bigger than a batch is
+ *                      always iterated over in full.
+ *  @param deviations - Leaves out points this many standard deviations further from their neighbours than usual,
+ *                      as Inliers does, or 0 to keep every point.
+ *  @param jobs       - The job system to read and cluster in parallel with, or NULL to run on the calling thread.
+ *  @return A pair per cluster consisting of {x, y, z} and r, the center point and radius of its sphere.
+ */
+inline std::vector<std::pair<std::array<float,3>, float>> Clusters(int k, int miniBatch = 0, float deviations = 0.0f,
+                                                                   JobSystem* jobs = NULL)
+{
+    const int OUTLIER_NEIGHBOURS = 8; // Neighbours a point's spacing is measured against.
+
+    PointCloud cloud;
+    PointBatch batch;
+    std::vector<float> storage;
+    LoadInput(cloud, batch, storage, jobs);
+
+    std::vector<float> inliers;
+    if ( deviations > 0.0f )
+    {
+        std::vector<int> kept = Inliers(batch, OUTLIER_NEIGHBOURS, deviations, jobs);
+        int m = static_cast<int>(kept.size());
+        inliers.resize(static_cast<size_t>(m) * 3);
+        for (int j = 0; j < m; j++)
+        {
+            inliers[j]         = batch.GetX()[kept[j]];
+            inliers[m + j]     = batch.GetY()[kept[j]];
+            inliers[2 * m + j] = batch.GetZ()[kept[j]];
+        }
+        batch.View(inliers.data(), inliers.data() + m, inliers.data() + 2 * m, m);
+    }
+
+    KMeans kmeans;
+    kmeans.SetJobSystem(jobs);
+    kmeans.SetMiniBatch(batch.GetCount() > miniBatch ? miniBatch : 0);
+    kmeans.Fit(batch, k);
+
+    std::vector<std::pair<std::array<float,3>, float>> spheres;
+    for (const KMeans::Ball& ball : kmeans.GetBalls())
+        spheres.push_back(std::make_pair(ball.center, ball.radius));
+    return spheres;
+};
+
+/**
+ *  This method calculates a sphere around the points in a file without holding them all in memory, reading it
+ *  a chunk at a time with a StreamingBall.
+ *  @param path       - The file, a point count line and then a line of x y z per point.
+ *  @param correct    - Whether to read the file a second time for the correction pass.
+ *  @param errorBound - Receives how much bigger than the smallest sphere this one can be, if not NULL.
+ *  @return An pair consisting of {x, y, z} and r, where xyz are the coordinates of the center point and r is the radius.
+ */
+inline std::pair<std::array<float,3>, float> StreamCenter(const char* path = "../OGLBubbles/bin/input.txt", bool correct = true,
+                                                          float* errorBound = NULL)
+{
+    StreamingBall ball;
+    std::vector<Point> chunk(StreamingBall::CHUNK);
+    PointReader source;
+    source.Open(path);
+
+    for (int pass = 0; pass < (correct ? 2 : 1); pass++)
+    {
+        if ( pass == 1 )
+        {
+            source.Rewind();
+            ball.Rewind();
+        }
+
+        Point* at = chunk.data();
+        for ( int read; (read = source.Next(&at->x, &at->y, &at->z, StreamingBall::CHUNK, 3)) > 0; )
+            ball.Add(at, read);
+    }
+
+    if ( errorBound != NULL )
+        *errorBound = ball.GetErrorBound();
+
+    Point center = ball.GetCenter();
+    std::array<float, 3> cent = {center.x, center.y, center.z};
+    return std::make_pair(cent, ball.GetRadius());
+};
+
 #endif
\ No newline at end of file
@@ -0,0 +1,499 @@
+#include "ConvexHull.hpp"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <map>
+#include <utility>
+
+// Axes, face diagonals and corner diagonals of a cube; the extremes along them already wrap most of a cloud
+static const float AXES[ConvexHull::DIRECTIONS][3] =
+{
+    { 1.0f,  0.0f,  0.0f }, { 0.0f,  1.0f,  0.0f }, { 0.0f,  0.0f,  1.0f },
+    { 1.0f,  1.0f,  0.0f }, { 1.0f, -1.0f,  0.0f }, { 1.0f,  0.0f,  1.0f },
+    { 1.0f,  0.0f, -1.0f }, { 0.0f,  1.0f,  1.0f }, { 0.0f,  1.0f, -1.0f },
+    { 1.0f,  1.0f,  1.0f }, { 1.0f,  1.0f, -1.0f }, { 1.0f, -1.0f,  1.0f },
+    { 1.0f, -1.0f, -1.0f }
+};
+
+static const int CHUNK = 256; // Points tested against every face at a time, so the loop over them vectorizes.
+
+/**
+ *  Runs body(block, begin, end) over blocks of points, in parallel if there are jobs.
+ *  @return The number of blocks.
+ */
+template <typename Body>
+static int ForBlocks(JobSystem* jobs, int n, const Body& body)
+{
+    int blocks = (n + ConvexHull::BLOCK - 1) / ConvexHull::BLOCK;
+    auto run = [&](int start, int end)
+    {
+        for (int b = start; b < end; b++)
+            body(b, b * ConvexHull::BLOCK, std::min(n, (b + 1) * ConvexHull::BLOCK));
+    };
+    if ( jobs != NULL && blocks > 1 )
+        jobs->ParallelFor(0, blocks, 1, run);
+    else
+        run(0, blocks);
+    return blocks;
+}
+
+/** Finds the point with the largest measure, the lowest index on a tie, in parallel blocks joined in order. */
+template <typename Measure>
+static int Furthest(JobSystem* jobs, int n, const Measure& measure, double* best)
+{
+    std::vector<std::pair<double, int>> picks((n + ConvexHull::BLOCK - 1) / ConvexHull::BLOCK, std::make_pair(-1.0, -1));
+    ForBlocks(jobs, n, [&](int b, int begin, int end)
+    {
+        for (int i = begin; i < end; i++)
+        {
+            double value = measure(i);
+            if ( value > picks[b].first )
+                picks[b] = std::make_pair(value, i);
+        }
+    });
+
+    std::pair<double, int> top = std::make_pair(-1.0, -1);
+    for (const std::pair<double, int>& pick : picks)
+        if ( pick.first > top.first )
+            top = pick;
+    *best = top.first;
+    return top.second;
+}
+
+ConvexHull::ConvexHull()
+{
+    x          = NULL;
+    y          = NULL;
+    z          = NULL;
+    count      = 0;
+    tolerance  = 0.0;
+    pass       = 0;
+    candidates = 0;
+    jobs       = NULL;
+}
+
+bool ConvexHull::Build(const float* x, const float* y, const float* z, int n)
+{
+    this->x    = x;
+    this->y    = y;
+    this->z    = z;
+    count      = std::max(0, n);
+    pass       = 0;
+    candidates = 0;
+    faces.clear();
+    spare.clear();
+    pending.clear();
+    vertices.clear();
+    indices.clear();
+    planes.clear();
+    if ( count < 4 )
+        return false;
+
+    // The extreme points each way along every direction, and the size of the cloud for the tolerance
+    struct Extremes
+    {
+        float low[DIRECTIONS], high[DIRECTIONS];
+        int   lowest[DIRECTIONS], highest[DIRECTIONS];
+        float size[3];
+    };
+    std::vector<Extremes> blocks((count + BLOCK - 1) / BLOCK);
+    ForBlocks(jobs, count, [&](int b, int begin, int end)
+    {
+        Extremes& extremes = blocks[b];
+        for (int d = 0; d < DIRECTIONS; d++)
+        {
+            extremes.low[d]    =  HUGE_VALF;
+            extremes.high[d]   = -HUGE_VALF;
+            extremes.lowest[d] = extremes.highest[d] = begin;
+        }
+        extremes.size[0] = extremes.size[1] = extremes.size[2] = 0.0f;
+        for (int i = begin; i < end; i++)
+        {
+            for (int d = 0; d < DIRECTIONS; d++)
+            {
+                float along = AXES[d][0] * x[i] + AXES[d][1] * y[i] + AXES[d][2] * z[i];
+                if ( along < extremes.low[d] )
+                {
+                    extremes.low[d]    = along;
+                    extremes.lowest[d] = i;
+                }
+                if ( along > extremes.high[d] )
+                {
+                    extremes.high[d]    = along;
+                    extremes.highest[d] = i;
+                }
+            }
+            extremes.size[0] = std::max(extremes.size[0], std::abs(x[i]));
+            extremes.size[1] = std::max(extremes.size[1], std::abs(y[i]));
+            extremes.size[2] = std::max(extremes.size[2], std::abs(z[i]));
+        }
+    });
+
+    std::vector<int> corners;
+    float size[3] = { 0.0f, 0.0f, 0.0f };
+    for (int d = 0; d < DIRECTIONS; d++)
+    {
+        int lowest = blocks[0].lowest[d], highest = blocks[0].highest[d];
+        float low = blocks[0].low[d], high = blocks[0].high[d];
+        for (size_t b = 1; b < blocks.size(); b++)
+        {
+            if ( blocks[b].low[d] < low )
+            {
+                low    = blocks[b].low[d];
+                lowest = blocks[b].lowest[d];
+            }
+            if ( blocks[b].high[d] > high )
+            {
+                high    = blocks[b].high[d];
+                highest = blocks[b].highest[d];
+            }
+        }
+        corners.push_back(lowest);
+        corners.push_back(highest);
+    }
+    for (const Extremes& extremes : blocks)
+        for (int a = 0; a < 3; a++)
+            size[a] = std::max(size[a], extremes.size[a]);
+    std::sort(corners.begin(), corners.end());
+    corners.erase(std::unique(corners.begin(), corners.end()), corners.end());
+    tolerance = 3.0 * DBL_EPSILON * (static_cast<double>(size[0]) + size[1] + size[2]);
+
+    // The tetrahedron: the two extremes furthest apart, the point furthest from their line, then from their plane
+    int    p0 = corners[0], p1 = corners[0];
+    double apart = -1.0;
+    for (size_t i = 0; i < corners.size(); i++)
+    {
+        for (size_t j = i + 1; j < corners.size(); j++)
+        {
+            double dx = static_cast<double>(x[corners[j]]) - x[corners[i]];
+            double dy = static_cast<double>(y[corners[j]]) - y[corners[i]];
+            double dz = static_cast<double>(z[corners[j]]) - z[corners[i]];
+            double sq = dx * dx + dy * dy + dz * dz;
+            if ( sq > apart )
+            {
+                apart = sq;
+                p0    = corners[i];
+                p1    = corners[j];
+            }
+        }
+    }
+    if ( std::sqrt(apart) <= tolerance )
+        return false;
+
+    double ux = static_cast<double>(x[p1]) - x[p0], uy = static_cast<double>(y[p1]) - y[p0], uz = static_cast<double>(z[p1]) - z[p0];
+    double length = std::sqrt(ux * ux + uy * uy + uz * uz);
+    ux /= length;
+    uy /= length;
+    uz /= length;
+    double fromLine;
+    int p2 = Furthest(jobs, count, [&](int i)
+    {
+        double dx = static_cast<double>(x[i]) - x[p0], dy = static_cast<double>(y[i]) - y[p0], dz = static_cast<double>(z[i]) - z[p0];
+        double cx = dy * uz - dz * uy, cy = dz * ux - dx * uz, cz = dx * uy - dy * ux;
+        return cx * cx + cy * cy + cz * cz;
+    }, &fromLine);
+    if ( std::sqrt(fromLine) <= tolerance )
+        return false;
+
+    int base = MakeFace(p0, p1, p2);
+    double fromPlane;
+    int p3 = Furthest(jobs, count, [&](int i) { return std::abs(Height(faces[base], i)); }, &fromPlane);
+    if ( fromPlane <= tolerance )
+    {
+        faces.clear();
+        return false;
+    }
+
+    // Four faces, each wound so the corner it leaves out is behind it, joined up across their edges
+    faces.clear();
+    int tetrahedron[4][4] = { { p0, p1, p2, p3 }, { p0, p1, p3, p2 }, { p0, p2, p3, p1 }, { p1, p2, p3, p0 } };
+    for (int f = 0; f < 4; f++)
+    {
+        int face = MakeFace(tetrahedron[f][0], tetrahedron[f][1], tetrahedron[f][2]);
+        if ( Height(faces[face], tetrahedron[f][3]) > 0.0 )
+        {
+            faces.pop_back();
+            MakeFace(tetrahedron[f][0], tetrahedron[f][2], tetrahedron[f][1]);
+        }
+    }
+    std::map<std::pair<int, int>, int> edges;
+    for (int f = 0; f < 4; f++)
+        for (int i = 0; i < 3; i++)
+            edges[std::make_pair(faces[f].v[i], faces[f].v[(i + 1) % 3])] = f;
+    for (int f = 0; f < 4; f++)
+        for (int i = 0; i < 3; i++)
+            faces[f].next[i] = edges[std::make_pair(faces[f].v[(i + 1) % 3], faces[f].v[i])];
+
+    // Grow the hull of the extremes first, then sort every point out against it
+    links.assign(count, -1);
+    made.assign({ 0, 1, 2, 3 });
+    for (int corner : corners)
+        Assign(corner, made);
+    Expand();
+    AssignAll();
+    Expand();
+
+    Finish();
+    return true;
+}
+
+int ConvexHull::MakeFace(int a, int b, int c)
+{
+    Face face;
+    face.v[0] = a;
+    face.v[1] = b;
+    face.v[2] = c;
+    face.next[0] = face.next[1] = face.next[2] = -1;
+
+    // Differences of floats are exact in doubles, so the normal only rounds in the products
+    double ax = x[a], ay = y[a], az = z[a];
+    double bx = x[b], by = y[b], bz = z[b];
+    double cx = x[c], cy = y[c], cz = z[c];
+    double ux = bx - ax, uy = by - ay, uz = bz - az;
+    double vx = cx - ax, vy = cy - ay, vz = cz - az;
+    double nx = uy * vz - uz * vy, ny = uz * vx - ux * vz, nz = ux * vy - uy * vx;
+    double length = std::sqrt(nx * nx + ny * ny + nz * nz);
+    if ( length > 0.0 )
+    {
+        nx /= length;
+        ny /= length;
+        nz /= length;
+    }
+
+    // The offset is taken at the centroid, which rounds less than any one corner
+    face.normal[0] = nx;
+    face.normal[1] = ny;
+    face.normal[2] = nz;
+    face.offset    = (nx * (ax + bx + cx) + ny * (ay + by + cy) + nz * (az + bz + cz)) / 3.0;
+    face.first     = -1;
+    face.furthest  = -1;
+    face.reach     = 0.0;
+    face.alive     = true;
+    face.mark      = -1;
+    if ( !spare.empty() )
+    {
+        int slot = spare.back();
+        spare.pop_back();
+        faces[slot] = face;
+        return slot;
+    }
+    faces.push_back(face);
+    return static_cast<int>(faces.size()) - 1;
+}
+
+void ConvexHull::Assign(int point, const std::vector<int>& among)
+{
+    int    best  = -1;
+    double reach = tolerance;
+    for (int f : among)
+    {
+        double height = Height(faces[f], point);
+        if ( height > reach )
+        {
+            reach = height;
+            best  = f;
+        }
+    }
+    if ( best >= 0 )
+        Give(best, point, reach);
+}
+
+void ConvexHull::Give(int face, int point, double reach)
+{
+    Face& target = faces[face];
+    if ( target.first < 0 )
+        pending.push_back(face);
+    links[point] = target.first;
+    target.first = point;
+    if ( target.furthest < 0 || reach > target.reach )
+    {
+        target.furthest = point;
+        target.reach    = reach;
+    }
+}
+
+void ConvexHull::AssignAll()
+{
+    // The live faces as float planes; a point clearly behind all of them is inside and dropped straight away
+    std::vector<int>   live;
+    std::vector<float> nx, ny, nz, offsets;
+    for (int f = 0; f < static_cast<int>(faces.size()); f++)
+    {
+        if ( !faces[f].alive )
+            continue;
+        live.push_back(f);
+        nx.push_back(static_cast<float>(faces[f].normal[0]));
+        ny.push_back(static_cast<float>(faces[f].normal[1]));
+        nz.push_back(static_cast<float>(faces[f].normal[2]));
+        offsets.push_back(static_cast<float>(faces[f].offset));
+        faces[f].first    = -1;
+        faces[f].furthest = -1;
+        faces[f].reach    = 0.0;
+    }
+    // Floats round the planes to about FLT_EPSILON of the cloud's size, so anything nearer than that gets the exact test
+    int   planeCount = static_cast<int>(live.size());
+    float slack      = static_cast<float>(tolerance + 8.0 * FLT_EPSILON * tolerance / (3.0 * DBL_EPSILON));
+
+    std::vector<std::vector<std::pair<int, int>>> picks((count + BLOCK - 1) / BLOCK);
+    ForBlocks(jobs, count, [&](int b, int begin, int end)
+    {
+        float highest[CHUNK];
+        for (int s = begin; s < end; s += CHUNK)
+        {
+            int e = std::min(end, s + CHUNK);
+            for (int i = s; i < e; i++)
+                highest[i - s] = -HUGE_VALF;
+            for (int f = 0; f < planeCount; f++)
+                for (int i = s; i < e; i++)
+                    highest[i - s] = std::max(highest[i - s], nx[f] * x[i] + ny[f] * y[i] + nz[f] * z[i] - offsets[f]);
+
+            // Points near or past a face get the exact test, against every face
+            for (int i = s; i < e; i++)
+            {
+                if ( highest[i - s] <= -slack )
+                    continue;
+                int    best  = -1;
+                double reach = tolerance;
+                for (int f = 0; f < planeCount; f++)
+                {
+                    double height = Height(faces[live[f]], i);
+                    if ( height > reach )
+                    {
+                        reach = height;
+                        best  = live[f];
+                    }
+                }
+                if ( best >= 0 )
+                    picks[b].push_back(std::make_pair(i, best));
+            }
+        }
+    });
+
+    // Blocks are joined in order, so every face gets its points in the same order on any number of threads
+    for (const std::vector<std::pair<int, int>>& block : picks)
+    {
+        for (const std::pair<int, int>& pick : block)
+            Give(pick.second, pick.first, Height(faces[pick.second], pick.first));
+        candidates += static_cast<int>(block.size());
+    }
+}
+
+void ConvexHull::Expand()
+{
+    // Faces are queued as they get points, so a queued face may have been torn out since and is checked first
+    while ( !pending.empty() )
+    {
+        int face = pending.back();
+        pending.pop_back();
+        if ( faces[face].alive && faces[face].furthest >= 0 )
+            AddPoint(face);
+    }
+}
+
+void ConvexHull::AddPoint(int start)
+{
+    int eye = faces[start].furthest;
+    pass++;
+
+    // Walk the faces the eye can see, depth first, collecting the edges of the hole in order around it
+    stack.clear();
+    visible.clear();
+    horizon.clear();
+    faces[start].mark = pass;
+    visible.push_back(start);
+    stack.push_back({ start, 0, 0 });
+    while ( !stack.empty() )
+    {
+        Visit& visit = stack.back();
+        if ( visit.done == 3 )
+        {
+            stack.pop_back();
+            continue;
+        }
+        int edge = (visit.first + visit.done++) % 3;
+        int face = visit.face;
+        int across = faces[face].next[edge];
+        if ( faces[across].mark == pass )
+            continue;
+
+        if ( Height(faces[across], eye) > tolerance )
+        {
+            // Carry on around the next face from the edge just crossed, which keeps the hole's edges in order
+            int back = 0;
+            while ( faces[across].next[back] != face )
+                back++;
+            faces[across].mark = pass;
+            visible.push_back(across);
+            stack.push_back({ across, back, 0 });
+        }
+        else
+            horizon.push_back({ faces[face].v[edge], faces[face].v[(edge + 1) % 3], across });
+    }
+
+    // Points in front of the torn out faces have to find new ones, and the faces' slots are free to reuse
+    orphans.clear();
+    for (int face : visible)
+    {
+        for (int point = faces[face].first; point >= 0; point = links[point])
+            if ( point != eye )
+                orphans.push_back(point);
+        faces[face].alive    = false;
+        faces[face].first    = -1;
+        faces[face].furthest = -1;
+        spare.push_back(face);
+    }
+
+    // Close the hole with a fan of faces from its edges to the eye
+    int edges = static_cast<int>(horizon.size());
+    made.resize(edges);
+    for (int k = 0; k < edges; k++)
+    {
+        const Rim& rim = horizon[k];
+        made[k] = MakeFace(rim.a, rim.b, eye);
+        faces[made[k]].next[0] = rim.outside;
+        Face& outside = faces[rim.outside];
+        for (int i = 0; i < 3; i++)
+            if ( outside.v[i] == rim.b && outside.v[(i + 1) % 3] == rim.a )
+                outside.next[i] = made[k];
+    }
+    for (int k = 0; k < edges; k++)
+    {
+        faces[made[k]].next[1] = made[(k + 1) % edges];
+        faces[made[k]].next[2] = made[(k + edges - 1) % edges];
+    }
+
+    for (int point : orphans)
+        Assign(point, made);
+}
+
+void ConvexHull::Finish()
+{
+    std::vector<int> remap(count, -1);
+    for (const Face& face : faces)
+    {
+        if ( !face.alive )
+            continue;
+        for (int i = 0; i < 3; i++)
+        {
+            int corner = face.v[i];
+            if ( remap[corner] < 0 )
+            {
+                remap[corner] = static_cast<int>(vertices.size());
+                vertices.push_back(glm::vec3(x[corner], y[corner], z[corner]));
+            }
+            indices.push_back(static_cast<unsigned int>(remap[corner]));
+        }
+        planes.push_back(glm::vec4(face.normal[0], face.normal[1], face.normal[2], face.offset));
+    }
+    std::vector<Face>().swap(faces);
+    std::vector<int>().swap(links);
+}
+
+float ConvexHull::Distance(glm::vec3 point) const
+{
+    float furthest = -HUGE_VALF;
+    for (const glm::vec4& plane : planes)
+        furthest = std::max(furthest, glm::dot(glm::vec3(plane), point) - plane.w);
+    return furthest;
+}
@@ -0,0 +1,159 @@
+#ifndef CONVEXHULL
+#define CONVEXHULL
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "JobSystem.hpp"
+#include "PointBatch.hpp"
+
+/**
+ *  The convex hull of a point cloud as an indexed triangle mesh, found with quickhull.
+ *  Quickhull grows a polytope from a tetrahedron: every face keeps the points in front of it, and the furthest of
+ *  them is added next. The faces that point can see are torn out and the hole is closed with a fan of faces
+ *  from the point to the edge of the hole, and the points of the torn out faces go to the new faces in front of them.
+ *  Nearly all the work with millions of points is sorting them out at the start, so that part runs in parallel: the
+ *  extreme points along DIRECTIONS directions are found, their hull is grown first, and then every point is tested
+ *  against its faces. Points inside that hull can't be on the final one and are dropped, which is most of the
+ *  cloud, so growing the hull from the rest is quick. Sums and picks are kept per block and joined in order, so
+ *  the hull is the same on any number of threads. Clouds whose points nearly all end up on the hull, like points
+ *  on a sphere, leave the serial growth all the work, which takes seconds for millions of points.
+ *  Planes are worked out in doubles, and points closer to a face than a tolerance scaled to the cloud's size count
+ *  as being on it. The triangles are wound counter-clockwise seen from outside, the way DistanceField wants them, so
+ *  the mesh can be drawn and also baked into a collision proxy.
+ */
+class ConvexHull
+{
+    public:
+        ConvexHull();
+
+        /** Copying would copy the faces and the mesh, so it's deleted. */
+        ConvexHull(const ConvexHull&) = delete;
+        ConvexHull& operator=(const ConvexHull&) = delete;
+
+        ~ConvexHull() { };
+
+        /**
+         *  Finds the hull of a set of points.
+         *  @param x, y, z - The coordinates of the points, which only have to last until Build returns.
+         *  @param n       - The number of points.
+         *  @return False if the points all lie in a plane, or there are fewer than four, which leaves the hull empty.
+         */
+        bool Build(const float* x, const float* y, const float* z, int n);
+
+        /** Finds the hull of a batch's points. */
+        bool Build(const PointBatch& points) { return Build(points.GetX(), points.GetY(), points.GetZ(), points.GetCount()); };
+
+        /** Gets the corners of the hull. */
+        const std::vector<glm::vec3>& GetVertices() const { return vertices; };
+
+        /** Gets three corners per triangle, counter-clockwise seen from outside. */
+        const std::vector<unsigned int>& GetIndices() const { return indices; };
+
+        /** Gets the number of triangles. */
+        int GetTriangleCount() const { return static_cast<int>(indices.size() / 3); };
+
+        /** Gets the number of points that were left after the parallel pass dropped the ones inside. */
+        int GetCandidateCount() const { return candidates; };
+
+        /**
+         *  Gets how far in front of the hull's faces a point is, which is negative inside the hull.
+         *  Inside it's the exact distance to the surface; outside, near edges and corners, it can be less, never more.
+         *  @param point - The point, in the space of the cloud.
+         */
+        float Distance(glm::vec3 point) const;
+
+        /** Gets whether a point is inside the hull or on it. */
+        bool Contains(glm::vec3 point) const { return !planes.empty() && Distance(point) <= 0.0f; };
+
+        /**
+         *  Sets the job system used to sort the points out in parallel.
+         *  @param jobs - The job system to use, or NULL to run on the calling thread.
+         */
+        void SetJobSystem(JobSystem* jobs) { this->jobs = jobs; };
+
+        static const int DIRECTIONS = 13;    // Directions extreme points are found along, both ways.
+        static const int BLOCK      = 65536; // Points per job when sorting them out.
+
+    private:
+        /** A triangle of the hull as it's grown. */
+        struct Face
+        {
+            int    v[3];             // Corners, counter-clockwise seen from outside.
+            int    next[3];          // Face across the edge from v[i] to v[(i + 1) % 3].
+            double normal[3];        // Unit normal, pointing out.
+            double offset;           // Normal dotted with any point on the face.
+            int    first;            // First point in front of the face that it's responsible for, or -1.
+            int    furthest;         // The one furthest in front, or -1.
+            double reach;            // How far in front of the face that one is.
+            bool   alive;            // False once the face has been torn out.
+            int    mark;             // The last pass that found the face could see the point being added.
+        };
+
+        /** A face being walked around while looking for the faces a point can see. */
+        struct Visit
+        {
+            int face;  // The face being walked around.
+            int first; // The edge the walk around it started at.
+            int done;  // How many of its edges have been looked across.
+        };
+
+        /** An edge of the hole a point tears in the hull, in order around the hole. */
+        struct Rim
+        {
+            int a, b;    // Corners of the edge, in the torn out face's order.
+            int outside; // The face left on the other side of the edge.
+        };
+
+        /** Makes a face through three points, in a spare slot if there is one; its neighbours are left for the caller. */
+        int MakeFace(int a, int b, int c);
+
+        /** Gets how far in front of a face a point is. */
+        double Height(const Face& face, int point) const
+        {
+            return face.normal[0] * x[point] + face.normal[1] * y[point] + face.normal[2] * z[point] - face.offset;
+        };
+
+        /** Gives a point to whichever of some faces it's furthest in front of, if it's in front of any. */
+        void Assign(int point, const std::vector<int>& among);
+
+        /** Adds a point to a face's list, queueing the face if it was empty. */
+        void Give(int face, int point, double reach);
+
+        /** Gives every point to a face of the current hull in parallel, dropping the ones inside it. */
+        void AssignAll();
+
+        /** Adds points to the hull until no face has any in front of it. */
+        void Expand();
+
+        /** Adds the point furthest in front of a face to the hull. */
+        void AddPoint(int face);
+
+        /** Gathers the finished faces into the mesh and the planes. */
+        void Finish();
+
+        const float* x;    // X coordinates of the points being hulled.
+        const float* y;    // Y coordinates.
+        const float* z;    // Z coordinates.
+        int    count;      // Number of points.
+        double tolerance;  // Distance from a face within which a point counts as on it.
+        int    pass;       // Counts AddPoint calls, for the face marks.
+        int    candidates; // Points left after the parallel pass.
+
+        std::vector<Face>         faces;    // Every face slot, torn out or not.
+        std::vector<int>          spare;    // Slots of torn out faces, for new faces to reuse.
+        std::vector<int>          pending;  // Faces that got points in front of them, maybe since torn out.
+        std::vector<int>          links;    // Next point in the same face's list, per point.
+        std::vector<Visit>        stack;    // Faces being walked around by AddPoint.
+        std::vector<int>          visible;  // Faces the point being added can see.
+        std::vector<Rim>          horizon;  // Edges of the hole the point being added tears.
+        std::vector<int>          orphans;  // Points of the torn out faces, looking for new ones.
+        std::vector<int>          made;     // Faces closing the hole.
+        std::vector<glm::vec3>    vertices; // Corners of the finished hull.
+        std::vector<unsigned int> indices;  // Triangles of the finished hull.
+        std::vector<glm::vec4>    planes;   // Outward normal and offset of every finished triangle.
+        JobSystem* jobs;                    // Job system used for sorting points out, may be NULL.
+};
+
+#endif
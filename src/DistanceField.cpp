@@ -0,0 +1,345 @@
+#include "DistanceField.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <utility>
+
+/** Orders positions lexicographically so equal corners can be welded with a map. */
+struct PositionLess
+{
+    bool operator()(const glm::vec3& a, const glm::vec3& b) const
+    {
+        if ( a.x != b.x ) return a.x < b.x;
+        if ( a.y != b.y ) return a.y < b.y;
+        return a.z < b.z;
+    };
+};
+
+DistanceField::DistanceField()
+{
+    voxelSize   = 1.0f;
+    band        = 0.0f;
+    bounds      = { glm::vec3(0.0f), glm::vec3(0.0f) };
+    brickCounts = glm::ivec3(0);
+    jobs        = NULL;
+}
+
+void DistanceField::Build(const std::vector<glm::vec3>& vertices, const std::vector<unsigned int>& indices, float voxelSize, float band)
+{
+    this->voxelSize = voxelSize;
+    this->band      = band;
+
+    // Weld corners that share a position, so neighbouring triangles agree on their edges
+    std::map<glm::vec3, int, PositionLess> welded;
+    std::vector<int> remap(vertices.size());
+    corners.clear();
+    for (size_t i = 0; i < vertices.size(); i++)
+    {
+        std::map<glm::vec3, int, PositionLess>::iterator found = welded.find(vertices[i]);
+        if ( found == welded.end() )
+        {
+            found = welded.insert({ vertices[i], static_cast<int>(corners.size()) }).first;
+            corners.push_back(vertices[i]);
+        }
+        remap[i] = found->second;
+    }
+
+    // Face normals, plus the angle weighted corner normals and summed edge normals they make up
+    triangles.clear();
+    cornerNormals.assign(corners.size(), glm::vec3(0.0f));
+    std::map<std::pair<int, int>, glm::vec3> edgeSums;
+    for (size_t i = 0; i + 2 < indices.size(); i += 3)
+    {
+        Triangle triangle;
+        for (int k = 0; k < 3; k++)
+            triangle.corners[k] = remap[indices[i + k]];
+
+        glm::vec3 a = corners[triangle.corners[0]];
+        glm::vec3 b = corners[triangle.corners[1]];
+        glm::vec3 c = corners[triangle.corners[2]];
+        glm::vec3 normal = glm::cross(b - a, c - a);
+        float length = glm::length(normal);
+        if ( length <= 0.0f )
+            continue;
+        triangle.faceNormal = normal / length;
+
+        for (int k = 0; k < 3; k++)
+        {
+            glm::vec3 corner = corners[triangle.corners[k]];
+            glm::vec3 next   = glm::normalize(corners[triangle.corners[(k + 1) % 3]] - corner);
+            glm::vec3 prev   = glm::normalize(corners[triangle.corners[(k + 2) % 3]] - corner);
+            float angle = std::acos(glm::clamp(glm::dot(next, prev), -1.0f, 1.0f));
+            cornerNormals[triangle.corners[k]] += angle * triangle.faceNormal;
+
+            int from = triangle.corners[k];
+            int to   = triangle.corners[(k + 1) % 3];
+            edgeSums[{ std::min(from, to), std::max(from, to) }] += triangle.faceNormal;
+        }
+        triangles.push_back(triangle);
+    }
+    for (Triangle& triangle : triangles)
+    {
+        for (int k = 0; k < 3; k++)
+        {
+            int from = triangle.corners[k];
+            int to   = triangle.corners[(k + 1) % 3];
+            triangle.edgeNormals[k] = edgeSums[{ std::min(from, to), std::max(from, to) }];
+        }
+    }
+
+    // The slot table covers the mesh and its band, rounded up to whole bricks
+    float brickSize = voxelSize * BRICK;
+    if ( corners.empty() )
+    {
+        bounds = { glm::vec3(0.0f), glm::vec3(0.0f) };
+    }
+    else
+    {
+        bounds = { corners[0], corners[0] };
+        for (const glm::vec3& corner : corners)
+        {
+            bounds.min = glm::min(bounds.min, corner);
+            bounds.max = glm::max(bounds.max, corner);
+        }
+    }
+    bounds.min -= glm::vec3(band);
+    brickCounts = glm::max(glm::ivec3(glm::ceil((bounds.max + glm::vec3(band) - bounds.min) / brickSize)), glm::ivec3(1));
+    bounds.max  = bounds.min + glm::vec3(brickCounts) * brickSize;
+
+    // Any sample of a brick in the band is within band plus the brick's diagonal of its closest triangle, so that
+    // wider margin catches every triangle that could be closest, and the signs come out right even past the band
+    float margin = band + brickSize * std::sqrt(3.0f);
+    std::vector<std::pair<int, int>> pairs;
+    std::vector<bool> reached(brickCounts.x * brickCounts.y * brickCounts.z, false);
+    for (int t = 0; t < static_cast<int>(triangles.size()); t++)
+    {
+        glm::vec3 a = corners[triangles[t].corners[0]];
+        glm::vec3 b = corners[triangles[t].corners[1]];
+        glm::vec3 c = corners[triangles[t].corners[2]];
+        glm::vec3 lo = glm::min(glm::min(a, b), c) - glm::vec3(margin);
+        glm::vec3 hi = glm::max(glm::max(a, b), c) + glm::vec3(margin);
+        glm::ivec3 first = glm::clamp(glm::ivec3(glm::floor((lo - bounds.min) / brickSize)), glm::ivec3(0), brickCounts - 1);
+        glm::ivec3 last  = glm::clamp(glm::ivec3(glm::floor((hi - bounds.min) / brickSize)), glm::ivec3(0), brickCounts - 1);
+
+        for (int z = first.z; z <= last.z; z++)
+        {
+            for (int y = first.y; y <= last.y; y++)
+            {
+                for (int x = first.x; x <= last.x; x++)
+                {
+                    glm::vec3 low = bounds.min + glm::vec3(x, y, z) * brickSize;
+                    AABB box = { low - glm::vec3(margin), low + glm::vec3(brickSize + margin) };
+                    if ( !Overlaps(box, a, b, c) )
+                        continue;
+
+                    int slot = (z * brickCounts.y + y) * brickCounts.x + x;
+                    pairs.push_back({ slot, t });
+
+                    box = { low - glm::vec3(band), low + glm::vec3(brickSize + band) };
+                    if ( !reached[slot] && Overlaps(box, a, b, c) )
+                        reached[slot] = true;
+                }
+            }
+        }
+    }
+    std::sort(pairs.begin(), pairs.end());
+
+    // Give every slot the band reaches a brick, along with its run of candidate triangles
+    slots.assign(reached.size(), static_cast<int>(EMPTY_OUTSIDE));
+    std::vector<int> brickSlots;
+    std::vector<int> candidateStart;
+    std::vector<int> candidates;
+    for (size_t i = 0; i < pairs.size(); i++)
+    {
+        int slot = pairs[i].first;
+        if ( !reached[slot] )
+            continue;
+        if ( i == 0 || pairs[i - 1].first != slot )
+        {
+            slots[slot] = static_cast<int>(brickSlots.size());
+            brickSlots.push_back(slot);
+            candidateStart.push_back(static_cast<int>(candidates.size()));
+        }
+        candidates.push_back(pairs[i].second);
+    }
+    candidateStart.push_back(static_cast<int>(candidates.size()));
+
+    // Bake the bricks; each one only reads the mesh and writes its own samples
+    int brickCount = static_cast<int>(brickSlots.size());
+    samples.resize(static_cast<size_t>(brickCount) * BRICK_SAMPLES);
+    auto bake = [&](int begin, int end)
+    {
+        for (int brick = begin; brick < end; brick++)
+        {
+            int slot = brickSlots[brick];
+            glm::ivec3 cell(slot % brickCounts.x, (slot / brickCounts.x) % brickCounts.y, slot / (brickCounts.x * brickCounts.y));
+            glm::vec3 low = bounds.min + glm::vec3(cell) * brickSize;
+            const int* list = candidates.data() + candidateStart[brick];
+            int count = candidateStart[brick + 1] - candidateStart[brick];
+
+            float* out = samples.data() + static_cast<size_t>(brick) * BRICK_SAMPLES;
+            for (int z = 0; z < SAMPLES; z++)
+                for (int y = 0; y < SAMPLES; y++)
+                    for (int x = 0; x < SAMPLES; x++)
+                        *out++ = SignedDistance(low + glm::vec3(x, y, z) * voxelSize, list, count);
+        }
+    };
+    if ( jobs != NULL )
+        jobs->ParallelFor(0, brickCount, BRICK_GRAIN, bake);
+    else
+        bake(0, brickCount);
+
+    // An empty slot has no surface in it, so it lies on the same side as the face it shares with any baked
+    // neighbour; from those, the side spreads through the empty slots that touch each other
+    static const glm::ivec3 NEIGHBOURS[6] = { { -1, 0, 0 }, { 1, 0, 0 }, { 0, -1, 0 }, { 0, 1, 0 }, { 0, 0, -1 }, { 0, 0, 1 } };
+    std::vector<int> frontier;
+    for (int slot = 0; slot < static_cast<int>(slots.size()); slot++)
+    {
+        if ( slots[slot] >= 0 )
+            continue;
+        glm::ivec3 cell(slot % brickCounts.x, (slot / brickCounts.x) % brickCounts.y, slot / (brickCounts.x * brickCounts.y));
+        for (int n = 0; n < 6; n++)
+        {
+            glm::ivec3 next = cell + NEIGHBOURS[n];
+            if ( glm::any(glm::lessThan(next, glm::ivec3(0))) || glm::any(glm::greaterThanEqual(next, brickCounts)) )
+                continue;
+            int brick = slots[(next.z * brickCounts.y + next.y) * brickCounts.x + next.x];
+            if ( brick < 0 )
+                continue;
+
+            // The middle sample of the shared face, on the neighbour's near side
+            glm::ivec3 sample(BRICK / 2);
+            for (int axis = 0; axis < 3; axis++)
+                if ( NEIGHBOURS[n][axis] != 0 )
+                    sample[axis] = NEIGHBOURS[n][axis] > 0 ? 0 : BRICK;
+            float value = samples[static_cast<size_t>(brick) * BRICK_SAMPLES + (sample.z * SAMPLES + sample.y) * SAMPLES + sample.x];
+            if ( value < 0.0f )
+            {
+                slots[slot] = EMPTY_INSIDE;
+                frontier.push_back(slot);
+            }
+            break;
+        }
+    }
+    while ( !frontier.empty() )
+    {
+        int slot = frontier.back();
+        frontier.pop_back();
+        glm::ivec3 cell(slot % brickCounts.x, (slot / brickCounts.x) % brickCounts.y, slot / (brickCounts.x * brickCounts.y));
+        for (int n = 0; n < 6; n++)
+        {
+            glm::ivec3 next = cell + NEIGHBOURS[n];
+            if ( glm::any(glm::lessThan(next, glm::ivec3(0))) || glm::any(glm::greaterThanEqual(next, brickCounts)) )
+                continue;
+            int index = (next.z * brickCounts.y + next.y) * brickCounts.x + next.x;
+            if ( slots[index] == EMPTY_OUTSIDE )
+            {
+                slots[index] = EMPTY_INSIDE;
+                frontier.push_back(index);
+            }
+        }
+    }
+}
+
+float DistanceField::SignedDistance(glm::vec3 point, const int* candidates, int count) const
+{
+    float     best    = INFINITY;
+    glm::vec3 offset  = glm::vec3(0.0f);
+    glm::vec3 normal  = glm::vec3(0.0f);
+    for (int i = 0; i < count; i++)
+    {
+        const Triangle& triangle = triangles[candidates[i]];
+        TriangleFeature feature;
+        glm::vec3 closest = ClosestOnTriangle(point, corners[triangle.corners[0]], corners[triangle.corners[1]],
+                                              corners[triangle.corners[2]], &feature);
+        glm::vec3 d = point - closest;
+        float squared = glm::dot(d, d);
+        if ( squared >= best )
+            continue;
+
+        best   = squared;
+        offset = d;
+        switch ( feature )
+        {
+            case FEATURE_A:  normal = cornerNormals[triangle.corners[0]]; break;
+            case FEATURE_B:  normal = cornerNormals[triangle.corners[1]]; break;
+            case FEATURE_C:  normal = cornerNormals[triangle.corners[2]]; break;
+            case FEATURE_AB: normal = triangle.edgeNormals[0];            break;
+            case FEATURE_BC: normal = triangle.edgeNormals[1];            break;
+            case FEATURE_CA: normal = triangle.edgeNormals[2];            break;
+            default:         normal = triangle.faceNormal;                break;
+        }
+    }
+
+    if ( count == 0 )
+        return band;
+    float distance = std::min(std::sqrt(best), band);
+    return glm::dot(offset, normal) < 0.0f ? -distance : distance;
+}
+
+void DistanceField::Query(const glm::vec3* points, float* distances, glm::vec3* gradients, int count) const
+{
+    float inverseVoxel = 1.0f / voxelSize;
+    glm::vec3 cells    = glm::vec3(brickCounts * BRICK);
+    for (int i = 0; i < count; i++)
+    {
+        glm::vec3 local = (points[i] - bounds.min) * inverseVoxel;
+        if ( glm::any(glm::lessThan(local, glm::vec3(0.0f))) || glm::any(glm::greaterThanEqual(local, cells)) )
+        {
+            distances[i] = band;
+            if ( gradients != NULL )
+                gradients[i] = glm::vec3(0.0f);
+            continue;
+        }
+
+        glm::ivec3 voxel = glm::ivec3(local);
+        glm::ivec3 cell  = voxel / BRICK;
+        int brick = slots[(cell.z * brickCounts.y + cell.y) * brickCounts.x + cell.x];
+        if ( brick < 0 )
+        {
+            distances[i] = brick == EMPTY_INSIDE ? -band : band;
+            if ( gradients != NULL )
+                gradients[i] = glm::vec3(0.0f);
+            continue;
+        }
+
+        // Trilinear interpolation inside the brick, along with its exact derivative
+        glm::ivec3 inner = voxel - cell * BRICK;
+        glm::vec3  f     = local - glm::vec3(voxel);
+        const float* s = samples.data() + static_cast<size_t>(brick) * BRICK_SAMPLES
+                       + (inner.z * SAMPLES + inner.y) * SAMPLES + inner.x;
+        float c000 = s[0];
+        float c100 = s[1];
+        float c010 = s[SAMPLES];
+        float c110 = s[SAMPLES + 1];
+        float c001 = s[SAMPLES * SAMPLES];
+        float c101 = s[SAMPLES * SAMPLES + 1];
+        float c011 = s[SAMPLES * SAMPLES + SAMPLES];
+        float c111 = s[SAMPLES * SAMPLES + SAMPLES + 1];
+
+        float x00 = c000 + (c100 - c000) * f.x;
+        float x10 = c010 + (c110 - c010) * f.x;
+        float x01 = c001 + (c101 - c001) * f.x;
+        float x11 = c011 + (c111 - c011) * f.x;
+        float y0  = x00 + (x10 - x00) * f.y;
+        float y1  = x01 + (x11 - x01) * f.y;
+        distances[i] = y0 + (y1 - y0) * f.z;
+
+        if ( gradients != NULL )
+        {
+            float dx0 = (c100 - c000) + ((c110 - c010) - (c100 - c000)) * f.y;
+            float dx1 = (c101 - c001) + ((c111 - c011) - (c101 - c001)) * f.y;
+            float dy0 = x10 - x00;
+            float dy1 = x11 - x01;
+            gradients[i] = glm::vec3(dx0 + (dx1 - dx0) * f.z, dy0 + (dy1 - dy0) * f.z, y1 - y0) * inverseVoxel;
+        }
+    }
+}
+
+float DistanceField::Distance(glm::vec3 point) const
+{
+    float distance;
+    Query(&point, &distance, NULL, 1);
+    return distance;
+}
@@ -0,0 +1,102 @@
+#ifndef DISTANCEFIELD
+#define DISTANCEFIELD
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "Geometry.hpp"
+#include "JobSystem.hpp"
+
+/**
+ *  A signed distance field baked from a static triangle mesh, negative inside and positive outside.
+ *  Only a narrow band around the surface is stored: space is cut into bricks of BRICK^3 voxels, and only the bricks
+ *  the band reaches are kept, each with its own (BRICK + 1)^3 samples so it can be interpolated on its own. A dense
+ *  table of brick slots finds the brick of any point, which makes every query a constant amount of work.
+ *  Signs come from the angle weighted pseudonormal of the closest corner, edge or face, so the mesh should be closed
+ *  and consistently wound. Empty slots remember which side of the surface they are on, so deep inside reads as -band.
+ *  Bricks are baked in parallel.
+ */
+class DistanceField
+{
+    public:
+        DistanceField();
+
+        /** Copying the bricks would duplicate a lot of memory, so it's deleted. */
+        DistanceField(const DistanceField&) = delete;
+        DistanceField& operator=(const DistanceField&) = delete;
+
+        ~DistanceField() { };
+
+        /**
+         *  Bakes the field of a mesh. Corners that share a position are welded first, so unindexed meshes work too.
+         *  @param vertices  - The corners of the mesh.
+         *  @param indices   - Three corners per triangle, wound counter-clockwise seen from outside.
+         *  @param voxelSize - The spacing of the samples.
+         *  @param band      - How far from the surface distances are stored; anything further reads as band.
+         */
+        void Build(const std::vector<glm::vec3>& vertices, const std::vector<unsigned int>& indices, float voxelSize, float band);
+
+        /**
+         *  Gets the distance to the surface and its gradient at many points at once.
+         *  Points outside the stored band get the band distance and a zero gradient.
+         *  @param points    - The points to query, in the mesh's space.
+         *  @param distances - Receives the signed distance at each point.
+         *  @param gradients - Receives the gradient at each point, which points away from the surface; may be NULL.
+         *  @param count     - The number of points.
+         */
+        void Query(const glm::vec3* points, float* distances, glm::vec3* gradients, int count) const;
+
+        /** Gets the signed distance at a single point. */
+        float Distance(glm::vec3 point) const;
+
+        /** Gets the box around the mesh and its band; every point outside it is at least band away. */
+        const AABB& GetBounds() const { return bounds; };
+
+        /** Gets the distance past which the field isn't stored. */
+        float GetBand() const { return band; };
+
+        /** Gets the number of bricks that were baked. */
+        int GetBrickCount() const { return static_cast<int>(samples.size() / BRICK_SAMPLES); };
+
+        /**
+         *  Sets the job system used to bake the bricks in parallel.
+         *  @param jobs - The job system to use, or NULL to run on the calling thread.
+         */
+        void SetJobSystem(JobSystem* jobs) { this->jobs = jobs; };
+
+        static const int BRICK = 8; // Voxels along each side of a brick.
+
+    private:
+        /** A welded triangle along with the pseudonormals of its corners and edges. */
+        struct Triangle
+        {
+            int       corners[3];     // Welded corner indices.
+            glm::vec3 faceNormal;     // Unit normal of the face.
+            glm::vec3 edgeNormals[3]; // Pseudonormals of edges AB, BC and CA.
+        };
+
+        /** Works out the signed distance from a point to the closest of a set of triangles, clamped to the band. */
+        float SignedDistance(glm::vec3 point, const int* candidates, int count) const;
+
+        static const int SAMPLES       = BRICK + 1;                   // Samples along each side of a brick.
+        static const int BRICK_SAMPLES = SAMPLES * SAMPLES * SAMPLES; // Samples in a brick.
+        static const int BRICK_GRAIN   = 4;                           // Bricks baked per job.
+        static const int EMPTY_OUTSIDE = -1;                          // Slot further than band outside the mesh.
+        static const int EMPTY_INSIDE  = -2;                          // Slot further than band inside the mesh.
+
+        float     voxelSize;     // Spacing of the samples.
+        float     band;          // Distance past which the field isn't stored.
+        AABB      bounds;        // Box around the mesh and its band.
+        glm::ivec3 brickCounts;  // Brick slots along each axis.
+
+        std::vector<int>   slots;   // Brick of every slot, or EMPTY_OUTSIDE or EMPTY_INSIDE where the band doesn't reach.
+        std::vector<float> samples; // Samples of every brick, one block of BRICK_SAMPLES each.
+
+        std::vector<glm::vec3> corners;       // Welded corners.
+        std::vector<glm::vec3> cornerNormals; // Angle weighted pseudonormals of the corners.
+        std::vector<Triangle>  triangles;     // Welded triangles.
+        JobSystem* jobs;                      // Job system used for baking, may be NULL.
+};
+
+#endif
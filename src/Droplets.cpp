@@ -0,0 +1,115 @@
+#include "Droplets.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include <glm/gtc/constants.hpp>
+
+int Droplets::BurstSize(float radius)
+{
+    float area = 4.0f * glm::pi<float>() * radius * radius;
+    return std::min(MAX_BURST, std::max(1, static_cast<int>(area * DENSITY)));
+}
+
+uint32_t Droplets::Hash(uint32_t value)
+{
+    // PCG's output permutation, which mixes well for consecutive inputs
+    uint32_t state = value * 747796405u + 2891336453u;
+    uint32_t word  = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+    return (word >> 22u) ^ word;
+}
+
+Droplet Droplets::Spawn(glm::vec3 position, glm::vec3 velocity, float radius, uint32_t seed, uint32_t index)
+{
+    // Five uniform numbers in [0, 1), each one hashed from the last
+    float random[5];
+    uint32_t state = seed ^ (index * 0x9E3779B9u);
+    for (float& r : random)
+    {
+        state = Hash(state);
+        r     = static_cast<float>(state >> 8) * (1.0f / 16777216.0f);
+    }
+
+    // A uniformly random direction, leaving from that point of the film
+    float z     = 1.0f - 2.0f * random[0];
+    float phi   = 2.0f * glm::pi<float>() * random[1];
+    float rim   = std::sqrt(std::max(0.0f, 1.0f - z * z));
+    glm::vec3 direction(rim * std::cos(phi), rim * std::sin(phi), z);
+
+    Droplet droplet;
+    droplet.position = position + direction * radius;
+    droplet.velocity = velocity + direction * (SPEED * (0.5f + random[2]));
+    droplet.life     = LIFETIME * (0.5f + random[3]);
+    droplet.size     = SIZE * (0.5f + random[4]);
+    return droplet;
+}
+
+CpuDroplets::CpuDroplets(int capacity)
+{
+    this->capacity = capacity;
+    bursts = 0;
+    jobs   = NULL;
+    droplets.reserve(capacity);
+}
+
+void CpuDroplets::Burst(glm::vec3 position, glm::vec3 velocity, float radius)
+{
+    pending.push_back({ position, velocity, radius, Hash(bursts++), BurstSize(radius) });
+}
+
+void CpuDroplets::Step(float dt)
+{
+    // New droplets go on the end, as many as there's room for
+    for (const Pending& burst : pending)
+    {
+        int count = std::min(burst.count, capacity - static_cast<int>(droplets.size()));
+        for (int i = 0; i < count; i++)
+            droplets.push_back(Spawn(burst.position, burst.velocity, burst.radius, burst.seed, i));
+    }
+    pending.clear();
+
+    // Every block moves its droplets and packs the survivors at its front
+    int count  = static_cast<int>(droplets.size());
+    int blocks = (count + BLOCK - 1) / BLOCK;
+    kept.assign(blocks, 0);
+
+    float     damping = std::exp(-DRAG * dt);
+    glm::vec3 gravity(0.0f, GRAVITY * dt, 0.0f);
+    auto step = [&](int begin, int end)
+    {
+        for (int block = begin; block < end; block++)
+        {
+            Droplet* first = droplets.data() + block * BLOCK;
+            int      size  = std::min(BLOCK, count - block * BLOCK);
+            int      write = 0;
+            for (int i = 0; i < size; i++)
+            {
+                Droplet droplet = first[i];
+                droplet.life -= dt;
+                if ( droplet.life <= 0.0f )
+                    continue;
+
+                droplet.velocity  = (droplet.velocity + gravity) * damping;
+                droplet.position += droplet.velocity * dt;
+                first[write++]    = droplet;
+            }
+            kept[block] = write;
+        }
+    };
+
+    if ( jobs != NULL )
+        jobs->ParallelFor(0, blocks, 1, step);
+    else
+        step(0, blocks);
+
+    // Close the gaps between the blocks
+    int write = kept.empty() ? 0 : kept[0];
+    for (int block = 1; block < blocks; block++)
+    {
+        if ( write != block * BLOCK )
+            std::memmove(&droplets[write], &droplets[block * BLOCK], kept[block] * sizeof(Droplet));
+        write += kept[block];
+    }
+    droplets.resize(write);
+}
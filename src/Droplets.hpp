@@ -0,0 +1,127 @@
+#ifndef DROPLETS
+#define DROPLETS
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "JobSystem.hpp"
+
+/** A single drop of soap water, laid out the same way as the GPU buffer. */
+struct Droplet
+{
+    glm::vec3 position; // World space position.
+    float     life;     // Seconds left before the droplet disappears.
+    glm::vec3 velocity; // World space velocity.
+    float     size;     // Radius of the drawn droplet.
+};
+
+/**
+ *  The spray of droplets a bubble bursts into when it pops.
+ *  Every pop becomes a burst of droplets scattered over the bubble's surface, flying outward on top of the bubble's
+ *  own velocity; they fall, slow down in the air and fade out after their lifetime. How many droplets a burst has
+ *  grows with the area of the film.
+ *  There are two implementations with the same interface: GpuDroplets keeps everything on the GPU, and
+ *  CpuDroplets runs the same spray on the CPU for headless runs.
+ */
+class Droplets
+{
+    public:
+        virtual ~Droplets() { };
+
+        /**
+         *  Queues the burst of a popped bubble; the droplets appear on the next Step.
+         *  Droplets that don't fit into the capacity are dropped.
+         *  @param position - The center of the bubble.
+         *  @param velocity - The velocity of the bubble.
+         *  @param radius   - The radius of the bubble.
+         */
+        virtual void Burst(glm::vec3 position, glm::vec3 velocity, float radius) = 0;
+
+        /**
+         *  Spawns the queued bursts and moves every droplet along.
+         *  @param dt - The time that has passed in seconds.
+         */
+        virtual void Step(float dt) = 0;
+
+        /** Gets the most droplets that can be alive at once. */
+        virtual int GetCapacity() const = 0;
+
+        /**
+         *  Works out how many droplets the burst of a bubble has.
+         *  @param radius - The radius of the bubble.
+         */
+        static int BurstSize(float radius);
+
+        /**
+         *  Creates one droplet of a burst. The GPU emitter does the same with the same random numbers.
+         *  @param position - The center of the bubble.
+         *  @param velocity - The velocity of the bubble.
+         *  @param radius   - The radius of the bubble.
+         *  @param seed     - The seed of the burst.
+         *  @param index    - The index of the droplet within the burst.
+         */
+        static Droplet Spawn(glm::vec3 position, glm::vec3 velocity, float radius, uint32_t seed, uint32_t index);
+
+        static constexpr float DENSITY  = 400.0f; // Droplets per unit of film area.
+        static constexpr float SPEED    = 2.0f;   // Average speed at which droplets leave the film.
+        static constexpr float DRAG     = 1.5f;   // Fraction of a droplet's velocity lost per second.
+        static constexpr float LIFETIME = 1.5f;   // Average seconds a droplet lives.
+        static constexpr float SIZE     = 0.015f; // Average droplet radius.
+        static constexpr float GRAVITY  = -9.8f;  // Acceleration along y.
+        static constexpr int   MAX_BURST = 4096;  // Most droplets in one burst.
+
+    protected:
+        /** A burst waiting for the next Step. */
+        struct Pending
+        {
+            glm::vec3 position; // Center of the bubble.
+            glm::vec3 velocity; // Velocity of the bubble.
+            float     radius;   // Radius of the bubble.
+            uint32_t  seed;     // Seed of the burst's random numbers.
+            int       count;    // Droplets in the burst.
+        };
+
+        /** Hashes an integer into a well mixed one; the GPU emitter uses the same hash. */
+        static uint32_t Hash(uint32_t value);
+};
+
+/**
+ *  Droplets simulated on the CPU, for running without a GL context. Live droplets are kept densely; every step
+ *  integrates and compacts fixed blocks of them in parallel, then closes the gaps between the blocks.
+ */
+class CpuDroplets : public Droplets
+{
+    public:
+        /**
+         *  Creates an empty spray.
+         *  @param capacity - The most droplets that can be alive at once.
+         */
+        CpuDroplets(int capacity);
+
+        void Burst(glm::vec3 position, glm::vec3 velocity, float radius) override;
+        void Step(float dt) override;
+        int GetCapacity() const override { return capacity; };
+
+        /** Gets the live droplets, in no particular order. */
+        const std::vector<Droplet>& GetDroplets() const { return droplets; };
+
+        /**
+         *  Sets the job system used to step the droplets in parallel.
+         *  @param jobs - The job system to use, or NULL to run on the calling thread.
+         */
+        void SetJobSystem(JobSystem* jobs) { this->jobs = jobs; };
+
+    private:
+        static constexpr int BLOCK = 16384; // Droplets integrated and compacted per job.
+
+        int capacity;                  // Most droplets alive at once.
+        uint32_t bursts;               // Bursts queued so far; seeds the next one.
+        std::vector<Pending> pending;  // Bursts waiting for the next Step.
+        std::vector<Droplet> droplets; // Live droplets.
+        std::vector<int>     kept;     // Droplets left in each block after a step.
+        JobSystem* jobs;               // Job system used for stepping, may be NULL.
+};
+
+#endif
@@ -0,0 +1,112 @@
+#ifndef FOAM
+#define FOAM
+
+#include <algorithm>
+#include <cmath>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/constants.hpp>
+
+/**
+ *  The soap film shared by two touching bubbles.
+ *  The film is a spherical cap spanning the circle where the two bubble surfaces meet. By the Young-Laplace law
+ *  its curvature is the difference of the bubbles' curvatures, so it bulges into the bigger (lower pressure) one.
+ */
+struct Film
+{
+    int       a;         // The first bubble.
+    int       b;         // The second bubble.
+    glm::vec3 center;    // Center of the rim circle.
+    glm::vec3 normal;    // Unit normal of the rim circle, pointing from a to b.
+    float     rimRadius; // Radius of the rim circle.
+    float     curvature; // 1/ra - 1/rb; positive when the film bulges toward b, zero when it's flat.
+};
+
+/**
+ *  Gets the center distance at which two bubbles meet at Plateau's 120 degrees.
+ *  The outer films and the shared film meet at equal angles when the two spheres cross at 60 degrees.
+ *  @param ra - The radius of the first bubble.
+ *  @param rb - The radius of the second bubble.
+ */
+inline float PlateauDistance(float ra, float rb)
+{
+    return std::sqrt(ra * ra + rb * rb - ra * rb);
+};
+
+/** Gets the volume of a sphere. */
+inline float SphereVolume(float radius)
+{
+    return 4.0f / 3.0f * glm::pi<float>() * radius * radius * radius;
+};
+
+/**
+ *  Gets the volume of a spherical cap.
+ *  @param radius - The radius of the sphere the cap is cut from.
+ *  @param height - The height of the cap, from 0 to twice the radius.
+ */
+inline float CapVolume(float radius, float height)
+{
+    return glm::pi<float>() * height * height * (3.0f * radius - height) / 3.0f;
+};
+
+/**
+ *  Works out the shared film of two bubbles.
+ *  @param film - Receives the film; a and b are left alone.
+ *  @return False if the bubbles don't cross, or one swallows the other.
+ */
+inline bool MakeFilm(glm::vec3 pa, float ra, glm::vec3 pb, float rb, Film* film)
+{
+    glm::vec3 delta = pb - pa;
+    float d = glm::length(delta);
+    if ( d >= ra + rb || d <= std::abs(ra - rb) )
+        return false;
+
+    // The rim lies in the radical plane of the two spheres
+    float x = (d * d + ra * ra - rb * rb) / (2.0f * d);
+
+    film->normal    = delta / d;
+    film->center    = pa + film->normal * x;
+    film->rimRadius = std::sqrt(std::max(ra * ra - x * x, 0.0f));
+    film->curvature = 1.0f / ra - 1.0f / rb;
+    return true;
+};
+
+/**
+ *  Gets how much gas two crossing bubbles lose to (or win from) each other's side of their shared film.
+ *  @param da - Receives the (usually negative) change to the volume of the first bubble.
+ *  @param db - Receives the (usually negative) change to the volume of the second bubble.
+ */
+inline void FilmVolumes(glm::vec3 pa, float ra, glm::vec3 pb, float rb, float* da, float* db)
+{
+    Film film;
+    *da = 0.0f;
+    *db = 0.0f;
+    if ( !MakeFilm(pa, ra, pb, rb, &film) )
+        return;
+
+    // Each sphere first loses the cap beyond the rim plane
+    float x = glm::dot(film.center - pa, film.normal);
+    float d = glm::length(pb - pa);
+    *da -= CapVolume(ra, ra - x);
+    *db -= CapVolume(rb, rb - (d - x));
+
+    // The curved film then moves the lens between the rim plane and itself from the bigger bubble to the smaller
+    if ( film.curvature == 0.0f )
+        return;
+
+    float filmRadius = 1.0f / std::abs(film.curvature);
+    float rim        = std::min(film.rimRadius, filmRadius);
+    float lens       = CapVolume(filmRadius, filmRadius - std::sqrt(filmRadius * filmRadius - rim * rim));
+    if ( film.curvature > 0.0f )
+    {
+        *da += lens;
+        *db -= lens;
+    }
+    else
+    {
+        *da -= lens;
+        *db += lens;
+    }
+};
+
+#endif
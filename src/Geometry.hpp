@@ -0,0 +1,325 @@
+#ifndef GEOMETRY
+#define GEOMETRY
+
+#include <algorithm>
+#include <cmath>
+
+#include <glm/glm.hpp>
+
+/** An axis-aligned bounding box described by its minimum and maximum corners. */
+struct AABB
+{
+    glm::vec3 min;
+    glm::vec3 max;
+};
+
+/** A half-line in world space; direction is expected to be normalized. */
+struct Ray
+{
+    glm::vec3 origin;
+    glm::vec3 direction;
+};
+
+/**
+ *  Creates the bounding box of a sphere.
+ *  @param center - The center of the sphere.
+ *  @param radius - The radius of the sphere.
+ *  @return The smallest box containing the sphere.
+ */
+inline AABB SphereBox(glm::vec3 center, float radius)
+{
+    return { center - glm::vec3(radius), center + glm::vec3(radius) };
+};
+
+/**
+ *  Returns the smallest box that contains both boxes.
+ *  @param a - The first box.
+ *  @param b - The second box.
+ */
+inline AABB Union(const AABB& a, const AABB& b)
+{
+    return { glm::min(a.min, b.min), glm::max(a.max, b.max) };
+};
+
+/**
+ *  Calculates the surface area of a box, used as the cost metric for tree construction.
+ *  @param box - The box to measure.
+ */
+inline float SurfaceArea(const AABB& box)
+{
+    glm::vec3 d = box.max - box.min;
+    return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+};
+
+/** Checks whether box a fully contains box b. */
+inline bool Contains(const AABB& a, const AABB& b)
+{
+    return a.min.x <= b.min.x && a.min.y <= b.min.y && a.min.z <= b.min.z
+        && a.max.x >= b.max.x && a.max.y >= b.max.y && a.max.z >= b.max.z;
+};
+
+/** Checks whether two boxes overlap. */
+inline bool Overlaps(const AABB& a, const AABB& b)
+{
+    return a.min.x <= b.max.x && a.max.x >= b.min.x
+        && a.min.y <= b.max.y && a.max.y >= b.min.y
+        && a.min.z <= b.max.z && a.max.z >= b.min.z;
+};
+
+/**
+ *  Checks whether a sphere touches a box.
+ *  @param box    - The box to test against.
+ *  @param center - The center of the sphere.
+ *  @param radius - The radius of the sphere.
+ */
+inline bool Overlaps(const AABB& box, glm::vec3 center, float radius)
+{
+    glm::vec3 closest = glm::clamp(center, box.min, box.max);
+    glm::vec3 d       = closest - center;
+    return glm::dot(d, d) <= radius * radius;
+};
+
+/**
+ *  Separating axis test between a box and a triangle.
+ *  @param box     - The box to test against.
+ *  @param a, b, c - The corners of the triangle.
+ */
+inline bool Overlaps(const AABB& box, glm::vec3 a, glm::vec3 b, glm::vec3 c)
+{
+    // Work relative to the box center so the box is symmetric around the origin
+    glm::vec3 center = (box.min + box.max) * 0.5f;
+    glm::vec3 extent = (box.max - box.min) * 0.5f;
+    glm::vec3 v[3]   = { a - center, b - center, c - center };
+
+    // The box's own axes
+    for (int axis = 0; axis < 3; axis++)
+    {
+        float lo = std::min(std::min(v[0][axis], v[1][axis]), v[2][axis]);
+        float hi = std::max(std::max(v[0][axis], v[1][axis]), v[2][axis]);
+        if ( lo > extent[axis] || hi < -extent[axis] )
+            return false;
+    }
+
+    // The triangle's plane
+    glm::vec3 edges[3] = { v[1] - v[0], v[2] - v[1], v[0] - v[2] };
+    glm::vec3 normal   = glm::cross(edges[0], edges[1]);
+    if ( std::abs(glm::dot(normal, v[0])) > glm::dot(extent, glm::abs(normal)) )
+        return false;
+
+    // Cross products of the box axes with the triangle edges
+    for (int e = 0; e < 3; e++)
+    {
+        for (int axis = 0; axis < 3; axis++)
+        {
+            glm::vec3 unit(0.0f);
+            unit[axis] = 1.0f;
+            glm::vec3 l = glm::cross(unit, edges[e]);
+
+            float p0 = glm::dot(v[0], l);
+            float p1 = glm::dot(v[1], l);
+            float p2 = glm::dot(v[2], l);
+            float r  = glm::dot(extent, glm::abs(l));
+            if ( std::min(std::min(p0, p1), p2) > r || std::max(std::max(p0, p1), p2) < -r )
+                return false;
+        }
+    }
+
+    return true;
+};
+
+/**
+ *  Slab test between a ray and a box.
+ *  @param box    - The box to test against.
+ *  @param origin - The origin of the ray.
+ *  @param invDir - The component-wise reciprocal of the ray direction.
+ *  @param maxT   - The furthest distance along the ray worth considering.
+ *  @return The entry distance along the ray, or -1 if the ray misses the box.
+ */
+inline float RayBox(const AABB& box, glm::vec3 origin, glm::vec3 invDir, float maxT)
+{
+    glm::vec3 t1 = (box.min - origin) * invDir;
+    glm::vec3 t2 = (box.max - origin) * invDir;
+    glm::vec3 lo = glm::min(t1, t2);
+    glm::vec3 hi = glm::max(t1, t2);
+
+    float enter = std::max(std::max(lo.x, lo.y), std::max(lo.z, 0.0f));
+    float exit  = std::min(std::min(hi.x, hi.y), std::min(hi.z, maxT));
+
+    return ( enter <= exit ) ? enter : -1.0f;
+};
+
+/**
+ *  Intersects a ray with a sphere.
+ *  @param ray    - The ray to cast; its direction must be normalized.
+ *  @param center - The center of the sphere.
+ *  @param radius - The radius of the sphere.
+ *  @return The distance to the first hit in front of the origin, or -1 if the ray misses.
+ */
+inline float RaySphere(const Ray& ray, glm::vec3 center, float radius)
+{
+    glm::vec3 m = ray.origin - center;
+    float b     = glm::dot(m, ray.direction);
+    float c     = glm::dot(m, m) - radius * radius;
+
+    // Origin outside of the sphere and pointing away from it
+    if ( c > 0.0f && b > 0.0f )
+        return -1.0f;
+
+    float disc = b * b - c;
+    if ( disc < 0.0f )
+        return -1.0f;
+
+    return std::max(-b - std::sqrt(disc), 0.0f);
+};
+
+/**
+ *  Sweeps a ray around a fixed origin, from one direction to another, and finds when it crosses a sphere.
+ *  The direction is blended linearly, dir(s) = from + s * (to - from), which is how a cursor moving in a straight
+ *  line across the screen turns a camera ray.
+ *  @param origin - The shared origin of the rays.
+ *  @param from   - The direction at s = 0, doesn't need to be normalized.
+ *  @param to     - The direction at s = 1, doesn't need to be normalized.
+ *  @param center - The center of the sphere.
+ *  @param radius - The radius of the sphere.
+ *  @param enter  - Receives the first s in [0, 1] at which the ray hits the sphere.
+ *  @param exit   - Receives the last s in [0, 1] at which the ray hits the sphere.
+ *  @return False if the ray never hits the sphere during the sweep.
+ */
+inline bool SweptRaySphere(glm::vec3 origin, glm::vec3 from, glm::vec3 to, glm::vec3 center, float radius,
+                           float* enter, float* exit)
+{
+    glm::vec3 w = center - origin;
+    glm::vec3 e = to - from;
+    float k     = glm::dot(w, w) - radius * radius;
+
+    // An origin inside the sphere hits it in every direction
+    if ( k <= 0.0f )
+    {
+        *enter = 0.0f;
+        *exit  = 1.0f;
+        return true;
+    }
+
+    // dir(s) hits the sphere when k |dir|^2 - (w . dir)^2 <= 0 and w . dir > 0, a quadratic in s
+    float p  = glm::dot(w, from);
+    float q  = glm::dot(w, e);
+    float qa = k * glm::dot(e, e) - q * q;
+    float qb = k * glm::dot(from, e) - p * q;
+    float qc = k * glm::dot(from, from) - p * p;
+
+    auto inside = [&](float s) { return (qa * s + 2.0f * qb) * s + qc <= 0.0f && p + q * s > 0.0f; };
+
+    // Split [0, 1] at the roots; the forward cone is convex, so the hits form a single run of pieces
+    float cuts[4] = { 0.0f, 1.0f, 1.0f, 1.0f };
+    int   count   = 1;
+    if ( std::abs(qa) > 1e-12f )
+    {
+        float disc = qb * qb - qa * qc;
+        if ( disc >= 0.0f )
+        {
+            float root = std::sqrt(disc);
+            float r0   = (-qb - root) / qa;
+            float r1   = (-qb + root) / qa;
+            if ( r0 > r1 )
+                std::swap(r0, r1);
+            if ( r0 > 0.0f && r0 < 1.0f ) cuts[count++] = r0;
+            if ( r1 > 0.0f && r1 < 1.0f ) cuts[count++] = r1;
+        }
+    }
+    else if ( std::abs(qb) > 1e-12f )
+    {
+        float r = -qc / (2.0f * qb);
+        if ( r > 0.0f && r < 1.0f ) cuts[count++] = r;
+    }
+    cuts[count++] = 1.0f;
+
+    bool hit = false;
+    for (int i = 0; i + 1 < count; i++)
+    {
+        float lo = cuts[i];
+        float hi = cuts[i + 1];
+        if ( !inside(( lo == hi ) ? lo : 0.5f * (lo + hi)) )
+            continue;
+
+        if ( !hit )
+            *enter = lo;
+        *exit = hi;
+        hit   = true;
+    }
+
+    return hit;
+};
+
+/** The part of a triangle a closest point lies on. */
+enum TriangleFeature
+{
+    FEATURE_A, FEATURE_B, FEATURE_C,       // One of the corners.
+    FEATURE_AB, FEATURE_BC, FEATURE_CA,    // The inside of one of the edges.
+    FEATURE_FACE                           // The inside of the triangle.
+};
+
+/**
+ *  Finds the point of a triangle closest to a point, by the Voronoi regions of its corners and edges.
+ *  @param p       - The point to search from.
+ *  @param a, b, c - The corners of the triangle.
+ *  @param feature - Receives the corner, edge or face the closest point lies on.
+ *  @return The closest point on the triangle.
+ */
+inline glm::vec3 ClosestOnTriangle(glm::vec3 p, glm::vec3 a, glm::vec3 b, glm::vec3 c, TriangleFeature* feature)
+{
+    glm::vec3 ab = b - a;
+    glm::vec3 ac = c - a;
+    glm::vec3 ap = p - a;
+    float d1 = glm::dot(ab, ap);
+    float d2 = glm::dot(ac, ap);
+    if ( d1 <= 0.0f && d2 <= 0.0f )
+    {
+        *feature = FEATURE_A;
+        return a;
+    }
+
+    glm::vec3 bp = p - b;
+    float d3 = glm::dot(ab, bp);
+    float d4 = glm::dot(ac, bp);
+    if ( d3 >= 0.0f && d4 <= d3 )
+    {
+        *feature = FEATURE_B;
+        return b;
+    }
+
+    float vc = d1 * d4 - d3 * d2;
+    if ( vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f )
+    {
+        *feature = FEATURE_AB;
+        return a + ab * (d1 / (d1 - d3));
+    }
+
+    glm::vec3 cp = p - c;
+    float d5 = glm::dot(ab, cp);
+    float d6 = glm::dot(ac, cp);
+    if ( d6 >= 0.0f && d5 <= d6 )
+    {
+        *feature = FEATURE_C;
+        return c;
+    }
+
+    float vb = d5 * d2 - d1 * d6;
+    if ( vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f )
+    {
+        *feature = FEATURE_CA;
+        return a + ac * (d2 / (d2 - d6));
+    }
+
+    float va = d3 * d6 - d5 * d4;
+    if ( va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f )
+    {
+        *feature = FEATURE_BC;
+        return b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+    }
+
+    float denominator = 1.0f / (va + vb + vc);
+    *feature = FEATURE_FACE;
+    return a + ab * (vb * denominator) + ac * (vc * denominator);
+};
+
+#endif
@@ -0,0 +1,164 @@
+#include "GpuDroplets.hpp"
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <numeric>
+
+#include <glm/gtc/type_ptr.hpp>
+
+GpuDroplets::GpuDroplets(int capacity)
+{
+    this->capacity = capacity;
+    current      = 0;
+    bursts       = 0;
+    pendingCount = 0;
+
+    emitShader  = new Shader("..\\shaders\\DropletEmitCS.GLSL");
+    stepShader  = new Shader("..\\shaders\\DropletStepCS.GLSL");
+    countShader = new Shader("..\\shaders\\DropletCountCS.GLSL");
+    drawShader  = new Shader("..\\shaders\\DropletVS.GLSL", "..\\shaders\\DropletPS.GLSL");
+
+    // The spray's constants are shared with the CPU version, so they're handed to the shaders instead of repeated
+    emitShader->use();
+    glUniform1f(glGetUniformLocation(emitShader->ID, "speed"),    SPEED);
+    glUniform1f(glGetUniformLocation(emitShader->ID, "lifetime"), LIFETIME);
+    glUniform1f(glGetUniformLocation(emitShader->ID, "size"),     SIZE);
+    drawShader->use();
+    glUniform1f(glGetUniformLocation(drawShader->ID, "lifetime"), LIFETIME);
+    glUniform3f(glGetUniformLocation(drawShader->ID, "dropletColor"), 0.8f, 0.9f, 1.0f);
+
+    // Every slot starts out free
+    std::vector<uint32_t> slots(capacity);
+    std::iota(slots.begin(), slots.end(), 0u);
+
+    State state = {};
+    state.dispatch[1] = 1;
+    state.dispatch[2] = 1;
+    state.draw[0]     = 4; // One quad per instance, as a triangle strip
+    state.dead        = capacity;
+
+    glGenBuffers(1, &dropletBuffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, dropletBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, static_cast<GLsizeiptr>(capacity) * sizeof(Droplet), NULL, GL_DYNAMIC_COPY);
+
+    glGenBuffers(1, &deadBuffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, deadBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, slots.size() * sizeof(uint32_t), slots.data(), GL_DYNAMIC_COPY);
+
+    glGenBuffers(2, aliveBuffers);
+    for (unsigned int buffer : aliveBuffers)
+    {
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, static_cast<GLsizeiptr>(capacity) * sizeof(uint32_t), NULL, GL_DYNAMIC_COPY);
+    }
+
+    glGenBuffers(1, &stateBuffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, stateBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(State), &state, GL_DYNAMIC_COPY);
+
+    glGenBuffers(1, &burstBuffer);
+    glGenVertexArrays(1, &VAO);
+}
+
+GpuDroplets::~GpuDroplets()
+{
+    glDeleteBuffers(1, &dropletBuffer);
+    glDeleteBuffers(1, &deadBuffer);
+    glDeleteBuffers(2, aliveBuffers);
+    glDeleteBuffers(1, &stateBuffer);
+    glDeleteBuffers(1, &burstBuffer);
+    glDeleteVertexArrays(1, &VAO);
+
+    for (Shader* shader : { emitShader, stepShader, countShader, drawShader })
+    {
+        glDeleteProgram(shader->ID);
+        delete shader;
+    }
+}
+
+void GpuDroplets::Burst(glm::vec3 position, glm::vec3 velocity, float radius)
+{
+    // Bursts past the capacity would all fail to find a slot anyway
+    uint32_t count = static_cast<uint32_t>(BurstSize(radius));
+    if ( pendingCount + count > static_cast<uint32_t>(capacity) )
+        return;
+
+    pending.push_back({ glm::vec4(position, radius), glm::vec4(velocity, 0.0f), pendingCount, count, Hash(bursts++), 0 });
+    pendingCount += count;
+}
+
+void GpuDroplets::Count(int stage)
+{
+    countShader->use();
+    glUniform1i(glGetUniformLocation(countShader->ID, "stage"),   stage);
+    glUniform1i(glGetUniformLocation(countShader->ID, "current"), current);
+    glDispatchCompute(1, 1, 1);
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT);
+}
+
+void GpuDroplets::Step(float dt)
+{
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, DROPLET_BUFFER, dropletBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, DEAD_LIST,      deadBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, ALIVE_IN,       aliveBuffers[current]);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, ALIVE_OUT,      aliveBuffers[1 - current]);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, STATE,          stateBuffer);
+
+    // New droplets take slots off the dead list and join the live ones, so they move on this step already
+    if ( !pending.empty() )
+    {
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, burstBuffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, pending.size() * sizeof(GpuBurst), pending.data(), GL_STREAM_DRAW);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, BURSTS, burstBuffer);
+
+        emitShader->use();
+        glUniform1ui(glGetUniformLocation(emitShader->ID, "total"),      pendingCount);
+        glUniform1i(glGetUniformLocation(emitShader->ID, "burstCount"), static_cast<int>(pending.size()));
+        glUniform1i(glGetUniformLocation(emitShader->ID, "current"),    current);
+        glDispatchCompute((pendingCount + GROUP - 1) / GROUP, 1, 1);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+        pending.clear();
+        pendingCount = 0;
+    }
+
+    // Size the step to the live droplets, then sort the survivors into the other alive list
+    Count(0);
+
+    stepShader->use();
+    glUniform1f(glGetUniformLocation(stepShader->ID, "dt"),      dt);
+    glUniform1f(glGetUniformLocation(stepShader->ID, "damping"), std::exp(-DRAG * dt));
+    glUniform3f(glGetUniformLocation(stepShader->ID, "gravity"), 0.0f, GRAVITY, 0.0f);
+    glUniform1i(glGetUniformLocation(stepShader->ID, "current"), current);
+    glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, stateBuffer);
+    glDispatchComputeIndirect(offsetof(State, dispatch));
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+    current = 1 - current;
+    Count(1);
+}
+
+void GpuDroplets::Draw(const glm::mat4& view, const glm::mat4& projection)
+{
+    drawShader->use();
+    glUniformMatrix4fv(glGetUniformLocation(drawShader->ID, "view"),       1, GL_FALSE, glm::value_ptr(view));
+    glUniformMatrix4fv(glGetUniformLocation(drawShader->ID, "projection"), 1, GL_FALSE, glm::value_ptr(projection));
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, DROPLET_BUFFER, dropletBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, ALIVE_IN,       aliveBuffers[current]);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, stateBuffer);
+    glBindVertexArray(VAO);
+
+    // Droplets are small and see-through, so they blend over the scene without hiding each other
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    glDepthMask(GL_FALSE);
+
+    glDrawArraysIndirect(GL_TRIANGLE_STRIP, reinterpret_cast<const void*>(offsetof(State, draw)));
+
+    glDepthMask(GL_TRUE);
+    glDisable(GL_BLEND);
+}
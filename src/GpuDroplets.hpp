@@ -0,0 +1,95 @@
+#ifndef GPUDROPLETS
+#define GPUDROPLETS
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "Droplets.hpp"
+#include "Shader.hpp"
+
+/**
+ *  Droplets simulated and drawn entirely on the GPU; nothing is ever read back.
+ *  Droplets live in a fixed pool. Free slots sit on a dead list and live ones on an alive list, with a second alive
+ *  list the survivors of a step are written to. Compute shaders spawn bursts from the dead list, write the dispatch
+ *  size of the next step and the instance count of the draw into an indirect buffer, and move the droplets, so the
+ *  CPU only uploads the new bursts and issues a fixed set of calls every frame.
+ *  Needs an OpenGL 4.3 context for compute shaders and storage buffers.
+ */
+class GpuDroplets : public Droplets
+{
+    public:
+        /**
+         *  Creates the buffers and shaders; a GL context must be current.
+         *  @param capacity - The most droplets that can be alive at once.
+         */
+        GpuDroplets(int capacity);
+
+        /** The buffers belong to the GL context, so copying is deleted. */
+        GpuDroplets(const GpuDroplets&) = delete;
+        GpuDroplets& operator=(const GpuDroplets&) = delete;
+
+        /** Deletes the buffers and shaders; the GL context must still be current. */
+        ~GpuDroplets();
+
+        void Burst(glm::vec3 position, glm::vec3 velocity, float radius) override;
+        void Step(float dt) override;
+        int GetCapacity() const override { return capacity; };
+
+        /**
+         *  Draws every live droplet as a camera facing disc with one indirect call.
+         *  @param view       - The camera's view matrix.
+         *  @param projection - The camera's projection matrix.
+         */
+        void Draw(const glm::mat4& view, const glm::mat4& projection);
+
+    private:
+        /** The indirect arguments and counters, laid out like the State block of the shaders. */
+        struct State
+        {
+            uint32_t dispatch[3]; // Work groups of the next step, for glDispatchComputeIndirect.
+            uint32_t draw[4];     // Vertices, instances, first vertex and base instance, for glDrawArraysIndirect.
+            int32_t  dead;        // Free slots on the dead list.
+            uint32_t alive[2];    // Droplets on each alive list.
+        };
+
+        /** A queued burst, laid out like the Burst struct of the emit shader. */
+        struct GpuBurst
+        {
+            glm::vec4 centerRadius; // Center (xyz) and radius (w) of the bubble.
+            glm::vec4 velocity;     // Velocity of the bubble (xyz).
+            uint32_t  first;        // Droplets in the bursts before this one.
+            uint32_t  count;        // Droplets in this burst.
+            uint32_t  seed;         // Seed of the burst's random numbers.
+            uint32_t  padding;
+        };
+
+        /** Runs the single work group of the count shader, between barriers. */
+        void Count(int stage);
+
+        static const int GROUP = 256; // Invocations per work group of the emit and step shaders.
+
+        /** Storage buffer binding points, matching the layouts in the droplet shaders. */
+        enum Binding { DROPLET_BUFFER, DEAD_LIST, ALIVE_IN, ALIVE_OUT, STATE, BURSTS };
+
+        int capacity;                  // Most droplets alive at once.
+        int current;                   // Alive list holding the live droplets.
+        uint32_t bursts;               // Bursts queued so far; seeds the next one.
+        std::vector<GpuBurst> pending; // Bursts waiting for the next Step.
+        uint32_t pendingCount;         // Droplets in the pending bursts.
+
+        unsigned int dropletBuffer;   // Every droplet slot.
+        unsigned int deadBuffer;      // Stack of free slots.
+        unsigned int aliveBuffers[2]; // Live slots before and after a step.
+        unsigned int stateBuffer;     // Indirect arguments and counters.
+        unsigned int burstBuffer;     // Bursts being spawned.
+        unsigned int VAO;             // Empty vertex array for the attribute-less draw.
+
+        Shader* emitShader;  // Spawns bursts from the dead list.
+        Shader* stepShader;  // Moves droplets and sorts them into the dead or next alive list.
+        Shader* countShader; // Writes the indirect arguments.
+        Shader* drawShader;  // Draws the droplets as discs.
+};
+
+#endif
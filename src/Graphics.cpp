@@ -11,6 +11,8 @@
 #include <sstream>
 #include <string>
 #include <ios>
+#include <utility>
+#include <algorithm>
 
 // OpenGL Mathematics library
 #include <glm/glm.hpp>
@@ -21,99 +23,85 @@
 #include "OGLBLOG.hpp"
 #include "Shader.hpp"
 #include "Centroid.hpp"
+#include "PointReader.hpp"
+#include "PointCloud.hpp"
+#include "PointBatch.hpp"
 
-Graphics::Graphics(GLFWwindow* wnd, Camera* cam, float radius)
+Graphics::Graphics(GLFWwindow* wnd, Camera* cam, SimThread* sim, float radius)
 {
-    this->window = wnd;
-    this->camera = cam;
+    this->window     = wnd;
+    this->camera     = cam;
+    this->simulation = sim;
 
     // Initializes shader array to the default max size
     maxSize = 6;
-    VAOs = new unsigned int [maxSize];
-    VBOs = new unsigned int [maxSize];
-    EBOs = new unsigned int [maxSize];
+    VAOs = new unsigned int [maxSize]();
+    VBOs = new unsigned int [maxSize]();
+    EBOs = new unsigned int [maxSize]();
     sphere = new Sphere(radius);
+    film   = new ThinFilm();
+    filmVBO = 0;
+    droplets = NULL;
+    shapes   = new Harmonics();
+    jobs     = NULL;
 }
 
-void Graphics::GenerateCluster(int index)
+int Graphics::GenerateCluster(int index, ConvexHull* hull)
 {
-    // The number of points in this cluster
-    int n;
-
-    // Read in points
-    std::ifstream source;
-    try
-    {
-        source.open("../OGLBubbles/bin/input.txt", std::ios::in);
-    }
-    catch (std::ios_base::failure &ex)
-    {
-        std::cout << ex.what() << std::endl;
-    }
-
-    if ( source.fail() ) 
-    {
-        std::cout << "Cannot open file: " << source.eof() << std::endl;
-        return;
-    }
-    bool first = true;
-    std::vector<float> vertices = std::vector<float>();
-    
-    // Iterates over the input
-    for ( std::string line; std::getline(source, line); )
+    // Step 1. Load the points and find their hull; only the hull goes to the GPU
+    PointCloud cloud;
+    PointBatch points;
+    std::vector<float> storage;
+    LoadInput(cloud, points, storage, jobs);
+
+    ConvexHull local;
+    if ( hull == NULL )
+        hull = &local;
+    hull->SetJobSystem(jobs);
+    if ( !hull->Build(points) )
     {
-        std::istringstream in(line);
-
-        if ( first )
-        {
-            in >> n;
-            first = false;
-            continue;
-        }
-
-        float p1;
-        float p2;
-        float p3;
-        
-        in >> p1;
-        in >> p2;
-        in >> p3;
-        
-        vertices.push_back(p1);
-        vertices.push_back(p2);
-        vertices.push_back(p3);
+        std::cout << "Cannot find the hull of the input points" << std::endl;
+        return 0;
     }
-    source.close();
+    const std::vector<glm::vec3>&    vertices = hull->GetVertices();
+    const std::vector<unsigned int>& indices  = hull->GetIndices();
 
     // Graphics Pipeline
-    // Step 1: Create the data for the object and generate buffers
-
-    // Generates and binds a vertex buffer, then copies data to it
-    unsigned int VBO;
-    glGenBuffers(1, &VBO);
-
-    // Adds all the defined data into a vertex array object (note that you can make an array of these)
-    unsigned int VAO;
+    // Step 2: Generate the buffers and bind them to a vertex array object
+    unsigned int VAO, VBO, EBO;
     glGenVertexArrays(1, &VAO);
+    glGenBuffers(1, &VBO);
+    glGenBuffers(1, &EBO);
     VAOs[index] = VAO;
-
-    // Step 2. Copy the data into buffers and bind them to the current VAO
+    VBOs[index] = VBO;
+    EBOs[index] = EBO;
     glBindVertexArray(VAOs[index]);
+
+    // Step 3. Upload the hull once; it doesn't change after this
     glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(vertices.front()), static_cast<void*>(vertices.data()), GL_STATIC_DRAW);
+    glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(vertices.size() * sizeof(glm::vec3)), vertices.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, static_cast<GLsizeiptr>(indices.size() * sizeof(unsigned int)), indices.data(), GL_STATIC_DRAW);
 
-    // Step 3. Set the vertex attribute pointers and enable them
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+    // Step 4. Set the vertex attribute pointer and enable it
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void*)0);
     glEnableVertexAttribArray(0);
+
+    return static_cast<int>(indices.size());
 }
 
-void Graphics::DrawCluster(int index, int n)
+void Graphics::DrawCluster(int index, int n, float width, float height)
 {
-    // Renders the cluster
-    glUseProgram(shaders.back()->ID);
+    // Renders the cluster with the cluster shader, the last one created
+    Shader* shader = shaders.back();
+    glm::mat4 projection = camera->GetProjection(width, height);
+
+    glUseProgram(shader->ID);
+    glUniformMatrix4fv(glGetUniformLocation(shader->ID, "view"),       1, GL_FALSE, &camera->GetView()[0][0]);
+    glUniformMatrix4fv(glGetUniformLocation(shader->ID, "projection"), 1, GL_FALSE, &projection[0][0]);
     glBindVertexArray(VAOs[index]);
     
-    glDrawArrays(GL_LINE_LOOP, 0, n);
+    glDrawElements(GL_TRIANGLES, n, GL_UNSIGNED_INT, 0);
 }
 
 void Graphics::ClearBuffer(float red, float green, float blue, float alpha)
@@ -131,11 +119,16 @@ void Graphics::CreateShaders()
 {
     shaders.push_back(new Shader("..\\shaders\\LightVS.GLSL", "..\\shaders\\LightPS.GLSL"));
 
-    shaders.push_back(new Shader("..\\shaders\\DefaultVertex.GLSL", "..\\shaders\\DefaultPixel.GLSL"));
+    shaders.push_back(new Shader("..\\shaders\\SoapVertex.GLSL", "..\\shaders\\SoapPixel.GLSL"));
+    shaders[1]->use();
+    glUniform1f(glGetUniformLocation(shaders[1]->ID, "filmScale"), ThinFilm::MAX_THICKNESS);
     glUniform3f(glGetUniformLocation(shaders[1]->ID, "objectColor"), 1.0f, 1.0f, 1.0f);
     glUniform3f(glGetUniformLocation(shaders[1]->ID, "lightColor" ), 1.0f, 1.0f, 1.0f );
     //glUniform3f(glGetUniformLocation(shaders[1]->ID, "lightPos" ), lightPos[0], lightPos[1], lightPos[2] );
     glUniform3f(glGetUniformLocation(shaders[1]->ID, "viewPos" ), camera->GetCameraPos().x, camera->GetCameraPos().y, camera->GetCameraPos().z);
+
+    // Clusters are drawn with the last shader
+    shaders.push_back(new Shader("..\\shaders\\ClusterVS.GLSL", "..\\shaders\\LightPS.GLSL"));
 }
 
 void Graphics::UseShader(int shaderID)
@@ -235,53 +228,55 @@ void Graphics::GenerateTriangle(int index)
     glEnableVertexAttribArray(1);
 }
 
-void Graphics::GenerateCube(int index)
+/** The light cube: 36 unindexed corners, each a position followed by a colour. */
+static const float CUBE_VERTICES[] =
 {
-    float vertices[] = 
-    {
-        -0.5f, -0.5f, -0.5f,   0.0f, 0.0f, 1.0f,
-         0.5f, -0.5f, -0.5f,   1.0f, 0.0f, 0.0f,
-         0.5f,  0.5f, -0.5f,   1.0f, 1.0f, 0.0f,
-         0.5f,  0.5f, -0.5f,   1.0f, 1.0f, 0.0f,
-        -0.5f,  0.5f, -0.5f,   0.0f, 1.0f, 0.0f,
-        -0.5f, -0.5f, -0.5f,   0.0f, 0.0f, 1.0f,
-
-        -0.5f, -0.5f,  0.5f,   0.0f, 0.0f, 1.0f,
-         0.5f, -0.5f,  0.5f,   1.0f, 0.0f, 0.0f,
-         0.5f,  0.5f,  0.5f,   1.0f, 1.0f, 0.0f,
-         0.5f,  0.5f,  0.5f,   1.0f, 1.0f, 0.0f,
-        -0.5f,  0.5f,  0.5f,   0.0f, 1.0f, 0.0f,
-        -0.5f, -0.5f,  0.5f,   0.0f, 0.0f, 1.0f,
-
-        -0.5f,  0.5f,  0.5f,   1.0f, 0.0f, 0.0f,
-        -0.5f,  0.5f, -0.5f,   1.0f, 1.0f, 0.0f,
-        -0.5f, -0.5f, -0.5f,   0.0f, 1.0f, 0.0f,
-        -0.5f, -0.5f, -0.5f,   0.0f, 1.0f, 0.0f,
-        -0.5f, -0.5f,  0.5f,   0.0f, 0.0f, 1.0f,
-        -0.5f,  0.5f,  0.5f,   1.0f, 0.0f, 0.0f,
-
-         0.5f,  0.5f,  0.5f,   1.0f, 0.0f, 0.0f,
-         0.5f,  0.5f, -0.5f,   1.0f, 1.0f, 0.0f,
-         0.5f, -0.5f, -0.5f,   0.0f, 1.0f, 0.0f,
-         0.5f, -0.5f, -0.5f,   0.0f, 1.0f, 0.0f,
-         0.5f, -0.5f,  0.5f,   0.0f, 0.0f, 1.0f,
-         0.5f,  0.5f,  0.5f,   1.0f, 0.0f, 0.0f,
-
-        -0.5f, -0.5f, -0.5f,   0.0f, 1.0f, 0.0f,
-         0.5f, -0.5f, -0.5f,   1.0f, 1.0f, 1.0f,
-         0.5f, -0.5f,  0.5f,   1.0f, 0.0f, 0.0f,
-         0.5f, -0.5f,  0.5f,   1.0f, 0.0f, 1.0f,
-        -0.5f, -0.5f,  0.5f,   0.0f, 0.0f, 1.0f,
-        -0.5f, -0.5f, -0.5f,   0.0f, 1.0f, 0.0f,
-
-        -0.5f,  0.5f, -0.5f,   0.0f, 1.0f, 0.0f,
-         0.5f,  0.5f, -0.5f,   1.0f, 1.0f, 1.0f,
-         0.5f,  0.5f,  0.5f,   1.0f, 0.0f, 0.0f,
-         0.5f,  0.5f,  0.5f,   1.0f, 0.0f, 0.0f,
-        -0.5f,  0.5f,  0.5f,   0.0f, 0.0f, 1.0f,
-        -0.5f,  0.5f, -0.5f ,  0.0f, 1.0f, 0.0f
-    };
+    -0.5f, -0.5f, -0.5f,   0.0f, 0.0f, 1.0f,
+     0.5f, -0.5f, -0.5f,   1.0f, 0.0f, 0.0f,
+     0.5f,  0.5f, -0.5f,   1.0f, 1.0f, 0.0f,
+     0.5f,  0.5f, -0.5f,   1.0f, 1.0f, 0.0f,
+    -0.5f,  0.5f, -0.5f,   0.0f, 1.0f, 0.0f,
+    -0.5f, -0.5f, -0.5f,   0.0f, 0.0f, 1.0f,
+
+    -0.5f, -0.5f,  0.5f,   0.0f, 0.0f, 1.0f,
+     0.5f, -0.5f,  0.5f,   1.0f, 0.0f, 0.0f,
+     0.5f,  0.5f,  0.5f,   1.0f, 1.0f, 0.0f,
+     0.5f,  0.5f,  0.5f,   1.0f, 1.0f, 0.0f,
+    -0.5f,  0.5f,  0.5f,   0.0f, 1.0f, 0.0f,
+    -0.5f, -0.5f,  0.5f,   0.0f, 0.0f, 1.0f,
+
+    -0.5f,  0.5f,  0.5f,   1.0f, 0.0f, 0.0f,
+    -0.5f,  0.5f, -0.5f,   1.0f, 1.0f, 0.0f,
+    -0.5f, -0.5f, -0.5f,   0.0f, 1.0f, 0.0f,
+    -0.5f, -0.5f, -0.5f,   0.0f, 1.0f, 0.0f,
+    -0.5f, -0.5f,  0.5f,   0.0f, 0.0f, 1.0f,
+    -0.5f,  0.5f,  0.5f,   1.0f, 0.0f, 0.0f,
+
+     0.5f,  0.5f,  0.5f,   1.0f, 0.0f, 0.0f,
+     0.5f,  0.5f, -0.5f,   1.0f, 1.0f, 0.0f,
+     0.5f, -0.5f, -0.5f,   0.0f, 1.0f, 0.0f,
+     0.5f, -0.5f, -0.5f,   0.0f, 1.0f, 0.0f,
+     0.5f, -0.5f,  0.5f,   0.0f, 0.0f, 1.0f,
+     0.5f,  0.5f,  0.5f,   1.0f, 0.0f, 0.0f,
+
+    -0.5f, -0.5f, -0.5f,   0.0f, 1.0f, 0.0f,
+     0.5f, -0.5f, -0.5f,   1.0f, 1.0f, 1.0f,
+     0.5f, -0.5f,  0.5f,   1.0f, 0.0f, 0.0f,
+     0.5f, -0.5f,  0.5f,   1.0f, 0.0f, 1.0f,
+    -0.5f, -0.5f,  0.5f,   0.0f, 0.0f, 1.0f,
+    -0.5f, -0.5f, -0.5f,   0.0f, 1.0f, 0.0f,
+
+    -0.5f,  0.5f, -0.5f,   0.0f, 1.0f, 0.0f,
+     0.5f,  0.5f, -0.5f,   1.0f, 1.0f, 1.0f,
+     0.5f,  0.5f,  0.5f,   1.0f, 0.0f, 0.0f,
+     0.5f,  0.5f,  0.5f,   1.0f, 0.0f, 0.0f,
+    -0.5f,  0.5f,  0.5f,   0.0f, 0.0f, 1.0f,
+    -0.5f,  0.5f, -0.5f ,  0.0f, 1.0f, 0.0f
+};
+static const int CUBE_STRIDE = 6; // Floats per cube corner.
 
+void Graphics::GenerateCube(int index)
+{
     // Generates and binds a vertex buffer, then copies data to it
     unsigned int VBO;
     glGenBuffers(1, &VBO);
@@ -298,14 +293,35 @@ void Graphics::GenerateCube(int index)
     //glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices) / sizeof(indices[0]), static_cast<void*>(indices), GL_STATIC_DRAW);
     
     glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), static_cast<void*>(vertices), GL_STATIC_DRAW);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(CUBE_VERTICES), CUBE_VERTICES, GL_STATIC_DRAW);
 
 
     // Step 3. Set the vertex attribute pointers and enable them
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, CUBE_STRIDE * sizeof(float), (void*)0);
     glEnableVertexAttribArray(0);
 }
 
+void Graphics::CubeMesh(std::vector<glm::vec3>* positions, std::vector<unsigned int>* indices)
+{
+    int count = static_cast<int>(sizeof(CUBE_VERTICES) / sizeof(float)) / CUBE_STRIDE;
+    positions->resize(count);
+    indices->resize(count);
+    for (int i = 0; i < count; i++)
+    {
+        (*positions)[i] = glm::vec3(CUBE_VERTICES[i * CUBE_STRIDE], CUBE_VERTICES[i * CUBE_STRIDE + 1], CUBE_VERTICES[i * CUBE_STRIDE + 2]);
+        (*indices)[i]   = i;
+    }
+
+    // The drawn faces don't all share one winding, so turn every triangle to face away from the cube's center
+    for (int i = 0; i + 2 < count; i += 3)
+    {
+        glm::vec3 a = (*positions)[i];
+        glm::vec3 normal = glm::cross((*positions)[i + 1] - a, (*positions)[i + 2] - a);
+        if ( glm::dot(normal, a) < 0.0f )
+            std::swap((*indices)[i + 1], (*indices)[i + 2]);
+    }
+}
+
 void Graphics::GenerateSphere(int index)
 {
     // Get icosahedron data from the sphere object
@@ -349,15 +365,73 @@ void Graphics::GenerateSphere(int index)
     // Normals
     glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(3 * sizeof(float)));
     glEnableVertexAttribArray(1);
+
+    // Film thickness lives in its own buffer so it can be updated every frame without touching the mesh
+    film->Build(sphere->GetVertices(), indices);
+    const std::vector<uint16_t>& thickness = film->GetPacked();
+
+    glGenBuffers(1, &filmVBO);
+    glBindBuffer(GL_ARRAY_BUFFER, filmVBO);
+    glBufferData(GL_ARRAY_BUFFER, thickness.size() * sizeof(uint16_t), thickness.data(), GL_DYNAMIC_DRAW);
+    glVertexAttribPointer(2, 1, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(uint16_t), (void*)0);
+    glEnableVertexAttribArray(2);
+}
+
+void Graphics::UpdateFilm(float dt)
+{
+    if ( filmVBO == 0 )
+        return;
+
+    // Every bubble shares the mesh's orientation, so gravity is the same in all of their model spaces
+    glm::mat3 rotation = glm::mat3(BubbleModel(glm::vec3(0.0f), sphere->GetRadius()));
+    glm::vec3 gravity  = glm::transpose(rotation) * glm::vec3(0.0f, -1.0f, 0.0f);
+    if ( !film->Advance(dt, gravity) )
+        return;
+
+    const std::vector<uint16_t>& thickness = film->GetPacked();
+    glBindBuffer(GL_ARRAY_BUFFER, filmVBO);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, thickness.size() * sizeof(uint16_t), thickness.data());
+}
+
+void Graphics::GenerateDroplets(int capacity)
+{
+    droplets = new GpuDroplets(capacity);
+}
+
+void Graphics::UpdateDroplets(float dt)
+{
+    if ( droplets == NULL )
+        return;
+
+    simulation->TakePops(popped);
+    for (const Pop& pop : popped)
+        droplets->Burst(pop.position, pop.velocity, pop.radius);
+    popped.clear();
+
+    droplets->Step(dt);
+}
+
+void Graphics::DrawDroplets(float width, float height)
+{
+    if ( droplets == NULL )
+        return;
+
+    droplets->Draw(camera->GetView(), camera->GetProjection(width, height));
 }
 
 void Graphics::RegenSphere(int index)
 {
-    std::vector <float> vertices = sphere->GetVertices();
+    // The buffer interleaves positions and normals, so both go up together
+    std::vector <float> vertices = sphere->GetVertNorms();
 
     glBindVertexArray(VAOs[index]);
     glBindBuffer(GL_ARRAY_BUFFER, VBOs[index]);
-    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(vertices.front()), static_cast<void*>(vertices.data()), GL_STATIC_DRAW);
+    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(vertices.front()), static_cast<void*>(vertices.data()), GL_DYNAMIC_DRAW);
+}
+
+void Graphics::UpdateShape(float dt)
+{
+    shapes->Step(dt);
 }
 
 void Graphics::DrawSphere(int index, int shaderID)
@@ -432,7 +506,7 @@ void Graphics::Transform(float width, float height, int shaderID)
     model      = glm::rotate(model, glm::radians(-55.0f), glm::vec3(1.0f, 0.0f, 0.0f));
     //model = glm::rotate(model, (float)glfwGetTime() * glm::radians(50.0f), glm::vec3(0.5f, 1.0f, 0.0f));//(float)glfwGetTime() * glm::radians(50.0f), glm::vec3(0.5f, 1.0f, 0.0f));
     //view  = glm::translate(view, glm::vec3(0.0f, 0.0f, -5.0f));
-    projection = glm::perspective(glm::radians(45.0f), width / height, 0.1f, 100.0f);
+    projection = camera->GetProjection(width, height);
 
     // Retrieve the matrix uniform locations
     unsigned int modelLoc = glGetUniformLocation(shaders[shaderID]->ID, "model");
@@ -458,7 +532,7 @@ void Graphics::TransformLight(float width, float height, int shaderID)
     
     model      = glm::translate(model, camera->GetLightPos());
     model      = glm::scale(model, glm::vec3(0.1f));
-    projection = glm::perspective(glm::radians(45.0f), width / height, 0.1f, 100.0f);
+    projection = camera->GetProjection(width, height);
 
     // Retrieve the matrix uniform locations
     unsigned int modelLoc = glGetUniformLocation(shaders[shaderID]->ID, "model");
@@ -476,9 +550,32 @@ void Graphics::TransformLight(float width, float height, int shaderID)
 
 void Graphics::SetMaxSize(int size)
 {
+    // Objects past a smaller size can't be drawn anymore, so they're deleted (zero names are ignored)
+    for (int i = size; i < maxSize; i++)
+    {
+        glDeleteVertexArrays(1, &VAOs[i]);
+        glDeleteBuffers(1, &VBOs[i]);
+        glDeleteBuffers(1, &EBOs[i]);
+    }
+
+    // Copy the remaining names into arrays of the new size; the shader programs already live in a vector
+    int keep = std::min(size, maxSize);
+    for (unsigned int** names : { &VAOs, &VBOs, &EBOs })
+    {
+        unsigned int* resized = new unsigned int [size]();
+        std::copy(*names, *names + keep, resized);
+        delete[] *names;
+        *names = resized;
+    }
+
     this->maxSize = size;
-    
-    // TODO: Copy VAOs, EBOs and shader programs to new arrays of the updated size
+}
+
+void Graphics::SetJobSystem(JobSystem* jobs)
+{
+    this->jobs = jobs;
+    sphere->SetJobSystem(jobs);
+    film->SetJobSystem(jobs);
 }
 
 void Graphics::Mouse(GLFWwindow* window, double xpos, double ypos)
@@ -486,61 +583,147 @@ void Graphics::Mouse(GLFWwindow* window, double xpos, double ypos)
     // Stub
 }
 
-void Graphics::Collision(std::array<float,3> vertex, float magnitude)
+glm::mat4 Graphics::BubbleModel(glm::vec3 position, float radius)
 {
-    // Stub
-    sphere->Collision(vertex, magnitude);
+    glm::mat4 model = glm::translate(glm::mat4(1.0f), position);
+    model = glm::rotate(model, glm::radians(-55.0f), glm::vec3(1.0f, 0.0f, 0.0f));
+    return glm::scale(model, glm::vec3(radius / sphere->GetRadius()));
 }
 
 void Graphics::CollisionCheck(float x, float y, float velocity)
 {
-    // Get rough sphere bounds
-    // Model center! {0,0}!!! need to project this into world space
-    std::array<float,3> center = sphere->FindCenter();
-    float radius = sphere->GetRadius();
+    // Unproject the cursor into a world space ray
+    int width, height;
+    glfwGetWindowSize(window, &width, &height);
+    if ( width == 0 || height == 0 )
+        return;
 
-    // Transform model center into worldspace
-    glm::mat4 model = glm::mat4(1.0f);
-    model = glm::rotate(model, glm::radians(-55.0f), glm::vec3(1.0f, 0.0f, 0.0f));
+    Ray ray = camera->GetRay(x, y, static_cast<float>(width), static_cast<float>(height));
 
-    // TODO: Multiply center point by model -> world space transformation
-    
+    // The bubbles belong to the simulation thread, so the pick runs there and reports back through pokes
+    simulation->Post([this, ray, velocity](Simulation& sim)
+    {
+        float t = 0.0f;
+        int   id = sim.Pick(ray, &t);
+        if ( id == -1 )
+            return;
 
-    // TODO: Transform x, y position into screen percentage
+        // Move the impact point into the sphere mesh's model space
+        const Bubble& bubble = sim.GetBubble(id);
+        glm::vec3 impact     = ray.origin + ray.direction * t;
+        glm::vec4 local      = glm::inverse(BubbleModel(bubble.position, bubble.radius)) * glm::vec4(impact, 1.0f);
 
-    // TODO: Transform screen percentage into view space coordinates
+        sim.ApplyImpulse(id, ray.direction * velocity * POKE_STRENGTH);
+
+        std::lock_guard<std::mutex> lock(pokeMutex);
+        pokes.push_back({ sim.GetHandle(id), bubble.radius, {local.x, local.y, local.z}, velocity });
+    });
+}
 
-    // Check if x,y is within sphere
-    if ( (x != 0.0f && y != 0.0f) && (((x - center[0]) * (x - center[0]) + (y - center[1]) * (y - center[1]) /*+ (z - center[2]) * (z - center[2])*/ ) < radius * radius) )
+void Graphics::SweepCheck(float x0, float y0, float x1, float y1, float duration)
+{
+    if ( x0 == x1 && y0 == y1 )
+        return;
+
+    int width, height;
+    glfwGetWindowSize(window, &width, &height);
+    if ( width == 0 || height == 0 )
+        return;
+
+    Ray   from  = camera->GetRay(x0, y0, static_cast<float>(width), static_cast<float>(height));
+    Ray   to    = camera->GetRay(x1, y1, static_cast<float>(width), static_cast<float>(height));
+    float range = camera->GetFarPlane();
+
+    simulation->Post([this, from, to, duration, range](Simulation& sim)
+    {
+        std::vector<Impact> impacts = sim.SweepRay(from, to, duration, range);
+
+        std::lock_guard<std::mutex> lock(pokeMutex);
+        for (const Impact& impact : impacts)
+        {
+            const Bubble& bubble = sim.GetBubble(impact.id);
+            glm::vec4 local = glm::inverse(BubbleModel(bubble.position, bubble.radius)) * glm::vec4(impact.point, 1.0f);
+
+            // Measure the poke by the change in speed it causes, like the mouse velocity used for clicks
+            glm::vec3 before = bubble.velocity;
+            sim.ApplyImpulse(impact.id, impact.impulse);
+            pokes.push_back({ sim.GetHandle(impact.id), bubble.radius, {local.x, local.y, local.z},
+                              glm::length(sim.GetBubble(impact.id).velocity - before) });
+        }
+
+        // The swipe also drags the air along, so bubbles it missed still feel the draft
+        AirFlow* air = sim.GetAirFlow();
+        if ( air != NULL && duration > 0.0f )
+        {
+            glm::vec3 turn = (to.direction - from.direction) / duration;
+            for (float t = STIR_SPACING; t < range; t += STIR_SPACING)
+                air->AddVelocity(to.origin + to.direction * t, turn * t * STIR_STRENGTH, STIR_RADIUS);
+        }
+    });
+}
+
+void Graphics::ApplyPokes()
+{
+    std::vector<Poke> hits;
     {
-        std::cout << "Collision detected: {" << x << ", " << y << "}, velocity {" << velocity << "}." << std::endl;
-        Collision({x, y, center[2]}, velocity);
+        std::lock_guard<std::mutex> lock(pokeMutex);
+        hits.swap(pokes);
     }
-    else 
+
+    for (const Poke& poke : hits)
     {
-        std::cout << "No collision detected, distance: {x: " << x << ", " << center[0] << "},  {y: " << y << ", " << center[1] << "}." << std::endl;
+        std::cout << "Collision detected: {" << poke.vertex[0] << ", " << poke.vertex[1] << ", " << poke.vertex[2] << "}, velocity {" << poke.magnitude << "}." << std::endl;
+        shapes->Poke(poke.handle, poke.radius, glm::vec3(poke.vertex[0], poke.vertex[1], poke.vertex[2]), poke.magnitude);
     }
+}
+
+void Graphics::DrawBubbles(int index, int shaderID)
+{
+    const Snapshot& snapshot = simulation->Acquire();
+    float alpha = simulation->GetAlpha();
+
+    glUseProgram(shaders[shaderID]->ID);
+    glBindVertexArray(VAOs[index]);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBOs[index]);
 
-    /*// Old code, delete later (it doesn't even check the triangles...)
-    std::vector<float> vertices = sphere->GetVertices();
-    for (int i = 0; i < vertices.size(); i += 3)
+    unsigned int modelLoc = glGetUniformLocation(shaders[shaderID]->ID, "model");
+    int          shapeLoc = glGetUniformLocation(shaders[shaderID]->ID, "shape");
+    GLsizei      count    = static_cast<GLsizei>(sphere->GetIndices().size());
+
+    // A wobble is a few vec4s of coefficients, so it goes up with the model matrix instead of as a new mesh
+    static const float round[Harmonics::STRIDE] = {};
+    for (int i = 0; i < static_cast<int>(snapshot.current.size()); i++)
     {
-        if (vertices[i] == x && vertices[i + 1] == y && !(x == 0 && y == 0))
-        {
-            std::cout << "Collision detected: [" << x << ", " << y << "]." << std::endl;
-            Collision({vertices[i], vertices[i + 1], vertices[i + 2] }, 0.05f);
-            break;
-        }
-    }*/
+        glm::vec4 bubble = snapshot.Lerp(i, alpha);
+        glm::mat4 model  = BubbleModel(glm::vec3(bubble), bubble.w);
+        const float* shape = shapes->Find(snapshot.handles[i]);
+
+        glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
+        glUniform4fv(shapeLoc, Harmonics::STRIDE / 4, shape != NULL ? shape : round);
+        glDrawElements(GL_TRIANGLES, count, GL_UNSIGNED_INT, 0);
+    }
 }
 
 void Graphics::Close()
 {
+    // The droplet buffers belong to the context, so they go before it
+    if ( droplets != NULL )
+        delete droplets;
+    droplets = NULL;
+
     glfwTerminate();
 
     // Delete sphere object
     if ( sphere != NULL )
         delete sphere;
+    if ( film != NULL )
+        delete film;
+    if ( shapes != NULL )
+        delete shapes;
+
+    delete[] VAOs;
+    delete[] VBOs;
+    delete[] EBOs;
 
     // Delete shaders (glfwTerminate might already handle this...)
     for (auto shader : shaders)
@@ -5,10 +5,17 @@
 #include <GLFW/glfw3.h>
 
 #include <vector>
+#include <mutex>
 
 #include "Shader.hpp"
 #include "Sphere.hpp"
+#include "ThinFilm.hpp"
+#include "GpuDroplets.hpp"
+#include "Harmonics.hpp"
 #include "Camera.hpp"
+#include "Simulation.hpp"
+#include "SimThread.hpp"
+#include "ConvexHull.hpp"
 
 
 /**
@@ -23,8 +30,10 @@ class Graphics
          *  TODO: Implement the display lists in the tutorial for Chapter 7: https://www.opengl.org.ru/docs/pg/0208.html
          *  @param window - A pointer to the GLFW window you wish to attach Graphics to.
          *  @param cam    - A pointer to the Camera associated with this Graphics object.
+         *  @param sim    - A pointer to the thread running the simulation whose bubbles are drawn.
+         *  @param radius - The radius of the sphere mesh.
          */
-        Graphics(GLFWwindow* window, Camera* cam, float radius);
+        Graphics(GLFWwindow* window, Camera* cam, SimThread* sim, float radius);
 
         /**
          *  A basic copy operation on the Graphics object.
@@ -121,22 +130,67 @@ class Graphics
          */
         void GenerateCube(int index);
 
+        /**
+         *  Gets the triangles of the light cube, for baking a collision field from it.
+         *  @param positions - Receives the corners, three per triangle.
+         *  @param indices   - Receives the index of every corner.
+         */
+        static void CubeMesh(std::vector<glm::vec3>* positions, std::vector<unsigned int>* indices);
+
         /**
          *  Generates bindables for a Sphere.
          *  @param index - The index of the VAO for this drawable object.
          */
         void GenerateSphere(int index);
 
+        /**
+         *  Lets the soap film on the sphere mesh drain and smooth out, then uploads its new thickness.
+         *  Call once per frame after GenerateSphere; the film steps at its own fixed rate.
+         *  @param dt - The time since the last call in seconds.
+         */
+        void UpdateFilm(float dt);
+
+        /**
+         *  Creates the droplet spray that popped bubbles burst into.
+         *  @param capacity - The most droplets that can be alive at once.
+         */
+        void GenerateDroplets(int capacity);
+
+        /**
+         *  Bursts the bubbles that popped since the last call into droplets and moves the spray along.
+         *  Call once per frame after GenerateDroplets.
+         *  @param dt - The time since the last call in seconds.
+         */
+        void UpdateDroplets(float dt);
+
+        /**
+         *  Draws the droplet spray; call after the opaque geometry, since the droplets blend over it.
+         *  @param width  - The screen width.
+         *  @param height - The screen height.
+         */
+        void DrawDroplets(float width, float height);
+
         /**
          *  Recalculates the vertex array object for the sphere.
          */
         void RegenSphere(int index);
 
         /**
-         *  Generates bindables for a cluster of points using input.txt.
+         *  Rings the wobble of every poked bubble on.
+         *  @param dt - The time since the last call in seconds.
+         */
+        void UpdateShape(float dt);
+
+        /**
+         *  Generates bindables for the outline of a cluster of points using input.opc, or input.txt without it.
+         *  The outline is the points' convex hull, found in parallel and uploaded once as an indexed triangle mesh.
+         *  The same mesh makes a tight collision proxy: bake hull->GetVertices() and hull->GetIndices() into a
+         *  DistanceField and hand it to Simulation::AddCollider.
          *  @param index - The index of the VAO for this drawable object.
+         *  @param hull  - Receives the hull, if not NULL.
+         *  @return The number of indices to draw, or 0 if the points have no hull.
          */
-        void GenerateCluster(int index);
+        int GenerateCluster(int index, ConvexHull* hull = NULL);
 
         /**
          *  Draws a sphere to the screen using the graphics pipeline.
@@ -144,6 +198,20 @@ class Graphics
          */
         void DrawSphere(int index, int shaderID);
 
+        /**
+         *  Draws the sphere mesh once for every bubble in the latest simulation snapshot.
+         *  Positions are interpolated between the last two simulation steps.
+         *  @param index    - The index of the sphere's VAO.
+         *  @param shaderID - The index of the shader to use; Transform must have been called for it.
+         */
+        void DrawBubbles(int index, int shaderID);
+
+        /**
+         *  Sets every bubble hit since the last frame wobbling.
+         *  Called from the render thread; hits are found on the simulation thread.
+         */
+        void ApplyPokes();
+
         /**
          *  Draws a cube to the screen using the graphics pipeline.
          *  @param index - The index of the VAO for this drawable object.
@@ -164,11 +232,13 @@ class Graphics
 
 
         /**
-         *  Uses the Centroid mini-project to draw a cluster and containing sphere.
-         *  @param index - The index of the VAO for this drawable object.
-         *  @param n     - The number of vertices to draw.
+         *  Uses the Centroid mini-project to draw the hull of a cluster.
+         *  @param index  - The index of the VAO for this drawable object.
+         *  @param n      - The number of indices to draw, as GenerateCluster returned.
+         *  @param width  - The width of the viewport.
+         *  @param height - The height of the viewport.
          */
-        void DrawCluster(int index, int n);
+        void DrawCluster(int index, int n, float width, float height);
 
         /**
          *  Processes any inputs given to the window this Graphics instance is attached to.
@@ -181,6 +251,12 @@ class Graphics
          */
         void SetMaxSize(int size);
 
+        /**
+         *  Sets the job system used for mesh generation and for parsing clusters.
+         *  @param jobs - The job system to use, or NULL to run on the calling thread.
+         */
+        void SetJobSystem(JobSystem* jobs);
+
         /**
          *  Closes any remaining graphics resources attached to the active window.
          */
@@ -205,8 +281,8 @@ class Graphics
         );
 
         /**
-         *  Checks for any collisions between the x/y positions of the mouse and the active sphere object.
-         *  Chains the Collision function with an appropriate force vector if a collision is found.
+         *  Casts a ray from the camera through the mouse position and checks it against every bubble.
+         *  Queues a poke with an appropriate force vector for ApplyPokes if a collision is found.
          *  @param x        - The x position of the mouse.
          *  @param y        - The y position of the mouse.
          *  @param velocity - The velocity of the mouse.
@@ -214,14 +290,36 @@ class Graphics
         void CollisionCheck(float x, float y, float velocity);
 
         /**
-         *  Applies a collision of the specified magnitude to the active sphere in this Graphics instance.
-         *  @param vertex    - The position of the impact, assumed to be a force direction toward the center point.
-         *  @param magnitude - The magnitude of impact force to be applied to this collision event.
+         *  Sweeps the cursor ray along the straight path the mouse took since the last frame and pokes every
+         *  bubble it runs into, in the order they were hit. Fast swipes can't skip over bubbles this way.
+         *  @param x0, y0   - The mouse position at the start of the path.
+         *  @param x1, y1   - The mouse position at the end of the path.
+         *  @param duration - The time in seconds the mouse took to move along the path.
          */
-        void Collision(std::array<float,3> vertex, float magnitude);
+        void SweepCheck(float x0, float y0, float x1, float y1, float duration);
 
     private:
-        
+        /** A mouse hit on a bubble, waiting to set it wobbling. */
+        struct Poke
+        {
+            BubbleHandle handle;        // The bubble that was hit.
+            float radius;               // Radius of the bubble.
+            std::array<float,3> vertex; // Impact point in the sphere's model space.
+            float magnitude;            // Strength of the impact.
+        };
+
+        /**
+         *  Builds the model matrix used to draw the sphere mesh for a bubble.
+         *  @param position - The world space center of the bubble.
+         *  @param radius   - The radius of the bubble.
+         */
+        glm::mat4 BubbleModel(glm::vec3 position, float radius);
+
+        static constexpr float POKE_STRENGTH = 0.01f; // Converts mouse velocity into a bubble impulse.
+        static constexpr float STIR_STRENGTH = 0.5f;  // Fraction of a swipe's speed handed to the air.
+        static constexpr float STIR_SPACING  = 0.5f;  // Distance between the air pushes along a swipe.
+        static constexpr float STIR_RADIUS   = 0.75f; // Radius of each air push along a swipe.
+
         GLFWwindow* window; // A pointer to the window this Graphics instance paints to.
 
         int maxSize;        // The maximum shader capacity of this graphics object (defaults to 6).
@@ -235,7 +333,17 @@ class Graphics
         unsigned int* EBOs; // Pointer to this Graphics object's Element Buffer Object array.
         
         Sphere* sphere;     // Pointer to this Graphics object's sphere object (TODO: Refactor code so this isn't used).
+        ThinFilm* film;     // Soap film thickness over the sphere mesh, shared by every bubble.
+        unsigned int filmVBO; // Vertex buffer holding the packed film thickness of the sphere mesh.
+        GpuDroplets* droplets;   // Spray of the popped bubbles, or NULL before GenerateDroplets.
+        std::vector<Pop> popped; // Pops taken from the simulation, waiting to burst.
+        Harmonics* shapes;       // Wobble of every poked bubble, drawn by the soap shader.
+        JobSystem* jobs;         // Job system for parsing clusters in parallel, may be NULL.
         Camera* camera;     // The camera associated with this Graphics object
+        SimThread* simulation; // The simulation thread whose bubbles this Graphics object draws.
+
+        std::mutex pokeMutex;     // Guards pokes, which are filled by the simulation thread.
+        std::vector<Poke> pokes;  // Hits waiting to be applied to the bubbles.
 };
 
 #endif
\ No newline at end of file
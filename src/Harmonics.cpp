@@ -0,0 +1,182 @@
+#include "Harmonics.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+static const float PI = 3.14159265358979f;
+
+Harmonics::Harmonics()
+{
+}
+
+void Harmonics::Basis(glm::vec3 n, float* basis)
+{
+    float x = n.x, y = n.y, z = n.z;
+    float x2 = x * x, y2 = y * y, z2 = z * z;
+
+    // Degree 2
+    basis[0]  = 1.092548f * x * y;
+    basis[1]  = 1.092548f * y * z;
+    basis[2]  = 0.315392f * (3.0f * z2 - 1.0f);
+    basis[3]  = 1.092548f * x * z;
+    basis[4]  = 0.546274f * (x2 - y2);
+
+    // Degree 3
+    basis[5]  = 0.590044f * y * (3.0f * x2 - y2);
+    basis[6]  = 2.890611f * x * y * z;
+    basis[7]  = 0.457046f * y * (5.0f * z2 - 1.0f);
+    basis[8]  = 0.373176f * z * (5.0f * z2 - 3.0f);
+    basis[9]  = 0.457046f * x * (5.0f * z2 - 1.0f);
+    basis[10] = 1.445306f * z * (x2 - y2);
+    basis[11] = 0.590044f * x * (x2 - 3.0f * y2);
+
+    // Degree 4
+    basis[12] = 2.503343f * x * y * (x2 - y2);
+    basis[13] = 1.770131f * y * z * (3.0f * x2 - y2);
+    basis[14] = 0.946175f * x * y * (7.0f * z2 - 1.0f);
+    basis[15] = 0.669047f * y * z * (7.0f * z2 - 3.0f);
+    basis[16] = 0.105786f * (35.0f * z2 * z2 - 30.0f * z2 + 3.0f);
+    basis[17] = 0.669047f * x * z * (7.0f * z2 - 3.0f);
+    basis[18] = 0.473087f * (x2 - y2) * (7.0f * z2 - 1.0f);
+    basis[19] = 1.770131f * x * z * (x2 - 3.0f * y2);
+    basis[20] = 0.625836f * (x2 * (x2 - 3.0f * y2) - y2 * (3.0f * x2 - y2));
+}
+
+void Harmonics::Rates(int degree, float radius, float* frequency, float* decay)
+{
+    float l = static_cast<float>(degree);
+    *frequency = std::sqrt(STIFFNESS * (l - 1.0f) * (l + 1.0f) * (l + 2.0f) / (radius * radius * radius));
+    *decay     = VISCOSITY * (l - 1.0f) * (2.0f * l + 1.0f) / (radius * radius);
+}
+
+void Harmonics::Poke(BubbleHandle handle, float radius, glm::vec3 direction, float strength)
+{
+    float length = glm::length(direction);
+    if ( length <= 0.0f || radius <= 0.0f || handle.index < 0 )
+        return;
+
+    if ( handle.index >= static_cast<int>(slots.size()) )
+        slots.resize(handle.index + 1, -1);
+
+    // A popped bubble's slot may have been handed on, in which case its wobble goes with it
+    int entry = slots[handle.index];
+    if ( entry == -1 || active[entry].handle.generation != handle.generation )
+    {
+        if ( entry == -1 )
+        {
+            entry = static_cast<int>(active.size());
+            active.emplace_back();
+            slots[handle.index] = entry;
+        }
+
+        Wobble& wobble = active[entry];
+        wobble.handle = handle;
+        std::fill(std::begin(wobble.shape), std::end(wobble.shape), 0.0f);
+        std::fill(std::begin(wobble.speed), std::end(wobble.speed), 0.0f);
+    }
+
+    // A push at one point is a spike, which every mode gets its own share of
+    Wobble& wobble = active[entry];
+    wobble.radius  = radius;
+
+    float basis[MODES];
+    Basis(direction / length, basis);
+    for (int m = 0; m < MODES; m++)
+        wobble.speed[m] -= KICK * strength * basis[m];
+
+    Amplitude(wobble);
+}
+
+void Harmonics::Step(float dt)
+{
+    if ( dt <= 0.0f )
+        return;
+
+    for (size_t i = 0; i < active.size(); )
+    {
+        Wobble& wobble = active[i];
+        int m = 0;
+        for (int degree = 2; degree <= MAX_DEGREE; degree++)
+        {
+            float frequency, decay;
+            Rates(degree, wobble.radius, &frequency, &decay);
+
+            // Underdamped modes turn on a shrinking circle, which is exact for any step; the rest creep back
+            float fade = std::exp(-decay * dt);
+            float ring = frequency * frequency - decay * decay;
+            float damped = ring > 0.0f ? std::sqrt(ring) : 0.0f;
+            float cosine = std::cos(damped * dt), sine = std::sin(damped * dt);
+
+            for (int end = m + 2 * degree + 1; m < end; m++)
+            {
+                float c = wobble.shape[m], v = wobble.speed[m];
+                if ( damped > 0.0f )
+                {
+                    wobble.shape[m] = fade * (c * cosine + (v + decay * c) / damped * sine);
+                    wobble.speed[m] = fade * (v * cosine - (frequency * frequency * c + decay * v) / damped * sine);
+                }
+                else
+                {
+                    wobble.speed[m] = (v - frequency * frequency * c * dt) / (1.0f + 2.0f * decay * dt + frequency * frequency * dt * dt);
+                    wobble.shape[m] = c + wobble.speed[m] * dt;
+                }
+            }
+        }
+
+        if ( Amplitude(wobble) >= AT_REST )
+        {
+            i++;
+            continue;
+        }
+
+        // Round again, so the last entry takes its place
+        slots[wobble.handle.index] = -1;
+        if ( i + 1 < active.size() )
+        {
+            wobble = active.back();
+            slots[wobble.handle.index] = static_cast<int>(i);
+        }
+        active.pop_back();
+    }
+}
+
+float Harmonics::Amplitude(Wobble& wobble)
+{
+    // The modes of one degree can add up to at most sqrt((2 l + 1) / 4 pi) times their length anywhere, and a mode
+    // that's moving swings out to its coefficient and its speed over the frequency together
+    float reach = 0.0f;
+    int m = 0;
+    for (int degree = 2; degree <= MAX_DEGREE; degree++)
+    {
+        float frequency, decay;
+        Rates(degree, wobble.radius, &frequency, &decay);
+
+        float energy = 0.0f;
+        for (int end = m + 2 * degree + 1; m < end; m++)
+        {
+            float speed = wobble.speed[m] / frequency;
+            energy += wobble.shape[m] * wobble.shape[m] + speed * speed;
+        }
+        reach += std::sqrt((2.0f * degree + 1.0f) / (4.0f * PI) * energy);
+    }
+
+    if ( reach <= MAX_DENT )
+        return reach;
+
+    float scale = MAX_DENT / reach;
+    for (int m = 0; m < MODES; m++)
+    {
+        wobble.shape[m] *= scale;
+        wobble.speed[m] *= scale;
+    }
+    return MAX_DENT;
+}
+
+const float* Harmonics::Find(BubbleHandle handle) const
+{
+    if ( handle.index < 0 || handle.index >= static_cast<int>(slots.size()) || slots[handle.index] == -1 )
+        return NULL;
+
+    const Wobble& wobble = active[slots[handle.index]];
+    return wobble.handle.generation == handle.generation ? wobble.shape : NULL;
+}
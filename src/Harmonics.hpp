@@ -0,0 +1,98 @@
+#ifndef HARMONICS
+#define HARMONICS
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "Simulation.hpp"
+
+/**
+ *  The wobble of every bubble as a sum of real spherical harmonics, from degree 2 up to MAX_DEGREE.
+ *  A bubble's surface sits at r (1 + sum_lm c_lm Y_lm(n)) along every direction n of the shared sphere mesh, so its
+ *  whole shape is a handful of coefficients: the soap vertex shader evaluates the sum, and nothing but the
+ *  coefficients is uploaded per bubble. Degree 0 would change the volume and degree 1 would move the bubble, so
+ *  both are left out.
+ *  Every mode rings on its own as a damped oscillator with Lamb's frequency, w_l^2 = STIFFNESS (l - 1)(l + 1)(l + 2)
+ *  / r^3, and a viscous decay of VISCOSITY (l - 1)(2 l + 1) / r^2; the step is exact, so small stiff bubbles need no
+ *  substeps. Pokes kick the modes at the point of impact. Only bubbles that were poked are stored, keyed by
+ *  handle, and they're dropped again once they've rung down.
+ */
+class Harmonics
+{
+    public:
+        Harmonics();
+
+        /** Copying would duplicate every bubble's modes, so it's deleted. */
+        Harmonics(const Harmonics&) = delete;
+        Harmonics& operator=(const Harmonics&) = delete;
+
+        ~Harmonics() { };
+
+        /**
+         *  Kicks a bubble's modes with an inward push at a point on its surface.
+         *  @param handle    - The bubble that was hit.
+         *  @param radius    - The radius of the bubble, which sets how fast it rings.
+         *  @param direction - The direction of the impact point from the bubble's center, in the mesh's model space.
+         *  @param strength  - The speed the surface is pushed in with.
+         */
+        void Poke(BubbleHandle handle, float radius, glm::vec3 direction, float strength);
+
+        /**
+         *  Rings every wobbling bubble on for a while and forgets the ones that came to rest.
+         *  @param dt - The time that has passed in seconds.
+         */
+        void Step(float dt);
+
+        /**
+         *  Finds the coefficients of a bubble, in the order Basis evaluates the harmonics and padded to STRIDE.
+         *  @param handle - The bubble to look up.
+         *  @return The coefficients, or NULL if the bubble is round.
+         */
+        const float* Find(BubbleHandle handle) const;
+
+        /** Gets the number of bubbles that are wobbling. */
+        int GetActiveCount() const { return static_cast<int>(active.size()); };
+
+        /**
+         *  Evaluates every harmonic of the shape in one direction; matches the soap vertex shader.
+         *  @param n     - The unit direction.
+         *  @param basis - Receives MODES values.
+         */
+        static void Basis(glm::vec3 n, float* basis);
+
+        static const int MAX_DEGREE = 4;                                        // Highest degree of the modes.
+        static const int MODES      = (MAX_DEGREE + 1) * (MAX_DEGREE + 1) - 4;  // Modes of degree 2 and up.
+        static const int STRIDE     = (MODES + 3) / 4 * 4;                      // Floats per bubble, whole vec4s.
+
+        static constexpr float STIFFNESS = 1.5f;   // Surface tension over density; sets the ringing frequencies.
+        static constexpr float VISCOSITY = 0.1f;   // Kinematic viscosity; sets how fast the ringing dies down.
+        static constexpr float KICK      = 2.0f;   // Mode speed per unit of poke strength.
+        static constexpr float MAX_DENT  = 0.35f;  // Furthest the surface may move, as a fraction of the radius.
+        static constexpr float AT_REST   = 1e-4f;  // Amplitude below which a bubble counts as round again.
+
+    private:
+        /** The modes of one wobbling bubble. */
+        struct Wobble
+        {
+            BubbleHandle handle;  // The bubble.
+            float radius;         // Its radius.
+            float shape[STRIDE];  // Coefficient of every mode, zero past MODES.
+            float speed[MODES];   // Rate of change of every coefficient.
+        };
+
+        /** Gets the ringing frequency and decay rate of the modes of one degree. */
+        static void Rates(int degree, float radius, float* frequency, float* decay);
+
+        /**
+         *  Scales a bubble's modes down so the surface can't swing further than MAX_DENT, even at the top of a swing.
+         *  @return The furthest the surface can still swing, as a fraction of the radius.
+         */
+        static float Amplitude(Wobble& wobble);
+
+        std::vector<Wobble> active; // Bubbles that are wobbling, in no particular order.
+        std::vector<int>    slots;  // Entry in active of every handle slot, or -1.
+};
+
+#endif
@@ -0,0 +1,193 @@
+#include "JobSystem.hpp"
+
+#include <algorithm>
+
+namespace
+{
+    // The job system and queue the current thread works for; outside threads share the last queue
+    thread_local const JobSystem* currentSystem = NULL;
+    thread_local int              currentQueue  = -1;
+}
+
+JobSystem::JobSystem(int threads)
+{
+    if ( threads <= 0 )
+        threads = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+
+    running = true;
+    queued  = 0;
+
+    // One queue per worker plus one for the threads that call in from outside
+    for (int i = 0; i < threads; i++)
+        queues.push_back(std::unique_ptr<Queue>(new Queue()));
+
+    for (int i = 0; i < threads - 1; i++)
+        workers.push_back(std::thread(&JobSystem::WorkerLoop, this, i));
+}
+
+JobSystem::~JobSystem()
+{
+    // Help run whatever is still queued, so every counter reaches zero and every continuation gets released
+    JobTask task;
+    while ( queued.load() > 0 )
+    {
+        if ( Pop(task) )
+            Execute(task);
+        else
+            std::this_thread::yield();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        running = false;
+    }
+    wake.notify_all();
+
+    for (std::thread& worker : workers)
+        worker.join();
+}
+
+void JobSystem::Run(std::function<void()> job, JobCounter* counter)
+{
+    if ( counter != NULL )
+        counter->count.fetch_add(1, std::memory_order_relaxed);
+
+    Push({ std::move(job), counter });
+}
+
+void JobSystem::RunAfter(JobCounter& dependency, std::function<void()> job, JobCounter* counter)
+{
+    if ( counter != NULL )
+        counter->count.fetch_add(1, std::memory_order_relaxed);
+
+    {
+        std::lock_guard<std::mutex> lock(dependency.mutex);
+        if ( !dependency.Done() )
+        {
+            dependency.continuations.push_back({ std::move(job), counter });
+            return;
+        }
+    }
+
+    Push({ std::move(job), counter });
+}
+
+void JobSystem::Wait(JobCounter& counter)
+{
+    // Help out instead of blocking, so waiting inside a job can't starve the pool
+    JobTask task;
+    while ( !counter.Done() )
+    {
+        if ( Pop(task) )
+            Execute(task);
+        else
+            std::this_thread::yield();
+    }
+
+    // The last Finish may still hold the lock; once we get it the counter is safe to destroy
+    std::lock_guard<std::mutex> lock(counter.mutex);
+}
+
+int JobSystem::QueueIndex() const
+{
+    return ( currentSystem == this ) ? currentQueue : static_cast<int>(queues.size()) - 1;
+}
+
+void JobSystem::Push(JobTask task)
+{
+    Queue& queue = *queues[QueueIndex()];
+    {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.jobs.push_back(std::move(task));
+    }
+    queued.fetch_add(1, std::memory_order_release);
+
+    // Taking the lock orders this with a worker that is about to go to sleep
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+    }
+    wake.notify_one();
+}
+
+bool JobSystem::Pop(JobTask& task)
+{
+    if ( queued.load(std::memory_order_acquire) == 0 )
+        return false;
+
+    int count = static_cast<int>(queues.size());
+    int own   = QueueIndex();
+
+    // Newest job of our own queue first
+    {
+        Queue& queue = *queues[own];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if ( !queue.jobs.empty() )
+        {
+            task = std::move(queue.jobs.back());
+            queue.jobs.pop_back();
+            queued.fetch_sub(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+
+    // Then the oldest (usually biggest) job of someone else's
+    for (int i = 1; i < count; i++)
+    {
+        Queue& queue = *queues[(own + i) % count];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if ( !queue.jobs.empty() )
+        {
+            task = std::move(queue.jobs.front());
+            queue.jobs.pop_front();
+            queued.fetch_sub(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void JobSystem::Execute(JobTask& task)
+{
+    task.work();
+    task.work = nullptr;
+
+    if ( task.counter != NULL )
+        Finish(task.counter);
+}
+
+void JobSystem::Finish(JobCounter* counter)
+{
+    // Decrement under the lock so RunAfter can't attach a job between the last decrement and the release
+    std::vector<JobTask> released;
+    {
+        std::lock_guard<std::mutex> lock(counter->mutex);
+        if ( counter->count.fetch_sub(1, std::memory_order_acq_rel) == 1 )
+            released.swap(counter->continuations);
+    }
+
+    for (JobTask& task : released)
+        Push(std::move(task));
+}
+
+void JobSystem::WorkerLoop(int index)
+{
+    currentSystem = this;
+    currentQueue  = index;
+
+    // A job still running when the system stops may release continuations, so workers leave once the queues are empty
+    JobTask task;
+    while ( true )
+    {
+        if ( Pop(task) )
+        {
+            Execute(task);
+            continue;
+        }
+        if ( !running && queued.load() == 0 )
+            break;
+
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        wake.wait(lock, [this]() { return queued.load() > 0 || !running; });
+    }
+}
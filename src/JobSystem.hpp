@@ -0,0 +1,159 @@
+#ifndef JOBSYSTEM
+#define JOBSYSTEM
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class JobCounter;
+
+/** A unit of work along with the counter it reports to. */
+struct JobTask
+{
+    std::function<void()> work;    // The work to run.
+    JobCounter*           counter; // Decremented after the work has run, may be NULL.
+};
+
+/**
+ *  Counts unfinished jobs. Jobs can be made to wait on a counter, which starts them once it reaches zero.
+ */
+class JobCounter
+{
+    public:
+        JobCounter() { count = 0; };
+
+        JobCounter(const JobCounter&) = delete;
+        JobCounter& operator=(const JobCounter&) = delete;
+
+        /** Checks whether every job attached to this counter has finished. */
+        bool Done() const { return count.load(std::memory_order_acquire) == 0; };
+
+    private:
+        friend class JobSystem;
+
+        std::atomic<int> count;              // Unfinished jobs.
+        std::mutex mutex;                    // Guards continuations.
+        std::vector<JobTask> continuations;  // Jobs released when count reaches zero.
+};
+
+/**
+ *  A work-stealing thread pool.
+ *  Every worker owns a deque: it pushes and pops its own jobs at the back (depth first, cache friendly) and
+ *  steals from the front of the others when it runs dry. Threads that Wait() on a counter keep running jobs
+ *  instead of blocking, which makes nested fork/join safe.
+ */
+class JobSystem
+{
+    public:
+        /**
+         *  Starts the worker threads.
+         *  @param threads - The total number of threads doing work, including the ones calling Wait().
+         *                   Zero picks the number of hardware threads.
+         */
+        JobSystem(int threads = 0);
+
+        JobSystem(const JobSystem&) = delete;
+        JobSystem& operator=(const JobSystem&) = delete;
+
+        /** Finishes the queued jobs, and any continuations they release, then joins the workers. */
+        ~JobSystem();
+
+        /**
+         *  Queues a job.
+         *  @param job     - The work to run.
+         *  @param counter - Incremented now and decremented when the job finishes; may be NULL.
+         */
+        void Run(std::function<void()> job, JobCounter* counter);
+
+        /**
+         *  Queues a job that only starts once another counter has reached zero.
+         *  @param dependency - The counter to wait for.
+         *  @param job        - The work to run.
+         *  @param counter    - Incremented now and decremented when the job finishes; may be NULL.
+         */
+        void RunAfter(JobCounter& dependency, std::function<void()> job, JobCounter* counter);
+
+        /**
+         *  Runs jobs on the calling thread until the counter reaches zero.
+         *  @param counter - The counter to wait for.
+         */
+        void Wait(JobCounter& counter);
+
+        /**
+         *  Splits [begin, end) into chunks and runs them in parallel, returning once all are done.
+         *  @param begin - The first index.
+         *  @param end   - One past the last index.
+         *  @param grain - The largest chunk run as a single job.
+         *  @param body  - Called as body(int start, int end) for each chunk.
+         */
+        template <typename Body>
+        void ParallelFor(int begin, int end, int grain, const Body& body)
+        {
+            if ( end - begin <= grain || GetThreadCount() == 1 )
+            {
+                if ( begin < end )
+                    body(begin, end);
+                return;
+            }
+
+            JobCounter counter;
+            Split(begin, end, grain, body, counter);
+            Wait(counter);
+        };
+
+        /** Gets the number of threads doing work, including the caller of Wait(). */
+        int GetThreadCount() const { return static_cast<int>(workers.size()) + 1; };
+
+    private:
+        /** A worker's job deque; owners use the back, thieves the front. */
+        struct Queue
+        {
+            std::mutex          mutex;
+            std::deque<JobTask> jobs;
+        };
+
+        /** Recursively halves a range, queueing one half and keeping the other, until it's small enough. */
+        template <typename Body>
+        void Split(int begin, int end, int grain, const Body& body, JobCounter& counter)
+        {
+            while ( end - begin > grain )
+            {
+                int mid = begin + (end - begin) / 2;
+                Run([this, mid, end, grain, &body, &counter]() { Split(mid, end, grain, body, counter); }, &counter);
+                end = mid;
+            }
+            body(begin, end);
+        };
+
+        /** Pushes a job onto the calling thread's deque and wakes a sleeping worker. */
+        void Push(JobTask task);
+
+        /** Takes a job from the calling thread's deque, or steals one from another. */
+        bool Pop(JobTask& task);
+
+        /** Runs a job and releases its counter. */
+        void Execute(JobTask& task);
+
+        /** Decrements a counter and queues its continuations once it reaches zero. */
+        void Finish(JobCounter* counter);
+
+        /** The worker threads' main loop. */
+        void WorkerLoop(int index);
+
+        /** Gets the queue used by the calling thread. */
+        int QueueIndex() const;
+
+        std::vector<std::unique_ptr<Queue>> queues; // One per worker, plus a shared one for outside threads.
+        std::vector<std::thread> workers;           // The worker threads.
+        std::atomic<bool> running;                  // Cleared to stop the workers.
+        std::atomic<int>  queued;                   // Jobs sitting in the queues.
+        std::mutex sleepMutex;                      // Guards sleeping workers.
+        std::condition_variable wake;               // Signalled when jobs are queued.
+};
+
+#endif
@@ -0,0 +1,397 @@
+#include "KMeans.hpp"
+
+#include <cmath>
+#include <numeric>
+#include <random>
+
+#include "Centroid.hpp"
+
+KMeans::KMeans()
+{
+    inertia    = 0.0;
+    miniBatch  = 0;
+    iterations = 100;
+    jobs       = NULL;
+}
+
+int KMeans::Fit(const PointBatch& points, int k, unsigned int seed)
+{
+    int n = points.GetCount();
+    cx.clear();
+    cy.clear();
+    cz.clear();
+    labels.clear();
+    balls.clear();
+    inertia = 0.0;
+    if ( n == 0 || k <= 0 )
+        return 0;
+
+    std::mt19937 random(seed);
+    std::vector<Partial> sums;
+    int ran = 0;
+
+    if ( miniBatch == 0 )
+    {
+        Seed(points, k, seed);
+
+        // Lloyd's iterations, until no point changes cluster and no empty cluster had to be moved
+        labels.assign(n, -1);
+        for (ran = 1; ran <= iterations; ran++)
+        {
+            int changed = Assign(points, labels.data(), sums, &inertia);
+            int moved   = Reseed(points, sums);
+            for (int c = 0; c < GetClusterCount(); c++)
+            {
+                if ( sums[c].count == 0 )
+                    continue;
+                cx[c] = static_cast<float>(sums[c].sum[0] / sums[c].count);
+                cy[c] = static_cast<float>(sums[c].sum[1] / sums[c].count);
+                cz[c] = static_cast<float>(sums[c].sum[2] / sums[c].count);
+            }
+            if ( changed == 0 && moved == 0 )
+                break;
+        }
+        ran = std::min(ran, iterations);
+        Compact(sums);
+    }
+    else
+    {
+        // Seed from a random sample, so seeding doesn't sweep the whole cloud k times
+        const float* x = points.GetX();
+        const float* y = points.GetY();
+        const float* z = points.GetZ();
+        int size = std::min(n, std::max(miniBatch, SEED_SAMPLE));
+        std::vector<float> sample(static_cast<size_t>(size) * 3);
+        for (int j = 0; j < size; j++)
+        {
+            int i = size == n ? j : static_cast<int>(random() % n);
+            sample[j]            = x[i];
+            sample[size + j]     = y[i];
+            sample[2 * size + j] = z[i];
+        }
+
+        PointBatch batch;
+        batch.SetKernels(points.GetKernels());
+        batch.View(sample.data(), sample.data() + size, sample.data() + 2 * size, size);
+        Seed(batch, k, seed);
+
+        // Each center is the running mean of every batch point it was handed, so it moves less as it settles
+        size = std::min(n, miniBatch);
+        sample.resize(static_cast<size_t>(size) * 3);
+        batch.View(sample.data(), sample.data() + size, sample.data() + 2 * size, size);
+        std::vector<double> seen(GetClusterCount(), 0.0);
+        for (ran = 1; ran <= iterations; ran++)
+        {
+            for (int j = 0; j < size; j++)
+            {
+                int i = static_cast<int>(random() % n);
+                sample[j]            = x[i];
+                sample[size + j]     = y[i];
+                sample[2 * size + j] = z[i];
+            }
+
+            double error;
+            Assign(batch, NULL, sums, &error);
+
+            double shift = 0.0;
+            for (int c = 0; c < GetClusterCount(); c++)
+            {
+                if ( sums[c].count == 0 )
+                    continue;
+                seen[c] += sums[c].count;
+                double dx = (sums[c].sum[0] - sums[c].count * static_cast<double>(cx[c])) / seen[c];
+                double dy = (sums[c].sum[1] - sums[c].count * static_cast<double>(cy[c])) / seen[c];
+                double dz = (sums[c].sum[2] - sums[c].count * static_cast<double>(cz[c])) / seen[c];
+                cx[c] = static_cast<float>(cx[c] + dx);
+                cy[c] = static_cast<float>(cy[c] + dy);
+                cz[c] = static_cast<float>(cz[c] + dz);
+                shift = std::max(shift, dx * dx + dy * dy + dz * dz);
+            }
+
+            // Settled once the furthest move is small next to the batch's mean squared distance from its centers
+            if ( shift <= static_cast<double>(TOLERANCE) * TOLERANCE * error / size )
+                break;
+        }
+        ran = std::min(ran, iterations);
+
+        // One full pass labels every point; clusters no point ended up nearest to are dropped
+        labels.assign(n, -1);
+        Assign(points, labels.data(), sums, &inertia);
+        Compact(sums);
+    }
+
+    Enclose(points);
+    return ran;
+}
+
+void KMeans::Seed(const PointBatch& points, int k, unsigned int seed)
+{
+    int n      = points.GetCount();
+    int blocks = (n + BLOCK - 1) / BLOCK;
+    int trials = 2 + static_cast<int>(std::log(static_cast<double>(k)));
+    const float* x = points.GetX();
+    const float* y = points.GetY();
+    const float* z = points.GetZ();
+
+    std::mt19937 random(seed);
+    std::vector<double> weights(blocks);
+    std::vector<double> potentials(static_cast<size_t>(blocks) * trials);
+    std::vector<int>    picks(trials);
+    std::vector<float>  tx(trials), ty(trials), tz(trials);
+    sqDist.assign(n, HUGE_VALF);
+
+    // Draws a point with odds in proportion to its squared distance from the centers; points on a center can't be drawn
+    auto draw = [&](double total)
+    {
+        double target = std::uniform_real_distribution<double>(0.0, total)(random);
+        int b = 0;
+        while ( b < blocks - 1 && (target >= weights[b] || weights[b] == 0.0) )
+            target -= weights[b++];
+
+        int picked = -1;
+        for (int i = b * BLOCK; i < std::min(n, (b + 1) * BLOCK); i++)
+        {
+            if ( sqDist[i] <= 0.0f )
+                continue;
+            picked  = i;
+            target -= sqDist[i];
+            if ( target < 0.0 )
+                break;
+        }
+        return picked;
+    };
+
+    int next = static_cast<int>(random() % n);
+    while ( true )
+    {
+        cx.push_back(x[next]);
+        cy.push_back(y[next]);
+        cz.push_back(z[next]);
+        if ( GetClusterCount() == k )
+            break;
+
+        // Every point's squared distance from the nearest center so far, summed per block
+        int c = GetClusterCount() - 1;
+        ForBlocks(n, [&](int b, int begin, int end)
+        {
+            int   label[CHUNK];
+            float sq[CHUNK];
+            double weight = 0.0;
+            for (int s = begin; s < end; s += CHUNK)
+            {
+                int e = std::min(end, s + CHUNK);
+                points.Nearest(&cx[c], &cy[c], &cz[c], 1, s, e, label, sq);
+                for (int i = s; i < e; i++)
+                {
+                    sqDist[i] = std::min(sqDist[i], sq[i - s]);
+                    weight   += sqDist[i];
+                }
+            }
+            weights[b] = weight;
+        });
+
+        double total = std::accumulate(weights.begin(), weights.end(), 0.0);
+        if ( !(total > 0.0) )
+            break;
+
+        // Greedy k-means++: draw a few candidates and keep the one that leaves the points closest to a center
+        for (int t = 0; t < trials; t++)
+        {
+            picks[t] = draw(total);
+            if ( picks[t] < 0 )
+                return;
+            tx[t] = x[picks[t]];
+            ty[t] = y[picks[t]];
+            tz[t] = z[picks[t]];
+        }
+
+        ForBlocks(n, [&](int b, int begin, int end)
+        {
+            int   label[CHUNK];
+            float sq[CHUNK];
+            double* potential = &potentials[static_cast<size_t>(b) * trials];
+            std::fill(potential, potential + trials, 0.0);
+            for (int s = begin; s < end; s += CHUNK)
+            {
+                int e = std::min(end, s + CHUNK);
+                for (int t = 0; t < trials; t++)
+                {
+                    points.Nearest(&tx[t], &ty[t], &tz[t], 1, s, e, label, sq);
+                    for (int i = s; i < e; i++)
+                        potential[t] += std::min(sqDist[i], sq[i - s]);
+                }
+            }
+        });
+
+        int    best  = 0;
+        double least = HUGE_VAL;
+        for (int t = 0; t < trials; t++)
+        {
+            double potential = 0.0;
+            for (int b = 0; b < blocks; b++)
+                potential += potentials[static_cast<size_t>(b) * trials + t];
+            if ( potential < least )
+            {
+                least = potential;
+                best  = t;
+            }
+        }
+        next = picks[best];
+    }
+}
+
+int KMeans::Assign(const PointBatch& points, int* labels, std::vector<Partial>& sums, double* error)
+{
+    int n      = points.GetCount();
+    int k      = GetClusterCount();
+    int blocks = (n + BLOCK - 1) / BLOCK;
+    const float* x = points.GetX();
+    const float* y = points.GetY();
+    const float* z = points.GetZ();
+
+    partials.assign(static_cast<size_t>(blocks) * k, Partial{ { 0.0, 0.0, 0.0 }, 0 });
+    changes.assign(blocks, 0);
+    errors.assign(blocks, 0.0);
+    sqDist.resize(n);
+
+    ForBlocks(n, [&](int b, int begin, int end)
+    {
+        Partial* partial = &partials[static_cast<size_t>(b) * k];
+        int    label[CHUNK];
+        int    changed = 0;
+        double sum     = 0.0;
+        for (int s = begin; s < end; s += CHUNK)
+        {
+            int e = std::min(end, s + CHUNK);
+            points.Nearest(cx.data(), cy.data(), cz.data(), k, s, e, label, &sqDist[s]);
+            for (int i = s; i < e; i++)
+            {
+                int c = label[i - s];
+                if ( labels != NULL && labels[i] != c )
+                {
+                    labels[i] = c;
+                    changed++;
+                }
+                partial[c].sum[0] += x[i];
+                partial[c].sum[1] += y[i];
+                partial[c].sum[2] += z[i];
+                partial[c].count++;
+                sum += sqDist[i];
+            }
+        }
+        changes[b] = changed;
+        errors[b]  = sum;
+    });
+
+    // Blocks are added up in order, so the sums don't depend on which thread ran which block
+    sums.assign(k, Partial{ { 0.0, 0.0, 0.0 }, 0 });
+    for (int b = 0; b < blocks; b++)
+    {
+        for (int c = 0; c < k; c++)
+        {
+            const Partial& partial = partials[static_cast<size_t>(b) * k + c];
+            for (int a = 0; a < 3; a++)
+                sums[c].sum[a] += partial.sum[a];
+            sums[c].count += partial.count;
+        }
+    }
+
+    *error = std::accumulate(errors.begin(), errors.end(), 0.0);
+    return std::accumulate(changes.begin(), changes.end(), 0);
+}
+
+int KMeans::Reseed(const PointBatch& points, const std::vector<Partial>& sums)
+{
+    std::vector<int> empty;
+    for (int c = 0; c < GetClusterCount(); c++)
+        if ( sums[c].count == 0 )
+            empty.push_back(c);
+    if ( empty.empty() )
+        return 0;
+
+    // The points furthest from their centers, one per empty cluster, furthest first
+    int n = points.GetCount();
+    int m = std::min(static_cast<int>(empty.size()), n);
+    std::vector<int> order(n);
+    std::iota(order.begin(), order.end(), 0);
+    std::partial_sort(order.begin(), order.begin() + m, order.end(), [&](int a, int b)
+    {
+        return sqDist[a] > sqDist[b] || (sqDist[a] == sqDist[b] && a < b);
+    });
+
+    for (int j = 0; j < m; j++)
+    {
+        cx[empty[j]] = points.GetX()[order[j]];
+        cy[empty[j]] = points.GetY()[order[j]];
+        cz[empty[j]] = points.GetZ()[order[j]];
+    }
+    return m;
+}
+
+void KMeans::Compact(const std::vector<Partial>& sums)
+{
+    std::vector<int> remap(GetClusterCount(), -1);
+    int kept = 0;
+    for (int c = 0; c < GetClusterCount(); c++)
+    {
+        if ( sums[c].count == 0 )
+            continue;
+        remap[c] = kept;
+        cx[kept] = cx[c];
+        cy[kept] = cy[c];
+        cz[kept] = cz[c];
+        kept++;
+    }
+    if ( kept == GetClusterCount() )
+        return;
+
+    cx.resize(kept);
+    cy.resize(kept);
+    cz.resize(kept);
+    for (int& label : labels)
+        label = remap[label];
+}
+
+void KMeans::Enclose(const PointBatch& points)
+{
+    int n = points.GetCount();
+    int k = GetClusterCount();
+    const float* x = points.GetX();
+    const float* y = points.GetY();
+    const float* z = points.GetZ();
+
+    // Sort the points by cluster, so every cluster's coordinates lie together for MinimumBall
+    std::vector<int> offsets(k + 1, 0);
+    for (int i = 0; i < n; i++)
+        offsets[labels[i] + 1]++;
+    std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+
+    std::vector<float> sorted(static_cast<size_t>(n) * 3);
+    float* sx = sorted.data();
+    float* sy = sx + n;
+    float* sz = sy + n;
+    std::vector<int> cursor(offsets.begin(), offsets.end() - 1);
+    for (int i = 0; i < n; i++)
+    {
+        int at = cursor[labels[i]]++;
+        sx[at] = x[i];
+        sy[at] = y[i];
+        sz[at] = z[i];
+    }
+
+    balls.resize(k);
+    auto fit = [&](int start, int end)
+    {
+        for (int c = start; c < end; c++)
+        {
+            int first = offsets[c], count = offsets[c + 1] - offsets[c];
+            MinimumBall ball(sx + first, sy + first, sz + first, count);
+            Point center = ball.GetCenter();
+            balls[c] = { { center.x, center.y, center.z }, ball.GetRadius(), count };
+        }
+    };
+    if ( jobs != NULL && k > 1 )
+        jobs->ParallelFor(0, k, 1, fit);
+    else
+        fit(0, k);
+}
@@ -0,0 +1,152 @@
+#ifndef KMEANS
+#define KMEANS
+
+#include <algorithm>
+#include <array>
+#include <vector>
+
+#include "JobSystem.hpp"
+#include "PointBatch.hpp"
+
+/**
+ *  Splits a point cloud into k clusters with k-means, then fits the smallest sphere around each one, so a cloud
+ *  holding several clumps of points becomes several bubbles rather than one.
+ *  Centers are seeded with greedy k-means++: a few candidates are drawn with odds in proportion to their squared
+ *  distance from the centers already picked, and the one that leaves the points closest to a center is kept. Lloyd's iterations then assign every point to its nearest center with PointBatch's SIMD
+ *  kernels and move each center to the mean of its points, until no point changes cluster. Points are handled in
+ *  blocks, in parallel, and every block keeps its own partial sums, which are added up in block order, so the
+ *  clusters come out the same whatever the number of threads.
+ *  Mini-batch mode is for clouds too big to sweep over and over: every iteration only a random batch of points is
+ *  assigned, and each center moves toward the batch's points at a rate that falls with the points it has seen.
+ *  Seeding then works on a random sample, and only the final assignment reads the whole cloud.
+ *  A cluster that runs out of points is moved to the point furthest from its center.
+ */
+class KMeans
+{
+    public:
+        /** The smallest sphere around one cluster's points. */
+        struct Ball
+        {
+            std::array<float,3> center; // Center of the sphere.
+            float               radius; // Radius of the sphere, zero for a single point.
+            int                 count;  // Points in the cluster.
+        };
+
+        KMeans();
+
+        /** Copying would duplicate a label per point, so it's deleted. */
+        KMeans(const KMeans&) = delete;
+        KMeans& operator=(const KMeans&) = delete;
+
+        ~KMeans() { };
+
+        /**
+         *  Clusters the points and fits a ball around every cluster.
+         *  @param points - The cloud; it has to stay as it is until Fit returns.
+         *  @param k      - The number of clusters wanted, cut down to the number of distinct points.
+         *  @param seed   - Seeds the choice of centers, and of batches in mini-batch mode.
+         *  @return The number of iterations run.
+         */
+        int Fit(const PointBatch& points, int k, unsigned int seed = 1u);
+
+        /**
+         *  Turns mini-batch mode on or off.
+         *  @param size - Points per batch, or 0 to run full Lloyd's iterations over every point.
+         */
+        void SetMiniBatch(int size) { miniBatch = size > 0 ? size : 0; };
+
+        /** Sets the most iterations Fit runs before it stops, converged or not. */
+        void SetIterations(int iterations) { this->iterations = iterations > 0 ? iterations : 1; };
+
+        /** Gets the number of clusters found. */
+        int GetClusterCount() const { return static_cast<int>(cx.size()); };
+
+        /** Gets the mean of a cluster, or its mini-batch estimate. */
+        std::array<float,3> GetCenter(int cluster) const { return { cx[cluster], cy[cluster], cz[cluster] }; };
+
+        /** Gets the cluster of every point. */
+        const std::vector<int>& GetLabels() const { return labels; };
+
+        /** Gets the ball around every cluster. */
+        const std::vector<Ball>& GetBalls() const { return balls; };
+
+        /** Gets the sum of the squared distances of the points from their centers. */
+        double GetInertia() const { return inertia; };
+
+        /**
+         *  Sets the job system used to assign points and fit balls in parallel.
+         *  @param jobs - The job system to use, or NULL to run on the calling thread.
+         */
+        void SetJobSystem(JobSystem* jobs) { this->jobs = jobs; };
+
+        static constexpr int   BLOCK       = 16384; // Points per job, each with its own partial sums.
+        static constexpr int   SEED_SAMPLE = 65536; // Points mini-batch mode seeds from.
+        static constexpr float TOLERANCE   = 1e-3f; // Mini-batch stops once no center moves this many typical spreads.
+
+    private:
+        /** The points that one block, or a whole pass, put in a cluster, summed. */
+        struct Partial
+        {
+            double sum[3]; // Sum of the points' coordinates.
+            int    count;  // Number of points.
+        };
+
+        /** Picks k centers from the points with k-means++, fewer if there aren't k distinct points. */
+        void Seed(const PointBatch& points, int k, unsigned int seed);
+
+        /**
+         *  Assigns every point to its nearest center, in parallel, and sums each cluster's points.
+         *  @param points - The points to assign.
+         *  @param labels - Holds the previous label of every point and receives the new one, or NULL to only sum them.
+         *  @param sums   - Receives the sums per cluster over every point.
+         *  @param error  - Receives the squared distances of the points from their centers, summed.
+         *  @return The number of points whose label changed.
+         */
+        int Assign(const PointBatch& points, int* labels, std::vector<Partial>& sums, double* error);
+
+        /**
+         *  Moves clusters that got no points to the points furthest from their centers in the last Assign.
+         *  @return The number of clusters moved.
+         */
+        int Reseed(const PointBatch& points, const std::vector<Partial>& sums);
+
+        /** Drops clusters no point was assigned to in the last Assign, relabelling the rest to match. */
+        void Compact(const std::vector<Partial>& sums);
+
+        /** Fits the ball around every cluster's points, in parallel. */
+        void Enclose(const PointBatch& points);
+
+        /** Splits n points into blocks and runs body(block, begin, end) on each, in parallel if there are jobs. */
+        template <typename Body>
+        void ForBlocks(int n, const Body& body)
+        {
+            int blocks = (n + BLOCK - 1) / BLOCK;
+            auto run = [&](int start, int end)
+            {
+                for (int b = start; b < end; b++)
+                    body(b, b * BLOCK, std::min(n, (b + 1) * BLOCK));
+            };
+            if ( jobs != NULL && blocks > 1 )
+                jobs->ParallelFor(0, blocks, 1, run);
+            else
+                run(0, blocks);
+        };
+
+        std::vector<float>   cx;         // X coordinate of every center.
+        std::vector<float>   cy;         // Y coordinate of every center.
+        std::vector<float>   cz;         // Z coordinate of every center.
+        std::vector<int>     labels;     // Cluster of every point.
+        std::vector<float>   sqDist;     // Squared distance of every point from its center.
+        std::vector<Partial> partials;   // Per block, per cluster sums from the last Assign.
+        std::vector<int>     changes;    // Labels changed per block in the last Assign.
+        std::vector<double>  errors;     // Squared distances summed per block in the last Assign.
+        std::vector<Ball>    balls;      // Ball around every cluster.
+        double     inertia;              // Squared distances summed over the last full assignment.
+        int        miniBatch;            // Points per batch, or 0 for full iterations.
+        int        iterations;           // Most iterations per Fit.
+        JobSystem* jobs;                 // Job system used for the passes, may be NULL.
+
+        static constexpr int CHUNK = 256; // Points a job hands the nearest center kernel at a time.
+};
+
+#endif
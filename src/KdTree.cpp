@@ -0,0 +1,343 @@
+#include "KdTree.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+/** Orders neighbours by distance, then by index, so ties come out the same every time. */
+static bool Closer(float aSq, int a, float bSq, int b)
+{
+    return aSq < bSq || (aSq == bSq && a < b);
+}
+
+/** Restores a max heap of neighbours, the furthest on top, after its top was replaced. */
+static void SiftDown(int* indices, float* sqDist, int size)
+{
+    int i = 0;
+    while ( true )
+    {
+        int largest = i;
+        for (int child = 2 * i + 1; child <= 2 * i + 2 && child < size; child++)
+            if ( Closer(sqDist[largest], indices[largest], sqDist[child], indices[child]) )
+                largest = child;
+        if ( largest == i )
+            return;
+        std::swap(indices[i], indices[largest]);
+        std::swap(sqDist[i], sqDist[largest]);
+        i = largest;
+    }
+}
+
+/** Restores a max heap of neighbours after one was added at the end. */
+static void SiftUp(int* indices, float* sqDist, int i)
+{
+    while ( i > 0 )
+    {
+        int parent = (i - 1) / 2;
+        if ( !Closer(sqDist[parent], indices[parent], sqDist[i], indices[i]) )
+            return;
+        std::swap(indices[i], indices[parent]);
+        std::swap(sqDist[i], sqDist[parent]);
+        i = parent;
+    }
+}
+
+KdTree::KdTree()
+{
+    count = 0;
+    depth = 0;
+    jobs  = NULL;
+}
+
+void KdTree::Build(const float* x, const float* y, const float* z, int n)
+{
+    count = std::max(0, n);
+    depth = 0;
+    while ( depth < MAX_DEPTH && (static_cast<int64_t>(BUCKET) << depth) < count )
+        depth++;
+
+    std::vector<Item> items(count);
+    for (int i = 0; i < count; i++)
+        items[i] = { { x[i], y[i], z[i] }, i };
+
+    // Split the top levels here until there are a few subtrees per thread, then split those in parallel
+    int threads   = jobs != NULL ? jobs->GetThreadCount() : 1;
+    int stopLevel = 0;
+    while ( stopLevel < depth && (1 << stopLevel) < threads * 4 )
+        stopLevel++;
+    if ( threads == 1 )
+        stopLevel = depth;
+
+    Split(items, 0, 0, stopLevel);
+    if ( stopLevel < depth )
+    {
+        int first = (1 << stopLevel) - 1;
+        jobs->ParallelFor(first, 2 * first + 1, 1, [&](int start, int end)
+        {
+            for (int node = start; node < end; node++)
+                Split(items, node, stopLevel, depth);
+        });
+    }
+
+    px.resize(count);
+    py.resize(count);
+    pz.resize(count);
+    ids.resize(count);
+    for (int i = 0; i < count; i++)
+    {
+        px[i]  = items[i].p[0];
+        py[i]  = items[i].p[1];
+        pz[i]  = items[i].p[2];
+        ids[i] = items[i].id;
+    }
+
+    // Boxes of the leaves from their points, then of every level above from the two below
+    int leaves = 1 << depth;
+    bounds.assign(static_cast<size_t>(2 * leaves - 1) * 6, 0.0f);
+    auto leafBoxes = [&](int start, int end)
+    {
+        for (int leaf = start; leaf < end; leaf++)
+        {
+            int node = leaves - 1 + leaf, begin, stop;
+            Range(node, depth, &begin, &stop);
+            float* box = &bounds[static_cast<size_t>(node) * 6];
+            box[0] = box[1] = box[2] =  HUGE_VALF;
+            box[3] = box[4] = box[5] = -HUGE_VALF;
+            for (int i = begin; i < stop; i++)
+            {
+                box[0] = std::min(box[0], px[i]);
+                box[1] = std::min(box[1], py[i]);
+                box[2] = std::min(box[2], pz[i]);
+                box[3] = std::max(box[3], px[i]);
+                box[4] = std::max(box[4], py[i]);
+                box[5] = std::max(box[5], pz[i]);
+            }
+        }
+    };
+    if ( jobs != NULL && leaves > 1 )
+        jobs->ParallelFor(0, leaves, 64, leafBoxes);
+    else
+        leafBoxes(0, leaves);
+
+    for (int node = leaves - 2; node >= 0; node--)
+    {
+        float*       box   = &bounds[static_cast<size_t>(node) * 6];
+        const float* left  = &bounds[static_cast<size_t>(2 * node + 1) * 6];
+        const float* right = &bounds[static_cast<size_t>(2 * node + 2) * 6];
+        for (int a = 0; a < 3; a++)
+        {
+            box[a]     = std::min(left[a], right[a]);
+            box[3 + a] = std::max(left[3 + a], right[3 + a]);
+        }
+    }
+}
+
+void KdTree::Split(std::vector<Item>& items, int node, int level, int stopLevel) const
+{
+    if ( level >= stopLevel )
+        return;
+
+    int begin, end;
+    Range(node, level, &begin, &end);
+    if ( end - begin > 1 )
+    {
+        // Split along the axis the points spread furthest on
+        float low[3]  = {  HUGE_VALF,  HUGE_VALF,  HUGE_VALF };
+        float high[3] = { -HUGE_VALF, -HUGE_VALF, -HUGE_VALF };
+        for (int i = begin; i < end; i++)
+        {
+            for (int a = 0; a < 3; a++)
+            {
+                low[a]  = std::min(low[a], items[i].p[a]);
+                high[a] = std::max(high[a], items[i].p[a]);
+            }
+        }
+        int axis = 0;
+        for (int a = 1; a < 3; a++)
+            if ( high[a] - low[a] > high[axis] - low[axis] )
+                axis = a;
+
+        int left, middle;
+        Range(2 * node + 1, level + 1, &left, &middle);
+        std::nth_element(items.begin() + begin, items.begin() + middle, items.begin() + end, [axis](const Item& a, const Item& b)
+        {
+            return a.p[axis] < b.p[axis];
+        });
+    }
+
+    Split(items, 2 * node + 1, level + 1, stopLevel);
+    Split(items, 2 * node + 2, level + 1, stopLevel);
+}
+
+int KdTree::Nearest(const float query[3], int k, int* indices, float* sqDist) const
+{
+    k = std::min(k, count);
+    if ( k <= 0 )
+        return 0;
+
+    // The neighbours found so far are kept as a max heap in the output, so the furthest one is always on top
+    std::vector<float> distances;
+    if ( sqDist == NULL )
+    {
+        distances.resize(k);
+        sqDist = distances.data();
+    }
+    int found = 0;
+
+    // Nodes waiting to be searched, with the squared distance to their boxes
+    struct Pending
+    {
+        int   node;
+        int   level;
+        float sq;
+    };
+    Pending stack[MAX_DEPTH + 2];
+    int top = 0;
+    stack[top++] = { 0, 0, BoxDistanceSq(0, query) };
+    while ( top > 0 )
+    {
+        Pending pending = stack[--top];
+        if ( found == k && pending.sq > sqDist[0] )
+            continue;
+
+        if ( pending.level == depth )
+        {
+            int begin, end;
+            Range(pending.node, pending.level, &begin, &end);
+            for (int i = begin; i < end; i++)
+            {
+                float dx = px[i] - query[0], dy = py[i] - query[1], dz = pz[i] - query[2];
+                float sq = dx * dx + dy * dy + dz * dz;
+                if ( found < k )
+                {
+                    indices[found] = ids[i];
+                    sqDist[found]  = sq;
+                    SiftUp(indices, sqDist, found++);
+                }
+                else if ( Closer(sq, ids[i], sqDist[0], indices[0]) )
+                {
+                    indices[0] = ids[i];
+                    sqDist[0]  = sq;
+                    SiftDown(indices, sqDist, k);
+                }
+            }
+            continue;
+        }
+
+        // The nearer child goes on top, so it's searched first and shrinks the bound the further one is tested with
+        Pending left  = { 2 * pending.node + 1, pending.level + 1, BoxDistanceSq(2 * pending.node + 1, query) };
+        Pending right = { 2 * pending.node + 2, pending.level + 1, BoxDistanceSq(2 * pending.node + 2, query) };
+        bool    first = left.sq <= right.sq;
+        if ( found < k || (first ? right.sq : left.sq) <= sqDist[0] )
+            stack[top++] = first ? right : left;
+        stack[top++] = first ? left : right;
+    }
+
+    // Pop the heap from the top, which leaves the neighbours nearest first
+    for (int size = found; size > 1; size--)
+    {
+        std::swap(indices[0], indices[size - 1]);
+        std::swap(sqDist[0], sqDist[size - 1]);
+        SiftDown(indices, sqDist, size - 1);
+    }
+    return found;
+}
+
+void KdTree::Radius(const float query[3], float radius, std::vector<int>& found) const
+{
+    found.clear();
+    if ( count == 0 || !(radius >= 0.0f) )
+        return;
+
+    float limit = radius * radius;
+    int stack[2 * MAX_DEPTH + 2][2];
+    int top = 0;
+    stack[top][0] = 0;
+    stack[top][1] = 0;
+    top++;
+    while ( top > 0 )
+    {
+        top--;
+        int node = stack[top][0], level = stack[top][1];
+        if ( BoxDistanceSq(node, query) > limit )
+            continue;
+
+        if ( level == depth )
+        {
+            int begin, end;
+            Range(node, level, &begin, &end);
+            for (int i = begin; i < end; i++)
+            {
+                float dx = px[i] - query[0], dy = py[i] - query[1], dz = pz[i] - query[2];
+                if ( dx * dx + dy * dy + dz * dz <= limit )
+                    found.push_back(ids[i]);
+            }
+            continue;
+        }
+
+        stack[top][0] = 2 * node + 2;
+        stack[top][1] = level + 1;
+        top++;
+        stack[top][0] = 2 * node + 1;
+        stack[top][1] = level + 1;
+        top++;
+    }
+
+    std::sort(found.begin(), found.end());
+}
+
+void KdTree::NearestBatch(const float* qx, const float* qy, const float* qz, int m, int k, int* indices, float* sqDist) const
+{
+    auto run = [&](int start, int end)
+    {
+        for (int q = start; q < end; q++)
+        {
+            float  query[3] = { qx[q], qy[q], qz[q] };
+            int*   slots    = indices + static_cast<size_t>(q) * k;
+            float* sq       = sqDist != NULL ? sqDist + static_cast<size_t>(q) * k : NULL;
+            int    found    = Nearest(query, k, slots, sq);
+            std::fill(slots + found, slots + k, -1);
+            if ( sq != NULL )
+                std::fill(sq + found, sq + k, HUGE_VALF);
+        }
+    };
+
+    if ( jobs != NULL && m > GRAIN )
+        jobs->ParallelFor(0, m, GRAIN, run);
+    else
+        run(0, m);
+}
+
+void KdTree::RadiusBatch(const float* qx, const float* qy, const float* qz, int m, float radius,
+                         std::vector<int>& offsets, std::vector<int>& found) const
+{
+    // Every block of queries collects its points on its own, then the blocks are joined in order
+    int blocks = (m + GRAIN - 1) / GRAIN;
+    std::vector<std::vector<int>> points(blocks);
+    offsets.assign(static_cast<size_t>(m) + 1, 0);
+    auto run = [&](int start, int end)
+    {
+        std::vector<int> near;
+        for (int b = start; b < end; b++)
+        {
+            for (int q = b * GRAIN; q < std::min(m, (b + 1) * GRAIN); q++)
+            {
+                float query[3] = { qx[q], qy[q], qz[q] };
+                Radius(query, radius, near);
+                points[b].insert(points[b].end(), near.begin(), near.end());
+                offsets[q + 1] = static_cast<int>(near.size());
+            }
+        }
+    };
+
+    if ( jobs != NULL && blocks > 1 )
+        jobs->ParallelFor(0, blocks, 1, run);
+    else
+        run(0, blocks);
+
+    for (int q = 0; q < m; q++)
+        offsets[q + 1] += offsets[q];
+    found.clear();
+    found.reserve(offsets[m]);
+    for (const std::vector<int>& block : points)
+        found.insert(found.end(), block.begin(), block.end());
+}
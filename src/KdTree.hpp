@@ -0,0 +1,141 @@
+#ifndef KDTREE
+#define KDTREE
+
+#include <cstdint>
+#include <vector>
+
+#include "JobSystem.hpp"
+#include "PointBatch.hpp"
+
+/**
+ *  A static k-d tree over a point cloud, for nearest neighbour and radius queries that only look at the few
+ *  buckets near the query instead of every point.
+ *  The layout is implicit: the tree is complete, node i has children 2i + 1 and 2i + 2, and the node at position j
+ *  of level l covers points [j n / 2^l, (j + 1) n / 2^l) of the sorted arrays, so nodes store nothing but their box.
+ *  Each inner node splits its points at the median along the axis they spread furthest on, and every leaf is a
+ *  bucket of at most BUCKET points scanned straight through. Points are kept as three coordinate arrays in tree
+ *  order, so a bucket's points sit together in memory.
+ *  The top levels are split on the calling thread, then the subtrees below them are built in parallel. Batched
+ *  queries run in parallel too, a block of queries per job.
+ */
+class KdTree
+{
+    public:
+        KdTree();
+
+        /** Copying would duplicate every point, so it's deleted. */
+        KdTree(const KdTree&) = delete;
+        KdTree& operator=(const KdTree&) = delete;
+
+        ~KdTree() { };
+
+        /**
+         *  Builds the tree over a copy of the points.
+         *  @param x, y, z - The coordinates of the points.
+         *  @param n       - The number of points.
+         */
+        void Build(const float* x, const float* y, const float* z, int n);
+
+        /** Builds the tree over a copy of a batch's points. */
+        void Build(const PointBatch& points) { Build(points.GetX(), points.GetY(), points.GetZ(), points.GetCount()); };
+
+        /**
+         *  Finds the points nearest to a query point.
+         *  @param query   - The x, y and z of the query.
+         *  @param k       - The number of neighbours wanted.
+         *  @param indices - Receives the indices of the neighbours as they were passed to Build, nearest first, the
+         *                   lower index first on a tie.
+         *  @param sqDist  - Receives the squared distance of each neighbour, if not NULL.
+         *  @return The number of neighbours found, k unless the tree has fewer points.
+         */
+        int Nearest(const float query[3], int k, int* indices, float* sqDist) const;
+
+        /**
+         *  Finds every point within a radius of a query point.
+         *  @param query  - The x, y and z of the query.
+         *  @param radius - The radius; points exactly on it are found.
+         *  @param found  - Receives the indices of the points in increasing order, replacing what it held.
+         */
+        void Radius(const float query[3], float radius, std::vector<int>& found) const;
+
+        /**
+         *  Finds the nearest points to many query points, in parallel.
+         *  @param qx, qy, qz - The coordinates of the queries.
+         *  @param m          - The number of queries.
+         *  @param k          - The number of neighbours wanted per query.
+         *  @param indices    - Receives k indices per query, nearest first, padded with -1 past the points found.
+         *  @param sqDist     - Receives k squared distances per query, padded with infinity, if not NULL.
+         */
+        void NearestBatch(const float* qx, const float* qy, const float* qz, int m, int k, int* indices, float* sqDist) const;
+
+        /**
+         *  Finds every point within a radius of many query points, in parallel.
+         *  @param qx, qy, qz - The coordinates of the queries.
+         *  @param m          - The number of queries.
+         *  @param radius     - The radius; points exactly on it are found.
+         *  @param offsets    - Receives m + 1 offsets; query q's points are found[offsets[q]] up to found[offsets[q + 1]].
+         *  @param found      - Receives the indices of every query's points, each query's in increasing order.
+         */
+        void RadiusBatch(const float* qx, const float* qy, const float* qz, int m, float radius,
+                         std::vector<int>& offsets, std::vector<int>& found) const;
+
+        /** Gets the number of points in the tree. */
+        int GetCount() const { return count; };
+
+        /** Gets the number of levels below the root; the leaves are all this deep. */
+        int GetDepth() const { return depth; };
+
+        /**
+         *  Sets the job system used to build the tree and run batched queries in parallel.
+         *  @param jobs - The job system to use, or NULL to run on the calling thread.
+         */
+        void SetJobSystem(JobSystem* jobs) { this->jobs = jobs; };
+
+        static const int BUCKET = 16;  // Most points in a leaf.
+        static const int GRAIN  = 256; // Queries per job in a batch.
+
+    private:
+        /** A point while the tree is built, kept together so partitioning moves one thing. */
+        struct Item
+        {
+            float p[3]; // Coordinates.
+            int   id;   // Index as it was passed to Build.
+        };
+
+        /** Gets the points a node on a level covers. */
+        void Range(int node, int level, int* begin, int* end) const
+        {
+            int64_t position = node - ((1 << level) - 1);
+            *begin = static_cast<int>((position * count) >> level);
+            *end   = static_cast<int>(((position + 1) * count) >> level);
+        };
+
+        /** Splits a node's items at their median, then its children's, down to the leaves. */
+        void Split(std::vector<Item>& items, int node, int level, int stopLevel) const;
+
+        /** Gets the squared distance from a point to a node's box, zero inside it. */
+        float BoxDistanceSq(int node, const float query[3]) const
+        {
+            const float* box = &bounds[static_cast<size_t>(node) * 6];
+            float sq = 0.0f;
+            for (int a = 0; a < 3; a++)
+            {
+                float d = query[a] < box[a] ? box[a] - query[a] : (query[a] > box[3 + a] ? query[a] - box[3 + a] : 0.0f);
+                sq += d * d;
+            }
+            return sq;
+        };
+
+        std::vector<float> px;     // X coordinate of every point, in tree order.
+        std::vector<float> py;     // Y coordinate of every point, in tree order.
+        std::vector<float> pz;     // Z coordinate of every point, in tree order.
+        std::vector<int>   ids;    // Index of every point as it was passed to Build, in tree order.
+        std::vector<float> bounds; // Box of every node, smallest x y z then largest x y z.
+        int        count;          // Number of points.
+        int        depth;          // Levels below the root.
+        JobSystem* jobs;           // Job system used for building and batches, may be NULL.
+
+        static const int MAX_DEPTH = 27; // Deepest a tree gets: an int's worth of points in buckets of BUCKET.
+};
+
+#endif
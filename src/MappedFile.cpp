@@ -0,0 +1,83 @@
+#include "MappedFile.hpp"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile()
+{
+    data    = NULL;
+    size    = 0;
+#ifdef _WIN32
+    file    = INVALID_HANDLE_VALUE;
+    mapping = NULL;
+#else
+    file    = -1;
+#endif
+}
+
+bool MappedFile::Open(const char* path)
+{
+    Close();
+
+#ifdef _WIN32
+    file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    LARGE_INTEGER length;
+    if ( file == INVALID_HANDLE_VALUE || !GetFileSizeEx(file, &length) || length.QuadPart == 0 )
+    {
+        Close();
+        return false;
+    }
+    size    = static_cast<size_t>(length.QuadPart);
+    mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    data    = mapping != NULL ? static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0)) : NULL;
+#else
+    file = open(path, O_RDONLY);
+    struct stat info;
+    if ( file < 0 || fstat(file, &info) != 0 || info.st_size == 0 )
+    {
+        Close();
+        return false;
+    }
+    size = static_cast<size_t>(info.st_size);
+    void* view = mmap(NULL, size, PROT_READ, MAP_PRIVATE, file, 0);
+    data = view != MAP_FAILED ? static_cast<const char*>(view) : NULL;
+    if ( data != NULL )
+        madvise(view, size, MADV_SEQUENTIAL);
+#endif
+    if ( data == NULL )
+    {
+        Close();
+        return false;
+    }
+    return true;
+}
+
+void MappedFile::Close()
+{
+#ifdef _WIN32
+    if ( data != NULL )
+        UnmapViewOfFile(data);
+    if ( mapping != NULL )
+        CloseHandle(mapping);
+    if ( file != INVALID_HANDLE_VALUE )
+        CloseHandle(file);
+    mapping = NULL;
+    file    = INVALID_HANDLE_VALUE;
+#else
+    if ( data != NULL )
+        munmap(const_cast<char*>(data), size);
+    if ( file >= 0 )
+        close(file);
+    file = -1;
+#endif
+    data = NULL;
+    size = 0;
+}
@@ -0,0 +1,48 @@
+#ifndef MAPPEDFILE
+#define MAPPEDFILE
+
+#include <cstddef>
+
+/**
+ *  A whole file mapped read only into memory, with mmap on POSIX systems and a file mapping on Windows.
+ *  Pages are read in by the OS as they're touched, so a file bigger than memory can still be walked through.
+ */
+class MappedFile
+{
+    public:
+        MappedFile();
+
+        /** Copying would unmap the file under the copy, so it's deleted. */
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        ~MappedFile() { Close(); };
+
+        /**
+         *  Maps a file, hinting that it'll be read front to back.
+         *  @param path - The file to map.
+         *  @return Whether the file exists, isn't empty and was mapped.
+         */
+        bool Open(const char* path);
+
+        /** Unmaps the file. */
+        void Close();
+
+        /** Gets the mapped bytes, or NULL if nothing is mapped. */
+        const char* GetData() const { return data; };
+
+        /** Gets the size of the mapped file in bytes. */
+        size_t GetSize() const { return size; };
+
+    private:
+        const char* data; // The mapped file, or NULL.
+        size_t      size; // Bytes mapped.
+#ifdef _WIN32
+        void*       file;    // Handle of the open file.
+        void*       mapping; // Handle of its mapping.
+#else
+        int         file;    // Descriptor of the open file.
+#endif
+};
+
+#endif
@@ -9,16 +9,43 @@
 #include "OGLBubbles.hpp"
 
 #include <iostream>
+#include <fstream>
+#include <string>
 
 #include "Graphics.hpp"
 #include "Camera.hpp"
+#include "Simulation.hpp"
+#include "SimThread.hpp"
+#include "JobSystem.hpp"
+#include "AirFlow.hpp"
+#include "DistanceField.hpp"
 #include "Centroid.hpp"
 #include "OGLBLOG.hpp"
 
 Graphics*   Gfx;    // Global pointer to the graphics object
 Camera*     Cam;    // Global pointer to the camera object
+Simulation* Sim;    // Global pointer to the bubble simulation
+SimThread*  Worker; // Global pointer to the thread stepping the simulation
+JobSystem*  Jobs;   // Global pointer to the work-stealing thread pool
+AirFlow*    Air;    // Global pointer to the air the bubbles drift in
+DistanceField* LightField; // Global pointer to the distance field of the light cube
 GLFWwindow* Window; // Global pointer to the window object
 
+static const int   AIR_CELLS  = 128;   // Cells along each side of the air grid.
+static const float AIR_EXTENT = 16.0f; // Width of the box of air around the scene's center.
+static const float LIGHT_SCALE = 0.1f;  // Size of the light cube in the world, as drawn by TransformLight.
+static const float LIGHT_VOXEL = 0.25f; // Finest sample spacing of the light cube's field, in cube units.
+static const float LIGHT_BAND  = 12.0f; // Narrowest band of the light cube's field in cube units.
+static const float LIGHT_SWELL = 1.5f;  // Band past the largest bubble's radius, for cells that swell in a foam.
+static const int   LIGHT_SPAN  = 128;   // Most samples across the light cube's field; wider bands get coarser.
+static const float EMITTER_RATE     = 2.0f;  // Bubbles blown into the scene per second.
+static const float EMITTER_LIFETIME = 20.0f; // Seconds before a blown bubble pops.
+static const int   DROPLET_CAPACITY = 1 << 20; // Most pop droplets alive at once.
+static const int   INPUT_CLUSTERS   = 8;       // Bubbles blown around the clumps of the input points, at most.
+static const int   INPUT_MINI_BATCH = 65536;   // Points per k-means mini-batch, for very large input clouds.
+static const float CLUSTER_RADIUS   = 0.2f;    // Smallest radius of a bubble blown around a clump.
+static const float INPUT_OUTLIERS   = 3.0f;    // Standard deviations of spacing past which input points are left out.
+
 /** Entry point to the app, calls initialization functions and handles the render loop. */
 int main()
 {
@@ -31,11 +58,42 @@ int main()
 
     // Loops while the window is open so graphics keep being drawn
     l.d("Initialization complete. Beginning render loop.");
+    Worker->Start();
+    double lastTitle = 0.0;
+    double lastFrame = glfwGetTime();
+    float  lastX     = Cam->GetX();
+    float  lastY     = Cam->GetY();
+    bool   dragging  = false;
+    glm::vec3 lastLight = Cam->GetLightPos();
     while ( !glfwWindowShouldClose(Window) )
     {
-        // Process any inputs
+        // Process any inputs (the simulation steps on its own thread)
         Cam->ProcessInput();
 
+        // Sweep the whole path the cursor took while the button is held (the press itself is a click)
+        double now  = glfwGetTime();
+        bool   held = glfwGetMouseButton(Window, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS;
+        if ( held && dragging )
+            Gfx->SweepCheck(lastX, lastY, Cam->GetX(), Cam->GetY(), static_cast<float>(now - lastFrame));
+        float frameTime = static_cast<float>(now - lastFrame);
+        dragging  = held;
+        lastFrame = now;
+        lastX     = Cam->GetX();
+        lastY     = Cam->GetY();
+
+        // The light cube is collider 0; bubbles get pushed aside when it's moved into them
+        glm::vec3 light = Cam->GetLightPos();
+        if ( light != lastLight )
+        {
+            Worker->Post([light](Simulation& sim) { sim.MoveCollider(0, light); });
+            lastLight = light;
+        }
+
+        Gfx->ApplyPokes();
+        Gfx->UpdateShape(frameTime);
+        Gfx->UpdateFilm(frameTime);
+        Gfx->UpdateDroplets(frameTime);
+
         // Clear the back buffer before drawing to it
         Gfx->ClearBuffer(0.0f, 0.0f, 0.0f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
@@ -51,7 +109,20 @@ int main()
         // Sphere
         Gfx->UseShader(1);
         Gfx->Transform(800.0f, 600.0f, 1);
-        Gfx->DrawSphere(1, 1);
+        Gfx->DrawBubbles(1, 1);
+
+        // Pop droplets, blended over everything else
+        Gfx->DrawDroplets(800.0f, 600.0f);
+
+        // Show the simulation metrics in the title bar once a second
+        if ( glfwGetTime() - lastTitle >= 1.0 )
+        {
+            const Snapshot& snapshot = Worker->Acquire();
+            std::string title = "OGLBubbles - " + std::to_string(snapshot.awake) + " awake, "
+                              + std::to_string(snapshot.sleeping) + " sleeping";
+            glfwSetWindowTitle(Window, title.c_str());
+            lastTitle = glfwGetTime();
+        }
 
         // Swap the front and back buffers and processes pending glfw events
         Gfx->EndFrame();
@@ -73,12 +144,28 @@ void mouse_move_callback(GLFWwindow* window, double xPos, double yPos)
     Cam->ProcessMouse(xPos, yPos);
 }
 
+void mouse_button_callback(GLFWwindow* window, int button, int action, int mods)
+{
+    if ( button == GLFW_MOUSE_BUTTON_LEFT && action == GLFW_PRESS )
+        Gfx->CollisionCheck(Cam->GetX(), Cam->GetY(), Cam->GetMouseVelocity());
+}
+
 void OGLBexit()
 {
+    if ( Worker != NULL )
+        delete Worker;
     if ( Gfx != NULL )
         delete Gfx;
     if ( Cam != NULL )
         delete Cam;
+    if ( Sim != NULL )
+        delete Sim;
+    if ( Air != NULL )
+        delete Air;
+    if ( LightField != NULL )
+        delete LightField;
+    if ( Jobs != NULL )
+        delete Jobs;
     glfwTerminate();
 }
 
@@ -142,12 +229,63 @@ bool init()
     glfwSetFramebufferSizeCallback(Window, framebuffer_size_callback);
     glfwSetInputMode(Window, GLFW_CURSOR, GLFW_CURSOR_NORMAL); // Capture: GLFW_CUROR_DISABLED
     glfwSetCursorPosCallback(Window, mouse_move_callback);
+    glfwSetMouseButtonCallback(Window, mouse_button_callback);
+
+    // Creates the scene's bubbles (the sphere mesh is drawn at the first one)
+    Jobs = new JobSystem();
+    Air  = new AirFlow(AIR_CELLS, AIR_EXTENT / AIR_CELLS, glm::vec3(-0.5f * AIR_EXTENT));
+    Air->SetJobSystem(Jobs);
+    Sim  = new Simulation();
+    Sim->SetJobSystem(Jobs);
+    Sim->SetAirFlow(Air);
+    Sim->AddBubble(glm::vec3(0.0f), 1.0f);
+
+    // A gentle stream of small bubbles rising from below the scene
+    Emitter emitter;
+    emitter.position    = glm::vec3(0.0f, -4.0f, 0.0f);
+    emitter.velocity    = glm::vec3(0.0f, 1.0f, 0.0f);
+    emitter.size        = 0.5f;
+    emitter.spread      = 0.25f;
+    emitter.rate        = EMITTER_RATE;
+    emitter.minRadius   = 0.2f;
+    emitter.maxRadius   = 0.5f;
+    emitter.lifetime    = EMITTER_LIFETIME;
+    emitter.accumulator = 0.0f;
+    emitter.seed        = 1;
+    Sim->AddEmitter(emitter);
+
+    // A bubble around every clump of the input points, if there are any
+    for (const std::pair<std::array<float,3>, float>& cluster : Clusters(INPUT_CLUSTERS, INPUT_MINI_BATCH, INPUT_OUTLIERS, Jobs))
+        Sim->AddBubble(glm::vec3(cluster.first[0], cluster.first[1], cluster.first[2]), std::max(cluster.second, CLUSTER_RADIUS));
+
+    // Bake the light cube once so bubbles can bump into it
+    std::vector<glm::vec3>    cubePositions;
+    std::vector<unsigned int> cubeIndices;
+    Graphics::CubeMesh(&cubePositions, &cubeIndices);
+    // The band has to reach the center of the largest bubble touching the cube, which input clumps can make big
+    float largest = emitter.maxRadius;
+    for (int id = 0; id < Sim->GetBubbleCount(); id++)
+        largest = std::max(largest, Sim->GetBubble(id).radius);
+    float band  = std::max(LIGHT_BAND, LIGHT_SWELL * largest / LIGHT_SCALE);
+    float voxel = std::max(LIGHT_VOXEL, (1.0f + 2.0f * band) / LIGHT_SPAN);
+
+    LightField = new DistanceField();
+    LightField->SetJobSystem(Jobs);
+    LightField->Build(cubePositions, cubeIndices, voxel, band);
+    Sim->AddCollider(LightField, Cam->GetLightPos(), LIGHT_SCALE);
+
+    Worker = new SimThread(Sim);
 
-    Gfx = new Graphics(Window, Cam, 1.0f);
+    Gfx = new Graphics(Window, Cam, Worker, 1.0f);
     if ( Gfx == NULL )
     {
         std::cerr << "Failed to create graphics object" << std::endl;
         delete Cam;
+        delete Worker;
+        delete Sim;
+        delete Air;
+        delete LightField;
+        delete Jobs;
         glfwTerminate();
         return false;
     }
@@ -155,9 +293,11 @@ bool init()
     // Loads reusable graphics
     try
     {
+        Gfx->SetJobSystem(Jobs);
         Gfx->CreateShaders();
         Gfx->GenerateCube(0);
         Gfx->GenerateSphere(1);
+        Gfx->GenerateDroplets(DROPLET_CAPACITY);
     }
     catch (const std::exception& e)
     {
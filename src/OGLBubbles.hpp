@@ -25,6 +25,15 @@ void framebuffer_size_callback(GLFWwindow* window, int width, int height);
  */
 void mouse_move_callback(GLFWwindow* window, double xPos, double yPos);
 
+/**
+ *  Checks for bubble hits when a mouse button is pressed.
+ *  @param window - The window that received the event.
+ *  @param button - The mouse button that was pressed or released.
+ *  @param action - GLFW_PRESS or GLFW_RELEASE.
+ *  @param mods   - Bit field of the modifier keys held down.
+ */
+void mouse_button_callback(GLFWwindow* window, int button, int action, int mods);
+
 /**
  *  Cleans up any resources before exiting the program.
  */
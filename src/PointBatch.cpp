@@ -0,0 +1,421 @@
+#include "PointBatch.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+// SSE2 is part of every x86-64 target, so its kernels build without a runtime check
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define POINTBATCH_SSE
+#endif
+
+// The AVX2 kernels are built for AVX2 on their own and only run once the CPU has been checked for it
+#if defined(POINTBATCH_SSE) && (defined(__GNUC__) || defined(__clang__) || defined(_MSC_VER))
+#include <immintrin.h>
+#define POINTBATCH_AVX2
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#define AVX2_TARGET
+#else
+#define AVX2_TARGET __attribute__((target("avx2")))
+#endif
+#endif
+
+// Every kernel measures a squared distance as (dx dx + dy dy) + dz dz, so they all pick the same furthest point
+
+static void SumScalar(const float* x, const float* y, const float* z, int begin, int end, float sum[3])
+{
+    float sx = 0.0f, sy = 0.0f, sz = 0.0f;
+    for (int i = begin; i < end; i++)
+    {
+        sx += x[i];
+        sy += y[i];
+        sz += z[i];
+    }
+    sum[0] = sx;
+    sum[1] = sy;
+    sum[2] = sz;
+}
+
+static int FarthestScalar(const float* x, const float* y, const float* z, int begin, int end, const float c[3], float* best)
+{
+    int index = -1;
+    for (int i = begin; i < end; i++)
+    {
+        float dx = x[i] - c[0], dy = y[i] - c[1], dz = z[i] - c[2];
+        float sq = dx * dx + dy * dy + dz * dz;
+        if ( sq > *best )
+        {
+            *best = sq;
+            index = i;
+        }
+    }
+    return index;
+}
+
+static void DistancesScalar(const float* x, const float* y, const float* z, int begin, int end, const float c[3], float* out)
+{
+    for (int i = begin; i < end; i++)
+    {
+        float dx = x[i] - c[0], dy = y[i] - c[1], dz = z[i] - c[2];
+        out[i] = dx * dx + dy * dy + dz * dz;
+    }
+}
+
+static void NearestScalar(const float* x, const float* y, const float* z, int begin, int end,
+                          const float* cx, const float* cy, const float* cz, int k, int* labels, float* sqDist)
+{
+    for (int i = begin; i < end; i++)
+    {
+        float best  = HUGE_VALF;
+        int   label = 0;
+        for (int c = 0; c < k; c++)
+        {
+            float dx = x[i] - cx[c], dy = y[i] - cy[c], dz = z[i] - cz[c];
+            float sq = dx * dx + dy * dy + dz * dz;
+            if ( sq < best )
+            {
+                best  = sq;
+                label = c;
+            }
+        }
+        labels[i - begin] = label;
+        sqDist[i - begin] = best;
+    }
+}
+
+/** Picks the furthest of a register's lanes, the lowest index on a tie. */
+static int ReduceLanes(const float* sq, const int* index, int lanes, float* best)
+{
+    int found = -1;
+    for (int l = 0; l < lanes; l++)
+    {
+        if ( index[l] < 0 )
+            continue;
+        if ( sq[l] > *best || (sq[l] == *best && found >= 0 && index[l] < found) )
+        {
+            *best = sq[l];
+            found = index[l];
+        }
+    }
+    return found;
+}
+
+#ifdef POINTBATCH_SSE
+static void SumSSE(const float* x, const float* y, const float* z, int begin, int end, float sum[3])
+{
+    __m128 sx = _mm_setzero_ps(), sy = _mm_setzero_ps(), sz = _mm_setzero_ps();
+    int i = begin;
+    for (; i + 4 <= end; i += 4)
+    {
+        sx = _mm_add_ps(sx, _mm_loadu_ps(x + i));
+        sy = _mm_add_ps(sy, _mm_loadu_ps(y + i));
+        sz = _mm_add_ps(sz, _mm_loadu_ps(z + i));
+    }
+
+    float lanes[3][4];
+    _mm_storeu_ps(lanes[0], sx);
+    _mm_storeu_ps(lanes[1], sy);
+    _mm_storeu_ps(lanes[2], sz);
+    SumScalar(x, y, z, i, end, sum);
+    for (int a = 0; a < 3; a++)
+        sum[a] += (lanes[a][0] + lanes[a][1]) + (lanes[a][2] + lanes[a][3]);
+}
+
+static __m128 SquaredSSE(const float* x, const float* y, const float* z, int i, __m128 cx, __m128 cy, __m128 cz)
+{
+    __m128 dx = _mm_sub_ps(_mm_loadu_ps(x + i), cx);
+    __m128 dy = _mm_sub_ps(_mm_loadu_ps(y + i), cy);
+    __m128 dz = _mm_sub_ps(_mm_loadu_ps(z + i), cz);
+    return _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+}
+
+static int FarthestSSE(const float* x, const float* y, const float* z, int begin, int end, const float c[3], float* best)
+{
+    __m128  cx = _mm_set1_ps(c[0]), cy = _mm_set1_ps(c[1]), cz = _mm_set1_ps(c[2]);
+    __m128  top   = _mm_set1_ps(*best);
+    __m128i which = _mm_set1_epi32(-1);
+    __m128i index = _mm_setr_epi32(begin, begin + 1, begin + 2, begin + 3);
+    __m128i step  = _mm_set1_epi32(4);
+
+    // Each lane keeps its own furthest point; a strict comparison keeps the first of equals
+    int i = begin;
+    for (; i + 4 <= end; i += 4)
+    {
+        __m128  sq   = SquaredSSE(x, y, z, i, cx, cy, cz);
+        __m128  mask = _mm_cmpgt_ps(sq, top);
+        __m128i pick = _mm_castps_si128(mask);
+        top   = _mm_or_ps(_mm_and_ps(mask, sq), _mm_andnot_ps(mask, top));
+        which = _mm_or_si128(_mm_and_si128(pick, index), _mm_andnot_si128(pick, which));
+        index = _mm_add_epi32(index, step);
+    }
+
+    float sq[4];
+    int   lanes[4];
+    _mm_storeu_ps(sq, top);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), which);
+    int found = ReduceLanes(sq, lanes, 4, best);
+    int tail  = FarthestScalar(x, y, z, i, end, c, best);
+    return tail >= 0 ? tail : found;
+}
+
+static void NearestSSE(const float* x, const float* y, const float* z, int begin, int end,
+                       const float* cx, const float* cy, const float* cz, int k, int* labels, float* sqDist)
+{
+    // Four points at a time against every center; a strict comparison keeps the lowest of equal centers
+    int i = begin;
+    for (; i + 4 <= end; i += 4)
+    {
+        __m128  best  = _mm_set1_ps(HUGE_VALF);
+        __m128i label = _mm_setzero_si128();
+        for (int c = 0; c < k; c++)
+        {
+            __m128  sq   = SquaredSSE(x, y, z, i, _mm_set1_ps(cx[c]), _mm_set1_ps(cy[c]), _mm_set1_ps(cz[c]));
+            __m128  mask = _mm_cmplt_ps(sq, best);
+            __m128i pick = _mm_castps_si128(mask);
+            best  = _mm_or_ps(_mm_and_ps(mask, sq), _mm_andnot_ps(mask, best));
+            label = _mm_or_si128(_mm_and_si128(pick, _mm_set1_epi32(c)), _mm_andnot_si128(pick, label));
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(labels + (i - begin)), label);
+        _mm_storeu_ps(sqDist + (i - begin), best);
+    }
+    NearestScalar(x, y, z, i, end, cx, cy, cz, k, labels + (i - begin), sqDist + (i - begin));
+}
+
+static void DistancesSSE(const float* x, const float* y, const float* z, int begin, int end, const float c[3], float* out)
+{
+    __m128 cx = _mm_set1_ps(c[0]), cy = _mm_set1_ps(c[1]), cz = _mm_set1_ps(c[2]);
+    int i = begin;
+    for (; i + 4 <= end; i += 4)
+        _mm_storeu_ps(out + i, SquaredSSE(x, y, z, i, cx, cy, cz));
+    DistancesScalar(x, y, z, i, end, c, out);
+}
+#endif
+
+#ifdef POINTBATCH_AVX2
+AVX2_TARGET static void SumAVX2(const float* x, const float* y, const float* z, int begin, int end, float sum[3])
+{
+    __m256 sx = _mm256_setzero_ps(), sy = _mm256_setzero_ps(), sz = _mm256_setzero_ps();
+    int i = begin;
+    for (; i + 8 <= end; i += 8)
+    {
+        sx = _mm256_add_ps(sx, _mm256_loadu_ps(x + i));
+        sy = _mm256_add_ps(sy, _mm256_loadu_ps(y + i));
+        sz = _mm256_add_ps(sz, _mm256_loadu_ps(z + i));
+    }
+
+    float lanes[3][8];
+    _mm256_storeu_ps(lanes[0], sx);
+    _mm256_storeu_ps(lanes[1], sy);
+    _mm256_storeu_ps(lanes[2], sz);
+    SumScalar(x, y, z, i, end, sum);
+    for (int a = 0; a < 3; a++)
+        sum[a] += ((lanes[a][0] + lanes[a][1]) + (lanes[a][2] + lanes[a][3])) + ((lanes[a][4] + lanes[a][5]) + (lanes[a][6] + lanes[a][7]));
+}
+
+AVX2_TARGET static __m256 SquaredAVX2(const float* x, const float* y, const float* z, int i, __m256 cx, __m256 cy, __m256 cz)
+{
+    __m256 dx = _mm256_sub_ps(_mm256_loadu_ps(x + i), cx);
+    __m256 dy = _mm256_sub_ps(_mm256_loadu_ps(y + i), cy);
+    __m256 dz = _mm256_sub_ps(_mm256_loadu_ps(z + i), cz);
+    return _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)), _mm256_mul_ps(dz, dz));
+}
+
+AVX2_TARGET static int FarthestAVX2(const float* x, const float* y, const float* z, int begin, int end, const float c[3], float* best)
+{
+    __m256  cx = _mm256_set1_ps(c[0]), cy = _mm256_set1_ps(c[1]), cz = _mm256_set1_ps(c[2]);
+    __m256  top   = _mm256_set1_ps(*best);
+    __m256i which = _mm256_set1_epi32(-1);
+    __m256i index = _mm256_setr_epi32(begin, begin + 1, begin + 2, begin + 3, begin + 4, begin + 5, begin + 6, begin + 7);
+    __m256i step  = _mm256_set1_epi32(8);
+
+    int i = begin;
+    for (; i + 8 <= end; i += 8)
+    {
+        __m256 sq   = SquaredAVX2(x, y, z, i, cx, cy, cz);
+        __m256 mask = _mm256_cmp_ps(sq, top, _CMP_GT_OQ);
+        top   = _mm256_blendv_ps(top, sq, mask);
+        which = _mm256_castps_si256(_mm256_blendv_ps(_mm256_castsi256_ps(which), _mm256_castsi256_ps(index), mask));
+        index = _mm256_add_epi32(index, step);
+    }
+
+    float sq[8];
+    int   lanes[8];
+    _mm256_storeu_ps(sq, top);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes), which);
+    int found = ReduceLanes(sq, lanes, 8, best);
+    int tail  = FarthestScalar(x, y, z, i, end, c, best);
+    return tail >= 0 ? tail : found;
+}
+
+AVX2_TARGET static void NearestAVX2(const float* x, const float* y, const float* z, int begin, int end,
+                                    const float* cx, const float* cy, const float* cz, int k, int* labels, float* sqDist)
+{
+    int i = begin;
+    for (; i + 8 <= end; i += 8)
+    {
+        __m256  best  = _mm256_set1_ps(HUGE_VALF);
+        __m256i label = _mm256_setzero_si256();
+        for (int c = 0; c < k; c++)
+        {
+            __m256 sq   = SquaredAVX2(x, y, z, i, _mm256_set1_ps(cx[c]), _mm256_set1_ps(cy[c]), _mm256_set1_ps(cz[c]));
+            __m256 mask = _mm256_cmp_ps(sq, best, _CMP_LT_OQ);
+            best  = _mm256_blendv_ps(best, sq, mask);
+            label = _mm256_castps_si256(_mm256_blendv_ps(_mm256_castsi256_ps(label), _mm256_castsi256_ps(_mm256_set1_epi32(c)), mask));
+        }
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(labels + (i - begin)), label);
+        _mm256_storeu_ps(sqDist + (i - begin), best);
+    }
+    NearestScalar(x, y, z, i, end, cx, cy, cz, k, labels + (i - begin), sqDist + (i - begin));
+}
+
+AVX2_TARGET static void DistancesAVX2(const float* x, const float* y, const float* z, int begin, int end, const float c[3], float* out)
+{
+    __m256 cx = _mm256_set1_ps(c[0]), cy = _mm256_set1_ps(c[1]), cz = _mm256_set1_ps(c[2]);
+    int i = begin;
+    for (; i + 8 <= end; i += 8)
+        _mm256_storeu_ps(out + i, SquaredAVX2(x, y, z, i, cx, cy, cz));
+    DistancesScalar(x, y, z, i, end, c, out);
+}
+#endif
+
+PointBatch::PointBatch()
+{
+    px      = NULL;
+    py      = NULL;
+    pz      = NULL;
+    count   = 0;
+    kernels = Detect();
+}
+
+PointBatch::Kernels PointBatch::Detect()
+{
+    static const Kernels widest = []()
+    {
+#if defined(POINTBATCH_AVX2) && defined(_MSC_VER) && !defined(__clang__)
+        // AVX2 needs the OS to save the wide registers as well as the CPU to have it
+        int info[4];
+        __cpuid(info, 0);
+        if ( info[0] >= 7 )
+        {
+            __cpuid(info, 1);
+            bool saved = (info[2] & (1 << 27)) != 0 && (info[2] & (1 << 28)) != 0 && (_xgetbv(0) & 6) == 6;
+            __cpuidex(info, 7, 0);
+            if ( saved && (info[1] & (1 << 5)) != 0 )
+                return AVX2;
+        }
+#elif defined(POINTBATCH_AVX2)
+        if ( __builtin_cpu_supports("avx2") )
+            return AVX2;
+#endif
+#ifdef POINTBATCH_SSE
+        return SSE2;
+#else
+        return SCALAR;
+#endif
+    }();
+    return widest;
+}
+
+PointBatch::Kernels PointBatch::SetKernels(Kernels kernels)
+{
+    this->kernels = std::min(kernels, Detect());
+    return this->kernels;
+}
+
+void PointBatch::Assign(const float* xyz, int n, int stride)
+{
+    n = std::max(0, n);
+    x.resize(n);
+    y.resize(n);
+    z.resize(n);
+    for (int i = 0; i < n; i++)
+    {
+        x[i] = xyz[i * stride];
+        y[i] = xyz[i * stride + 1];
+        z[i] = xyz[i * stride + 2];
+    }
+    View(x.data(), y.data(), z.data(), n);
+}
+
+void PointBatch::View(const float* x, const float* y, const float* z, int n)
+{
+    px    = x;
+    py    = y;
+    pz    = z;
+    count = std::max(0, n);
+}
+
+void PointBatch::Centroid(float center[3]) const
+{
+    int n = GetCount();
+    double total[3] = { 0.0, 0.0, 0.0 };
+    for (int begin = 0; begin < n; begin += BLOCK)
+    {
+        int   end = std::min(n, begin + BLOCK);
+        float sum[3];
+        switch ( kernels )
+        {
+#ifdef POINTBATCH_AVX2
+            case AVX2:  SumAVX2(px, py, pz, begin, end, sum); break;
+#endif
+#ifdef POINTBATCH_SSE
+            case SSE2:  SumSSE(px, py, pz, begin, end, sum); break;
+#endif
+            default:    SumScalar(px, py, pz, begin, end, sum); break;
+        }
+        for (int a = 0; a < 3; a++)
+            total[a] += sum[a];
+    }
+
+    for (int a = 0; a < 3; a++)
+        center[a] = n > 0 ? static_cast<float>(total[a] / n) : 0.0f;
+}
+
+int PointBatch::Farthest(const float center[3], float* sqDist) const
+{
+    float best = -1.0f;
+    int   index;
+    switch ( kernels )
+    {
+#ifdef POINTBATCH_AVX2
+        case AVX2:  index = FarthestAVX2(px, py, pz, 0, GetCount(), center, &best); break;
+#endif
+#ifdef POINTBATCH_SSE
+        case SSE2:  index = FarthestSSE(px, py, pz, 0, GetCount(), center, &best); break;
+#endif
+        default:    index = FarthestScalar(px, py, pz, 0, GetCount(), center, &best); break;
+    }
+
+    if ( sqDist != NULL )
+        *sqDist = std::max(best, 0.0f);
+    return index;
+}
+
+void PointBatch::DistancesSq(const float center[3], float* out) const
+{
+    switch ( kernels )
+    {
+#ifdef POINTBATCH_AVX2
+        case AVX2:  DistancesAVX2(px, py, pz, 0, GetCount(), center, out); break;
+#endif
+#ifdef POINTBATCH_SSE
+        case SSE2:  DistancesSSE(px, py, pz, 0, GetCount(), center, out); break;
+#endif
+        default:    DistancesScalar(px, py, pz, 0, GetCount(), center, out); break;
+    }
+}
+
+void PointBatch::Nearest(const float* cx, const float* cy, const float* cz, int k, int begin, int end, int* labels, float* sqDist) const
+{
+    switch ( kernels )
+    {
+#ifdef POINTBATCH_AVX2
+        case AVX2:  NearestAVX2(px, py, pz, begin, end, cx, cy, cz, k, labels, sqDist); break;
+#endif
+#ifdef POINTBATCH_SSE
+        case SSE2:  NearestSSE(px, py, pz, begin, end, cx, cy, cz, k, labels, sqDist); break;
+#endif
+        default:    NearestScalar(px, py, pz, begin, end, cx, cy, cz, k, labels, sqDist); break;
+    }
+}
@@ -0,0 +1,116 @@
+#ifndef POINTBATCH
+#define POINTBATCH
+
+#include <cstddef>
+#include <vector>
+
+/**
+ *  A batch of points stored as three separate coordinate arrays, so wide registers load eight x's, y's or z's at
+ *  once, with the reductions a fit keeps repeating over it: the centroid, the point furthest from a center, the
+ *  squared distance of every point from a center, and the nearest of several centers to every point. Distances stay
+ *  squared; nothing takes a square root.
+ *  The kernels come in AVX2, SSE2 and plain versions, and the widest one the CPU supports is picked at runtime,
+ *  so a build runs on CPUs without AVX2. Every version measures distances in the same order of operations, so they
+ *  all agree on the furthest point.
+ */
+class PointBatch
+{
+    public:
+        /** The kernel sets, narrowest first. */
+        enum Kernels { SCALAR, SSE2, AVX2 };
+
+        /** Creates an empty batch using the widest kernels the CPU supports. */
+        PointBatch();
+
+        /** Copying would duplicate every coordinate, so it's deleted. */
+        PointBatch(const PointBatch&) = delete;
+        PointBatch& operator=(const PointBatch&) = delete;
+
+        ~PointBatch() { };
+
+        /**
+         *  Fills the batch from interleaved coordinates.
+         *  @param xyz    - The first point's x, with its y and z right after it.
+         *  @param n      - The number of points.
+         *  @param stride - The number of floats from one point to the next.
+         */
+        void Assign(const float* xyz, int n, int stride = 3);
+
+        /**
+         *  Points the batch at coordinate arrays it doesn't own, such as the columns of a mapped PointCloud, so
+         *  nothing is copied. The arrays have to outlive the batch, or the next Assign or View.
+         *  @param x, y, z - The coordinates of the points.
+         *  @param n       - The number of points.
+         */
+        void View(const float* x, const float* y, const float* z, int n);
+
+        /**
+         *  Works out the average of the points, summing in blocks so large batches don't lose precision.
+         *  @param center - Receives the x, y and z of the average, or zeros for an empty batch.
+         */
+        void Centroid(float center[3]) const;
+
+        /**
+         *  Finds the point furthest from a center.
+         *  @param center - The x, y and z distances are measured from.
+         *  @param sqDist - Receives the squared distance of that point, if not NULL.
+         *  @return The index of the furthest point, the lowest one on a tie, or -1 for an empty batch.
+         */
+        int Farthest(const float center[3], float* sqDist = NULL) const;
+
+        /**
+         *  Works out the squared distance of every point from a center.
+         *  @param center - The x, y and z distances are measured from.
+         *  @param out    - Receives one squared distance per point.
+         */
+        void DistancesSq(const float center[3], float* out) const;
+
+        /**
+         *  Finds the nearest of several centers to each point in a range, for clustering.
+         *  @param cx, cy, cz - The coordinates of the centers.
+         *  @param k          - The number of centers, at least one.
+         *  @param begin, end - The range of points.
+         *  @param labels     - Receives the nearest center of each point, the lowest one on a tie; labels[0] is begin's.
+         *  @param sqDist     - Receives the squared distance to that center, laid out like labels.
+         */
+        void Nearest(const float* cx, const float* cy, const float* cz, int k, int begin, int end, int* labels, float* sqDist) const;
+
+        /**
+         *  Picks the kernels to run, which can't be wider than the CPU supports.
+         *  @param kernels - The kernel set wanted.
+         *  @return The kernel set now in use.
+         */
+        Kernels SetKernels(Kernels kernels);
+
+        /** Gets the kernel set in use. */
+        Kernels GetKernels() const { return kernels; };
+
+        /** Gets the widest kernel set this CPU supports, checked once. */
+        static Kernels Detect();
+
+        /** Gets the number of points. */
+        int GetCount() const { return count; };
+
+        /** Gets the x coordinates. */
+        const float* GetX() const { return px; };
+
+        /** Gets the y coordinates. */
+        const float* GetY() const { return py; };
+
+        /** Gets the z coordinates. */
+        const float* GetZ() const { return pz; };
+
+        static const int BLOCK = 4096; // Points summed in floats before the sums are added up in doubles.
+
+    private:
+        std::vector<float> x;  // X coordinate of every point, when the batch owns them.
+        std::vector<float> y;  // Y coordinate of every point, when the batch owns them.
+        std::vector<float> z;  // Z coordinate of every point, when the batch owns them.
+        const float* px;       // X coordinates in use, owned or viewed.
+        const float* py;       // Y coordinates in use.
+        const float* pz;       // Z coordinates in use.
+        int     count;         // Number of points.
+        Kernels kernels;       // Kernel set the reductions run with.
+};
+
+#endif
@@ -0,0 +1,214 @@
+#include "PointCloud.hpp"
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+
+#include "PointReader.hpp"
+
+// The header is written and mapped as is, so its layout can't depend on the compiler
+static_assert(sizeof(PointCloud::Header) == 96, "The cloud file header has to be 96 bytes with no padding");
+
+const char PointCloud::MAGIC[8] = { 'O', 'G', 'L', 'B', 'P', 'T', 'S', '\0' };
+
+static const int CHUNK = 65536; // Points converted at a time.
+
+/** Rounds a byte offset up to the column alignment. */
+static uint64_t Align(uint64_t offset)
+{
+    return (offset + PointCloud::ALIGNMENT - 1) / PointCloud::ALIGNMENT * PointCloud::ALIGNMENT;
+}
+
+PointCloud::PointCloud()
+{
+    std::memset(&header, 0, sizeof(header));
+}
+
+bool PointCloud::Open(const char* path)
+{
+    Close();
+    if ( !file.Open(path) || file.GetSize() < sizeof(Header) )
+    {
+        Close();
+        return false;
+    }
+
+    std::memcpy(&header, file.GetData(), sizeof(Header));
+    bool valid = std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) == 0 && header.version == VERSION &&
+                 (header.encoding == FLOAT32 || header.encoding == INT16) && header.count <= static_cast<uint64_t>(INT_MAX);
+
+    // Every column has to lie in the file after the one before it, aligned for its values
+    uint64_t end = sizeof(Header);
+    for (int axis = 0; valid && axis < 3; axis++)
+    {
+        valid = header.columns[axis] >= end && header.columns[axis] % sizeof(float) == 0 &&
+                header.columns[axis] + header.count * ValueSize() <= file.GetSize();
+        end   = header.columns[axis] + header.count * ValueSize();
+    }
+
+    if ( !valid )
+    {
+        Close();
+        return false;
+    }
+    return true;
+}
+
+void PointCloud::Close()
+{
+    file.Close();
+    std::memset(&header, 0, sizeof(header));
+}
+
+const float* PointCloud::GetColumn(int axis) const
+{
+    if ( file.GetData() == NULL || header.encoding != FLOAT32 )
+        return NULL;
+    return reinterpret_cast<const float*>(file.GetData() + header.columns[axis]);
+}
+
+const int16_t* PointCloud::GetQuantized(int axis) const
+{
+    if ( file.GetData() == NULL || header.encoding != INT16 )
+        return NULL;
+    return reinterpret_cast<const int16_t*>(file.GetData() + header.columns[axis]);
+}
+
+size_t PointCloud::GetColumnsSize() const
+{
+    if ( file.GetData() == NULL )
+        return 0;
+    return static_cast<size_t>(header.columns[2] + header.count * ValueSize() - header.columns[0]);
+}
+
+void PointCloud::Decode(int axis, int begin, int end, float* out) const
+{
+    if ( const float* column = GetColumn(axis) )
+    {
+        std::copy(column + begin, column + end, out);
+        return;
+    }
+
+    const int16_t* column = GetQuantized(axis);
+    if ( column == NULL )
+        return;
+
+    float scale = header.scale[axis], offset = header.offset[axis];
+    for (int i = begin; i < end; i++)
+        out[i - begin] = offset + column[i] * scale;
+}
+
+void PointCloud::Fill(PointBatch& batch, std::vector<float>& storage) const
+{
+    int n = GetCount();
+    if ( header.encoding == FLOAT32 )
+    {
+        batch.View(GetColumn(0), GetColumn(1), GetColumn(2), n);
+        return;
+    }
+
+    storage.resize(static_cast<size_t>(n) * 3);
+    for (int axis = 0; axis < 3; axis++)
+        Decode(axis, 0, n, storage.data() + static_cast<size_t>(axis) * n);
+    batch.View(storage.data(), storage.data() + n, storage.data() + static_cast<size_t>(n) * 2, n);
+}
+
+bool PointCloud::Convert(const char* source, const char* target, Encoding encoding)
+{
+    PointReader reader;
+    if ( !reader.Open(source) )
+        return false;
+
+    // First pass: count the points and find their bounds
+    std::vector<float> chunk(static_cast<size_t>(CHUNK) * 3);
+    float* x = chunk.data();
+    float* y = x + CHUNK;
+    float* z = y + CHUNK;
+
+    Header header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version  = VERSION;
+    header.encoding = encoding;
+    for (int axis = 0; axis < 3; axis++)
+    {
+        header.min[axis]   =  HUGE_VALF;
+        header.max[axis]   = -HUGE_VALF;
+        header.scale[axis] = 1.0f;
+    }
+
+    for ( int read; (read = reader.Next(x, y, z, CHUNK)) > 0; )
+    {
+        const float* columns[3] = { x, y, z };
+        for (int axis = 0; axis < 3; axis++)
+        {
+            auto bounds = std::minmax_element(columns[axis], columns[axis] + read);
+            header.min[axis] = std::min(header.min[axis], *bounds.first);
+            header.max[axis] = std::max(header.max[axis], *bounds.second);
+        }
+        header.count += read;
+    }
+    if ( header.count > static_cast<uint64_t>(INT_MAX) )
+        return false;
+
+    size_t valueSize = encoding == INT16 ? sizeof(int16_t) : sizeof(float);
+    uint64_t offset  = Align(sizeof(Header));
+    for (int axis = 0; axis < 3; axis++)
+    {
+        if ( header.count == 0 )
+        {
+            header.min[axis] = header.max[axis] = 0.0f;
+        }
+        else if ( encoding == INT16 )
+        {
+            // Stored values span -QUANTA to QUANTA across the bounds
+            header.offset[axis] = 0.5f * (header.min[axis] + header.max[axis]);
+            float half = 0.5f * (header.max[axis] - header.min[axis]);
+            header.scale[axis] = half > 0.0f ? half / QUANTA : 1.0f;
+        }
+        header.columns[axis] = offset;
+        offset = Align(offset + header.count * valueSize);
+    }
+
+    std::ofstream out(target, std::ios::binary | std::ios::trunc);
+    if ( !out )
+        return false;
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    // Second pass: write each chunk into its place in the three columns
+    std::vector<int16_t> quantized(CHUNK);
+    reader.Rewind();
+    uint64_t written = 0;
+    for ( int read; (read = reader.Next(x, y, z, CHUNK)) > 0; written += read )
+    {
+        const float* columns[3] = { x, y, z };
+        for (int axis = 0; axis < 3; axis++)
+        {
+            out.seekp(static_cast<std::streamoff>(header.columns[axis] + written * valueSize));
+            if ( encoding == FLOAT32 )
+            {
+                out.write(reinterpret_cast<const char*>(columns[axis]), static_cast<std::streamsize>(read * sizeof(float)));
+                continue;
+            }
+
+            float inverse = 1.0f / header.scale[axis];
+            for (int i = 0; i < read; i++)
+            {
+                long stored  = std::lround((columns[axis][i] - header.offset[axis]) * inverse);
+                quantized[i] = static_cast<int16_t>(std::max(-static_cast<long>(QUANTA), std::min(static_cast<long>(QUANTA), stored)));
+            }
+            out.write(reinterpret_cast<const char*>(quantized.data()), static_cast<std::streamsize>(read * sizeof(int16_t)));
+        }
+    }
+
+    // Pad the last column out to the alignment, so the column block is whole
+    if ( offset > header.columns[2] + header.count * valueSize )
+    {
+        out.seekp(static_cast<std::streamoff>(offset - 1));
+        out.put('\0');
+    }
+
+    return static_cast<bool>(out);
+}
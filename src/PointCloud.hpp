@@ -0,0 +1,123 @@
+#ifndef POINTCLOUD
+#define POINTCLOUD
+
+#include <cstdint>
+#include <vector>
+
+#include "MappedFile.hpp"
+#include "PointBatch.hpp"
+
+/**
+ *  A point cloud in a binary columnar file, mapped straight into memory.
+ *  The file is a Header followed by three columns, every x, then every y, then every z, each starting on a
+ *  multiple of ALIGNMENT bytes. Columns are either floats, which are used in place with no copying, or int16s
+ *  quantized over the cloud's bounds, where a value is offset + stored * scale, to within about half a scale.
+ *  Everything is little endian. Convert writes one from the text format that PointReader reads, streaming it in
+ *  two passes so neither file has to fit in memory.
+ */
+class PointCloud
+{
+    public:
+        /** How the columns are stored. */
+        enum Encoding { FLOAT32 = 0, INT16 = 1 };
+
+        /** The start of the file. */
+        struct Header
+        {
+            char     magic[8];   // MAGIC.
+            uint32_t version;    // VERSION.
+            uint32_t encoding;   // An Encoding.
+            uint64_t count;      // Points in the cloud.
+            float    min[3];     // Smallest x, y and z.
+            float    max[3];     // Largest x, y and z.
+            float    scale[3];   // Stored value to coordinate, per column; one for floats.
+            float    offset[3];  // Coordinate of a stored zero, per column; zero for floats.
+            uint64_t columns[3]; // Byte offset of each column from the start of the file.
+        };
+
+        PointCloud();
+
+        /** Copying would unmap the columns under the copy, so it's deleted. */
+        PointCloud(const PointCloud&) = delete;
+        PointCloud& operator=(const PointCloud&) = delete;
+
+        ~PointCloud() { };
+
+        /**
+         *  Maps a cloud file and checks that its header and columns fit it.
+         *  @param path - The file to map.
+         *  @return Whether it's a cloud file this version can read.
+         */
+        bool Open(const char* path);
+
+        /** Unmaps the file. */
+        void Close();
+
+        /**
+         *  Gets a float column in place.
+         *  @param axis - 0, 1 or 2 for x, y or z.
+         *  @return The column, or NULL if the columns are quantized.
+         */
+        const float* GetColumn(int axis) const;
+
+        /**
+         *  Gets a quantized column in place.
+         *  @param axis - 0, 1 or 2 for x, y or z.
+         *  @return The column, or NULL if the columns are floats.
+         */
+        const int16_t* GetQuantized(int axis) const;
+
+        /**
+         *  Works out coordinates from a column, which for float columns is a plain copy.
+         *  @param axis       - 0, 1 or 2 for x, y or z.
+         *  @param begin, end - The range of points.
+         *  @param out        - Receives end - begin coordinates.
+         */
+        void Decode(int axis, int begin, int end, float* out) const;
+
+        /**
+         *  Points a batch at the cloud. Float columns are viewed where they're mapped; quantized ones are decoded
+         *  into storage first.
+         *  @param batch   - The batch to fill.
+         *  @param storage - Holds the decoded columns, which the batch then views, if there are any.
+         */
+        void Fill(PointBatch& batch, std::vector<float>& storage) const;
+
+        /** Gets the header, which is only valid while a file is open. */
+        const Header& GetHeader() const { return header; };
+
+        /** Gets the number of points. */
+        int GetCount() const { return static_cast<int>(header.count); };
+
+        /** Gets how the columns are stored. */
+        Encoding GetEncoding() const { return static_cast<Encoding>(header.encoding); };
+
+        /** Gets the first byte of the column block, x through z, for handing the whole block to the GPU at once. */
+        const char* GetColumns() const { return file.GetData() != NULL ? file.GetData() + header.columns[0] : NULL; };
+
+        /** Gets the size of the column block in bytes, from the first x through the last z. */
+        size_t GetColumnsSize() const;
+
+        /**
+         *  Converts a text point cloud into a cloud file.
+         *  @param source   - The text file, a count line and then a line of x y z per point.
+         *  @param target   - The cloud file to write.
+         *  @param encoding - How to store the columns.
+         *  @return Whether the text was read and the cloud written.
+         */
+        static bool Convert(const char* source, const char* target, Encoding encoding);
+
+        static const char     MAGIC[8];          // Identifies a cloud file.
+        static const uint32_t VERSION   = 1;     // Version of the format this writes and reads.
+        static const int      ALIGNMENT = 64;    // Columns start on multiples of this many bytes.
+        static const int      QUANTA    = 32767; // Largest stored magnitude of a quantized value.
+
+    private:
+        /** Gets the bytes one stored value takes up. */
+        size_t ValueSize() const { return header.encoding == INT16 ? sizeof(int16_t) : sizeof(float); };
+
+        MappedFile file;   // The mapped cloud.
+        Header     header; // Copy of its header.
+};
+
+#endif
@@ -0,0 +1,213 @@
+#include "PointReader.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <vector>
+
+/** Whether a character separates numbers on a line; a carriage return counts, so Windows line endings work. */
+static inline bool Blank(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r' || c == ',';
+}
+
+/** Moves past the end of the current line. */
+static inline const char* NextLine(const char* p, const char* end)
+{
+    const char* newline = static_cast<const char*>(std::memchr(p, '\n', end - p));
+    return newline != NULL ? newline + 1 : end;
+}
+
+/**
+ *  Parses a plain decimal like -12.345678 the quick way: its digits make an integer that a double holds exactly, and
+ *  one division by an exact power of ten rounds it correctly. Rounding that double to a float is only wrong when it
+ *  lands exactly halfway between two floats, so those are handed back, along with exponents, long numbers and
+ *  anything else, for std::from_chars to parse.
+ *  @return Whether it parsed the number and moved p past it.
+ */
+static inline bool ParseDecimal(const char*& p, const char* end, float& value)
+{
+    static const double POWERS[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+                                     1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+    const unsigned long long EXACT = 1ull << 53;
+
+    const char* q = p;
+    bool negative = q < end && *q == '-';
+    if ( negative )
+        q++;
+
+    unsigned long long digits = 0;
+    int count = 0, scale = 0;
+    for (; q < end && *q >= '0' && *q <= '9'; q++, count++)
+        digits = digits * 10 + (*q - '0');
+    if ( q < end && *q == '.' )
+    {
+        for (q++; q < end && *q >= '0' && *q <= '9'; q++, count++, scale++)
+            digits = digits * 10 + (*q - '0');
+    }
+    if ( count == 0 || count > 15 || digits > EXACT || scale > 22 || (q < end && (*q == 'e' || *q == 'E')) )
+        return false;
+
+    double exact = static_cast<double>(digits) / POWERS[scale];
+    unsigned long long bits;
+    std::memcpy(&bits, &exact, sizeof(bits));
+    if ( (bits & 0x1FFFFFFFull) == 0x10000000ull )
+        return false;
+
+    value = static_cast<float>(negative ? -exact : exact);
+    p     = q;
+    return true;
+}
+
+PointReader::PointReader()
+{
+    body   = NULL;
+    cursor = NULL;
+    count  = 0;
+}
+
+bool PointReader::Open(const char* path)
+{
+    Close();
+    if ( !file.Open(path) )
+        return false;
+
+    // The first line holds the count
+    const char* end = file.GetData() + file.GetSize();
+    const char* p   = file.GetData();
+    while ( p < end && Blank(*p) )
+        p++;
+    std::from_chars_result result = std::from_chars(p, end, count);
+    if ( result.ec != std::errc() || count < 0 )
+    {
+        Close();
+        return false;
+    }
+
+    body   = NextLine(result.ptr, end);
+    cursor = body;
+    return true;
+}
+
+void PointReader::Close()
+{
+    file.Close();
+    body   = NULL;
+    cursor = NULL;
+    count  = 0;
+}
+
+int PointReader::Read(float* x, float* y, float* z, int capacity, int stride, JobSystem* jobs)
+{
+    if ( file.GetData() == NULL || capacity <= 0 )
+        return 0;
+
+    const char* end = file.GetData() + file.GetSize();
+    int parsed = 0;
+    if ( jobs == NULL || jobs->GetThreadCount() == 1 || end - body <= CHUNK_BYTES )
+    {
+        Parse(body, end, x, y, z, capacity, stride, &parsed);
+        return parsed;
+    }
+
+    // Chunks start on the line after a multiple of the chunk size
+    int chunks = static_cast<int>((end - body + CHUNK_BYTES - 1) / CHUNK_BYTES);
+    std::vector<const char*> starts(chunks + 1);
+    starts[0]      = body;
+    starts[chunks] = end;
+    for (int c = 1; c < chunks; c++)
+        starts[c] = std::max(starts[c - 1], NextLine(body + static_cast<size_t>(c) * CHUNK_BYTES - 1, end));
+
+    // Each chunk's points go after all the points in the chunks before it
+    std::vector<int> offsets(chunks + 1, 0);
+    jobs->ParallelFor(0, chunks, 1, [&](int first, int last)
+    {
+        for (int c = first; c < last; c++)
+            offsets[c + 1] = Count(starts[c], starts[c + 1]);
+    });
+    for (int c = 0; c < chunks; c++)
+        offsets[c + 1] += offsets[c];
+
+    jobs->ParallelFor(0, chunks, 1, [&](int first, int last)
+    {
+        for (int c = first; c < last; c++)
+        {
+            if ( offsets[c] >= capacity )
+                continue;
+            size_t at = static_cast<size_t>(offsets[c]) * stride;
+            int    done;
+            Parse(starts[c], starts[c + 1], x + at, y + at, z + at, capacity - offsets[c], stride, &done);
+        }
+    });
+
+    return std::min(offsets[chunks], capacity);
+}
+
+int PointReader::Next(float* x, float* y, float* z, int capacity, int stride)
+{
+    if ( file.GetData() == NULL || capacity <= 0 )
+        return 0;
+
+    int parsed = 0;
+    cursor = Parse(cursor, file.GetData() + file.GetSize(), x, y, z, capacity, stride, &parsed);
+    return parsed;
+}
+
+int PointReader::Count(const char* begin, const char* end)
+{
+    int points = 0;
+    for (const char* p = begin; p < end; p = NextLine(p, end))
+    {
+        while ( p < end && Blank(*p) )
+            p++;
+        if ( p < end && *p != '\n' )
+            points++;
+    }
+    return points;
+}
+
+const char* PointReader::Parse(const char* begin, const char* end, float* x, float* y, float* z, int capacity, int stride, int* parsed)
+{
+    float* out[3] = { x, y, z };
+    int    points = 0;
+    const char* p = begin;
+
+    while ( p < end && points < capacity )
+    {
+        while ( p < end && Blank(*p) )
+            p++;
+        if ( p == end )
+            break;
+        if ( *p == '\n' )
+        {
+            p++;
+            continue;
+        }
+
+        size_t at = static_cast<size_t>(points) * stride;
+        for (int axis = 0; axis < 3; axis++)
+        {
+            while ( p < end && Blank(*p) )
+                p++;
+            if ( p < end && *p == '+' )
+                p++;
+
+            float value = 0.0f;
+            if ( !ParseDecimal(p, end, value) )
+            {
+                std::from_chars_result result = std::from_chars(p, end, value);
+                if ( result.ec == std::errc() || result.ec == std::errc::result_out_of_range )
+                    p = result.ptr;
+                if ( result.ec != std::errc() )
+                    value = 0.0f;
+            }
+            out[axis][at] = value;
+        }
+
+        p = NextLine(p, end);
+        points++;
+    }
+
+    *parsed = points;
+    return p;
+}
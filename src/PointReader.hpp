@@ -0,0 +1,86 @@
+#ifndef POINTREADER
+#define POINTREADER
+
+#include <cstddef>
+
+#include "JobSystem.hpp"
+#include "MappedFile.hpp"
+
+/**
+ *  Reads a text point cloud: a line with the point count, then a line of whitespace separated x y z per point.
+ *  The file is memory mapped and the numbers are parsed with std::from_chars straight off the mapped bytes, so there
+ *  are no stream objects, no locale and no copies of the text. Points are written wherever the caller says: three
+ *  separate arrays, or one interleaved array with a stride of three.
+ *  Read parses the whole file, and with a job system it splits the file into chunks on line boundaries, counts the
+ *  points in each in parallel, then parses every chunk in parallel straight into its place. Next parses a chunk at a
+ *  time from a cursor, for clouds that are streamed rather than held.
+ *  Blank lines are skipped. Every other line is a point, and a coordinate that doesn't parse is read as zero.
+ */
+class PointReader
+{
+    public:
+        PointReader();
+
+        /** Copying would map the file twice, or unmap it under the copy, so it's deleted. */
+        PointReader(const PointReader&) = delete;
+        PointReader& operator=(const PointReader&) = delete;
+
+        ~PointReader() { Close(); };
+
+        /**
+         *  Maps a file and reads its point count line.
+         *  @param path - The file to read.
+         *  @return Whether the file was mapped and starts with a count.
+         */
+        bool Open(const char* path);
+
+        /** Unmaps the file. */
+        void Close();
+
+        /**
+         *  Parses every point in the file.
+         *  @param x, y, z  - Receive the coordinates.
+         *  @param capacity - The most points there's room for; the rest are left out.
+         *  @param stride   - The number of floats from one point's coordinate to the next one's.
+         *  @param jobs     - The job system to parse in parallel with, or NULL to parse on the calling thread.
+         *  @return The number of points written.
+         */
+        int Read(float* x, float* y, float* z, int capacity, int stride = 1, JobSystem* jobs = NULL);
+
+        /**
+         *  Parses the next points after the cursor and moves it past them.
+         *  @param x, y, z  - Receive the coordinates.
+         *  @param capacity - The most points to parse.
+         *  @param stride   - The number of floats from one point's coordinate to the next one's.
+         *  @return The number of points written, zero once the file runs out.
+         */
+        int Next(float* x, float* y, float* z, int capacity, int stride = 1);
+
+        /** Moves the cursor back to the first point. */
+        void Rewind() { cursor = body; };
+
+        /** Gets the point count the file starts with, which may not match the points that follow it. */
+        int GetCount() const { return count; };
+
+        /** Gets the size of the mapped file in bytes. */
+        size_t GetSize() const { return file.GetSize(); };
+
+        static const int CHUNK_BYTES = 1 << 22; // Bytes of text each parallel job parses.
+
+    private:
+        /** Counts the points in [begin, end), which starts on a line. */
+        static int Count(const char* begin, const char* end);
+
+        /**
+         *  Parses up to capacity points from the line at begin, stopping at end.
+         *  @return Where parsing stopped, the start of a line.
+         */
+        static const char* Parse(const char* begin, const char* end, float* x, float* y, float* z, int capacity, int stride, int* parsed);
+
+        MappedFile  file;   // The mapped text.
+        const char* body;   // Start of the line after the count.
+        const char* cursor; // Where Next carries on from.
+        int         count;  // Points the file says it holds.
+};
+
+#endif
@@ -248,6 +248,70 @@ Shader::Shader(const char* vertexPath, const char* pixelPath, const char* geoPat
     //delete geoCode;
 }
 
+Shader::Shader(const char* computePath)
+{
+    // Retrieves the compute source code from filePath
+    std::string   computeCode;
+    std::ifstream cShaderFile;
+
+    // Ensures ifstream objects can throw exceptions:
+    cShaderFile.exceptions (std::ifstream::failbit | std::ifstream::badbit);
+    try 
+    {
+        cShaderFile.open(computePath);
+
+        std::stringstream cShaderStream;
+        cShaderStream << cShaderFile.rdbuf();
+        cShaderFile.close();
+
+        computeCode = cShaderStream.str();
+    }
+    catch(std::ifstream::failure e)
+    {
+        std::cerr << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << e.what() << std::endl;
+        return;
+    }
+
+    const char* cShaderCode = computeCode.c_str();
+
+    // Shader generation (compute)
+    unsigned int computeShader;
+    computeShader = glCreateShader(GL_COMPUTE_SHADER);
+
+    glShaderSource(computeShader, 1, &cShaderCode, NULL);
+    glCompileShader(computeShader);
+
+    int  success;
+    char infoLog[512];
+    glGetShaderiv(computeShader, GL_COMPILE_STATUS, &success);
+
+    if ( !success )
+    {
+        glGetShaderInfoLog(computeShader, 512, NULL, infoLog);
+        std::cerr << "ERROR::SHADER::COMPUTE::COMPILATION_FAILED" << std::endl << infoLog << std::endl;
+        return;
+    }
+
+    // Creates a shader program from the compiled shader
+    ID = glCreateProgram();
+
+    glAttachShader(ID, computeShader);
+    glLinkProgram(ID);
+
+    glGetProgramiv(ID, GL_LINK_STATUS, &success);
+
+    if ( !success ) 
+    {
+        glGetProgramInfoLog(ID, 512, NULL, infoLog);
+        std::cerr << "ERROR::SHADER::PROGRAM::LINK_FAILED" << std::endl << infoLog << std::endl;
+        return;
+    }
+
+    // Removes unneeded data and sets the Shader object's id
+    this->use();
+    glDeleteShader(computeShader);
+}
+
 void Shader::use()
 {
     glUseProgram(this->ID);
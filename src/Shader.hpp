@@ -22,6 +22,12 @@ class Shader
          */
         Shader(const char* vertexShaderPath, const char* pixelShaderPath, const char* geoPath);
 
+        /**
+         *  Reads and compiles a compute shader at the specified filename.
+         *  @param computeShaderPath - The path and filename of the compute shader you want to load.
+         */
+        Shader(const char* computeShaderPath);
+
         ~Shader()  { }; // Deconstructor
         
         /**
@@ -0,0 +1,145 @@
+#include "SimThread.hpp"
+
+#include <chrono>
+#include <algorithm>
+
+SimThread::SimThread(Simulation* sim, float step)
+{
+    simulation = sim;
+    dt         = step;
+    stepCount  = 0;
+    running    = false;
+}
+
+void SimThread::Start()
+{
+    if ( running )
+        return;
+
+    // Publish the initial state so the renderer has something to draw right away
+    Publish();
+
+    running = true;
+    thread  = std::thread(&SimThread::Run, this);
+}
+
+void SimThread::Stop()
+{
+    running = false;
+    if ( thread.joinable() )
+        thread.join();
+}
+
+void SimThread::Post(std::function<void(Simulation&)> command)
+{
+    std::lock_guard<std::mutex> lock(commandMutex);
+    commands.push_back(std::move(command));
+}
+
+const Snapshot& SimThread::Acquire()
+{
+    snapshots.Update();
+    return snapshots.Front();
+}
+
+void SimThread::TakePops(std::vector<Pop>& out)
+{
+    std::lock_guard<std::mutex> lock(popMutex);
+    out.insert(out.end(), pops.begin(), pops.end());
+    pops.clear();
+}
+
+float SimThread::GetAlpha() const
+{
+    float alpha = static_cast<float>((Now() - snapshots.Front().time) / dt);
+    return std::min(std::max(alpha, 0.0f), 1.0f);
+}
+
+double SimThread::Now()
+{
+    using namespace std::chrono;
+    return duration<double>(steady_clock::now().time_since_epoch()).count();
+}
+
+void SimThread::Run()
+{
+    std::vector<std::function<void(Simulation&)>> pending;
+    double next = Now();
+
+    while ( running )
+    {
+        // Run as many fixed steps as the wall clock asks for, but give up time instead of spiralling
+        int steps = 0;
+        while ( Now() >= next && steps < MAX_STEPS )
+        {
+            {
+                std::lock_guard<std::mutex> lock(commandMutex);
+                pending.swap(commands);
+            }
+            for (auto& command : pending)
+                command(*simulation);
+            pending.clear();
+
+            simulation->Step(dt);
+            stepCount++;
+
+            // Pops would be lost if a snapshot were skipped, so they're queued separately
+            if ( !simulation->GetPops().empty() )
+            {
+                std::lock_guard<std::mutex> lock(popMutex);
+                pops.insert(pops.end(), simulation->GetPops().begin(), simulation->GetPops().end());
+                simulation->ClearPops();
+            }
+            next += dt;
+            steps++;
+        }
+
+        if ( steps == MAX_STEPS )
+            next = Now();
+
+        if ( steps > 0 )
+            Publish();
+
+        std::this_thread::sleep_until(std::chrono::steady_clock::time_point(
+            std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(next))));
+    }
+}
+
+void SimThread::Publish()
+{
+    Snapshot& snapshot = snapshots.Back();
+    int count = simulation->GetBubbleCount();
+
+    // Ids shift when bubbles pop, so the previous state is looked up by handle. Bubbles spawned since the last
+    // publish have no previous state and start where they are
+    snapshot.current.resize(count);
+    snapshot.previous.resize(count);
+    snapshot.handles.resize(count);
+    for (int i = 0; i < count; i++)
+    {
+        const Bubble& bubble = simulation->GetBubble(i);
+        BubbleHandle handle  = simulation->GetHandle(i);
+        snapshot.current[i]  = glm::vec4(bubble.position, bubble.radius);
+        snapshot.handles[i]  = handle;
+
+        if ( handle.index >= static_cast<int>(last.size()) )
+        {
+            last.resize(handle.index + 1);
+            lastGeneration.resize(handle.index + 1, UINT32_MAX);
+        }
+
+        if ( lastGeneration[handle.index] == handle.generation )
+            snapshot.previous[i] = last[handle.index];
+        else
+            snapshot.previous[i] = snapshot.current[i];
+        last[handle.index] = snapshot.current[i];
+        lastGeneration[handle.index] = handle.generation;
+    }
+
+    snapshot.time = Now();
+    snapshot.step = stepCount;
+    snapshot.awake    = simulation->GetAwakeCount();
+    snapshot.sleeping = simulation->GetSleepingCount();
+
+    snapshots.Publish();
+}
@@ -0,0 +1,167 @@
+#ifndef SIMTHREAD
+#define SIMTHREAD
+
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <vector>
+#include <functional>
+#include <cstdint>
+
+#include <glm/glm.hpp>
+
+#include "Simulation.hpp"
+
+/**
+ *  A wait-free single-producer/single-consumer triple buffer.
+ *  The producer fills Back() and publishes it, the consumer picks up the newest published buffer with
+ *  Update() and reads Front(). Neither side ever blocks the other.
+ */
+template <typename T>
+class TripleBuffer
+{
+    public:
+        TripleBuffer()
+        {
+            back   = 0;
+            middle = 1;
+            front  = 2;
+        };
+
+        /** Gets the buffer the producer is allowed to write. */
+        T& Back() { return buffers[back]; };
+
+        /** Hands the back buffer to the consumer and takes over the previous middle buffer. */
+        void Publish()
+        {
+            back = middle.exchange(back | DIRTY) & INDEX;
+        };
+
+        /**
+         *  Swaps in the newest published buffer, if there is one.
+         *  @return True if Front() changed.
+         */
+        bool Update()
+        {
+            if ( !(middle.load() & DIRTY) )
+                return false;
+
+            front = middle.exchange(front) & INDEX;
+            return true;
+        };
+
+        /** Gets the buffer the consumer is allowed to read. */
+        const T& Front() const { return buffers[front]; };
+
+    private:
+        static const int INDEX = 3; // Mask for the buffer index.
+        static const int DIRTY = 4; // Set when the middle buffer holds unread data.
+
+        T buffers[3];
+        int back;                // Only touched by the producer.
+        std::atomic<int> middle; // Shared between both sides.
+        int front;               // Only touched by the consumer.
+};
+
+/** A copy of the bubble state published by the simulation thread for rendering. */
+struct Snapshot
+{
+    std::vector<glm::vec4>    previous; // Position (xyz) and radius (w) of each bubble one step ago.
+    std::vector<glm::vec4>    current;  // Position (xyz) and radius (w) of each bubble after the last step.
+    std::vector<BubbleHandle> handles;  // Handle of each bubble, which stays with it across snapshots.
+    double   time = 0.0;                // Wall clock time (seconds) at which current was published.
+    uint64_t step = 0;                  // Number of steps simulated so far.
+    int      awake    = 0;              // Bubbles being simulated when the snapshot was taken.
+    int      sleeping = 0;              // Bubbles asleep when the snapshot was taken.
+
+    /**
+     *  Blends a bubble between the last two simulated states.
+     *  @param index - The bubble to look up.
+     *  @param alpha - 0 for the previous state, 1 for the current one.
+     */
+    glm::vec4 Lerp(int index, float alpha) const
+    {
+        return glm::mix(previous[index], current[index], alpha);
+    };
+};
+
+/**
+ *  Runs a Simulation on its own thread with a fixed time step, decoupled from the render loop.
+ *  All access to the simulation from other threads must go through Post().
+ */
+class SimThread
+{
+    public:
+        /**
+         *  Prepares a simulation thread; call Start() to begin stepping.
+         *  @param sim - The simulation to step. It must not be touched by other threads while running.
+         *  @param dt  - The fixed time step in seconds.
+         */
+        SimThread(Simulation* sim, float dt = 1.0f / 120.0f);
+
+        SimThread(const SimThread&) = delete;
+        SimThread& operator=(const SimThread&) = delete;
+
+        /** Stops the thread if it's still running. */
+        ~SimThread() { Stop(); };
+
+        /** Starts stepping the simulation. */
+        void Start();
+
+        /** Stops stepping and waits for the thread to finish. */
+        void Stop();
+
+        /**
+         *  Queues work to run on the simulation thread before its next step.
+         *  @param command - The function to run with exclusive access to the simulation.
+         */
+        void Post(std::function<void(Simulation&)> command);
+
+        /**
+         *  Picks up the newest published state; called once per rendered frame.
+         *  @return The latest snapshot, valid until the next call.
+         */
+        const Snapshot& Acquire();
+
+        /**
+         *  Gets how far the render clock is between the previous and current state of the acquired snapshot.
+         *  @return A blend factor in [0, 1] for Snapshot::Lerp.
+         */
+        float GetAlpha() const;
+
+        /**
+         *  Takes the bubbles that popped since the last call, so they can burst on screen.
+         *  @param out - Receives the pops, appended in the order they happened.
+         */
+        void TakePops(std::vector<Pop>& out);
+
+        /** Gets the fixed time step of the simulation. */
+        float GetTimeStep() const { return dt; };
+
+    private:
+        /** The thread's main loop. */
+        void Run();
+
+        /** Copies the simulation's bubbles into the back buffer and publishes it. */
+        void Publish();
+
+        /** Gets the wall clock time in seconds. */
+        static double Now();
+
+        static const int MAX_STEPS = 8; // Steps allowed per wake-up before the simulation drops time.
+
+        Simulation* simulation;           // The simulation being stepped.
+        float dt;                         // The fixed time step.
+        uint64_t stepCount;               // Number of steps simulated so far.
+        std::thread thread;               // The simulation thread.
+        std::atomic<bool> running;        // Cleared to stop the thread.
+        std::mutex commandMutex;          // Guards commands.
+        std::vector<std::function<void(Simulation&)>> commands; // Work posted from other threads.
+        std::mutex popMutex;              // Guards pops.
+        std::vector<Pop> pops;            // Pops waiting to be taken by the render thread.
+        std::vector<glm::vec4> last;      // The state published last time by handle slot, the next previous state.
+        std::vector<uint32_t> lastGeneration; // Generation of the bubble each entry of last belongs to.
+        TripleBuffer<Snapshot> snapshots; // Snapshots shared with the render thread.
+};
+
+#endif
@@ -0,0 +1,1003 @@
+#include "Simulation.hpp"
+
+#include <limits>
+#include <algorithm>
+#include <functional>
+
+/** Steps a random number generator and returns a number in [0, 1). */
+static inline float NextRandom(uint32_t& state)
+{
+    state = state * 1664525u + 1013904223u;
+    uint32_t x = state ^ (state >> 16);
+    return static_cast<float>(x >> 8) * (1.0f / 16777216.0f);
+}
+
+Simulation::Simulation()
+{
+    jobs        = NULL;
+    air         = NULL;
+    wind        = NULL;
+    islandCount = 0;
+    time        = 0.0f;
+    freeHandle  = -1;
+}
+
+int Simulation::AddBubble(glm::vec3 position, float radius)
+{
+    int id = static_cast<int>(bubbles.size());
+
+    Bubble bubble;
+    bubble.position = position;
+    bubble.velocity = glm::vec3(0.0f);
+    bubble.radius   = radius;
+    bubble.volume   = SphereVolume(radius);
+    bubble.proxy    = tree.CreateProxy(SphereBox(position, radius), id);
+    bubble.sapProxy = broadPhase.CreateProxy(SphereBox(position, radius), id);
+    bubble.awakeIndex = static_cast<int>(awake.size());
+    bubble.sleepTime  = 0.0f;
+    bubble.expiry     = std::numeric_limits<float>::infinity();
+
+    // Reuse a handle slot a popped bubble left behind
+    if ( freeHandle != -1 )
+    {
+        bubble.handle = freeHandle;
+        freeHandle    = handleIds[freeHandle];
+        handleIds[bubble.handle] = id;
+    }
+    else
+    {
+        bubble.handle = static_cast<int>(handleIds.size());
+        handleIds.push_back(id);
+        generations.push_back(0);
+    }
+
+    // Neighbour lists of popped bubbles are kept around, so steady spawning doesn't allocate
+    bubbles.push_back(bubble);
+    if ( static_cast<int>(neighbours.size()) > id )
+        neighbours[id].clear();
+    else
+        neighbours.emplace_back();
+    awake.push_back(id);
+    return id;
+}
+
+bool Simulation::PopBubble(BubbleHandle handle)
+{
+    int id = FindBubble(handle);
+    if ( id == -1 )
+        return false;
+
+    RemoveBubble(id);
+    return true;
+}
+
+void Simulation::RemoveBubble(int id)
+{
+    pops.push_back({ bubbles[id].position, bubbles[id].velocity, bubbles[id].radius });
+
+    // Unhook the bubble from its neighbours first, then wake the ones it touched so their foam closes the gap
+    for (int other : neighbours[id])
+    {
+        std::vector<int>& list = neighbours[other];
+        auto found = std::find(list.begin(), list.end(), id);
+        if ( found != list.end() )
+        {
+            *found = list.back();
+            list.pop_back();
+        }
+    }
+    for (int other : neighbours[id])
+        if ( Touching(id, other) )
+            WakeBubble(other);
+
+    Bubble& bubble = bubbles[id];
+    tree.DestroyProxy(bubble.proxy);
+    broadPhase.DestroyProxy(bubble.sapProxy);
+
+    if ( bubble.awakeIndex != -1 )
+    {
+        int slot = bubble.awakeIndex;
+        awake[slot] = awake.back();
+        bubbles[awake[slot]].awakeIndex = slot;
+        awake.pop_back();
+    }
+
+    // Bumping the generation makes every handle to this bubble stale
+    generations[bubble.handle]++;
+    handleIds[bubble.handle] = freeHandle;
+    freeHandle = bubble.handle;
+
+    // Move the last bubble into the hole and point everything that refers to it at its new id
+    int last = static_cast<int>(bubbles.size()) - 1;
+    if ( id != last )
+    {
+        bubbles[id] = bubbles[last];
+        const Bubble& moved = bubbles[id];
+        tree.SetData(moved.proxy, id);
+        broadPhase.SetData(moved.sapProxy, id);
+        handleIds[moved.handle] = id;
+        if ( moved.awakeIndex != -1 )
+            awake[moved.awakeIndex] = id;
+
+        neighbours[id].swap(neighbours[last]);
+        for (int other : neighbours[id])
+            std::replace(neighbours[other].begin(), neighbours[other].end(), last, id);
+    }
+
+    neighbours[last].clear();
+    bubbles.pop_back();
+}
+
+void Simulation::SetLifetime(int id, float seconds)
+{
+    // An earlier entry for the same bubble is skipped when it comes up, since the expiry no longer matches
+    bubbles[id].expiry = time + seconds;
+    expiries.push_back({ bubbles[id].expiry, GetHandle(id) });
+    std::push_heap(expiries.begin(), expiries.end(), std::greater<Expiry>());
+}
+
+int Simulation::AddEmitter(const Emitter& emitter)
+{
+    emitters.push_back(emitter);
+    return static_cast<int>(emitters.size()) - 1;
+}
+
+void Simulation::UpdateLifetimes(float dt)
+{
+    time += dt;
+
+    // Pop every bubble whose time is up, soonest first
+    while ( !expiries.empty() && expiries.front().time <= time )
+    {
+        std::pop_heap(expiries.begin(), expiries.end(), std::greater<Expiry>());
+        Expiry expiry = expiries.back();
+        expiries.pop_back();
+
+        int id = FindBubble(expiry.handle);
+        if ( id != -1 && bubbles[id].expiry == expiry.time )
+            RemoveBubble(id);
+    }
+
+    for (Emitter& emitter : emitters)
+    {
+        emitter.accumulator += emitter.rate * dt;
+        int count = static_cast<int>(emitter.accumulator);
+        emitter.accumulator -= static_cast<float>(count);
+
+        for (int i = 0; i < count; i++)
+        {
+            glm::vec3 offset(NextRandom(emitter.seed), NextRandom(emitter.seed), NextRandom(emitter.seed));
+            glm::vec3 jitter(NextRandom(emitter.seed), NextRandom(emitter.seed), NextRandom(emitter.seed));
+            float radius = glm::mix(emitter.minRadius, emitter.maxRadius, NextRandom(emitter.seed));
+
+            int id = AddBubble(emitter.position + (offset * 2.0f - 1.0f) * emitter.size, radius);
+            bubbles[id].velocity = emitter.velocity + (jitter * 2.0f - 1.0f) * emitter.spread;
+            if ( emitter.lifetime > 0.0f )
+                SetLifetime(id, emitter.lifetime);
+        }
+    }
+}
+
+void Simulation::MoveBubble(int id, glm::vec3 position)
+{
+    WakeBubble(id);
+
+    Bubble& bubble = bubbles[id];
+    glm::vec3 displacement = position - bubble.position;
+
+    bubble.position = position;
+    tree.MoveProxy(bubble.proxy, SphereBox(position, bubble.radius), displacement);
+    broadPhase.MoveProxy(bubble.sapProxy, SphereBox(position, bubble.radius));
+}
+
+void Simulation::ApplyImpulse(int id, glm::vec3 impulse)
+{
+    WakeBubble(id);
+
+    Bubble& bubble = bubbles[id];
+    bubble.velocity += impulse * InverseMass(bubble.radius);
+}
+
+void Simulation::Step(float dt)
+{
+    // Spawn and pop before anything is gathered, so the ids stay put for the rest of the step
+    UpdateLifetimes(dt);
+
+    // Move the air on; a gust strong enough wakes the sleeping bubbles it reaches before the awake ones are gathered
+    if ( air != NULL )
+        air->Advance(dt);
+    if ( wind != NULL )
+        wind->Advance(dt);
+    WakeBreezed();
+
+    float damping = std::max(0.0f, 1.0f - DRAG * dt);
+    int   count   = static_cast<int>(awake.size());
+    SampleAir(awake);
+
+    // Integrate every awake bubble in parallel, remembering how far each one moved
+    displacements.resize(count);
+    ForEach(count, INTEGRATE_GRAIN, [&](int begin, int end)
+    {
+        for (int i = begin; i < end; i++)
+        {
+            Bubble& bubble = bubbles[awake[i]];
+            glm::vec3 wind = airVelocities[i];
+            if ( bubble.velocity == glm::vec3(0.0f) && wind == glm::vec3(0.0f) )
+            {
+                displacements[i] = glm::vec3(0.0f);
+                continue;
+            }
+
+            // Drag works on the velocity relative to the air, so bubbles end up drifting along with it
+            displacements[i] = bubble.velocity * dt;
+            bubble.position += displacements[i];
+            bubble.velocity  = wind + (bubble.velocity - wind) * damping;
+
+            // Let drifting bubbles come to a full stop so the broad-phase can skip them
+            if ( glm::dot(bubble.velocity, bubble.velocity) < REST_SPEED * REST_SPEED )
+                bubble.velocity = glm::vec3(0.0f);
+        }
+
+        Collide(begin, end);
+    });
+
+    // Only touch the acceleration structures for bubbles that actually moved
+    for (int i = 0; i < count; i++)
+    {
+        if ( displacements[i] == glm::vec3(0.0f) )
+            continue;
+
+        const Bubble& bubble = bubbles[awake[i]];
+        AABB box = SphereBox(bubble.position, bubble.radius);
+        tree.MoveProxy(bubble.proxy, box, displacements[i]);
+        broadPhase.MoveProxy(bubble.sapProxy, box);
+    }
+
+    // Sort the endpoints that moved, then wake whatever the moving bubbles ran into
+    broadPhase.Update();
+    UpdateNeighbours();
+    WakeTouched();
+
+    // Pairs where both bubbles sleep are never visited, so this scales with the awake bubbles
+    contacts.clear();
+    for (int id : awake)
+    {
+        for (int other : neighbours[id])
+        {
+            if ( other > id && bubbles[other].awakeIndex != -1 )
+            {
+                Contact contact;
+                contact.a = id;
+                contact.b = other;
+                contacts.push_back(contact);
+            }
+        }
+    }
+
+    // Solve every contact against the same state in parallel, then apply the results in order
+    ForEach(static_cast<int>(contacts.size()), CONTACT_GRAIN, [&](int begin, int end)
+    {
+        for (int i = begin; i < end; i++)
+            contacts[i] = SolveContact(contacts[i].a, contacts[i].b);
+    });
+
+    for (const Contact& contact : contacts)
+        if ( contact.touching )
+            ApplyContact(contact);
+
+    // Touching bubbles share films, so each island is a foam cluster that can be relaxed on its own
+    BuildIslands();
+    ForEach(static_cast<int>(islandStart.size()) - 1, FOAM_GRAIN, [&](int begin, int end)
+    {
+        for (int island = begin; island < end; island++)
+            RelaxFoam(island);
+    });
+
+    for (int i = 0; i < static_cast<int>(awake.size()); i++)
+    {
+        if ( foamMotion[i] == 0.0f )
+            continue;
+
+        const Bubble& bubble = bubbles[awake[i]];
+        AABB box = SphereBox(bubble.position, bubble.radius);
+        tree.MoveProxy(bubble.proxy, box, glm::vec3(0.0f));
+        broadPhase.MoveProxy(bubble.sapProxy, box);
+    }
+
+    SleepIslands(dt);
+}
+
+int Simulation::AddCollider(const DistanceField* field, glm::vec3 position, float scale)
+{
+    Collider collider;
+    collider.field    = field;
+    collider.position = position;
+    collider.scale    = scale;
+
+    colliders.push_back(collider);
+    MoveCollider(static_cast<int>(colliders.size()) - 1, position);
+    return static_cast<int>(colliders.size()) - 1;
+}
+
+void Simulation::MoveCollider(int id, glm::vec3 position)
+{
+    Collider& collider = colliders[id];
+    collider.position  = position;
+
+    // Sleeping bubbles are skipped by the step, so the ones the mesh landed on have to be woken
+    const AABB& bounds = collider.field->GetBounds();
+    AABB box = { position + bounds.min * collider.scale, position + bounds.max * collider.scale };
+    for (int bubble : QueryAABB(box))
+        WakeBubble(bubble);
+}
+
+void Simulation::Collide(int begin, int end)
+{
+    glm::vec3 points[COLLIDE_BATCH];
+    glm::vec3 gradients[COLLIDE_BATCH];
+    float     distances[COLLIDE_BATCH];
+    int       slots[COLLIDE_BATCH];
+
+    for (const Collider& collider : colliders)
+    {
+        const AABB& bounds = collider.field->GetBounds();
+        AABB  box     = { collider.position + bounds.min * collider.scale, collider.position + bounds.max * collider.scale };
+        float inverse = 1.0f / collider.scale;
+
+        // Only bubbles that reach into the field's box are queried, in batches in the mesh's own space
+        int i = begin;
+        while ( i < end )
+        {
+            int batch = 0;
+            for (; i < end && batch < COLLIDE_BATCH; i++)
+            {
+                const Bubble& bubble = bubbles[awake[i]];
+                if ( !Overlaps(box, bubble.position, bubble.radius) )
+                    continue;
+
+                points[batch] = (bubble.position - collider.position) * inverse;
+                slots[batch]  = i;
+                batch++;
+            }
+
+            collider.field->Query(points, distances, gradients, batch);
+            for (int b = 0; b < batch; b++)
+            {
+                Bubble& bubble = bubbles[awake[slots[b]]];
+                float distance = distances[b] * collider.scale;
+                float length   = glm::length(gradients[b]);
+                if ( distance >= bubble.radius || length == 0.0f )
+                    continue;
+
+                glm::vec3 normal = gradients[b] / length;
+                glm::vec3 push   = normal * (bubble.radius - distance);
+                bubble.position += push;
+                displacements[slots[b]] += push;
+
+                float speed = glm::dot(bubble.velocity, normal);
+                if ( speed < 0.0f )
+                    bubble.velocity -= normal * ((1.0f + RESTITUTION) * speed);
+            }
+        }
+    }
+}
+
+void Simulation::SampleAir(const std::vector<int>& ids)
+{
+    int count = static_cast<int>(ids.size());
+    airVelocities.assign(count, glm::vec3(0.0f));
+    if ( air != NULL )
+    {
+        airPositions.resize(count);
+        ForEach(count, INTEGRATE_GRAIN, [&](int begin, int end)
+        {
+            for (int i = begin; i < end; i++)
+                airPositions[i] = bubbles[ids[i]].position;
+            air->Sample(&airPositions[begin], &airVelocities[begin], end - begin);
+        });
+    }
+
+    // The breeze blows on top of the air flow; it takes its points as separate coordinate arrays
+    if ( wind != NULL )
+    {
+        for (std::vector<float>* lane : { &windX, &windY, &windZ, &windU, &windV, &windW })
+            lane->resize(count);
+
+        ForEach(count, INTEGRATE_GRAIN, [&](int begin, int end)
+        {
+            for (int i = begin; i < end; i++)
+            {
+                const glm::vec3& position = bubbles[ids[i]].position;
+                windX[i] = position.x;
+                windY[i] = position.y;
+                windZ[i] = position.z;
+            }
+
+            wind->Sample(&windX[begin], &windY[begin], &windZ[begin], &windU[begin], &windV[begin], &windW[begin], end - begin);
+            for (int i = begin; i < end; i++)
+                airVelocities[i] += glm::vec3(windU[i], windV[i], windW[i]);
+        });
+    }
+}
+
+void Simulation::WakeBreezed()
+{
+    if ( air == NULL && wind == NULL )
+        return;
+
+    sleepers.clear();
+    for (int id = 0; id < static_cast<int>(bubbles.size()); id++)
+        if ( bubbles[id].awakeIndex == -1 )
+            sleepers.push_back(id);
+    if ( sleepers.empty() )
+        return;
+
+    // Air that would have kept a bubble from falling asleep wakes it, and its island with it
+    SampleAir(sleepers);
+    for (int i = 0; i < static_cast<int>(sleepers.size()); i++)
+    {
+        const Bubble& bubble = bubbles[sleepers[i]];
+        if ( glm::length(airVelocities[i] - bubble.velocity) > SLEEP_SPEED )
+            WakeBubble(sleepers[i]);
+    }
+}
+
+void Simulation::WakeBubble(int id)
+{
+    bubbles[id].sleepTime = 0.0f;
+    if ( bubbles[id].awakeIndex != -1 )
+        return;
+
+    // Sleeping bubbles haven't moved since their island fell asleep, so the touching ones are still that island
+    bubbles[id].awakeIndex = static_cast<int>(awake.size());
+    awake.push_back(id);
+    wakeStack.push_back(id);
+
+    while ( !wakeStack.empty() )
+    {
+        int current = wakeStack.back();
+        wakeStack.pop_back();
+
+        for (int other : neighbours[current])
+        {
+            if ( bubbles[other].awakeIndex != -1 || !Touching(current, other) )
+                continue;
+
+            bubbles[other].awakeIndex = static_cast<int>(awake.size());
+            bubbles[other].sleepTime  = 0.0f;
+            awake.push_back(other);
+            wakeStack.push_back(other);
+        }
+    }
+}
+
+bool Simulation::Touching(int a, int b) const
+{
+    glm::vec3 delta = bubbles[b].position - bubbles[a].position;
+    float reach     = bubbles[a].radius + bubbles[b].radius;
+
+    return glm::dot(delta, delta) < reach * reach;
+}
+
+void Simulation::UpdateNeighbours()
+{
+    for (const SAPEvent& e : broadPhase.GetEvents())
+    {
+        int a = broadPhase.GetData(e.a);
+        int b = broadPhase.GetData(e.b);
+
+        if ( e.added )
+        {
+            neighbours[a].push_back(b);
+            neighbours[b].push_back(a);
+            continue;
+        }
+
+        // Neighbour lists are short, so a linear search and swap-remove is enough
+        for (int side = 0; side < 2; side++)
+        {
+            std::vector<int>& list = neighbours[side == 0 ? a : b];
+            int other = ( side == 0 ) ? b : a;
+            auto found = std::find(list.begin(), list.end(), other);
+            if ( found != list.end() )
+            {
+                *found = list.back();
+                list.pop_back();
+            }
+        }
+    }
+}
+
+void Simulation::WakeTouched()
+{
+    // The awake list grows while waking, and the newly woken bubbles are checked too
+    for (size_t i = 0; i < awake.size(); i++)
+    {
+        int id = awake[i];
+        for (int other : neighbours[id])
+            if ( bubbles[other].awakeIndex == -1 && Touching(id, other) )
+                WakeBubble(other);
+    }
+}
+
+int Simulation::FindRoot(int slot)
+{
+    while ( islandParent[slot] != slot )
+    {
+        islandParent[slot] = islandParent[islandParent[slot]];
+        slot = islandParent[slot];
+    }
+    return slot;
+}
+
+void Simulation::BuildIslands()
+{
+    int count = static_cast<int>(awake.size());
+
+    // Join the awake bubbles along their touching contacts
+    islandParent.resize(count);
+    for (int i = 0; i < count; i++)
+        islandParent[i] = i;
+
+    for (const Contact& contact : contacts)
+    {
+        if ( !contact.touching )
+            continue;
+
+        int a = FindRoot(bubbles[contact.a].awakeIndex);
+        int b = FindRoot(bubbles[contact.b].awakeIndex);
+        if ( a != b )
+            islandParent[a] = b;
+    }
+
+    // Number the roots, then bucket the bubbles and films of each island next to each other
+    islandOf.assign(count, -1);
+    int islands = 0;
+    for (int i = 0; i < count; i++)
+    {
+        int root = FindRoot(i);
+        if ( islandOf[root] == -1 )
+            islandOf[root] = islands++;
+        islandOf[i] = islandOf[root];
+    }
+
+    islandStart.assign(islands + 1, 0);
+    filmStart.assign(islands + 1, 0);
+    for (int i = 0; i < count; i++)
+        islandStart[islandOf[i] + 1]++;
+    for (const Contact& contact : contacts)
+        if ( contact.touching )
+            filmStart[islandOf[bubbles[contact.a].awakeIndex] + 1]++;
+
+    for (int i = 0; i < islands; i++)
+    {
+        islandStart[i + 1] += islandStart[i];
+        filmStart[i + 1]   += filmStart[i];
+    }
+
+    std::vector<int> bubbleFill(islandStart.begin(), islandStart.end() - 1);
+    std::vector<int> filmFill(filmStart.begin(), filmStart.end() - 1);
+    islandBubbles.resize(count);
+    islandFilms.resize(filmStart[islands]);
+
+    for (int i = 0; i < count; i++)
+        islandBubbles[bubbleFill[islandOf[i]]++] = i;
+    for (int i = 0; i < static_cast<int>(contacts.size()); i++)
+        if ( contacts[i].touching )
+            islandFilms[filmFill[islandOf[bubbles[contacts[i].a].awakeIndex]]++] = i;
+
+    foamMotion.assign(count, 0.0f);
+    foamVolume.resize(count);
+    foamStart.resize(count);
+    filmExposure.resize(islandFilms.size());
+}
+
+void Simulation::RelaxFoam(int island)
+{
+    int firstBubble = islandStart[island];
+    int lastBubble  = islandStart[island + 1];
+    int firstFilm   = filmStart[island];
+    int lastFilm    = filmStart[island + 1];
+
+    // Remember where the cells started so the sleep test can tell whether the foam is still settling
+    for (int i = firstBubble; i < lastBubble; i++)
+    {
+        const Bubble& bubble = bubbles[awake[islandBubbles[i]]];
+        foamStart[islandBubbles[i]] = glm::vec4(bubble.position, bubble.radius);
+    }
+
+    // Two cells that overlap behind a third one don't share a wall, they're only kept from sinking into each other.
+    // The film fades out as its rim sinks into the third cell, and fades in as the rim opens up when two cells meet,
+    // so cells don't flicker between having a wall and not having one
+    for (int f = firstFilm; f < lastFilm; f++)
+    {
+        const Contact& contact = contacts[islandFilms[f]];
+        const Bubble& one = bubbles[contact.a];
+        const Bubble& two = bubbles[contact.b];
+
+        Film film;
+        filmExposure[f] = 0.0f;
+        if ( !MakeFilm(one.position, one.radius, two.position, two.radius, &film) )
+            continue;
+
+        float settled   = one.radius * two.radius * SIN_60 / PlateauDistance(one.radius, two.radius);
+        filmExposure[f] = std::min(film.rimRadius / settled, 1.0f);
+
+        // Only cells of this island or asleep are looked at, since other islands are being relaxed at the same time;
+        // a cell deep enough to reach the film touches one of its cells anyway, so it's in this island if it's awake
+        for (int other : neighbours[contact.a])
+        {
+            if ( other == contact.b || filmExposure[f] == 0.0f )
+                continue;
+
+            const Bubble& third = bubbles[other];
+            if ( third.awakeIndex != -1 && islandOf[third.awakeIndex] != island )
+                continue;
+
+            float depth     = (third.radius - glm::length(film.center - third.position)) / (FOAM_FADE * third.radius);
+            filmExposure[f] = std::min(filmExposure[f], std::min(std::max(1.0f - depth, 0.0f), 1.0f));
+        }
+    }
+
+    for (int iteration = 0; iteration < FOAM_ITERATIONS && firstFilm < lastFilm; iteration++)
+    {
+        // Pull or push every pair of cells toward the distance at which their films meet at 120 degrees
+        for (int f = firstFilm; f < lastFilm; f++)
+        {
+            const Contact& contact = contacts[islandFilms[f]];
+            Bubble& one = bubbles[contact.a];
+            Bubble& two = bubbles[contact.b];
+
+            glm::vec3 delta = two.position - one.position;
+            float dist      = glm::length(delta);
+            if ( dist == 0.0f )
+                continue;
+
+            float error = dist - PlateauDistance(one.radius, two.radius);
+            if ( error > 0.0f )
+                error *= filmExposure[f];
+
+            float invOne    = InverseMass(one.radius);
+            float invTwo    = InverseMass(two.radius);
+            glm::vec3 shift = delta * (FOAM_STIFFNESS * error / (dist * (invOne + invTwo)));
+
+            one.position += shift * invOne;
+            two.position -= shift * invTwo;
+        }
+    }
+
+    // Add up how much gas each cell gives away to its neighbours across the shared films
+    for (int i = firstBubble; i < lastBubble; i++)
+        foamVolume[islandBubbles[i]] = SphereVolume(bubbles[awake[islandBubbles[i]]].radius);
+
+    for (int f = firstFilm; f < lastFilm; f++)
+    {
+        const Contact& contact = contacts[islandFilms[f]];
+        const Bubble& one = bubbles[contact.a];
+        const Bubble& two = bubbles[contact.b];
+
+        float da, db;
+        FilmVolumes(one.position, one.radius, two.position, two.radius, &da, &db);
+        foamVolume[one.awakeIndex] += da * filmExposure[f];
+        foamVolume[two.awakeIndex] += db * filmExposure[f];
+    }
+
+    // Inflate or deflate each cell part of the way toward holding its own gas again; neighbours compete for the
+    // same space, so going all the way makes them overshoot. Caps of crowded cells overlap and get counted twice,
+    // so the swelling is also capped to keep packed clusters from blowing up
+    for (int i = firstBubble; i < lastBubble; i++)
+    {
+        Bubble& bubble = bubbles[awake[islandBubbles[i]]];
+        float held     = std::max(foamVolume[islandBubbles[i]], 0.1f * bubble.volume);
+        float scale    = std::cbrt(bubble.volume / held);
+        float natural  = NaturalRadius(bubble.volume);
+
+        bubble.radius *= 1.0f + FOAM_INFLATE * (scale - 1.0f);
+        bubble.radius  = std::min(std::max(bubble.radius, natural), natural * FOAM_SWELL);
+    }
+
+    // A cell that no longer touches anything goes back to being a plain sphere
+    if ( firstFilm == lastFilm )
+    {
+        for (int i = firstBubble; i < lastBubble; i++)
+        {
+            Bubble& bubble = bubbles[awake[islandBubbles[i]]];
+            bubble.radius  = NaturalRadius(bubble.volume);
+        }
+    }
+
+    for (int i = firstBubble; i < lastBubble; i++)
+    {
+        const Bubble& bubble = bubbles[awake[islandBubbles[i]]];
+        glm::vec4 before     = foamStart[islandBubbles[i]];
+        foamMotion[islandBubbles[i]] = glm::length(bubble.position - glm::vec3(before))
+                                     + std::abs(bubble.radius - before.w);
+    }
+}
+
+void Simulation::SleepIslands(float dt)
+{
+    int count   = static_cast<int>(awake.size());
+    int islands = static_cast<int>(islandStart.size()) - 1;
+
+    // An island is only as sleepy as its most restless bubble; foam that is still settling counts as moving
+    islandSleep.assign(islands, std::numeric_limits<float>::max());
+    for (int i = 0; i < count; i++)
+    {
+        Bubble& bubble = bubbles[awake[i]];
+        float speed    = glm::length(bubble.velocity) + foamMotion[i] / dt;
+        if ( speed < SLEEP_SPEED )
+            bubble.sleepTime += dt;
+        else
+            bubble.sleepTime = 0.0f;
+
+        islandSleep[islandOf[i]] = std::min(islandSleep[islandOf[i]], bubble.sleepTime);
+    }
+
+    // Drop the settled islands from the awake list, keeping the order of the others
+    int write   = 0;
+    islandCount = 0;
+    for (int island = 0; island < islands; island++)
+        if ( islandSleep[island] < SLEEP_TIME )
+            islandCount++;
+
+    for (int i = 0; i < count; i++)
+    {
+        Bubble& bubble = bubbles[awake[i]];
+
+        if ( islandSleep[islandOf[i]] >= SLEEP_TIME )
+        {
+            bubble.velocity   = glm::vec3(0.0f);
+            bubble.awakeIndex = -1;
+            continue;
+        }
+
+        bubble.awakeIndex = write;
+        awake[write++]    = awake[i];
+    }
+    awake.resize(write);
+}
+
+std::vector<Film> Simulation::GetFilms()
+{
+    std::vector<Film> films;
+
+    for (int id = 0; id < GetBubbleCount(); id++)
+    {
+        for (int other : neighbours[id])
+        {
+            Film film;
+            if ( other < id || !MakeFilm(bubbles[id].position, bubbles[id].radius,
+                                         bubbles[other].position, bubbles[other].radius, &film) )
+                continue;
+
+            film.a = id;
+            film.b = other;
+            films.push_back(film);
+        }
+    }
+
+    return films;
+}
+
+Simulation::Contact Simulation::SolveContact(int a, int b) const
+{
+    Contact contact;
+    contact.a        = a;
+    contact.b        = b;
+    contact.touching = Touching(a, b);
+    contact.impulse  = glm::vec3(0.0f);
+
+    const Bubble& one = bubbles[a];
+    const Bubble& two = bubbles[b];
+
+    glm::vec3 delta = two.position - one.position;
+    float distSq    = glm::dot(delta, delta);
+    if ( !contact.touching || distSq == 0.0f )
+        return contact;
+
+    // Remove the approaching part of the relative velocity; the foam pass takes care of the overlap
+    glm::vec3 normal = delta / std::sqrt(distSq);
+    float approach   = glm::dot(two.velocity - one.velocity, normal);
+    if ( approach < 0.0f )
+        contact.impulse = normal * (-(1.0f + RESTITUTION) * approach / (InverseMass(one.radius) + InverseMass(two.radius)));
+
+    return contact;
+}
+
+void Simulation::ApplyContact(const Contact& contact)
+{
+    Bubble& one = bubbles[contact.a];
+    Bubble& two = bubbles[contact.b];
+
+    one.velocity -= contact.impulse * InverseMass(one.radius);
+    two.velocity += contact.impulse * InverseMass(two.radius);
+}
+
+int Simulation::Pick(const Ray& ray, float* t)
+{
+    int   hit     = -1;
+    float closest = std::numeric_limits<float>::max();
+
+    tree.RayCast(ray, closest, [&](int proxy, float maxT)
+    {
+        const Bubble& bubble = bubbles[tree.GetData(proxy)];
+        float d = RaySphere(ray, bubble.position, bubble.radius);
+
+        if ( d < 0.0f || d >= maxT )
+            return -1.0f;
+
+        hit     = tree.GetData(proxy);
+        closest = d;
+
+        // A hit at the origin can't be beaten, so stop there
+        return ( d > 0.0f ) ? d : 0.0f;
+    });
+
+    if ( t != NULL && hit != -1 )
+        *t = closest;
+
+    return hit;
+}
+
+std::vector<Impact> Simulation::SweepRay(const Ray& from, const Ray& to, float duration, float maxT)
+{
+    struct Candidate
+    {
+        int   id;    // The bubble.
+        float enter; // First sweep fraction at which the ray crosses the bubble.
+        float exit;  // Last sweep fraction at which the ray crosses the bubble.
+    };
+
+    glm::vec3 origin = from.origin;
+    glm::vec3 turn   = to.direction - from.direction;
+
+    // The swept rays fill a fan, so push the far corners out until the triangle covers the whole arc
+    float cosHalf = std::sqrt(std::max(0.5f * (1.0f + glm::dot(from.direction, to.direction)), 1e-4f));
+    glm::vec3 far0 = origin + from.direction * (maxT / cosHalf);
+    glm::vec3 far1 = origin + to.direction * (maxT / cosHalf);
+
+    // One pass over the tree gathers everything the fan touches
+    std::vector<Candidate> candidates;
+    tree.QueryTriangle(origin, far0, far1, [&](int proxy)
+    {
+        const Bubble& bubble = bubbles[tree.GetData(proxy)];
+        Candidate candidate;
+        candidate.id = tree.GetData(proxy);
+
+        if ( SweptRaySphere(origin, from.direction, to.direction, bubble.position, bubble.radius,
+                            &candidate.enter, &candidate.exit) )
+            candidates.push_back(candidate);
+        return true;
+    });
+
+    std::sort(candidates.begin(), candidates.end(), [](const Candidate& a, const Candidate& b)
+    {
+        return a.enter < b.enter;
+    });
+
+    // Distance along the ray at sweep fraction s to a bubble; a grazing ray uses its closest approach
+    auto distance = [&](const Ray& ray, int id)
+    {
+        float t = RaySphere(ray, bubbles[id].position, bubbles[id].radius);
+        return ( t >= 0.0f ) ? t : std::max(glm::dot(bubbles[id].position - ray.origin, ray.direction), 0.0f);
+    };
+
+    // Candidates up to the current one that the sweep is still inside of when it's entered, in sorted order
+    std::vector<int> active;
+
+    std::vector<Impact> impacts;
+    for (size_t c = 0; c < candidates.size(); c++)
+    {
+        const Candidate& candidate = candidates[c];
+        active.erase(std::remove_if(active.begin(), active.end(), [&](int i)
+        {
+            return candidates[i].exit <= candidate.enter;
+        }), active.end());
+        active.push_back(static_cast<int>(c));
+
+        // Slide past nearer bubbles until this one shows from behind them, or the sweep has left it
+        float s = candidate.enter;
+        float t = 0.0f;
+        Ray   ray;
+        bool  visible = false;
+
+        for (size_t tries = 0; tries <= candidates.size() && s <= candidate.exit; tries++)
+        {
+            ray.origin    = origin;
+            ray.direction = glm::normalize(from.direction + turn * s);
+            t = distance(ray, candidate.id);
+
+            // Only bubbles the sweep is inside of at s can hide this one: the active ones, then later ones up to s
+            auto blocks = [&](const Candidate& other)
+            {
+                if ( other.id == candidate.id || s >= other.exit )
+                    return false;
+                float d = RaySphere(ray, bubbles[other.id].position, bubbles[other.id].radius);
+                return d >= 0.0f && d < t;
+            };
+
+            const Candidate* blocker = NULL;
+            for (size_t k = 0; k < active.size() && blocker == NULL; k++)
+                if ( blocks(candidates[active[k]]) )
+                    blocker = &candidates[active[k]];
+            for (size_t j = c + 1; j < candidates.size() && candidates[j].enter <= s && blocker == NULL; j++)
+                if ( blocks(candidates[j]) )
+                    blocker = &candidates[j];
+
+            if ( blocker == NULL )
+            {
+                visible = true;
+                break;
+            }
+
+            // Hidden until the sweep ends or leaves this bubble
+            if ( blocker->exit >= candidate.exit )
+                break;
+            s = blocker->exit;
+        }
+
+        if ( !visible || t > maxT )
+            continue;
+
+        const Bubble& bubble = bubbles[candidate.id];
+
+        Impact impact;
+        impact.id      = candidate.id;
+        impact.time    = s;
+        impact.point   = origin + ray.direction * t;
+        impact.impulse = glm::vec3(0.0f);
+
+        // The hit point moves with the turning ray; treat it as an immovable paddle pushing on the film
+        if ( duration > 0.0f )
+        {
+            glm::vec3 u    = from.direction + turn * s;
+            glm::vec3 spin = (turn - ray.direction * glm::dot(ray.direction, turn)) / glm::length(u);
+            glm::vec3 push = spin * (t / duration);
+
+            glm::vec3 normal = (impact.point - bubble.position) / bubble.radius;
+            float approach   = glm::dot(push - bubble.velocity, -normal);
+            if ( approach > 0.0f )
+                impact.impulse = -normal * ((1.0f + RESTITUTION) * approach / InverseMass(bubble.radius));
+        }
+
+        impacts.push_back(impact);
+    }
+
+    std::sort(impacts.begin(), impacts.end(), [](const Impact& a, const Impact& b) { return a.time < b.time; });
+    return impacts;
+}
+
+std::vector<int> Simulation::QuerySphere(glm::vec3 center, float radius)
+{
+    std::vector<int> result;
+
+    tree.QuerySphere(center, radius, [&](int proxy)
+    {
+        const Bubble& bubble = bubbles[tree.GetData(proxy)];
+        glm::vec3 d = bubble.position - center;
+        float r     = bubble.radius + radius;
+
+        if ( glm::dot(d, d) <= r * r )
+            result.push_back(tree.GetData(proxy));
+        return true;
+    });
+
+    return result;
+}
+
+std::vector<int> Simulation::QueryAABB(const AABB& box)
+{
+    std::vector<int> result;
+
+    tree.QueryAABB(box, [&](int proxy)
+    {
+        const Bubble& bubble = bubbles[tree.GetData(proxy)];
+
+        if ( Overlaps(box, bubble.position, bubble.radius) )
+            result.push_back(tree.GetData(proxy));
+        return true;
+    });
+
+    return result;
+}
@@ -0,0 +1,441 @@
+#ifndef SIMULATION
+#define SIMULATION
+
+#include <vector>
+#include <cstdint>
+
+#include <glm/glm.hpp>
+
+#include "Geometry.hpp"
+#include "BVH.hpp"
+#include "SweepAndPrune.hpp"
+#include "JobSystem.hpp"
+#include "AirFlow.hpp"
+#include "WindField.hpp"
+#include "DistanceField.hpp"
+#include "Foam.hpp"
+
+/** The simulated state of a single bubble. */
+struct Bubble
+{
+    glm::vec3 position;   // Center of the bubble in world space.
+    glm::vec3 velocity;   // Linear velocity of the bubble.
+    float     radius;     // Radius of the bubble; grows when the bubble is squeezed into a foam.
+    float     volume;     // Volume of gas inside the bubble, which never changes.
+    int       proxy;      // Leaf of this bubble in the bounding volume hierarchy.
+    int       sapProxy;   // Proxy of this bubble in the sweep-and-prune broad-phase.
+    int       awakeIndex; // Slot of this bubble in the awake list, or -1 while it sleeps.
+    float     sleepTime;  // Seconds this bubble has been slower than the sleep threshold.
+    int       handle;     // Slot of this bubble in the handle table.
+    float     expiry;     // Simulation time at which the bubble pops, or infinity.
+};
+
+/**
+ *  A lasting reference to a bubble. Bubble ids change when other bubbles pop, handles don't; once the bubble
+ *  itself pops, its handle goes stale and stops resolving, even after the slot is reused.
+ */
+struct BubbleHandle
+{
+    int      index;      // Slot in the handle table.
+    uint32_t generation; // Generation of the slot when the handle was made.
+};
+
+/** Blows a steady stream of bubbles into the scene. */
+struct Emitter
+{
+    glm::vec3 position;    // World space point the bubbles appear at.
+    glm::vec3 velocity;    // Average velocity of a new bubble.
+    float     size;        // Half the width of the box around position that new bubbles are scattered in.
+    float     spread;      // Largest random change to the velocity, along each axis.
+    float     rate;        // Bubbles per second; 0 turns the emitter off.
+    float     minRadius;   // Smallest radius of a new bubble.
+    float     maxRadius;   // Largest radius of a new bubble.
+    float     lifetime;    // Seconds before a new bubble pops, or 0 to keep them forever.
+    float     accumulator; // Fraction of a bubble owed from earlier steps.
+    uint32_t  seed;        // State of the emitter's random numbers.
+};
+
+/** A bubble that popped, for whoever shows the burst. */
+struct Pop
+{
+    glm::vec3 position; // Center of the bubble when it popped.
+    glm::vec3 velocity; // Velocity of the bubble when it popped.
+    float     radius;   // Radius of the bubble when it popped.
+};
+
+/** A bubble hit by a sweeping ray. */
+struct Impact
+{
+    int       id;      // The bubble that was hit.
+    float     time;    // When the hit happened, as a fraction of the sweep in [0, 1].
+    glm::vec3 point;   // World space point where the ray met the bubble.
+    glm::vec3 impulse; // Impulse the moving ray hands to the bubble.
+};
+
+/**
+ *  Owns every bubble in the scene along with the spatial structures used to query them.
+ *  Bubbles that touch form islands; once every bubble in an island has been slow for a while the whole island
+ *  falls asleep and drops out of the step until a contact, impulse or move wakes it again.
+ *  Touching bubbles stick together through shared films, so every island is also a foam cluster. Each step the
+ *  clusters are relaxed in parallel toward Plateau's 120 degree junctions while every cell keeps its volume.
+ *  If an air flow or a wind field is set, air drag pulls the awake bubbles along with it. The air is also sampled at
+ *  the sleeping bubbles, and one the air blows past faster than SLEEP_SPEED wakes up with its island.
+ *  Static meshes collide with the bubbles through their baked distance fields, which costs the same for every bubble
+ *  however detailed the mesh is.
+ *  Bubbles are packed densely by id: popping one moves the last bubble into its place, so the arrays never have holes
+ *  and steady spawning and popping reuses their memory. Handles keep track of bubbles across those moves.
+ */
+class Simulation
+{
+    public:
+        Simulation();
+
+        /** Copying a simulation would duplicate the acceleration structures, so it's deleted. */
+        Simulation(const Simulation&) = delete;
+        Simulation& operator=(const Simulation&) = delete;
+
+        ~Simulation() { };
+
+        /**
+         *  Adds a bubble to the scene.
+         *  @param position - The world space center of the new bubble.
+         *  @param radius   - The radius of the new bubble.
+         *  @return The id of the new bubble, valid until a bubble pops; use GetHandle to hold on to it for longer.
+         */
+        int AddBubble(glm::vec3 position, float radius);
+
+        /**
+         *  Pops a bubble, waking the bubbles it touched. The last bubble takes over its id.
+         *  @param handle - The bubble to pop.
+         *  @return False if the bubble had already popped.
+         */
+        bool PopBubble(BubbleHandle handle);
+
+        /** Gets the bubbles that popped since the last ClearPops, on their own or through PopBubble. */
+        const std::vector<Pop>& GetPops() const { return pops; };
+
+        /** Forgets the pops that have been handled. */
+        void ClearPops() { pops.clear(); };
+
+        /** Gets a lasting handle to a bubble by id. */
+        BubbleHandle GetHandle(int id) const { return { bubbles[id].handle, generations[bubbles[id].handle] }; };
+
+        /**
+         *  Looks up the current id of a bubble.
+         *  @param handle - The bubble to look up.
+         *  @return The id of the bubble, or -1 if it has popped.
+         */
+        int FindBubble(BubbleHandle handle) const
+        {
+            if ( handle.index < 0 || handle.index >= static_cast<int>(generations.size())
+              || generations[handle.index] != handle.generation )
+                return -1;
+            return handleIds[handle.index];
+        };
+
+        /**
+         *  Makes a bubble pop on its own after a while.
+         *  @param id      - The id of the bubble.
+         *  @param seconds - How long from now the bubble pops.
+         */
+        void SetLifetime(int id, float seconds);
+
+        /**
+         *  Adds an emitter, which spawns bubbles at the start of every step.
+         *  @param emitter - The emitter; its accumulator and seed are used as given.
+         *  @return The id of the new emitter.
+         */
+        int AddEmitter(const Emitter& emitter);
+
+        /** Gets an emitter by id, to move it or change its rate. */
+        Emitter& GetEmitter(int id) { return emitters[id]; };
+
+        /**
+         *  Moves a bubble and updates the hierarchy incrementally, waking it up.
+         *  @param id       - The id of the bubble to move.
+         *  @param position - The new center of the bubble.
+         */
+        void MoveBubble(int id, glm::vec3 position);
+
+        /**
+         *  Applies an instantaneous push to a bubble, waking it up.
+         *  @param id      - The id of the bubble to push.
+         *  @param impulse - The change in momentum; lighter (smaller) bubbles react more.
+         */
+        void ApplyImpulse(int id, glm::vec3 impulse);
+
+        /**
+         *  Advances the simulation: integrates the awake bubbles, updates the broad-phase, resolves contacts and
+         *  puts idle islands to sleep.
+         *  @param dt - The time step in seconds.
+         */
+        void Step(float dt);
+
+        /**
+         *  Finds the closest bubble hit by a ray.
+         *  @param ray - The ray to cast, usually from Camera::GetRay.
+         *  @param t   - Receives the distance along the ray to the hit, may be NULL.
+         *  @return The id of the hit bubble, or -1 if nothing was hit.
+         */
+        int Pick(const Ray& ray, float* t);
+
+        /**
+         *  Sweeps a ray between two directions and collects the bubbles it runs into along the way, so fast
+         *  cursor swipes can't tunnel through bubbles between frames. Nearer bubbles hide the ones behind them
+         *  for as long as the ray crosses both. The bubbles are left untouched; apply the impulses in order.
+         *  @param from     - The ray at the start of the sweep.
+         *  @param to       - The ray at the end of the sweep; it must share the origin of from.
+         *  @param duration - How long the sweep took in seconds, which sets how hard the ray hits.
+         *  @param maxT     - The furthest distance along the ray to consider.
+         *  @return The impacts ordered by time, at most one per bubble.
+         */
+        std::vector<Impact> SweepRay(const Ray& from, const Ray& to, float duration, float maxT);
+
+        /**
+         *  Collects every bubble that intersects a sphere.
+         *  @param center - The center of the query sphere.
+         *  @param radius - The radius of the query sphere.
+         *  @return The ids of the bubbles touching the sphere.
+         */
+        std::vector<int> QuerySphere(glm::vec3 center, float radius);
+
+        /**
+         *  Collects every bubble that intersects a box.
+         *  @param box - The query box.
+         *  @return The ids of the bubbles touching the box.
+         */
+        std::vector<int> QueryAABB(const AABB& box);
+
+        /**
+         *  Collects the films shared by every pair of touching bubbles, sleeping or not.
+         *  @return One film per touching pair.
+         */
+        std::vector<Film> GetFilms();
+
+        /** Gets a bubble by id. */
+        Bubble& GetBubble(int id) { return bubbles[id]; };
+
+        /** Gets the number of bubbles in the scene. */
+        int GetBubbleCount() { return static_cast<int>(bubbles.size()); };
+
+        /**
+         *  Wakes a bubble along with every sleeping bubble connected to it.
+         *  @param id - The id of the bubble to wake.
+         */
+        void WakeBubble(int id);
+
+        /** Checks whether a bubble is being simulated. */
+        bool IsAwake(int id) { return bubbles[id].awakeIndex != -1; };
+
+        /** Gets the number of bubbles being simulated. */
+        int GetAwakeCount() { return static_cast<int>(awake.size()); };
+
+        /** Gets the number of bubbles that are asleep. */
+        int GetSleepingCount() { return GetBubbleCount() - GetAwakeCount(); };
+
+        /** Gets the number of contact islands among the awake bubbles after the last step. */
+        int GetIslandCount() { return islandCount; };
+
+        /** Gets the bounding volume hierarchy over the bubbles. */
+        const BVH& GetTree() { return tree; };
+
+        /** Gets the sweep-and-prune broad-phase, whose pairs and events describe the bubble contacts. */
+        const SweepAndPrune& GetBroadPhase() { return broadPhase; };
+
+        /**
+         *  Sets the job system used to integrate bubbles and solve contacts in parallel.
+         *  @param jobs - The job system to use, or NULL to run on the calling thread.
+         */
+        void SetJobSystem(JobSystem* jobs) { this->jobs = jobs; };
+
+        /**
+         *  Sets the air the bubbles drift in; it's stepped along with the simulation.
+         *  @param air - The air flow to use, or NULL for still air everywhere.
+         */
+        void SetAirFlow(AirFlow* air) { this->air = air; };
+
+        /** Gets the air the bubbles drift in, or NULL if the air is still. */
+        AirFlow* GetAirFlow() { return air; };
+
+        /**
+         *  Sets a procedural breeze that blows on top of the air flow; it's advanced along with the simulation.
+         *  @param wind - The wind field to use, or NULL for no breeze.
+         */
+        void SetWindField(WindField* wind) { this->wind = wind; };
+
+        /**
+         *  Adds a static mesh that pushes bubbles out of itself. The field isn't copied and must outlive the simulation.
+         *  Bubbles are only pushed once their center is inside the field's band, so the band should be at least the radius
+         *  of the largest bubble, measured in the mesh's space.
+         *  @param field    - The distance field of the mesh.
+         *  @param position - Where the origin of the mesh's space sits in the world.
+         *  @param scale    - The uniform scale of the mesh in the world.
+         *  @return The id of the new collider.
+         */
+        int AddCollider(const DistanceField* field, glm::vec3 position, float scale);
+
+        /**
+         *  Moves a collider, waking the bubbles around its new place so they get pushed out.
+         *  @param id       - The id of the collider to move.
+         *  @param position - The new world space position of the mesh's origin.
+         */
+        void MoveCollider(int id, glm::vec3 position);
+
+    private:
+        /** A static mesh placed in the world. */
+        struct Collider
+        {
+            const DistanceField* field; // Distance field of the mesh.
+            glm::vec3 position;         // World space position of the mesh's origin.
+            float     scale;            // Uniform scale of the mesh.
+        };
+
+        /** The response to one touching pair, computed in parallel and applied afterwards. */
+        struct Contact
+        {
+            int       a;          // The first bubble.
+            int       b;          // The second bubble.
+            bool      touching;   // False if the broad-phase pair doesn't actually touch.
+            glm::vec3 impulse;    // Impulse applied to b (and subtracted from a).
+        };
+
+        /**
+         *  Works out the impulse that stops two touching bubbles from moving into each other.
+         *  @param a - The id of the first bubble.
+         *  @param b - The id of the second bubble.
+         */
+        Contact SolveContact(int a, int b) const;
+
+        /** Applies a solved contact to the velocities of its two bubbles. */
+        void ApplyContact(const Contact& contact);
+
+        /** A bubble waiting to pop once the clock reaches its time. */
+        struct Expiry
+        {
+            float        time;   // Simulation time at which the bubble pops.
+            BubbleHandle handle; // The bubble; stale if it already popped some other way.
+
+            bool operator>(const Expiry& other) const { return time > other.time; };
+        };
+
+        /** Spawns the bubbles the emitters owe and pops the ones whose lifetime ran out. */
+        void UpdateLifetimes(float dt);
+
+        /** Removes a bubble, moving the last bubble into its id. */
+        void RemoveBubble(int id);
+
+        /**
+         *  Pushes a range of awake bubbles out of every collider and takes away the speed they had into it.
+         *  @param begin - The first awake list slot.
+         *  @param end   - One past the last awake list slot.
+         */
+        void Collide(int begin, int end);
+
+        /** Checks whether two bubbles overlap. */
+        bool Touching(int a, int b) const;
+
+        /** Keeps the per-bubble neighbour lists in sync with the broad-phase pair events. */
+        void UpdateNeighbours();
+
+        /** Wakes sleeping bubbles that a moving bubble has started touching. */
+        void WakeTouched();
+
+        /**
+         *  Samples the air flow and the wind at some bubbles into airVelocities, in parallel.
+         *  @param ids - The ids of the bubbles.
+         */
+        void SampleAir(const std::vector<int>& ids);
+
+        /** Wakes sleeping bubbles the air is blowing past fast enough to keep them awake. */
+        void WakeBreezed();
+
+        /** Groups the awake bubbles into islands along their touching contacts, bucketing bubbles and films. */
+        void BuildIslands();
+
+        /**
+         *  Relaxes one foam cluster: moves its cells toward 120 degree junctions and resizes them to keep their
+         *  volumes. Only touches the island's own bubbles, so islands can be relaxed in parallel.
+         *  @param island - The island to relax.
+         */
+        void RelaxFoam(int island);
+
+        /** Puts the islands that have settled to sleep. */
+        void SleepIslands(float dt);
+
+        /** Finds the island root of an awake list slot, compressing the path on the way. */
+        int FindRoot(int slot);
+
+        /** Runs body(begin, end) over [0, count), in parallel if a job system is set. */
+        template <typename Body>
+        void ForEach(int count, int grain, const Body& body)
+        {
+            if ( jobs != NULL )
+                jobs->ParallelFor(0, count, grain, body);
+            else if ( count > 0 )
+                body(0, count);
+        };
+
+        /** Gets the inverse mass of a bubble; the film mass grows with the surface area. */
+        static float InverseMass(float radius) { return 1.0f / (radius * radius); };
+
+        /** Gets the radius of a free bubble holding the given volume of gas. */
+        static float NaturalRadius(float volume) { return std::cbrt(volume * 3.0f / (4.0f * glm::pi<float>())); };
+
+        static constexpr float DRAG           = 0.5f;  // Fraction of velocity relative to the air lost per second.
+        static constexpr float RESTITUTION    = 0.2f;  // Bounciness of bubble-bubble contacts.
+        static constexpr float REST_SPEED     = 1e-3f; // Speed below which a bubble is stopped.
+        static constexpr float SLEEP_SPEED    = 0.05f; // Speed below which a bubble counts as idle.
+        static constexpr float SLEEP_TIME     = 0.5f;  // Seconds an island has to be idle before it sleeps.
+        static constexpr float FOAM_STIFFNESS = 0.5f;  // Fraction of a film's length error fixed per iteration.
+        static constexpr float FOAM_INFLATE   = 0.25f; // Fraction of a cell's volume error fixed per step.
+        static constexpr float FOAM_SWELL     = 1.3f;  // Largest radius of a cell relative to a free bubble.
+        static constexpr float FOAM_FADE      = 0.2f;  // Depth, relative to a cell's radius, over which walls fade.
+        static constexpr float SIN_60         = 0.8660254f; // Rim radius of a settled film over ra * rb / distance.
+        static const int FOAM_ITERATIONS = 4;       // Relaxation sweeps per cluster per step.
+        static const int FOAM_GRAIN      = 16;      // Islands relaxed per job.
+        static const int INTEGRATE_GRAIN = 4096;    // Bubbles integrated per job.
+        static const int CONTACT_GRAIN   = 2048;    // Contacts solved per job.
+        static const int COLLIDE_BATCH   = 64;      // Bubbles queried against a distance field at a time.
+
+        std::vector<Bubble> bubbles; // Every bubble in the scene, indexed by id.
+        BVH tree;                    // Dynamic hierarchy over the bubble bounds.
+        SweepAndPrune broadPhase;    // Incremental broad-phase used to find touching bubbles.
+        JobSystem* jobs;             // Job system for the parallel passes, may be NULL.
+        AirFlow* air;                // Air flow the bubbles drift in, may be NULL.
+        WindField* wind;             // Breeze blowing on top of the air flow, may be NULL.
+        std::vector<Collider> colliders; // Static meshes the bubbles bump into.
+        std::vector<Emitter>  emitters;  // Sources of new bubbles.
+        std::vector<Expiry>   expiries;  // Min-heap of the bubbles with a lifetime, soonest first.
+        std::vector<Pop>      pops;      // Bubbles popped since the last ClearPops.
+        float time;                      // Seconds simulated so far.
+
+        std::vector<int>      handleIds;   // Bubble id of every handle slot, or the next free slot.
+        std::vector<uint32_t> generations; // Generation of every handle slot, bumped when its bubble pops.
+        int freeHandle;                    // First free handle slot, or -1.
+
+        std::vector<glm::vec3> displacements; // Per-step movement of each bubble.
+        std::vector<int>       sleepers;      // Ids of the sleeping bubbles, gathered for sampling the air.
+        std::vector<glm::vec3> airPositions;  // Positions of the sampled bubbles, gathered for sampling the air.
+        std::vector<glm::vec3> airVelocities; // Air velocity at each sampled bubble.
+        std::vector<float> windX, windY, windZ; // Coordinates of the sampled bubbles, gathered for the wind field.
+        std::vector<float> windU, windV, windW; // Wind velocity at each sampled bubble.
+        std::vector<Contact>   contacts;      // Per-step contact responses.
+
+        std::vector<int> awake;                   // Ids of the bubbles being simulated.
+        std::vector<std::vector<int>> neighbours; // Bubbles whose bounds overlap each bubble's, from the broad-phase.
+        std::vector<int> islandParent;            // Union-find forest over the awake list slots.
+        std::vector<int> islandOf;                // Island of each awake list slot.
+        std::vector<int> islandStart;             // First entry of each island in islandBubbles, plus an end.
+        std::vector<int> islandBubbles;           // Awake list slots grouped by island.
+        std::vector<int> filmStart;               // First entry of each island in islandFilms, plus an end.
+        std::vector<int> islandFilms;             // Touching contacts grouped by island.
+        std::vector<float> filmExposure;          // How much of each island film is a real wall, 0 when buried.
+        std::vector<float> islandSleep;           // Shortest idle time found in each island.
+        std::vector<float> foamVolume;            // Gas each cell holds given its films, per awake list slot.
+        std::vector<float> foamMotion;            // How far the foam pass moved or resized each cell.
+        std::vector<glm::vec4> foamStart;         // Position and radius of each cell before the foam pass.
+        std::vector<int> wakeStack;               // Scratch stack for flooding through sleeping neighbours.
+        int islandCount;                          // Islands among the awake bubbles after the last step.
+};
+
+#endif
@@ -1,9 +1,13 @@
 #include "Sphere.hpp"
 
 #include <vector>
+#include <algorithm>
+#include <cmath>
 #include <iostream>
 #include <array>
 #include <map>
+#include <unordered_map>
+#include <cstdint>
 
 #include <glm/glm.hpp>
 
@@ -15,8 +19,10 @@ using namespace glm;
 Sphere::Sphere(float r)
 {
     // Generates default vertices
+    jobs    = NULL;
+    dented  = false;
     radius  = r;
-    float t = (1.0 + std::sqrtf(5.0)) / 2.0;
+    float t = (1.0 + std::sqrt(5.0)) / 2.0;
 
     // Fix the radius so each side is of length sqrt(t^2 +1)
     radius /= sqrt( t * t + 1.0 );
@@ -60,9 +66,9 @@ Sphere::Sphere(float r)
     }
 
     // Scale vertices to the radius
-    for (int i = 0; i <= vertices.size(); i++)
+    for (size_t i = 0; i < vertices.size(); i++)
     {
-        float scale = radius / std::sqrtf
+        float scale = radius / std::sqrt
         (
             (vertices[i][0] * vertices[i][0]) +
             (vertices[i][1] * vertices[i][1]) +
@@ -108,6 +114,7 @@ Sphere::Sphere(float r)
     };
 
     GenerateNormals();
+    BuildTension();
 
     counter = 11;
 }
@@ -183,65 +190,75 @@ void Sphere::Divide(int divisions)
 {
     for (int i = 0; i < divisions; i++)
         Subdivision();
+
+    // The triangles changed, so the curvature operator has to be built again
+    BuildTension();
 }
 
 void Sphere::Subdivision()
 {
     // Creates a new indices set (instead of keeping the old, larger lines)
-    std::vector<std::array<unsigned int, 3>> oldInds  = indices;
-    std::vector<std::array<float,        3>> oldVerts = vertices;
-    indices.clear();
-    vertices.clear();
-
-    // A map of vertex pairs with a unique id; allows better comparison than float == float (currently unchecked)
-    //Map map;
-    std::array<unsigned int, 3> oldTriad  = {0u, 0u, 0u};
-    std::array<unsigned int, 3> triad     = {0u, 0u, 0u};
-    std::array<unsigned int, 3> tempTriad = {0u, 0u, 0u};
-    std::vector<std::array<float, 3>> triangle;
-
-    // Loop through each index triad/triangle
-    for (auto tri : oldInds)
-    {
-        // Adds the old vertices/indices to the new list (for indexing purposes)
-        for (int i = 0; i < 3; i++)
-            oldTriad[i] = AddVertex(oldVerts[tri[i]]).first; // Unchecked addition
-
-        /*// Normals - INCOMPLETE
-        ///Calculate two edge of the triangle
-        //Vector3f edge1 = subtract(v0, v1);
-        //Vector3f edge2 = subtract(v1, v2);
-        
+    std::vector<std::array<unsigned int, 3>> oldInds;
+    oldInds.swap(indices);
+    unsigned int oldCount = static_cast<unsigned int>(vertices.size());
 
-        //Calculate face normal
-        //Vector3f normal = normalize(crossProduct(edge1, edge2));
-        */
+    // Gives every unique edge one new vertex id, keyed on the sorted vertex pair (no float == float checks)
+    std::unordered_map<uint64_t, unsigned int> edgeMap;
+    std::vector<std::array<unsigned int, 2>> edges;
+    std::vector<std::array<unsigned int, 3>> mids(oldInds.size());
+    edgeMap.reserve(oldInds.size() * 2);
 
-        // Gets the midpoint of each triangle edge
-        //        o
-        //      o   o
-        //     o  o  o
-        triangle.clear();
-        triangle.push_back(MidPoint(oldTriad[0], oldTriad[1])); // Vertex 1
-        triangle.push_back(MidPoint(oldTriad[1], oldTriad[2])); // Vertex 2
-        triangle.push_back(MidPoint(oldTriad[2], oldTriad[0])); // Vertex 3
+    for (size_t t = 0; t < oldInds.size(); t++)
+    {
+        for (int i = 0; i < 3; i++)
+        {
+            unsigned int a = oldInds[t][i];
+            unsigned int b = oldInds[t][(i + 1) % 3];
+            uint64_t key   = ( a < b ) ? (static_cast<uint64_t>(a) << 32 | b) : (static_cast<uint64_t>(b) << 32 | a);
+
+            auto inserted = edgeMap.emplace(key, oldCount + static_cast<unsigned int>(edges.size()));
+            if ( inserted.second )
+                edges.push_back({a, b});
+            mids[t][i] = inserted.first->second;
+        }
+    }
 
-        // Adds the new vertices to the new list
-        for (int j = 0; j < 3; j++)
-            triad[j] = AddVertex(triangle[j]).first; // Unchecked addition
-        
-        // Pushes the four new triangles to the end of the new indices list
-        tempTriad = { oldTriad[0], triad[0], triad[2] };
-        indices.push_back(tempTriad);
+    // Gets the midpoint of each triangle edge (only reads the old vertices, so every edge is independent)
+    //        o
+    //      o   o
+    //     o  o  o
+    vertices.resize(oldCount + edges.size());
+    auto midPoints = [&](int begin, int end)
+    {
+        for (int e = begin; e < end; e++)
+            vertices[oldCount + e] = MidPoint(edges[e][0], edges[e][1]);
+    };
 
-        tempTriad = { oldTriad[1], triad[1], triad[0] };
-        indices.push_back(tempTriad);
+    // Pushes the four new triangles of each old one to the new indices list
+    indices.resize(oldInds.size() * 4);
+    auto triangles = [&](int begin, int end)
+    {
+        for (int t = begin; t < end; t++)
+        {
+            const std::array<unsigned int, 3>& oldTriad = oldInds[t];
+            const std::array<unsigned int, 3>& triad    = mids[t];
 
-        tempTriad = { oldTriad[2], triad[2], triad[1] };
-        indices.push_back(tempTriad);
+            indices[4 * t + 0] = { oldTriad[0], triad[0], triad[2] };
+            indices[4 * t + 1] = { oldTriad[1], triad[1], triad[0] };
+            indices[4 * t + 2] = { oldTriad[2], triad[2], triad[1] };
+            indices[4 * t + 3] = { triad[0], triad[1], triad[2] };
+        }
+    };
 
-        tempTriad = { triad[0], triad[1], triad[2] };
-        indices.push_back(tempTriad);
+    if ( jobs != NULL )
+    {
+        jobs->ParallelFor(0, static_cast<int>(edges.size()),   PARALLEL_GRAIN, midPoints);
+        jobs->ParallelFor(0, static_cast<int>(oldInds.size()), PARALLEL_GRAIN, triangles);
+    }
+    else
+    {
+        midPoints(0, static_cast<int>(edges.size()));
+        triangles(0, static_cast<int>(oldInds.size()));
     }
 }
 
@@ -300,7 +317,7 @@ std::pair<unsigned int, bool> Sphere::AddVertex(std::array<float,3> vertex/*, Ma
             newVertex[i] = (vertices[x][i] + vertices[y][i]) / 2.0f;
 
         // Scale the new vertices to the unit circle (normalization)
-        float scale = radius / std::sqrtf
+        float scale = radius / std::sqrt
             (
                 newVertex[0] * newVertex[0] + 
                 newVertex[1] * newVertex[1] + 
@@ -328,7 +345,7 @@ std::array<float,3> Sphere::MidPoint(unsigned int x, unsigned int y)
         newVertex[i] = (vertices[x][i] + vertices[y][i]) / 2.0f;
 
     // Scale the new vertices to the unit circle (normalization)
-    float scale = radius / std::sqrtf
+    float scale = radius / std::sqrt
         (
             (newVertex[0] * newVertex[0]) + 
             (newVertex[1] * newVertex[1]) + 
@@ -370,6 +387,8 @@ void Sphere::Collision(std::array<float,3> vertex, float magnitude)
             vertices[i][j] *= (euDist * (1 + magnitude));
         }
     }
+
+    dented = true;
 }
 
 std::array<float,3> Sphere::FindCenter()
@@ -420,7 +439,7 @@ std::array<float, 3> Sphere::FaceNormal(std::array<float, 3> v1, std::array<floa
 
 std::array<float, 3> Sphere::Normalize(std::array<float, 3> vector)
 {
-    float length = std::sqrtf(std::powf(vector[0], 2) + std::powf(vector[1], 2) + std::powf(vector[2], 2));
+    float length = std::sqrt(std::pow(vector[0], 2) + std::pow(vector[1], 2) + std::pow(vector[2], 2));
 
     vector[0] /= length;
     vector[1] /= length;
@@ -440,17 +459,202 @@ void Sphere::GenerateNormals()
         normals.clear();
 
     normals.resize(vertices.size());
-    
+
+    // Lists the triangles around each vertex (compressed rows), so every vertex can be summed independently
+    std::vector<unsigned int> offsets(vertices.size() + 1, 0u);
     for ( auto tri : indices )
+        for (int i = 0; i < 3; i++)
+            offsets[tri[i] + 1]++;
+    for (size_t v = 0; v < vertices.size(); v++)
+        offsets[v + 1] += offsets[v];
+
+    std::vector<unsigned int> faces(offsets.back());
+    std::vector<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+    for (size_t t = 0; t < indices.size(); t++)
+        for (int i = 0; i < 3; i++)
+            faces[fill[indices[t][i]]++] = static_cast<unsigned int>(t);
+
+    // Sums the unnormalized face normals, which weights each face by its area
+    auto gather = [&](int begin, int end)
     {
-        auto result = FaceNormal(vertices[tri[0]], vertices[tri[1]], vertices[tri[2]]);
+        for (int v = begin; v < end; v++)
+        {
+            std::array<float, 3> sum = {0.0f, 0.0f, 0.0f};
+            for (unsigned int f = offsets[v]; f < offsets[v + 1]; f++)
+            {
+                const std::array<unsigned int, 3>& tri = indices[faces[f]];
+                std::array<float, 3> result = FaceNormal(vertices[tri[0]], vertices[tri[1]], vertices[tri[2]]);
+
+                sum[0] += result[0];
+                sum[1] += result[1];
+                sum[2] += result[2];
+            }
+            normals[v] = sum;
+        }
+    };
 
-        normals[tri[0]] = result;
-        normals[tri[1]] = result;
-        normals[tri[2]] = result;
-    }
+    if ( jobs != NULL )
+        jobs->ParallelFor(0, static_cast<int>(vertices.size()), PARALLEL_GRAIN, gather);
+    else
+        gather(0, static_cast<int>(vertices.size()));
 
     // output result
     //for ( auto normal : normals )
     //    std::cout << "Normal: (" << normal[0] << ", " << normal[1] << ", " << normal[2] << ")." << std::endl;
 }
+
+void Sphere::BuildTension()
+{
+    tension.Build(GetVertices(), GetIndices());
+    restVolume = Volume();
+
+    valence.assign(vertices.size(), 0);
+    for (const std::array<unsigned int, 3>& triad : indices)
+        for (unsigned int v : triad)
+            valence[v] += 2;
+}
+
+float Sphere::Volume()
+{
+    // Sum the signed volumes of the tetrahedra between the origin and every triangle
+    double volume = 0.0;
+    for (const std::array<unsigned int, 3>& tri : indices)
+    {
+        glm::vec3 a(vertices[tri[0]][0], vertices[tri[0]][1], vertices[tri[0]][2]);
+        glm::vec3 b(vertices[tri[1]][0], vertices[tri[1]][1], vertices[tri[1]][2]);
+        glm::vec3 c(vertices[tri[2]][0], vertices[tri[2]][1], vertices[tri[2]][2]);
+        volume += glm::dot(a, glm::cross(b, c));
+    }
+    return static_cast<float>(volume / 6.0);
+}
+
+bool Sphere::Relax(float dt)
+{
+    // An undented mesh is already round, so there is nothing for the flow to do
+    int count = static_cast<int>(vertices.size());
+    if ( !dented || count == 0 || dt <= 0.0f )
+        return false;
+
+    x.resize(count);
+    y.resize(count);
+    z.resize(count);
+    fx.resize(count);
+    fy.resize(count);
+    fz.resize(count);
+    nx.resize(count);
+    ny.resize(count);
+    nz.resize(count);
+    sx.resize(count);
+    sy.resize(count);
+    sz.resize(count);
+    for (int i = 0; i < count; i++)
+    {
+        x[i] = vertices[i][0];
+        y[i] = vertices[i][1];
+        z[i] = vertices[i][2];
+    }
+
+    // The explicit flow is stable while no vertex moves further than its neighbours pull it. Crushed vertices
+    // with tiny areas would hold the whole mesh to tiny steps, so past the substep limit each vertex is slowed
+    // down to its own stable step instead
+    tension.Update(x.data(), y.data(), z.data());
+    float rate     = TENSION * tension.GetMaxRate();
+    int   substeps = std::min(MAX_SUBSTEPS, std::max(1, static_cast<int>(std::ceil(dt * rate / STABILITY))));
+    float step     = dt / substeps;
+
+    float moved = 0.0f;
+    const std::vector<float>& areas    = tension.GetAreas();
+    const std::vector<float>& diagonal = tension.GetDiagonal();
+    for (int s = 0; s < substeps; s++)
+    {
+        // Surface tension over the vertex's area is the mean curvature normal. Only its part along the normal
+        // changes the shape, and the pressure of the air inside pushes back evenly so the volume stays put
+        tension.Forces(x.data(), y.data(), z.data(), fx.data(), fy.data(), fz.data(), TENSION);
+        tension.Normals(x.data(), y.data(), z.data(), nx.data(), ny.data(), nz.data());
+
+        double push = 0.0, area = 0.0;
+        for (int i = 0; i < count; i++)
+        {
+            push += fx[i] * nx[i] + fy[i] * ny[i] + fz[i] * nz[i];
+            area += areas[i];
+        }
+        float pressure = area > 0.0 ? static_cast<float>(-push / area) : 0.0f;
+
+        // The flow alone leaves crushed vertices where a dent put them, so they also slide along the surface
+        // toward the middle of their neighbours; every neighbour shows up twice around a closed mesh
+        std::fill(sx.begin(), sx.end(), 0.0f);
+        std::fill(sy.begin(), sy.end(), 0.0f);
+        std::fill(sz.begin(), sz.end(), 0.0f);
+        for (const std::array<unsigned int, 3>& triad : indices)
+        {
+            for (int c = 0; c < 3; c++)
+            {
+                unsigned int a = triad[(c + 1) % 3], b = triad[(c + 2) % 3];
+                sx[triad[c]] += x[a] + x[b];
+                sy[triad[c]] += y[a] + y[b];
+                sz[triad[c]] += z[a] + z[b];
+            }
+        }
+        float slide = std::min(1.0f, SMOOTHING * step);
+
+        auto flow = [&](int begin, int end)
+        {
+            for (int i = begin; i < end; i++)
+            {
+                if ( areas[i] <= 0.0f || valence[i] == 0 )
+                    continue;
+
+                float speed = (fx[i] * nx[i] + fy[i] * ny[i] + fz[i] * nz[i]) / areas[i] + pressure;
+                float limit = STABILITY * areas[i] / std::max(TENSION * diagonal[i], 1e-12f);
+                float move  = speed * std::min(step, limit);
+
+                glm::vec3 normal(nx[i], ny[i], nz[i]);
+                glm::vec3 toMiddle = glm::vec3(sx[i], sy[i], sz[i]) / static_cast<float>(valence[i]) - glm::vec3(x[i], y[i], z[i]);
+                glm::vec3 offset   = normal * move + (toMiddle - normal * glm::dot(toMiddle, normal)) * slide;
+                x[i] += offset.x;
+                y[i] += offset.y;
+                z[i] += offset.z;
+            }
+        };
+        if ( jobs != NULL )
+            jobs->ParallelFor(0, count, PARALLEL_GRAIN, flow);
+        else
+            flow(0, count);
+
+        if ( s + 1 < substeps )
+            tension.Update(x.data(), y.data(), z.data());
+    }
+
+    // The pressure only keeps the volume to first order, so scale away what's left about the center
+    glm::vec3 center(0.0f);
+    for (int i = 0; i < count; i++)
+        center += glm::vec3(x[i], y[i], z[i]);
+    center /= static_cast<float>(count);
+
+    std::vector<std::array<float, 3>> previous;
+    previous.swap(vertices);
+    vertices.resize(count);
+    for (int i = 0; i < count; i++)
+        vertices[i] = { x[i], y[i], z[i] };
+
+    float volume = Volume();
+    float grow   = volume > 0.0f ? std::cbrt(restVolume / volume) : 1.0f;
+    for (int i = 0; i < count; i++)
+    {
+        for (int j = 0; j < 3; j++)
+        {
+            vertices[i][j] = center[j] + (vertices[i][j] - center[j]) * grow;
+            moved = std::max(moved, std::abs(vertices[i][j] - previous[i][j]));
+        }
+    }
+
+    if ( moved < SETTLED * radius )
+    {
+        vertices.swap(previous);
+        dented = false;
+        return false;
+    }
+
+    GenerateNormals();
+    return true;
+}
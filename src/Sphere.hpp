@@ -6,6 +6,9 @@
 #include <array>
 #include <glm/glm.hpp>
 
+#include "JobSystem.hpp"
+#include "SurfaceTension.hpp"
+
 /**
  *  A class that represents a Spherical drawable.
  *  Contains member functions for icosahedron generation and spherical division.
@@ -58,12 +61,34 @@ class Sphere
          */
         void Divide(int iterations);
 
-        /** Divides the current icosahedron into more triangles. */
+        /**
+         *  Divides the current icosahedron into more triangles.
+         *  Each edge gets exactly one new vertex; the vertex positions and triangles are built in parallel.
+         */
         void Subdivision();
 
-        /** Generates normals for the current vertex array. */
+        /** Generates smooth (area weighted) normals for the current vertex array, in parallel per vertex. */
         void GenerateNormals();
 
+        /**
+         *  Lets surface tension pull the mesh back toward a sphere after it was dented, keeping its volume.
+         *  The vertices move along their normals with the mean curvature flow, against an even pressure that keeps the
+         *  volume the mesh had when it was divided, in as many substeps as the explicit flow needs to stay stable.
+         *  @param dt - The time that has passed in seconds.
+         *  Does nothing until Collision dents the mesh, and stops again once the mesh has settled.
+         *  @return True if the mesh moved enough to be worth uploading again; the normals are regenerated if so.
+         */
+        bool Relax(float dt);
+
+        /** Works out the volume enclosed by the mesh. */
+        float Volume();
+
+        /**
+         *  Sets the job system used to parallelize subdivision, normal generation and relaxation.
+         *  @param jobs - The job system to use, or NULL to run on the calling thread.
+         */
+        void SetJobSystem(JobSystem* jobs) { this->jobs = jobs; tension.SetJobSystem(jobs); };
+
         /**
          *  Calculates the vertex normal values for the triangle provided.
          *  @param v1 - The first vertex in the triangle.
@@ -127,8 +152,28 @@ class Sphere
         std::vector<std::array<float,3>       > normals;  // The list of normals corresponding to each vertex.
         std::vector<std::array<unsigned int,3>> indices;  // A list of the triangle indices formed from this shape's vertices.
 
+        /** Builds the surface tension operator for the current triangles and remembers the volume to keep. */
+        void BuildTension();
+
+        static const int PARALLEL_GRAIN = 2048; // Elements handled per job in the parallel passes.
+        static constexpr float TENSION   = 0.5f;  // Surface tension times mobility: curvature flow speed per unit of mean curvature.
+        static constexpr float STABILITY = 0.4f;  // Largest fraction of the explicit flow's stable step taken per substep.
+        static constexpr float SMOOTHING = 2.0f;  // Rate at which vertices slide toward the middle of their neighbours, per second.
+        static constexpr float SETTLED   = 1e-4f; // Largest movement, relative to the radius, that isn't worth uploading.
+        static constexpr int   MAX_SUBSTEPS = 16;  // Substeps per Relax call at most; slower frames relax less.
+
         float radius;         // The spherical radius of this icosahedron.
         unsigned int counter; // Counter for unique keys
+        JobSystem* jobs;      // Job system for the parallel passes, may be NULL.
+        bool dented;          // Set by Collision, cleared once Relax has settled the mesh.
+
+        SurfaceTension tension;          // Cotangent Laplacian of the current triangles.
+        float restVolume;                // Volume the mesh is kept at while it relaxes.
+        std::vector<float> x, y, z;      // Scratch: vertex coordinates, one array per axis.
+        std::vector<float> fx, fy, fz;   // Scratch: surface tension force on every vertex.
+        std::vector<float> nx, ny, nz;   // Scratch: normal of every vertex.
+        std::vector<float> sx, sy, sz;   // Scratch: sum of every vertex's neighbours, each counted twice.
+        std::vector<int>   valence;      // Neighbour count of every vertex, doubled to match the sums.
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,329 @@
+#include "SurfaceTension.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <tuple>
+
+// SSE2 is part of every x86-64 target, so the force kernel uses it without a runtime check
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SURFACETENSION_SSE
+#endif
+
+static const float MIN_SINE = 1e-12f; // Keeps the cotangents of degenerate triangles finite.
+
+SurfaceTension::SurfaceTension()
+{
+    count   = 0;
+    maxRate = 0.0f;
+    moveSq  = 0.0f;
+    jobs    = NULL;
+}
+
+void SurfaceTension::Build(const std::vector<float>& vertices, const std::vector<unsigned int>& indices, float tolerance)
+{
+    count = static_cast<int>(vertices.size() / 3);
+    int triangleCount = static_cast<int>(indices.size() / 3);
+    triangles.assign(indices.begin(), indices.begin() + triangleCount * 3);
+
+    // Every corner's angle faces the opposite side, which is an entry in both directions
+    std::vector<std::tuple<int, int, int>> edges;
+    edges.reserve(triangleCount * 6);
+    for (int slot = 0; slot < triangleCount * 3; slot++)
+    {
+        int t = slot / 3;
+        int a = triangles[t * 3 + (slot + 1) % 3];
+        int b = triangles[t * 3 + (slot + 2) % 3];
+        edges.emplace_back(a, b, slot);
+        edges.emplace_back(b, a, slot);
+    }
+    std::sort(edges.begin(), edges.end());
+
+    // Merge the two sides of every inner edge, then count the entries of each row
+    std::vector<std::tuple<int, int, int, int>> entries;
+    for (size_t e = 0; e < edges.size(); e++)
+    {
+        int row = std::get<0>(edges[e]), column = std::get<1>(edges[e]);
+        if ( !entries.empty() && std::get<0>(entries.back()) == row && std::get<1>(entries.back()) == column )
+            std::get<3>(entries.back()) = std::get<2>(edges[e]);
+        else
+            entries.emplace_back(row, column, std::get<2>(edges[e]), -1);
+    }
+
+    std::vector<int> rowStart(count + 1, 0);
+    for (const auto& entry : entries)
+        rowStart[std::get<0>(entry) + 1]++;
+    for (int i = 0; i < count; i++)
+        rowStart[i + 1] += rowStart[i];
+
+    // Slice the rows: each slice is as wide as its longest row, with LANES entries per step
+    int slices = (count + LANES - 1) / LANES;
+    sliceStart.assign(slices + 1, 0);
+    for (int s = 0; s < slices; s++)
+    {
+        int width = 0;
+        for (int row = s * LANES; row < std::min(count, (s + 1) * LANES); row++)
+            width = std::max(width, rowStart[row + 1] - rowStart[row]);
+        sliceStart[s + 1] = sliceStart[s] + width * LANES;
+    }
+
+    columns.assign(sliceStart[slices], 0);
+    weights.assign(sliceStart[slices], 0.0f);
+    faces.assign(sliceStart[slices] * 2, -1);
+    for (int s = 0; s < slices; s++)
+    {
+        for (int lane = 0; lane < LANES; lane++)
+        {
+            int row = s * LANES + lane;
+            for (int k = sliceStart[s] + lane; k < sliceStart[s + 1]; k += LANES)
+            {
+                int source = row < count ? rowStart[row] + (k - sliceStart[s]) / LANES : -1;
+                if ( source == -1 || source >= rowStart[row + 1] )
+                {
+                    columns[k] = row < count ? row : 0;
+                    continue;
+                }
+
+                columns[k]       = std::get<1>(entries[source]);
+                faces[k * 2]     = std::get<2>(entries[source]);
+                faces[k * 2 + 1] = std::get<3>(entries[source]);
+            }
+        }
+    }
+
+    // Triangle corners around every vertex, for summing the areas
+    cornerStart.assign(count + 1, 0);
+    for (int v : triangles)
+        cornerStart[v + 1]++;
+    for (int i = 0; i < count; i++)
+        cornerStart[i + 1] += cornerStart[i];
+    corners.resize(triangles.size());
+    std::vector<int> fill(cornerStart.begin(), cornerStart.end() - 1);
+    for (int slot = 0; slot < static_cast<int>(triangles.size()); slot++)
+        corners[fill[triangles[slot]]++] = slot;
+
+    // The tolerance scales with the mesh
+    std::vector<float> x(count), y(count), z(count);
+    measured.resize(count);
+    for (int i = 0; i < count; i++)
+    {
+        x[i] = vertices[i * 3];
+        y[i] = vertices[i * 3 + 1];
+        z[i] = vertices[i * 3 + 2];
+        measured[i] = glm::vec3(x[i], y[i], z[i]);
+    }
+
+    double length = 0.0;
+    for (size_t e = 0; e < entries.size(); e++)
+        length += glm::length(measured[std::get<1>(entries[e])] - measured[std::get<0>(entries[e])]);
+    float mean = entries.empty() ? 0.0f : static_cast<float>(length / entries.size());
+    moveSq = (tolerance * mean) * (tolerance * mean);
+
+    cotangents.assign(triangles.size(), 0.0f);
+    shares.assign(triangles.size(), 0.0f);
+    diagonal.assign(count, 0.0f);
+    areas.assign(count, 0.0f);
+    moved.assign(count, 0);
+    stale.assign(triangleCount, 0);
+    dirty.assign(count, 0);
+
+    ForEach(triangleCount, [&](int begin, int end)
+    {
+        for (int t = begin; t < end; t++)
+            Measure(t, x.data(), y.data(), z.data());
+    });
+    ForEach(count, [this](int begin, int end)
+    {
+        for (int i = begin; i < end; i++)
+            Gather(i);
+    });
+
+    maxRate = 0.0f;
+    for (int i = 0; i < count; i++)
+        maxRate = std::max(maxRate, areas[i] > 0.0f ? diagonal[i] / areas[i] : 0.0f);
+}
+
+void SurfaceTension::Measure(int triangle, const float* x, const float* y, const float* z)
+{
+    glm::vec3 p[3];
+    for (int c = 0; c < 3; c++)
+    {
+        int v = triangles[triangle * 3 + c];
+        p[c]  = glm::vec3(x[v], y[v], z[v]);
+    }
+
+    float twiceArea = glm::length(glm::cross(p[1] - p[0], p[2] - p[0]));
+    float sine      = std::max(twiceArea, MIN_SINE);
+    float dots[3];
+    for (int c = 0; c < 3; c++)
+    {
+        dots[c] = glm::dot(p[(c + 1) % 3] - p[c], p[(c + 2) % 3] - p[c]);
+        cotangents[triangle * 3 + c] = dots[c] / sine;
+    }
+
+    // Meyer's mixed area: the Voronoi region where the triangle isn't obtuse, otherwise a fixed split of its area
+    int obtuse = -1;
+    for (int c = 0; c < 3; c++)
+        if ( dots[c] < 0.0f )
+            obtuse = c;
+
+    for (int c = 0; c < 3; c++)
+    {
+        float share;
+        if ( obtuse == -1 )
+        {
+            glm::vec3 toNext = p[(c + 1) % 3] - p[c];
+            glm::vec3 toLast = p[(c + 2) % 3] - p[c];
+            share = (glm::dot(toLast, toLast) * cotangents[triangle * 3 + (c + 1) % 3]
+                   + glm::dot(toNext, toNext) * cotangents[triangle * 3 + (c + 2) % 3]) / 8.0f;
+        }
+        else
+        {
+            share = twiceArea * (c == obtuse ? 0.25f : 0.125f);
+        }
+        shares[triangle * 3 + c] = share;
+    }
+}
+
+void SurfaceTension::Gather(int row)
+{
+    int   s   = row / LANES;
+    float sum = 0.0f;
+    for (int k = sliceStart[s] + row % LANES; k < sliceStart[s + 1]; k += LANES)
+    {
+        float w = 0.0f;
+        for (int f = 0; f < 2; f++)
+            if ( faces[k * 2 + f] != -1 )
+                w += 0.5f * cotangents[faces[k * 2 + f]];
+        weights[k] = w;
+        sum += w;
+    }
+    diagonal[row] = sum;
+
+    float area = 0.0f;
+    for (int c = cornerStart[row]; c < cornerStart[row + 1]; c++)
+        area += shares[corners[c]];
+    areas[row] = area;
+}
+
+int SurfaceTension::Update(const float* x, const float* y, const float* z)
+{
+    ForEach(count, [&](int begin, int end)
+    {
+        for (int i = begin; i < end; i++)
+        {
+            glm::vec3 offset = glm::vec3(x[i], y[i], z[i]) - measured[i];
+            moved[i] = glm::dot(offset, offset) > moveSq;
+        }
+    });
+
+    // Only triangles with a corner past the tolerance are measured again, each by one job
+    int triangleCount = static_cast<int>(stale.size());
+    ForEach(triangleCount, [&](int begin, int end)
+    {
+        for (int t = begin; t < end; t++)
+        {
+            stale[t] = moved[triangles[t * 3]] || moved[triangles[t * 3 + 1]] || moved[triangles[t * 3 + 2]];
+            if ( stale[t] )
+                Measure(t, x, y, z);
+        }
+    });
+
+    // Every entry of a stale triangle's sides lives in the row of one of its corners
+    ForEach(count, [&](int begin, int end)
+    {
+        for (int i = begin; i < end; i++)
+        {
+            dirty[i] = 0;
+            for (int c = cornerStart[i]; c < cornerStart[i + 1]; c++)
+                dirty[i] |= stale[corners[c] / 3];
+
+            if ( dirty[i] )
+                Gather(i);
+            if ( moved[i] )
+                measured[i] = glm::vec3(x[i], y[i], z[i]);
+        }
+    });
+
+    int remeasured = static_cast<int>(std::count(stale.begin(), stale.end(), 1));
+    if ( remeasured > 0 )
+    {
+        maxRate = 0.0f;
+        for (int i = 0; i < count; i++)
+            maxRate = std::max(maxRate, areas[i] > 0.0f ? diagonal[i] / areas[i] : 0.0f);
+    }
+    return remeasured;
+}
+
+void SurfaceTension::Forces(const float* x, const float* y, const float* z, float* fx, float* fy, float* fz, float tension) const
+{
+    int slices = static_cast<int>(sliceStart.size()) - 1;
+    ForEach(slices, [&](int begin, int end)
+    {
+        for (int s = begin; s < end; s++)
+        {
+            int first = s * LANES;
+#ifdef SURFACETENSION_SSE
+            // Each lane walks its own row; the neighbours are gathered one by one since SSE can't gather
+            if ( first + LANES <= count )
+            {
+                __m128 sx = _mm_setzero_ps(), sy = _mm_setzero_ps(), sz = _mm_setzero_ps();
+                for (int k = sliceStart[s]; k < sliceStart[s + 1]; k += LANES)
+                {
+                    __m128 w = _mm_loadu_ps(&weights[k]);
+                    const int* j = &columns[k];
+                    sx = _mm_add_ps(sx, _mm_mul_ps(w, _mm_setr_ps(x[j[0]], x[j[1]], x[j[2]], x[j[3]])));
+                    sy = _mm_add_ps(sy, _mm_mul_ps(w, _mm_setr_ps(y[j[0]], y[j[1]], y[j[2]], y[j[3]])));
+                    sz = _mm_add_ps(sz, _mm_mul_ps(w, _mm_setr_ps(z[j[0]], z[j[1]], z[j[2]], z[j[3]])));
+                }
+
+                __m128 d = _mm_loadu_ps(&diagonal[first]);
+                __m128 t = _mm_set1_ps(tension);
+                _mm_storeu_ps(fx + first, _mm_mul_ps(t, _mm_sub_ps(sx, _mm_mul_ps(d, _mm_loadu_ps(x + first)))));
+                _mm_storeu_ps(fy + first, _mm_mul_ps(t, _mm_sub_ps(sy, _mm_mul_ps(d, _mm_loadu_ps(y + first)))));
+                _mm_storeu_ps(fz + first, _mm_mul_ps(t, _mm_sub_ps(sz, _mm_mul_ps(d, _mm_loadu_ps(z + first)))));
+                continue;
+            }
+#endif
+            for (int row = first; row < std::min(count, first + LANES); row++)
+            {
+                float sx = 0.0f, sy = 0.0f, sz = 0.0f;
+                for (int k = sliceStart[s] + row - first; k < sliceStart[s + 1]; k += LANES)
+                {
+                    sx += weights[k] * x[columns[k]];
+                    sy += weights[k] * y[columns[k]];
+                    sz += weights[k] * z[columns[k]];
+                }
+                fx[row] = tension * (sx - diagonal[row] * x[row]);
+                fy[row] = tension * (sy - diagonal[row] * y[row]);
+                fz[row] = tension * (sz - diagonal[row] * z[row]);
+            }
+        }
+    });
+}
+
+void SurfaceTension::Normals(const float* x, const float* y, const float* z, float* nx, float* ny, float* nz) const
+{
+    ForEach(count, [&](int begin, int end)
+    {
+        for (int i = begin; i < end; i++)
+        {
+            // The cross products of the triangles' sides are twice their areas long, which does the weighting
+            glm::vec3 sum(0.0f);
+            for (int c = cornerStart[i]; c < cornerStart[i + 1]; c++)
+            {
+                const int* tri = &triangles[corners[c] / 3 * 3];
+                glm::vec3 a(x[tri[0]], y[tri[0]], z[tri[0]]);
+                glm::vec3 b(x[tri[1]], y[tri[1]], z[tri[1]]);
+                glm::vec3 d(x[tri[2]], y[tri[2]], z[tri[2]]);
+                sum += glm::cross(b - a, d - a);
+            }
+
+            float length = glm::length(sum);
+            glm::vec3 normal = length > 0.0f ? sum / length : glm::vec3(0.0f);
+            nx[i] = normal.x;
+            ny[i] = normal.y;
+            nz[i] = normal.z;
+        }
+    });
+}
@@ -0,0 +1,127 @@
+#ifndef SURFACETENSION
+#define SURFACETENSION
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "JobSystem.hpp"
+
+/**
+ *  The cotangent Laplacian of a triangle mesh, which turns vertex positions into surface tension forces.
+ *  The force on a vertex is the tension times minus the gradient of the mesh's area, which is
+ *  sum_j (cot a_ij + cot b_ij) / 2 * (x_j - x_i) over its neighbours, with a and b the angles facing the edge ij.
+ *  Divided by the vertex's mixed Voronoi area it's the mean curvature normal, 2 H n. Flat patches feel nothing,
+ *  bumps get pulled flat, and a closed mesh is pulled toward a sphere.
+ *  The weights are built once per topology and stored as compressed rows, sliced four rows at a time: the entries
+ *  of four neighbouring rows are interleaved and padded to the longest of them, so one SSE lane works on each row.
+ *  Updates only recompute the triangles with a corner that moved further than a tolerance since they were last
+ *  measured, along with the rows those triangles touch.
+ */
+class SurfaceTension
+{
+    public:
+        SurfaceTension();
+
+        /** Copying would duplicate the operator, so it's deleted. */
+        SurfaceTension(const SurfaceTension&) = delete;
+        SurfaceTension& operator=(const SurfaceTension&) = delete;
+
+        ~SurfaceTension() { };
+
+        /**
+         *  Builds the operator for a mesh and measures every triangle.
+         *  @param vertices  - The mesh positions, three floats per vertex, as from Sphere::GetVertices.
+         *  @param indices   - The mesh triangles, three indices per triangle, as from Sphere::GetIndices.
+         *  @param tolerance - How far a vertex may move, relative to the mean edge length, before its triangles
+         *                     are measured again.
+         */
+        void Build(const std::vector<float>& vertices, const std::vector<unsigned int>& indices, float tolerance = 0.01f);
+
+        /**
+         *  Brings the weights and areas up to date with moved vertices.
+         *  @param x, y, z - The current coordinates of every vertex.
+         *  @return The number of triangles that were measured again.
+         */
+        int Update(const float* x, const float* y, const float* z);
+
+        /**
+         *  Works out the surface tension force on every vertex with the current weights.
+         *  @param x, y, z    - The current coordinates of every vertex.
+         *  @param fx, fy, fz - Receive the force on every vertex.
+         *  @param tension    - The surface tension, force per unit of length.
+         */
+        void Forces(const float* x, const float* y, const float* z, float* fx, float* fy, float* fz, float tension) const;
+
+        /**
+         *  Works out the area weighted normal of every vertex, for taking the tangential part out of the forces;
+         *  on a mesh that isn't perfectly regular that part slides the vertices around instead of changing the shape.
+         *  @param x, y, z    - The current coordinates of every vertex.
+         *  @param nx, ny, nz - Receive the unit normal of every vertex.
+         */
+        void Normals(const float* x, const float* y, const float* z, float* nx, float* ny, float* nz) const;
+
+        /** Gets the mixed Voronoi area of every vertex. */
+        const std::vector<float>& GetAreas() const { return areas; };
+
+        /** Gets the sum of each row's weights, which over the row's area is how fast a curvature flow moves it. */
+        const std::vector<float>& GetDiagonal() const { return diagonal; };
+
+        /** Gets the largest weight sum of any row over its area, which bounds the stable step of a curvature flow. */
+        float GetMaxRate() const { return maxRate; };
+
+        /** Gets the number of vertices. */
+        int GetVertexCount() const { return count; };
+
+        /**
+         *  Sets the job system used to update and apply the operator in parallel.
+         *  @param jobs - The job system to use, or NULL to run on the calling thread.
+         */
+        void SetJobSystem(JobSystem* jobs) { this->jobs = jobs; };
+
+        static const int LANES = 4; // Rows per slice.
+
+    private:
+        /** Measures a triangle: the cotangent at each corner and the share of its area each corner gets. */
+        void Measure(int triangle, const float* x, const float* y, const float* z);
+
+        /** Sums a row's weights from the cotangents of its triangles, along with its area and diagonal. */
+        void Gather(int row);
+
+        /** Runs body(begin, end) over [0, size), in parallel if a job system is set. */
+        template <typename Body>
+        void ForEach(int size, const Body& body) const
+        {
+            if ( jobs != NULL )
+                jobs->ParallelFor(0, size, GRAIN, body);
+            else if ( size > 0 )
+                body(0, size);
+        };
+
+        static const int GRAIN = 1024; // Rows or triangles handled per job.
+
+        int   count;    // Vertices in the mesh.
+        float maxRate;  // Largest diagonal over area of any row.
+        float moveSq;   // Squared distance a vertex may move before it's measured again.
+
+        std::vector<int>   sliceStart; // First entry of each slice, plus an end; a slice holds LANES entries per step.
+        std::vector<int>   columns;    // Neighbour of every entry; padding points back at the row itself.
+        std::vector<float> weights;    // Weight of every entry, half the cotangent sum; padding is zero.
+        std::vector<int>   faces;      // Cotangent slots facing every entry's edge, two per entry, or -1.
+        std::vector<float> diagonal;   // Sum of each row's weights.
+        std::vector<float> areas;      // Mixed Voronoi area of each vertex.
+
+        std::vector<int>   triangles;  // Three corners per triangle.
+        std::vector<float> cotangents; // Cotangent of the angle at each corner of each triangle.
+        std::vector<float> shares;     // Share of its triangle's area at each corner.
+        std::vector<int>   cornerStart; // First triangle corner of each vertex, plus an end.
+        std::vector<int>   corners;     // Triangle corner slots around each vertex.
+
+        std::vector<glm::vec3> measured; // Position of every vertex when its triangles were last measured.
+        std::vector<char>  moved;        // Scratch: set for vertices that moved past the tolerance.
+        std::vector<char>  stale;        // Scratch: set for triangles with a moved corner.
+        std::vector<char>  dirty;        // Scratch: set for rows next to a stale triangle.
+        JobSystem* jobs;                 // Job system for the parallel passes, may be NULL.
+};
+
+#endif
@@ -0,0 +1,484 @@
+#include "SweepAndPrune.hpp"
+
+#include <algorithm>
+#include <cassert>
+
+SweepAndPrune::SweepAndPrune()
+{
+    freeList    = -1;
+    swapCount   = 0;
+    activeCount = 0;
+}
+
+int SweepAndPrune::CreateProxy(const AABB& box, int data)
+{
+    int proxy;
+    if ( freeList != -1 )
+    {
+        proxy    = freeList;
+        freeList = proxies[proxy].data;
+    }
+    else
+    {
+        proxy = static_cast<int>(proxies.size());
+        proxies.push_back(SAPProxy());
+    }
+
+    proxies[proxy].box   = box;
+    proxies[proxy].data  = data;
+    proxies[proxy].state = ADDED;
+    pending.push_back(proxy);
+
+    return proxy;
+}
+
+void SweepAndPrune::DestroyProxy(int proxy)
+{
+    SAPProxy& p = proxies[proxy];
+    assert(p.state != FREE && p.state != REMOVED);
+
+    // Never made it into the endpoint lists, so it can be recycled right away
+    if ( p.state == ADDED )
+    {
+        p.state  = FREE;
+        p.data   = freeList;
+        freeList = proxy;
+        return;
+    }
+
+    if ( p.state == ACTIVE )
+        pending.push_back(proxy);
+    p.state = REMOVED;
+}
+
+void SweepAndPrune::MoveProxy(int proxy, const AABB& box)
+{
+    SAPProxy& p = proxies[proxy];
+    assert(p.state != FREE && p.state != REMOVED);
+
+    p.box = box;
+    if ( p.state == ACTIVE )
+    {
+        p.state = MOVED;
+        pending.push_back(proxy);
+    }
+}
+
+void SweepAndPrune::Update()
+{
+    events.clear();
+    swapCount = 0;
+
+    int added   = 0;
+    int removed = 0;
+    for (int proxy : pending)
+    {
+        if ( proxies[proxy].state == ADDED )
+            added++;
+        else if ( proxies[proxy].state == REMOVED )
+            removed++;
+    }
+
+    if ( removed > 0 )
+        FlushRemovals();
+
+    // Inserting one proxy walks half an axis on average, so big batches are cheaper to sort from scratch
+    // and medium ones, like a steady stream of spawns, are cheaper to merge in with one pass per axis
+    if ( added > 0 && added * 4 > activeCount + added )
+    {
+        Rebuild();
+    }
+    else
+    {
+        if ( added > MERGE_BATCH )
+            MergeAdded();
+
+        for (int proxy : pending)
+        {
+            if ( proxies[proxy].state == ADDED )
+                InsertProxy(proxy);
+            else if ( proxies[proxy].state == MOVED )
+                UpdateProxy(proxy);
+        }
+    }
+
+    pending.clear();
+}
+
+void SweepAndPrune::SetIndex(int axis, int index)
+{
+    const SAPEndpoint& e = axes[axis][index];
+    SAPProxy& p = proxies[e.data >> 1];
+
+    if ( e.data & 1 )
+        p.maxIndex[axis] = index;
+    else
+        p.minIndex[axis] = index;
+}
+
+void SweepAndPrune::SiftDown(int axis, int index)
+{
+    std::vector<SAPEndpoint>& ends = axes[axis];
+    SAPEndpoint e = ends[index];
+
+    while ( index > 0 && Less(e, ends[index - 1]) )
+    {
+        const SAPEndpoint& prev = ends[index - 1];
+
+        // A min passing a max starts an overlap on this axis, a max passing a min ends one
+        if ( (e.data & 1) != (prev.data & 1) && (e.data >> 1) != (prev.data >> 1) )
+            UpdatePair(e.data >> 1, prev.data >> 1);
+
+        ends[index] = prev;
+        SetIndex(axis, index);
+        index--;
+        swapCount++;
+    }
+
+    ends[index] = e;
+    SetIndex(axis, index);
+}
+
+void SweepAndPrune::SiftUp(int axis, int index)
+{
+    std::vector<SAPEndpoint>& ends = axes[axis];
+    SAPEndpoint e = ends[index];
+    int last = static_cast<int>(ends.size()) - 1;
+
+    while ( index < last && Less(ends[index + 1], e) )
+    {
+        const SAPEndpoint& next = ends[index + 1];
+
+        if ( (e.data & 1) != (next.data & 1) && (e.data >> 1) != (next.data >> 1) )
+            UpdatePair(e.data >> 1, next.data >> 1);
+
+        ends[index] = next;
+        SetIndex(axis, index);
+        index++;
+        swapCount++;
+    }
+
+    ends[index] = e;
+    SetIndex(axis, index);
+}
+
+void SweepAndPrune::UpdatePair(int a, int b)
+{
+    if ( Overlaps(proxies[a].box, proxies[b].box) )
+        AddPair(a, b);
+    else
+        RemovePair(a, b);
+}
+
+void SweepAndPrune::AddPair(int a, int b)
+{
+    if ( a > b )
+        std::swap(a, b);
+
+    auto inserted = pairIndex.emplace(Key(a, b), static_cast<int>(pairs.size()));
+    if ( !inserted.second )
+        return;
+
+    pairs.push_back({a, b});
+    events.push_back({a, b, true});
+}
+
+void SweepAndPrune::RemovePair(int a, int b, bool report)
+{
+    if ( a > b )
+        std::swap(a, b);
+
+    auto found = pairIndex.find(Key(a, b));
+    if ( found == pairIndex.end() )
+        return;
+
+    // Swap-remove from the dense list
+    int slot = found->second;
+    pairIndex.erase(found);
+
+    if ( slot != static_cast<int>(pairs.size()) - 1 )
+    {
+        pairs[slot] = pairs.back();
+        pairIndex[Key(pairs[slot].a, pairs[slot].b)] = slot;
+    }
+    pairs.pop_back();
+
+    if ( report )
+        events.push_back({a, b, false});
+}
+
+void SweepAndPrune::FlushRemovals()
+{
+    // A byte per proxy is far smaller than the proxies themselves, so looking removals up stays in cache
+    removedFlags.assign(proxies.size(), 0);
+    for (int proxy : pending)
+        if ( proxies[proxy].state == REMOVED )
+            removedFlags[proxy] = 1;
+
+    // Drop every pair that references a removed proxy; whoever destroyed it already knows its pairs are gone
+    for (int i = static_cast<int>(pairs.size()) - 1; i >= 0; i--)
+    {
+        SAPPair pair = pairs[i];
+        if ( removedFlags[pair.a] || removedFlags[pair.b] )
+            RemovePair(pair.a, pair.b, false);
+    }
+
+    // Compact the endpoint lists in one pass per axis; nothing in front of the first removed endpoint moves
+    for (int axis = 0; axis < 3; axis++)
+    {
+        std::vector<SAPEndpoint>& ends = axes[axis];
+        int write = 0;
+        while ( write < static_cast<int>(ends.size()) && !removedFlags[ends[write].data >> 1] )
+            write++;
+
+        for (int read = write; read < static_cast<int>(ends.size()); read++)
+        {
+            if ( removedFlags[ends[read].data >> 1] )
+                continue;
+
+            ends[write] = ends[read];
+            SetIndex(axis, write);
+            write++;
+        }
+        ends.resize(write);
+    }
+
+    // Recycle the proxies
+    for (int proxy : pending)
+    {
+        SAPProxy& p = proxies[proxy];
+        if ( p.state != REMOVED )
+            continue;
+
+        p.state  = FREE;
+        p.data   = freeList;
+        freeList = proxy;
+        activeCount--;
+    }
+}
+
+void SweepAndPrune::InsertProxy(int proxy)
+{
+    SAPProxy& p = proxies[proxy];
+
+    // Appending behind everything means "overlaps nothing", the sift then discovers the real pairs
+    for (int axis = 0; axis < 3; axis++)
+    {
+        std::vector<SAPEndpoint>& ends = axes[axis];
+
+        ends.push_back({p.box.min[axis], proxy << 1});
+        SiftDown(axis, static_cast<int>(ends.size()) - 1);
+
+        ends.push_back({p.box.max[axis], (proxy << 1) | 1});
+        SiftDown(axis, static_cast<int>(ends.size()) - 1);
+    }
+
+    p.state = ACTIVE;
+    activeCount++;
+}
+
+void SweepAndPrune::MergeAdded()
+{
+    // A proxy destroyed and recreated before the update is pending twice, so collect each one once
+    fresh.clear();
+    for (int proxy : pending)
+    {
+        if ( proxies[proxy].state != ADDED )
+            continue;
+
+        proxies[proxy].state = MERGING;
+        fresh.push_back(proxy);
+    }
+
+    // Sort the new endpoints on their own, then merge them into each axis in a single pass; everything in front of
+    // the first new endpoint stays where it was
+    for (int axis = 0; axis < 3; axis++)
+    {
+        incoming.clear();
+        for (int proxy : fresh)
+        {
+            const SAPProxy& p = proxies[proxy];
+            incoming.push_back({p.box.min[axis], proxy << 1});
+            incoming.push_back({p.box.max[axis], (proxy << 1) | 1});
+        }
+        std::sort(incoming.begin(), incoming.end(), Less);
+
+        std::vector<SAPEndpoint>& ends = axes[axis];
+        int first = static_cast<int>(std::lower_bound(ends.begin(), ends.end(), incoming.front(), Less) - ends.begin());
+        merged.resize(ends.size() + incoming.size());
+        std::copy(ends.begin(), ends.begin() + first, merged.begin());
+        std::merge(ends.begin() + first, ends.end(), incoming.begin(), incoming.end(), merged.begin() + first, Less);
+        ends.swap(merged);
+        for (int i = first; i < static_cast<int>(ends.size()); i++)
+            SetIndex(axis, i);
+    }
+
+    // Sweep along x like Rebuild, but only test pairs with at least one new proxy in them. The open lists carry a
+    // copy of each box so the tests run through memory in order, and intervals that have ended are dropped lazily.
+    // Moved proxies still sit at their old places; the pairs this misses are found when they're sifted afterwards
+    openOld.clear();
+    openNew.clear();
+    for (const SAPEndpoint& e : axes[0])
+    {
+        if ( e.data & 1 )
+            continue;
+
+        int proxy = e.data >> 1;
+        const SAPProxy& p = proxies[proxy];
+        bool added = p.state == MERGING;
+
+        Sweep(openNew, proxy, p.box, e.value);
+        if ( added )
+            Sweep(openOld, proxy, p.box, e.value);
+
+        (added ? openNew : openOld).push_back({ p.box, proxy });
+    }
+
+    for (int proxy : fresh)
+        proxies[proxy].state = ACTIVE;
+    activeCount += static_cast<int>(fresh.size());
+}
+
+void SweepAndPrune::Sweep(std::vector<OpenBox>& open, int proxy, const AABB& box, float position)
+{
+    int write = 0;
+    for (int read = 0; read < static_cast<int>(open.size()); read++)
+    {
+        const OpenBox& other = open[read];
+        if ( other.box.max.x < position )
+            continue;
+
+        if ( Overlaps(box, other.box) )
+            AddPair(proxy, other.proxy);
+        open[write++] = other;
+    }
+    open.resize(write);
+}
+
+void SweepAndPrune::UpdateProxy(int proxy)
+{
+    SAPProxy& p = proxies[proxy];
+
+    for (int axis = 0; axis < 3; axis++)
+    {
+        std::vector<SAPEndpoint>& ends = axes[axis];
+        int minIndex = p.minIndex[axis];
+        int maxIndex = p.maxIndex[axis];
+
+        float oldMin = ends[minIndex].value;
+        float oldMax = ends[maxIndex].value;
+        float newMin = p.box.min[axis];
+        float newMax = p.box.max[axis];
+
+        if ( newMin == oldMin && newMax == oldMax )
+            continue;
+
+        // Move the leading bound first so the interval never has to pass through itself
+        if ( newMin < oldMin )
+        {
+            ends[minIndex].value = newMin;
+            SiftDown(axis, minIndex);
+
+            maxIndex = p.maxIndex[axis];
+            ends[maxIndex].value = newMax;
+            if ( newMax < oldMax ) SiftDown(axis, maxIndex); else SiftUp(axis, maxIndex);
+        }
+        else
+        {
+            ends[maxIndex].value = newMax;
+            if ( newMax < oldMax ) SiftDown(axis, maxIndex); else SiftUp(axis, maxIndex);
+
+            minIndex = p.minIndex[axis];
+            ends[minIndex].value = newMin;
+            SiftUp(axis, minIndex);
+        }
+    }
+
+    p.state = ACTIVE;
+}
+
+void SweepAndPrune::Rebuild()
+{
+    // Refresh every endpoint value and append the new proxies
+    for (int axis = 0; axis < 3; axis++)
+    {
+        std::vector<SAPEndpoint>& ends = axes[axis];
+        for (SAPEndpoint& e : ends)
+        {
+            const AABB& box = proxies[e.data >> 1].box;
+            e.value = ( e.data & 1 ) ? box.max[axis] : box.min[axis];
+        }
+    }
+
+    for (int proxy : pending)
+    {
+        SAPProxy& p = proxies[proxy];
+        if ( p.state != ADDED )
+            continue;
+
+        for (int axis = 0; axis < 3; axis++)
+        {
+            axes[axis].push_back({p.box.min[axis], proxy << 1});
+            axes[axis].push_back({p.box.max[axis], (proxy << 1) | 1});
+        }
+        p.state = ACTIVE;
+        activeCount++;
+    }
+
+    for (int axis = 0; axis < 3; axis++)
+    {
+        std::sort(axes[axis].begin(), axes[axis].end(), Less);
+        for (int i = 0; i < static_cast<int>(axes[axis].size()); i++)
+            SetIndex(axis, i);
+    }
+
+    for (int proxy : pending)
+        if ( proxies[proxy].state == MOVED )
+            proxies[proxy].state = ACTIVE;
+
+    // Sweep along x, testing each opening interval against the ones still open
+    std::vector<char> seen(pairs.size(), 0);
+    std::vector<SAPPair> found;
+    std::vector<int> open;
+    std::vector<int> openSlot(proxies.size(), -1);
+
+    for (const SAPEndpoint& e : axes[0])
+    {
+        int proxy = e.data >> 1;
+        if ( e.data & 1 )
+        {
+            // Swap-remove from the open list
+            int slot = openSlot[proxy];
+            open[slot] = open.back();
+            openSlot[open[slot]] = slot;
+            open.pop_back();
+            continue;
+        }
+
+        const AABB& box = proxies[proxy].box;
+        for (int other : open)
+        {
+            if ( !Overlaps(box, proxies[other].box) )
+                continue;
+
+            int a = std::min(proxy, other);
+            int b = std::max(proxy, other);
+            auto existing = pairIndex.find(Key(a, b));
+            if ( existing != pairIndex.end() )
+                seen[existing->second] = 1;
+            else
+                found.push_back({a, b});
+        }
+
+        openSlot[proxy] = static_cast<int>(open.size());
+        open.push_back(proxy);
+    }
+
+    // Remove stale pairs back to front so the remaining slots stay valid, then add the new ones
+    for (int i = static_cast<int>(seen.size()) - 1; i >= 0; i--)
+        if ( !seen[i] )
+            RemovePair(pairs[i].a, pairs[i].b);
+
+    for (const SAPPair& pair : found)
+        AddPair(pair.a, pair.b);
+}
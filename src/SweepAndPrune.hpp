@@ -0,0 +1,171 @@
+#ifndef SWEEPANDPRUNE
+#define SWEEPANDPRUNE
+
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+
+#include "Geometry.hpp"
+
+/** A sorted interval bound on one axis; the proxy id and whether it's a max bound are packed into data. */
+struct SAPEndpoint
+{
+    float value; // Position of the bound along the axis.
+    int   data;  // proxy << 1 | isMax.
+};
+
+/** A pair of proxies whose boxes overlap, with a < b. */
+struct SAPPair
+{
+    int a;
+    int b;
+};
+
+/** Reports a pair that started (added) or stopped (!added) overlapping during the last update. */
+struct SAPEvent
+{
+    int  a;
+    int  b;
+    bool added;
+};
+
+/** A box registered with the sweep-and-prune broad-phase. */
+struct SAPProxy
+{
+    AABB box;          // The box as of the last MoveProxy call.
+    int  data;         // User id of the proxy.
+    int  minIndex[3];  // Index of the min endpoint on each axis.
+    int  maxIndex[3];  // Index of the max endpoint on each axis.
+    int  state;        // One of the SweepAndPrune proxy states.
+};
+
+/**
+ *  An incremental sweep-and-prune broad-phase.
+ *  The endpoint lists on each axis are kept sorted across updates with insertion sort, so proxies that
+ *  didn't move cost nothing and slowly moving ones cost a handful of swaps. Pair changes are detected
+ *  while swapping and reported as add/remove events.
+ */
+class SweepAndPrune
+{
+    public:
+        SweepAndPrune();
+
+        /**
+         *  Registers a new box; it joins the endpoint lists on the next Update.
+         *  @param box  - The bounds of the object.
+         *  @param data - The user id stored with the proxy.
+         *  @return The proxy id.
+         */
+        int CreateProxy(const AABB& box, int data);
+
+        /**
+         *  Unregisters a box; its pairs are removed on the next Update, without events since the caller knows.
+         *  @param proxy - The proxy id returned by CreateProxy.
+         */
+        void DestroyProxy(int proxy);
+
+        /**
+         *  Changes the bounds of a proxy; the endpoint lists are fixed on the next Update.
+         *  @param proxy - The proxy id.
+         *  @param box   - The new bounds.
+         */
+        void MoveProxy(int proxy, const AABB& box);
+
+        /**
+         *  Applies all pending insertions, removals and moves, generating pair events.
+         *  Large batches of insertions fall back to a full sort and sweep.
+         */
+        void Update();
+
+        /** Gets the pair events generated by the last Update. */
+        const std::vector<SAPEvent>& GetEvents() const { return events; };
+
+        /** Gets every currently overlapping pair. */
+        const std::vector<SAPPair>& GetPairs() const { return pairs; };
+
+        /** Gets the user id of a proxy. */
+        int GetData(int proxy) const { return proxies[proxy].data; };
+
+        /** Changes the user id of a proxy. */
+        void SetData(int proxy, int data) { proxies[proxy].data = data; };
+
+        /** Gets the number of endpoint swaps done by the last Update, a measure of its sorting cost. */
+        int GetSwapCount() const { return swapCount; };
+
+    private:
+        enum ProxyState { FREE, ADDED, MERGING, ACTIVE, MOVED, REMOVED };
+
+        /** Orders endpoints by value, placing min bounds before max bounds at equal values. */
+        static bool Less(const SAPEndpoint& a, const SAPEndpoint& b)
+        {
+            return a.value < b.value || (a.value == b.value && (a.data & 1) < (b.data & 1));
+        };
+
+        /** Stores the position of an endpoint in its proxy. */
+        void SetIndex(int axis, int index);
+
+        /** Moves an endpoint toward the front of its axis until the axis is sorted again. */
+        void SiftDown(int axis, int index);
+
+        /** Moves an endpoint toward the back of its axis until the axis is sorted again. */
+        void SiftUp(int axis, int index);
+
+        /** Adds or removes the pair depending on whether the boxes currently overlap. */
+        void UpdatePair(int a, int b);
+
+        void AddPair(int a, int b);
+        void RemovePair(int a, int b, bool report = true);
+
+        /** Removes the endpoints and pairs of every proxy marked for removal. */
+        void FlushRemovals();
+
+        /** Inserts one proxy into the endpoint lists using insertion sort. */
+        void InsertProxy(int proxy);
+
+        /** Merges every added proxy into the endpoint lists at once and finds their pairs with a sweep. */
+        void MergeAdded();
+
+        /** A box whose x interval was open at some point of a sweep. */
+        struct OpenBox
+        {
+            AABB box;   // Copy of the proxy's box.
+            int  proxy; // The proxy.
+        };
+
+        /**
+         *  Tests a box opening at a point of the sweep against a list of open boxes, adding the overlapping pairs and
+         *  dropping the boxes that ended before the point.
+         */
+        void Sweep(std::vector<OpenBox>& open, int proxy, const AABB& box, float position);
+
+        /** Writes the new box of a proxy into the endpoint lists and re-sorts them. */
+        void UpdateProxy(int proxy);
+
+        /** Sorts all axes from scratch and finds every pair with a single sweep. */
+        void Rebuild();
+
+        static const int MERGE_BATCH = 4; // Added proxies past which merging beats inserting them one by one.
+
+        static uint64_t Key(int a, int b)
+        {
+            return (static_cast<uint64_t>(static_cast<uint32_t>(a)) << 32) | static_cast<uint32_t>(b);
+        };
+
+        std::vector<SAPEndpoint> axes[3];        // Sorted endpoint lists for x, y and z.
+        std::vector<SAPProxy>    proxies;        // All proxies, used and free.
+        std::vector<int>         pending;        // Proxies added, moved or removed since the last Update.
+        std::vector<SAPPair>     pairs;          // Dense list of overlapping pairs.
+        std::unordered_map<uint64_t, int> pairIndex; // Maps a pair key to its slot in pairs.
+        std::vector<SAPEvent>    events;         // Events from the last Update.
+        std::vector<int>         fresh;          // Scratch: the added proxies, each once.
+        std::vector<SAPEndpoint> incoming;       // Scratch: sorted endpoints of the added proxies on one axis.
+        std::vector<SAPEndpoint> merged;         // Scratch: an axis with the added endpoints merged in.
+        std::vector<OpenBox>     openOld;        // Scratch: boxes already in the lists that may still be open.
+        std::vector<OpenBox>     openNew;        // Scratch: added boxes that may still be open.
+        std::vector<char>        removedFlags;   // Scratch: set for every proxy being removed.
+        int freeList;                            // First free proxy, chained through data.
+        int swapCount;                           // Swaps done by the last Update.
+        int activeCount;                         // Proxies currently in the endpoint lists.
+};
+
+#endif
@@ -0,0 +1,171 @@
+#include "ThinFilm.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+ThinFilm::ThinFilm()
+{
+    maxWeight   = 0.0f;
+    maxLength   = 0.0f;
+    accumulator = 0.0f;
+    jobs        = NULL;
+}
+
+void ThinFilm::Build(const std::vector<float>& vertices, const std::vector<unsigned int>& indices)
+{
+    int count = static_cast<int>(vertices.size() / 3);
+    positions.resize(count);
+    for (int i = 0; i < count; i++)
+        positions[i] = glm::vec3(vertices[i * 3], vertices[i * 3 + 1], vertices[i * 3 + 2]);
+
+    // Every triangle side is an edge in both directions; shared sides show up twice and are merged
+    std::vector<std::pair<int, int>> edges;
+    edges.reserve(indices.size() * 2);
+    for (size_t i = 0; i + 2 < indices.size(); i += 3)
+    {
+        for (int side = 0; side < 3; side++)
+        {
+            int a = static_cast<int>(indices[i + side]);
+            int b = static_cast<int>(indices[i + (side + 1) % 3]);
+            edges.push_back({ a, b });
+            edges.push_back({ b, a });
+        }
+    }
+    std::sort(edges.begin(), edges.end());
+    edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+
+    // Lay the edges out as compressed rows, one row per vertex
+    rowStart.assign(count + 1, 0);
+    columns.resize(edges.size());
+    weights.resize(edges.size());
+    smoothing.resize(edges.size());
+    for (const std::pair<int, int>& edge : edges)
+        rowStart[edge.first + 1]++;
+    for (int i = 0; i < count; i++)
+        rowStart[i + 1] += rowStart[i];
+
+    maxWeight = 0.0f;
+    maxLength = 0.0f;
+    for (size_t k = 0; k < edges.size(); k++)
+    {
+        float length = glm::length(positions[edges[k].second] - positions[edges[k].first]);
+        columns[k] = edges[k].second;
+        weights[k] = length > 0.0f ? 1.0f / (length * length) : 0.0f;
+        smoothing[k] = SMOOTHING * weights[k];
+        maxLength  = std::max(maxLength, length);
+    }
+    for (int i = 0; i < count; i++)
+    {
+        float row = 0.0f;
+        for (int k = rowStart[i]; k < rowStart[i + 1]; k++)
+            row += weights[k];
+        maxWeight = std::max(maxWeight, row);
+    }
+
+    heights.assign(count, 0.0f);
+    slopes.assign(edges.size(), 0.0f);
+    next.resize(count);
+    packed.resize(count);
+    accumulator = 0.0f;
+    Reset(REST_THICKNESS);
+}
+
+bool ThinFilm::Advance(float dt, glm::vec3 gravity)
+{
+    accumulator += dt;
+    int steps = 0;
+    while ( accumulator >= STEP && steps < MAX_STEPS )
+    {
+        Step(gravity);
+        accumulator -= STEP;
+        steps++;
+    }
+
+    // Drop whatever couldn't be caught up on rather than falling further behind
+    if ( steps == MAX_STEPS )
+        accumulator = std::min(accumulator, STEP);
+
+    if ( steps > 0 )
+        ForEach([this](int begin, int end) { Pack(begin, end); });
+    return steps > 0;
+}
+
+void ThinFilm::Step(glm::vec3 gravity)
+{
+    if ( thickness.empty() )
+        return;
+
+    // Gravity doesn't change during a step, so the drainage factor of every edge is worked out once up front
+    glm::vec3 down = glm::length(gravity) > 0.0f ? glm::normalize(gravity) : glm::vec3(0.0f);
+    ForEach([this, down](int begin, int end)
+    {
+        for (int i = begin; i < end; i++)
+            heights[i] = -glm::dot(down, positions[i]);
+    });
+    ForEach([this](int begin, int end)
+    {
+        const float scale = DRAINAGE / (REST_THICKNESS * REST_THICKNESS);
+        for (int i = begin; i < end; i++)
+            for (int k = rowStart[i]; k < rowStart[i + 1]; k++)
+                slopes[k] = scale * weights[k] * (heights[i] - heights[columns[k]]);
+    });
+
+    // The fastest a vertex can lose film bounds the substep: diffusion through every edge, plus drainage at the
+    // thickest film down the longest edge
+    float mobility = MAX_THICKNESS / REST_THICKNESS;
+    float rate     = maxWeight * (SMOOTHING + DRAINAGE * mobility * mobility * maxLength) + REPLENISH;
+    int   substeps = std::max(1, static_cast<int>(std::ceil(STEP * rate / STABILITY)));
+    float dt       = STEP / static_cast<float>(substeps);
+
+    for (int s = 0; s < substeps; s++)
+    {
+        ForEach([this, dt](int begin, int end) { Flux(begin, end, dt); });
+        thickness.swap(next);
+    }
+}
+
+void ThinFilm::Flux(int begin, int end, float dt)
+{
+    for (int i = begin; i < end; i++)
+    {
+        float h      = thickness[i];
+        float change = REPLENISH * (REST_THICKNESS - h);
+
+        // Both ends of an edge work out the same flux with opposite signs, so the film is conserved
+        for (int k = rowStart[i]; k < rowStart[i + 1]; k++)
+        {
+            float hj    = thickness[columns[k]];
+            float slope = slopes[k];
+
+            // Lubrication: the film slides downhill at a rate growing with the cube of the upstream thickness
+            float upwind = slope > 0.0f ? h : hj;
+            change += smoothing[k] * (hj - h) - slope * upwind * upwind * upwind;
+        }
+
+        // Anything past the thickest film drips off the bubble
+        next[i] = std::min(std::max(h + dt * change, MIN_THICKNESS), MAX_THICKNESS);
+    }
+}
+
+void ThinFilm::Pack(int begin, int end)
+{
+    for (int i = begin; i < end; i++)
+        packed[i] = static_cast<uint16_t>(thickness[i] / MAX_THICKNESS * 65535.0f + 0.5f);
+}
+
+void ThinFilm::Reset(float thickness)
+{
+    float clamped = std::min(std::max(thickness, MIN_THICKNESS), MAX_THICKNESS);
+    this->thickness.assign(positions.size(), clamped);
+    next.assign(positions.size(), clamped);
+    ForEach([this](int begin, int end) { Pack(begin, end); });
+}
+
+double ThinFilm::GetVolume()
+{
+    double volume = 0.0;
+    for (float h : thickness)
+        volume += h;
+    return volume;
+}
@@ -0,0 +1,122 @@
+#ifndef THINFILM
+#define THINFILM
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "JobSystem.hpp"
+
+/**
+ *  The thickness of the soap film over a bubble mesh, one value per vertex.
+ *  Gravity drains the film toward the bottom of the bubble, faster where it's thick, and Marangoni flow pulls
+ *  liquid back into thin spots, which smooths the thickness out. Both run as fluxes along the mesh edges through a
+ *  sparse Laplacian built once from the triangles, so the film only moves around; the only liquid lost is what piles
+ *  up past MAX_THICKNESS and drips off, and a slow pull back toward the rest thickness stands in for the liquid held
+ *  in the bubble's wall.
+ *  The thickness is packed into 16 bits per vertex for upload, where the soap shader turns it into interference colors.
+ */
+class ThinFilm
+{
+    public:
+        ThinFilm();
+
+        /** Copying a film would duplicate its adjacency, so it's deleted. */
+        ThinFilm(const ThinFilm&) = delete;
+        ThinFilm& operator=(const ThinFilm&) = delete;
+
+        ~ThinFilm() { };
+
+        /**
+         *  Builds the mesh adjacency and spreads the film evenly at the rest thickness.
+         *  @param vertices - The mesh positions, three floats per vertex, as from Sphere::GetVertices.
+         *  @param indices  - The mesh triangles, three indices per triangle, as from Sphere::GetIndices.
+         */
+        void Build(const std::vector<float>& vertices, const std::vector<unsigned int>& indices);
+
+        /**
+         *  Advances the film in fixed steps, carrying any leftover time over to the next call.
+         *  @param dt      - The time that has passed in seconds.
+         *  @param gravity - The direction of gravity in the mesh's model space.
+         *  @return True if the film changed and the packed thickness needs uploading.
+         */
+        bool Advance(float dt, glm::vec3 gravity);
+
+        /**
+         *  Runs a single fixed step, split into as many substeps as the explicit fluxes need to stay stable.
+         *  @param gravity - The direction of gravity in the mesh's model space.
+         */
+        void Step(glm::vec3 gravity);
+
+        /**
+         *  Resets the whole film to one thickness.
+         *  @param thickness - The new thickness in nanometres.
+         */
+        void Reset(float thickness);
+
+        /** Gets the thickness of every vertex in nanometres. */
+        const std::vector<float>& GetThickness() { return thickness; };
+
+        /** Gets the thickness of every vertex as a fraction of MAX_THICKNESS in 16 bits, ready for upload. */
+        const std::vector<uint16_t>& GetPacked() { return packed; };
+
+        /** Gets the number of vertices the film covers. */
+        int GetVertexCount() { return static_cast<int>(thickness.size()); };
+
+        /** Gets the total amount of film, the sum of the vertex thicknesses. */
+        double GetVolume();
+
+        /**
+         *  Sets the job system used to step the film in parallel.
+         *  @param jobs - The job system to use, or NULL to run on the calling thread.
+         */
+        void SetJobSystem(JobSystem* jobs) { this->jobs = jobs; };
+
+        static constexpr float REST_THICKNESS = 600.0f;  // Thickness of a fresh film in nanometres.
+        static constexpr float MIN_THICKNESS  = 10.0f;   // Thinnest film, the black film right before a bubble pops.
+        static constexpr float MAX_THICKNESS  = 1200.0f; // Thickest film the packed values can hold.
+        static constexpr float STEP           = 1.0f / 300.0f; // Length of a fixed step in seconds.
+
+    private:
+        /** Works out the film's rate of change for a range of vertices and writes the updated thickness. */
+        void Flux(int begin, int end, float dt);
+
+        /** Packs a range of vertices into 16 bits. */
+        void Pack(int begin, int end);
+
+        /** Runs body(begin, end) over every vertex, in parallel if a job system is set. */
+        template <typename Body>
+        void ForEach(const Body& body)
+        {
+            int count = GetVertexCount();
+            if ( jobs != NULL )
+                jobs->ParallelFor(0, count, VERTEX_GRAIN, body);
+            else if ( count > 0 )
+                body(0, count);
+        };
+
+        static constexpr float SMOOTHING = 0.004f; // Marangoni diffusivity, in squared mesh units per second.
+        static constexpr float DRAINAGE  = 0.1f;   // Speed at which a rest thickness film slides down, in mesh units per second.
+        static constexpr float REPLENISH = 0.02f;  // Fraction of the gap to the rest thickness closed per second.
+        static constexpr float STABILITY = 0.45f;  // Largest fraction of a vertex's film that may flow out per substep.
+        static const int MAX_STEPS    = 8;         // Fixed steps run per call at most, so slow frames can't snowball.
+        static const int VERTEX_GRAIN = 4096;      // Vertices stepped per job.
+
+        std::vector<glm::vec3> positions; // Rest position of every vertex.
+        std::vector<int>   rowStart;      // First entry of each vertex's row in columns and weights, plus an end.
+        std::vector<int>   columns;       // Neighbouring vertex of every directed edge.
+        std::vector<float> weights;       // Laplacian weight of every directed edge, one over its squared length.
+        std::vector<float> smoothing;     // Marangoni flux factor of every directed edge.
+        std::vector<float> heights;       // Height of every vertex against gravity, for the current step.
+        std::vector<float> slopes;        // Drainage flux factor of every directed edge, for the current step.
+        std::vector<float> thickness;     // Film thickness of every vertex in nanometres.
+        std::vector<float> next;          // Thickness being written by the current substep.
+        std::vector<uint16_t> packed;     // Thickness of every vertex as a fraction of MAX_THICKNESS.
+        float maxWeight;                  // Largest sum of weights over any vertex's row.
+        float maxLength;                  // Longest edge in the mesh.
+        float accumulator;                // Time not yet stepped, in seconds.
+        JobSystem* jobs;                  // Job system for the parallel passes, may be NULL.
+};
+
+#endif
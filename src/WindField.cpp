@@ -0,0 +1,329 @@
+#include "WindField.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+// SSE2 is part of every x86-64 target, so the noise uses it without a runtime check
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define WINDFIELD_SSE
+#endif
+
+static const uint32_t HASH_X   = 0x8da6b343u; // Large odd multipliers that spread the lattice coordinates.
+static const uint32_t HASH_Y   = 0xd8163841u;
+static const uint32_t HASH_Z   = 0xcb1ab31fu;
+static const uint32_t HASH_MIX = 0x2c1b3c6du;
+static const int      MASK     = WindField::PERIOD - 1;
+
+/** Scrambles the combined lattice hash; the top three bits pick the corner's gradient. */
+static inline uint32_t Mix(uint32_t h)
+{
+    h ^= h >> 15;
+    h *= HASH_MIX;
+    h ^= h >> 12;
+    return h;
+}
+
+/**
+ *  Gets the gradient of a periodic gradient noise at a point in lattice coordinates.
+ *  Every corner's gradient is one of the eight diagonals, picked by the sign bits of its hash.
+ */
+static glm::vec3 NoiseGradient(float x, float y, float z, uint32_t seed)
+{
+    float fx = std::floor(x);
+    float fy = std::floor(y);
+    float fz = std::floor(z);
+    int   ix = static_cast<int>(fx);
+    int   iy = static_cast<int>(fy);
+    int   iz = static_cast<int>(fz);
+    float p[3]  = { x - fx, y - fy, z - fz };
+    float w[3], dw[3];
+    for (int a = 0; a < 3; a++)
+    {
+        // Quintic fade, whose second derivative is zero at the lattice points, and its derivative
+        w[a]  = p[a] * p[a] * p[a] * (p[a] * (p[a] * 6.0f - 15.0f) + 10.0f);
+        dw[a] = 30.0f * p[a] * p[a] * (p[a] - 1.0f) * (p[a] - 1.0f);
+    }
+
+    uint32_t hx[2] = { static_cast<uint32_t>(ix & MASK) * HASH_X, static_cast<uint32_t>((ix + 1) & MASK) * HASH_X };
+    uint32_t hy[2] = { static_cast<uint32_t>(iy & MASK) * HASH_Y, static_cast<uint32_t>((iy + 1) & MASK) * HASH_Y };
+    uint32_t hz[2] = { static_cast<uint32_t>(iz & MASK) * HASH_Z, static_cast<uint32_t>((iz + 1) & MASK) * HASH_Z };
+
+    glm::vec3 gradient(0.0f);
+    for (int c = 0; c < 8; c++)
+    {
+        int cx = c & 1;
+        int cy = (c >> 1) & 1;
+        int cz = c >> 2;
+        uint32_t h = Mix(hx[cx] ^ hy[cy] ^ hz[cz] ^ seed);
+
+        float sx = (h & 0x80000000u) ? -1.0f : 1.0f;
+        float sy = (h & 0x40000000u) ? -1.0f : 1.0f;
+        float sz = (h & 0x20000000u) ? -1.0f : 1.0f;
+        float value = sx * (p[0] - cx) + sy * (p[1] - cy) + sz * (p[2] - cz);
+
+        float wx  = cx ? w[0] : 1.0f - w[0];
+        float wy  = cy ? w[1] : 1.0f - w[1];
+        float wz  = cz ? w[2] : 1.0f - w[2];
+        float dwx = cx ? dw[0] : -dw[0];
+        float dwy = cy ? dw[1] : -dw[1];
+        float dwz = cz ? dw[2] : -dw[2];
+        float weight = wx * wy * wz;
+
+        gradient.x += dwx * wy * wz * value + weight * sx;
+        gradient.y += wx * dwy * wz * value + weight * sy;
+        gradient.z += wx * wy * dwz * value + weight * sz;
+    }
+
+    return gradient;
+}
+
+#ifdef WINDFIELD_SSE
+/** Multiplies four 32-bit integers, keeping the low halves; SSE2 only multiplies two at a time. */
+static inline __m128i MulLo(__m128i a, __m128i b)
+{
+    __m128i even = _mm_mul_epu32(a, b);
+    __m128i odd  = _mm_mul_epu32(_mm_srli_si128(a, 4), _mm_srli_si128(b, 4));
+    return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)), _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+}
+
+/** Rounds four floats down, returning them as floats and as integers. */
+static inline __m128 Floor(__m128 x, __m128i* whole)
+{
+    __m128i truncated = _mm_cvttps_epi32(x);
+    __m128  back      = _mm_cvtepi32_ps(truncated);
+    __m128  over      = _mm_cmpgt_ps(back, x); // Negative values truncate up, so step them back down
+    *whole = _mm_add_epi32(truncated, _mm_castps_si128(over));
+    return _mm_sub_ps(back, _mm_and_ps(over, _mm_set1_ps(1.0f)));
+}
+
+/** NoiseGradient for four points at once. */
+static void NoiseGradient4(__m128 x, __m128 y, __m128 z, uint32_t seed, __m128* gx, __m128* gy, __m128* gz)
+{
+    const __m128  one   = _mm_set1_ps(1.0f);
+    const __m128i mask  = _mm_set1_epi32(MASK);
+    const __m128i step  = _mm_set1_epi32(1);
+    const __m128i mix   = _mm_set1_epi32(static_cast<int>(HASH_MIX));
+    const __m128i signX = _mm_set1_epi32(static_cast<int>(0x80000000u));
+
+    __m128i ix, iy, iz;
+    __m128 p[3] = { _mm_sub_ps(x, Floor(x, &ix)), _mm_sub_ps(y, Floor(y, &iy)), _mm_sub_ps(z, Floor(z, &iz)) };
+    __m128 w[2][3], dw[2][3];
+    for (int a = 0; a < 3; a++)
+    {
+        __m128 t  = p[a];
+        __m128 t2 = _mm_mul_ps(t, t);
+        __m128 tm = _mm_sub_ps(t, one);
+        __m128 fade = _mm_mul_ps(_mm_mul_ps(t2, t),
+                                 _mm_add_ps(_mm_mul_ps(t, _mm_sub_ps(_mm_mul_ps(t, _mm_set1_ps(6.0f)), _mm_set1_ps(15.0f))), _mm_set1_ps(10.0f)));
+        __m128 slope = _mm_mul_ps(_mm_set1_ps(30.0f), _mm_mul_ps(t2, _mm_mul_ps(tm, tm)));
+        w[0][a]  = _mm_sub_ps(one, fade);
+        w[1][a]  = fade;
+        dw[0][a] = _mm_sub_ps(_mm_setzero_ps(), slope);
+        dw[1][a] = slope;
+    }
+
+    __m128i hx[2] = { MulLo(_mm_and_si128(ix, mask), _mm_set1_epi32(static_cast<int>(HASH_X))),
+                      MulLo(_mm_and_si128(_mm_add_epi32(ix, step), mask), _mm_set1_epi32(static_cast<int>(HASH_X))) };
+    __m128i hy[2] = { MulLo(_mm_and_si128(iy, mask), _mm_set1_epi32(static_cast<int>(HASH_Y))),
+                      MulLo(_mm_and_si128(_mm_add_epi32(iy, step), mask), _mm_set1_epi32(static_cast<int>(HASH_Y))) };
+    __m128i hz[2] = { MulLo(_mm_and_si128(iz, mask), _mm_set1_epi32(static_cast<int>(HASH_Z))),
+                      MulLo(_mm_and_si128(_mm_add_epi32(iz, step), mask), _mm_set1_epi32(static_cast<int>(HASH_Z))) };
+    __m128i seeds = _mm_set1_epi32(static_cast<int>(seed));
+
+    __m128 ax = _mm_setzero_ps();
+    __m128 ay = _mm_setzero_ps();
+    __m128 az = _mm_setzero_ps();
+    for (int c = 0; c < 8; c++)
+    {
+        int cx = c & 1;
+        int cy = (c >> 1) & 1;
+        int cz = c >> 2;
+
+        __m128i h = _mm_xor_si128(_mm_xor_si128(hx[cx], hy[cy]), _mm_xor_si128(hz[cz], seeds));
+        h = _mm_xor_si128(h, _mm_srli_epi32(h, 15));
+        h = MulLo(h, mix);
+        h = _mm_xor_si128(h, _mm_srli_epi32(h, 12));
+
+        // Move the three gradient bits into the sign bits of the corner offsets
+        __m128 sx = _mm_castsi128_ps(_mm_and_si128(h, signX));
+        __m128 sy = _mm_castsi128_ps(_mm_and_si128(_mm_slli_epi32(h, 1), signX));
+        __m128 sz = _mm_castsi128_ps(_mm_and_si128(_mm_slli_epi32(h, 2), signX));
+        __m128 dx = _mm_xor_ps(cx ? _mm_sub_ps(p[0], one) : p[0], sx);
+        __m128 dy = _mm_xor_ps(cy ? _mm_sub_ps(p[1], one) : p[1], sy);
+        __m128 dz = _mm_xor_ps(cz ? _mm_sub_ps(p[2], one) : p[2], sz);
+        __m128 value = _mm_add_ps(_mm_add_ps(dx, dy), dz);
+
+        __m128 wyz    = _mm_mul_ps(w[cy][1], w[cz][2]);
+        __m128 wxz    = _mm_mul_ps(w[cx][0], w[cz][2]);
+        __m128 wxy    = _mm_mul_ps(w[cx][0], w[cy][1]);
+        __m128 weight = _mm_mul_ps(wxy, w[cz][2]);
+
+        ax = _mm_add_ps(ax, _mm_add_ps(_mm_mul_ps(_mm_mul_ps(dw[cx][0], wyz), value), _mm_xor_ps(weight, sx)));
+        ay = _mm_add_ps(ay, _mm_add_ps(_mm_mul_ps(_mm_mul_ps(dw[cy][1], wxz), value), _mm_xor_ps(weight, sy)));
+        az = _mm_add_ps(az, _mm_add_ps(_mm_mul_ps(_mm_mul_ps(dw[cz][2], wxy), value), _mm_xor_ps(weight, sz)));
+    }
+
+    *gx = ax;
+    *gy = ay;
+    *gz = az;
+}
+#endif
+
+WindField::WindField(float scale, float strength, glm::vec3 drift, uint32_t seed)
+{
+    this->inverseScale = 1.0f / scale;
+    this->strength     = strength;
+    this->drift        = drift;
+    seeds[0]   = Mix(seed);
+    seeds[1]   = Mix(seed ^ 0x9e3779b9u);
+    time       = 0.0f;
+    resolution = 0;
+    jobs       = NULL;
+}
+
+void WindField::Sample(const float* x, const float* y, const float* z, float* vx, float* vy, float* vz, int count) const
+{
+    // The pattern moves with the drift, which is the same as the points moving against it; keep the offset inside
+    // one tile so the lattice coordinates don't lose precision as time goes on
+    glm::vec3 offset = glm::mod(drift * (time * inverseScale), glm::vec3(static_cast<float>(PERIOD)));
+
+    float lx[BATCH];
+    float ly[BATCH];
+    float lz[BATCH];
+    for (int start = 0; start < count; start += BATCH)
+    {
+        int batch = std::min(BATCH, count - start);
+        for (int i = 0; i < batch; i++)
+        {
+            lx[i] = x[start + i] * inverseScale - offset.x;
+            ly[i] = y[start + i] * inverseScale - offset.y;
+            lz[i] = z[start + i] * inverseScale - offset.z;
+        }
+
+        if ( resolution > 0 )
+            Lookup(lx, ly, lz, vx + start, vy + start, vz + start, batch);
+        else
+            Evaluate(lx, ly, lz, vx + start, vy + start, vz + start, batch);
+    }
+}
+
+glm::vec3 WindField::Sample(glm::vec3 position) const
+{
+    glm::vec3 velocity;
+    Sample(&position.x, &position.y, &position.z, &velocity.x, &velocity.y, &velocity.z, 1);
+    return velocity;
+}
+
+void WindField::Evaluate(const float* lx, const float* ly, const float* lz, float* vx, float* vy, float* vz, int count) const
+{
+    int i = 0;
+#ifdef WINDFIELD_SSE
+    const __m128 scale = _mm_set1_ps(strength);
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128 x = _mm_loadu_ps(lx + i);
+        __m128 y = _mm_loadu_ps(ly + i);
+        __m128 z = _mm_loadu_ps(lz + i);
+
+        __m128 ax, ay, az, bx, by, bz;
+        NoiseGradient4(x, y, z, seeds[0], &ax, &ay, &az);
+        NoiseGradient4(x, y, z, seeds[1], &bx, &by, &bz);
+
+        _mm_storeu_ps(vx + i, _mm_mul_ps(scale, _mm_sub_ps(_mm_mul_ps(ay, bz), _mm_mul_ps(az, by))));
+        _mm_storeu_ps(vy + i, _mm_mul_ps(scale, _mm_sub_ps(_mm_mul_ps(az, bx), _mm_mul_ps(ax, bz))));
+        _mm_storeu_ps(vz + i, _mm_mul_ps(scale, _mm_sub_ps(_mm_mul_ps(ax, by), _mm_mul_ps(ay, bx))));
+    }
+#endif
+    for (; i < count; i++)
+    {
+        glm::vec3 velocity = strength * glm::cross(NoiseGradient(lx[i], ly[i], lz[i], seeds[0]),
+                                                   NoiseGradient(lx[i], ly[i], lz[i], seeds[1]));
+        vx[i] = velocity.x;
+        vy[i] = velocity.y;
+        vz[i] = velocity.z;
+    }
+}
+
+void WindField::Lookup(const float* lx, const float* ly, const float* lz, float* vx, float* vy, float* vz, int count) const
+{
+    int   wrap    = resolution - 1;
+    float samples = static_cast<float>(resolution) / PERIOD;
+
+    for (int i = 0; i < count; i++)
+    {
+        float gx = lx[i] * samples;
+        float gy = ly[i] * samples;
+        float gz = lz[i] * samples;
+        float fx = std::floor(gx);
+        float fy = std::floor(gy);
+        float fz = std::floor(gz);
+        float tx = gx - fx;
+        float ty = gy - fy;
+        float tz = gz - fz;
+
+        // The tile repeats, so every corner wraps around
+        int x0 = static_cast<int>(fx) & wrap;
+        int y0 = static_cast<int>(fy) & wrap;
+        int z0 = static_cast<int>(fz) & wrap;
+        int x1 = (x0 + 1) & wrap;
+        int y1 = (y0 + 1) & wrap;
+        int z1 = (z0 + 1) & wrap;
+        int r00 = (y0 + z0 * resolution) * resolution;
+        int r10 = (y1 + z0 * resolution) * resolution;
+        int r01 = (y0 + z1 * resolution) * resolution;
+        int r11 = (y1 + z1 * resolution) * resolution;
+
+        const glm::vec3* tile = baked.data();
+        glm::vec3 front = glm::mix(glm::mix(tile[r00 + x0], tile[r00 + x1], tx), glm::mix(tile[r10 + x0], tile[r10 + x1], tx), ty);
+        glm::vec3 back  = glm::mix(glm::mix(tile[r01 + x0], tile[r01 + x1], tx), glm::mix(tile[r11 + x0], tile[r11 + x1], tx), ty);
+        glm::vec3 velocity = glm::mix(front, back, tz);
+
+        vx[i] = velocity.x;
+        vy[i] = velocity.y;
+        vz[i] = velocity.z;
+    }
+}
+
+void WindField::Bake(int resolution)
+{
+    // Wrapping uses a mask, so round up to a power of two
+    int size = PERIOD;
+    while ( size < resolution )
+        size *= 2;
+
+    baked.resize(size * size * size);
+
+    // Evaluate the noise one row of the tile at a time
+    float spacing = static_cast<float>(PERIOD) / size;
+    auto bakeRows = [this, size, spacing](int begin, int end)
+    {
+        std::vector<float> lx(size), ly(size), lz(size), vx(size), vy(size), vz(size);
+        for (int row = begin; row < end; row++)
+        {
+            for (int x = 0; x < size; x++)
+            {
+                lx[x] = x * spacing;
+                ly[x] = (row % size) * spacing;
+                lz[x] = (row / size) * spacing;
+            }
+
+            Evaluate(lx.data(), ly.data(), lz.data(), vx.data(), vy.data(), vz.data(), size);
+            for (int x = 0; x < size; x++)
+                baked[row * size + x] = glm::vec3(vx[x], vy[x], vz[x]);
+        }
+    };
+
+    if ( jobs != NULL )
+        jobs->ParallelFor(0, size * size, 64, bakeRows);
+    else
+        bakeRows(0, size * size);
+
+    this->resolution = size;
+}
+
+void WindField::ClearBake()
+{
+    resolution = 0;
+    baked      = std::vector<glm::vec3>();
+}
@@ -0,0 +1,95 @@
+#ifndef WINDFIELD
+#define WINDFIELD
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "JobSystem.hpp"
+
+/**
+ *  A procedural breeze: a cheap, divergence free wind made from curl noise, for scenes that don't need AirFlow.
+ *  The velocity is the cross product of the gradients of two gradient noises, which is the curl of one noise times
+ *  the gradient of the other, so no air piles up or thins out anywhere. The noise tiles every PERIOD lattice cells
+ *  and the whole pattern drifts with the wind over time.
+ *  Positions are sampled in batches of separate x, y and z arrays, four at a time with SSE. Baking stores one tile
+ *  in a grid that is sampled with trilinear interpolation instead, which is cheaper when the points come in spatial
+ *  order, at the cost of memory and some accuracy.
+ */
+class WindField
+{
+    public:
+        /**
+         *  Creates a wind field.
+         *  @param scale    - The width in world units of one noise cell, about the size of a gust.
+         *  @param strength - The typical wind speed.
+         *  @param drift    - The velocity at which the gust pattern moves through the scene.
+         *  @param seed     - Picks one of many different patterns.
+         */
+        WindField(float scale, float strength, glm::vec3 drift, uint32_t seed = 1);
+
+        /**
+         *  Moves the gust pattern along with the drift.
+         *  @param dt - The time that has passed in seconds.
+         */
+        void Advance(float dt) { time += dt; };
+
+        /**
+         *  Gets the wind at many points at once, from the baked grid if there is one.
+         *  @param x, y, z    - The world space coordinates of the points.
+         *  @param vx, vy, vz - Receive the wind velocity at each point.
+         *  @param count      - The number of points.
+         */
+        void Sample(const float* x, const float* y, const float* z, float* vx, float* vy, float* vz, int count) const;
+
+        /** Gets the wind at a single world space point. */
+        glm::vec3 Sample(glm::vec3 position) const;
+
+        /**
+         *  Evaluates the noise for every sample of one tile and keeps them, so later samples only interpolate.
+         *  The interpolated wind is smooth but no longer exactly divergence free.
+         *  @param resolution - Samples along each side of the tile; a power of two at least PERIOD.
+         */
+        void Bake(int resolution);
+
+        /** Drops the baked grid, going back to evaluating the noise for every sample. */
+        void ClearBake();
+
+        /** Checks whether samples come from the baked grid. */
+        bool IsBaked() const { return resolution > 0; };
+
+        /**
+         *  Sets the job system used to bake in parallel.
+         *  @param jobs - The job system to use, or NULL to run on the calling thread.
+         */
+        void SetJobSystem(JobSystem* jobs) { this->jobs = jobs; };
+
+        static const int PERIOD = 16; // Lattice cells after which the noise repeats; a power of two.
+
+    private:
+        /**
+         *  Evaluates the curl noise at points given in lattice coordinates.
+         *  @param lx, ly, lz - The lattice coordinates of the points.
+         *  @param vx, vy, vz - Receive the wind velocity at each point.
+         *  @param count      - The number of points.
+         */
+        void Evaluate(const float* lx, const float* ly, const float* lz, float* vx, float* vy, float* vz, int count) const;
+
+        /** Interpolates the baked grid at points given in lattice coordinates. */
+        void Lookup(const float* lx, const float* ly, const float* lz, float* vx, float* vy, float* vz, int count) const;
+
+        static constexpr int BATCH = 256; // Points moved into lattice coordinates at a time.
+
+        float     inverseScale; // Lattice cells per world unit.
+        float     strength;     // Typical wind speed.
+        glm::vec3 drift;        // Velocity of the gust pattern in world units per second.
+        uint32_t  seeds[2];     // Seeds of the two noises.
+        float     time;         // Seconds the pattern has been drifting.
+
+        int resolution;               // Samples along each side of the baked tile, or 0 if nothing is baked.
+        std::vector<glm::vec3> baked; // Baked wind of one tile; the components of a sample share a cache line.
+        JobSystem* jobs;              // Job system used for baking, may be NULL.
+};
+
+#endif
@@ -0,0 +1,44 @@
+/**
+ *  Converts a text point cloud, a count line and then a line of x y z per point, into the binary columnar format
+ *  PointCloud maps.
+ *  Usage: OGLBubblesCloudConvert <input.txt> <output.opc> [--int16]
+ *  With --int16 the columns are quantized over the cloud's bounds, at a third of the size of the text's floats.
+ */
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+#include "PointCloud.hpp"
+
+int main(int argc, char** argv)
+{
+    if ( argc < 3 || (argc == 4 && std::strcmp(argv[3], "--int16") != 0) || argc > 4 )
+    {
+        std::fprintf(stderr, "Usage: %s <input.txt> <output.opc> [--int16]\n", argv[0]);
+        return 1;
+    }
+
+    PointCloud::Encoding encoding = argc == 4 ? PointCloud::INT16 : PointCloud::FLOAT32;
+    auto start = std::chrono::steady_clock::now();
+    if ( !PointCloud::Convert(argv[1], argv[2], encoding) )
+    {
+        std::fprintf(stderr, "Cannot convert %s to %s\n", argv[1], argv[2]);
+        return 1;
+    }
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    PointCloud cloud;
+    if ( !cloud.Open(argv[2]) )
+    {
+        std::fprintf(stderr, "Cannot read back %s\n", argv[2]);
+        return 1;
+    }
+
+    const PointCloud::Header& header = cloud.GetHeader();
+    std::printf("%d points, %s, in %.1f ms\n", cloud.GetCount(), encoding == PointCloud::INT16 ? "int16" : "float", ms);
+    std::printf("bounds (%g, %g, %g) to (%g, %g, %g)\n", header.min[0], header.min[1], header.min[2],
+                header.max[0], header.max[1], header.max[2]);
+    if ( encoding == PointCloud::INT16 )
+        std::printf("step (%g, %g, %g)\n", header.scale[0], header.scale[1], header.scale[2]);
+    return 0;
+}